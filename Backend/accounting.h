@@ -0,0 +1,214 @@
+/**
+ * @file accounting.h
+ * @brief Heap allocations and socket syscalls charged to each request, in CTF_ACCOUNTING builds.
+ *
+ * Built with -DCTF_ACCOUNTING (cmake -DCTF_ACCOUNTING=ON), the binary that
+ * expands CTF_ACCOUNTING_ALLOCATION_HOOKS() routes every operator new
+ * through accounting::allocate(), which charges the allocation to the Usage
+ * the calling thread is working for (see Scope). Socket calls are charged
+ * where they are made, with accounting::syscall(). Without the flag Scope
+ * and syscall() are empty and the hooks expand to nothing, so release
+ * builds keep the default allocator and pay nothing.
+ */
+
+#ifndef ACCOUNTING_H
+#define ACCOUNTING_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include "latency.h"
+#include "metrics.h"
+
+namespace accounting {
+
+#ifdef CTF_ACCOUNTING
+constexpr bool kEnabled = true;
+#else
+constexpr bool kEnabled = false;
+#endif
+
+/**
+ * @brief Work charged to one request.
+ *
+ * A request can move between threads (connection thread, worker, DB loop),
+ * and for a moment two of them may charge it at once, so the counts are
+ * atomic. Copying takes a snapshot, used to carry the usage so far to the
+ * thread that finishes the request.
+ */
+struct Usage {
+    std::atomic<uint64_t> allocations{ 0 };
+    /** @brief Bytes requested from operator new. */
+    std::atomic<uint64_t> bytes{ 0 };
+    /** @brief recv/sendmsg calls on the request's socket. */
+    std::atomic<uint64_t> syscalls{ 0 };
+
+    Usage() = default;
+
+    Usage(const Usage& other)
+        : allocations(other.allocations.load(std::memory_order_relaxed)),
+          bytes(other.bytes.load(std::memory_order_relaxed)),
+          syscalls(other.syscalls.load(std::memory_order_relaxed)) {}
+
+    Usage& operator=(const Usage& other) {
+        allocations.store(other.allocations.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        bytes.store(other.bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        syscalls.store(other.syscalls.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+};
+
+/** @brief The usage the calling thread is charging, or null outside any Scope. */
+inline Usage*& current() {
+    static thread_local Usage* usage = nullptr;
+    return usage;
+}
+
+/** @brief A copy of the calling thread's usage so far, to hand to the thread that continues the request. */
+inline Usage carry() {
+    Usage* usage = current();
+    return usage != nullptr ? *usage : Usage();
+}
+
+/**
+ * @brief Charges the calling thread's allocations and syscalls to a request until destroyed.
+ *
+ * Scopes nest: the innermost one is charged, and the previous one is
+ * restored on exit.
+ */
+class Scope {
+public:
+    explicit Scope(Usage* usage) {
+        if constexpr (kEnabled) {
+            previous = current();
+            current() = usage;
+        }
+    }
+
+    ~Scope() {
+        if constexpr (kEnabled) current() = previous;
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    Usage* previous = nullptr;
+};
+
+/** @brief Charges one socket syscall to the current request. */
+inline void syscall() {
+    if constexpr (kEnabled) {
+        if (Usage* usage = current()) usage->syscalls.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/** @brief Charges one allocation to the current request; called by the hooks. */
+inline void charge(std::size_t size) {
+    if (Usage* usage = current()) {
+        usage->allocations.fetch_add(1, std::memory_order_relaxed);
+        usage->bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+/** @brief operator new as the standard library defines it (retrying through the new_handler), plus charge(). */
+inline void* allocate(std::size_t size) {
+    charge(size);
+    if (size == 0) size = 1;
+    while (true) {
+        if (void* p = std::malloc(size)) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) throw std::bad_alloc();
+        handler();
+    }
+}
+
+/** @brief Over-aligned operator new. */
+inline void* allocate(std::size_t size, std::align_val_t alignment) {
+    charge(size);
+    std::size_t align = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+    if (size == 0) size = 1;
+    while (true) {
+        void* p = nullptr;
+        if (posix_memalign(&p, align, size) == 0) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) throw std::bad_alloc();
+        handler();
+    }
+}
+
+/**
+ * @brief Requests, allocations, allocated bytes and socket syscalls summed per command.
+ *
+ * Commands are slotted as in RequestLatency. Totals are per reply, so a
+ * mean per request is a total divided by requests.
+ */
+class CommandUsage {
+public:
+    void add(Command cmd, const Usage& usage) {
+        Slot& slot = slots[RequestLatency::slot(cmd)];
+        slot.requests.inc();
+        slot.allocations.inc(usage.allocations.load(std::memory_order_relaxed));
+        slot.bytes.inc(usage.bytes.load(std::memory_order_relaxed));
+        slot.syscalls.inc(usage.syscalls.load(std::memory_order_relaxed));
+    }
+
+    uint64_t requests(size_t slot) const { return slots[slot].requests.get(); }
+    uint64_t allocations(size_t slot) const { return slots[slot].allocations.get(); }
+    uint64_t bytes(size_t slot) const { return slots[slot].bytes.get(); }
+    uint64_t syscalls(size_t slot) const { return slots[slot].syscalls.get(); }
+
+private:
+    struct Slot {
+        Counter requests;
+        Counter allocations;
+        Counter bytes;
+        Counter syscalls;
+    };
+
+    std::array<Slot, RequestLatency::kSlots> slots;
+};
+
+} // namespace accounting
+
+#ifdef CTF_ACCOUNTING
+/**
+ * @brief Replaces the global allocation functions with counting ones.
+ *
+ * Expand once, at namespace scope, in the translation unit that defines
+ * main(); replacement allocation functions may not be inline.
+ */
+#define CTF_ACCOUNTING_ALLOCATION_HOOKS()                                                                           \
+    void* operator new(std::size_t size) { return ::accounting::allocate(size); }                                  \
+    void* operator new[](std::size_t size) { return ::accounting::allocate(size); }                                \
+    void* operator new(std::size_t size, const std::nothrow_t&) noexcept {                                        \
+        try { return ::accounting::allocate(size); } catch (...) { return nullptr; }                               \
+    }                                                                                                              \
+    void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {                                      \
+        try { return ::accounting::allocate(size); } catch (...) { return nullptr; }                               \
+    }                                                                                                              \
+    void* operator new(std::size_t size, std::align_val_t align) { return ::accounting::allocate(size, align); }  \
+    void* operator new[](std::size_t size, std::align_val_t align) { return ::accounting::allocate(size, align); }\
+    void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {                \
+        try { return ::accounting::allocate(size, align); } catch (...) { return nullptr; }                        \
+    }                                                                                                              \
+    void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {              \
+        try { return ::accounting::allocate(size, align); } catch (...) { return nullptr; }                        \
+    }                                                                                                              \
+    void operator delete(void* p) noexcept { std::free(p); }                                                       \
+    void operator delete[](void* p) noexcept { std::free(p); }                                                     \
+    void operator delete(void* p, std::size_t) noexcept { std::free(p); }                                          \
+    void operator delete[](void* p, std::size_t) noexcept { std::free(p); }                                        \
+    void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }                                     \
+    void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }                                   \
+    void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }                        \
+    void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#else
+#define CTF_ACCOUNTING_ALLOCATION_HOOKS()
+#endif
+
+#endif // ACCOUNTING_H
@@ -0,0 +1,118 @@
+/**
+ * @file asset_cache.h
+ * @brief In-memory cache of static assets served by the server, with precompressed variants.
+ */
+
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+#include "compression.h"
+#include "instrumented_mutex.h"
+#include "packet.h"
+
+/**
+ * @brief A file loaded into memory together with everything needed to send it.
+ */
+struct Asset {
+    /** @brief The file contents. */
+    std::vector<uint8_t> raw;
+
+    /** @brief CRC32 of raw. */
+    uint32_t rawCRC;
+
+    /** @brief Compressed payload, or empty if compression does not shrink the file. */
+    std::vector<uint8_t> compressed;
+
+    /** @brief CRC32 of compressed. */
+    uint32_t compressedCRC;
+
+    /** @brief Modification time of the file when it was loaded. */
+    time_t mtime;
+};
+
+/**
+ * @brief Counters describing the cache.
+ */
+struct AssetCacheStats {
+    /** @brief Lookups served from memory. */
+    uint64_t hits;
+
+    /** @brief Lookups that loaded the file, first use or after it changed. */
+    uint64_t misses;
+};
+
+/**
+ * @brief Thread-safe cache mapping file paths to loaded assets.
+ *
+ * Each file is read, checksummed and compressed once; later requests share
+ * the same immutable Asset. A file is reloaded when its modification time changes.
+ */
+class AssetCache {
+private:
+    std::unordered_map<std::string, std::shared_ptr<const Asset>> assets;
+    InstrumentedMutex cacheMutex{ locks::site("asset_cache") };
+    std::atomic<uint64_t> hits{ 0 };
+    std::atomic<uint64_t> misses{ 0 };
+
+    static std::shared_ptr<const Asset> load(const std::string& path, time_t mtime) {
+        std::ifstream f(path, std::ios::binary);
+        if (!f.is_open()) return nullptr;
+
+        auto asset = std::make_shared<Asset>();
+        f.seekg(0, std::ios::end);
+        asset->raw.resize(static_cast<size_t>(f.tellg()));
+        f.seekg(0, std::ios::beg);
+        f.read(reinterpret_cast<char*>(asset->raw.data()), asset->raw.size());
+        asset->rawCRC = NetworkPacket::checksum(asset->raw.data(), asset->raw.size());
+        asset->mtime = mtime;
+
+        // Paid once per file version, so use the smallest output zlib can produce.
+        if (compression::compress(asset->raw.data(), asset->raw.size(), asset->compressed, Z_BEST_COMPRESSION)) {
+            asset->compressedCRC = NetworkPacket::checksum(asset->compressed.data(), asset->compressed.size());
+        } else {
+            asset->compressedCRC = 0;
+        }
+        return asset;
+    }
+
+public:
+    /**
+     * @brief Retrieves an asset, loading it from disk on first use or after it changes.
+     * @param path The file path.
+     * @return The cached asset, or nullptr if the file cannot be read.
+     */
+    std::shared_ptr<const Asset> get(const std::string& path) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return nullptr;
+
+        std::lock_guard<InstrumentedMutex> lock(cacheMutex);
+        auto it = assets.find(path);
+        if (it != assets.end() && it->second->mtime == st.st_mtime) {
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return it->second;
+        }
+        misses.fetch_add(1, std::memory_order_relaxed);
+        std::shared_ptr<const Asset> asset = load(path, st.st_mtime);
+        if (asset) assets[path] = asset;
+        return asset;
+    }
+
+    /**
+     * @brief Retrieves the cache's counters.
+     * @return A snapshot of the counters.
+     */
+    AssetCacheStats stats() const {
+        return AssetCacheStats{ hits.load(std::memory_order_relaxed), misses.load(std::memory_order_relaxed) };
+    }
+};
+
+#endif // ASSET_CACHE_H
@@ -0,0 +1,978 @@
+/**
+ * @file audit_log.h
+ * @brief Binary packet audit log in segment files, fed through per-thread lock-free rings,
+ *        with rotation, background compression and a disk budget.
+ */
+
+#ifndef AUDIT_LOG_H
+#define AUDIT_LOG_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <zlib.h>
+
+/**
+ * @brief Settings of AuditLogger, read from the "audit" block of db_config.json.
+ */
+struct AuditConfig {
+    /** @brief Write the audit log at all. */
+    bool enabled = true;
+
+    /** @brief Directory holding the segment files; created if missing. */
+    std::string dir = "audit";
+
+    /** @brief A new segment is started once the current one would grow past this many bytes. */
+    uint64_t segmentBytes = 64ull << 20;
+
+    /** @brief Records buffered per thread; further records are dropped until the writer catches up. */
+    size_t ringCapacity = 4096;
+
+    /** @brief Longest a record waits before the writer picks it up. */
+    std::chrono::milliseconds flushInterval{ 50 };
+
+    /** @brief Disk space reserved ahead of the end of the segment, in bytes; 0 disables preallocation. */
+    size_t preallocate = 4 << 20;
+
+    /** @brief A segment holding records is closed once it is this old, even if not full; 0 disables. */
+    std::chrono::milliseconds rotateInterval = std::chrono::hours(1);
+
+    /** @brief Gzip closed segments to audit-NNNNNNNN.seg.gz in the background. */
+    bool compress = true;
+
+    /** @brief zlib level for compressed segments, 1 (fastest) to 9 (smallest). */
+    int compressLevel = 6;
+
+    /** @brief Oldest closed segments are deleted while all segments together exceed this; 0 disables. */
+    uint64_t diskBudget = 1ull << 30;
+};
+
+/** @brief What an audit record describes. */
+enum class AuditEvent : uint8_t {
+    RECEIVED,    /**< A request was accepted. */
+    SENT,        /**< A single-packet reply was sent. */
+    SENT_STREAM, /**< A streamed reply finished. */
+    BATCH,       /**< A BATCH finished; one record for all its entries. */
+    DROPPED,     /**< Written by the logger itself: count records were lost because a ring was full. */
+    USAGE,       /**< CTF_ACCOUNTING builds: heap and socket work of the request answered by the preceding reply. */
+};
+
+/** @brief RECEIVED, SENT and SENT_STREAM: the packet itself. */
+struct AuditPacket {
+    /** @brief Payload size. */
+    uint64_t size;
+
+    /** @brief Payload CRC. */
+    uint32_t crc;
+
+    /** @brief Replies: microseconds from receiving the request to sending this reply. */
+    uint32_t latency;
+};
+
+/** @brief BATCH: the whole exchange. */
+struct AuditBatch {
+    /** @brief Request payload size. */
+    uint64_t size;
+
+    /** @brief Request payload CRC. */
+    uint32_t crc;
+
+    /** @brief Microseconds from receiving the request to sending the combined reply. */
+    uint32_t latency;
+
+    /** @brief Size of the combined reply payload. */
+    uint32_t replySize;
+
+    /** @brief Entries in the batch. */
+    uint16_t entries;
+
+    /** @brief Entries that produced an ERROR. */
+    uint16_t failures;
+};
+
+/** @brief USAGE: heap and socket work charged to the request. */
+struct AuditUsage {
+    /** @brief Bytes requested from operator new. */
+    uint64_t allocatedBytes;
+
+    /** @brief Heap allocations. */
+    uint32_t allocations;
+
+    /** @brief recv/sendmsg calls. */
+    uint32_t syscalls;
+};
+
+/** @brief DROPPED: the gap left by a full ring. */
+struct AuditDropped {
+    /** @brief Records lost. */
+    uint64_t records;
+};
+
+/**
+ * @brief One audit entry, exactly as stored on disk (host byte order).
+ *
+ * Fixed width and trivially copyable: logging is a copy into a ring slot,
+ * writing is a memcpy into the segment, and readers index records directly
+ * in a memory-mapped file. The fields every event shares come first; the
+ * rest is the member of the union named for the event.
+ */
+struct AuditRecord {
+    /** @brief Wall-clock time the record was logged, in nanoseconds since the epoch. */
+    uint64_t timestamp;
+
+    /** @brief Connection the packet belongs to, numbered from 1 in accept order. */
+    uint64_t connection;
+
+    /** @brief Peer address; IPv4 is stored IPv4-mapped (::ffff:a.b.c.d). */
+    std::array<uint8_t, 16> peer;
+
+    /** @brief Request command; for replies, the command being answered (NONE if it was not recognised). */
+    uint32_t command;
+
+    /** @brief Replies, BATCH and USAGE: the reply command (ACK or ERROR); 0 for requests. */
+    uint16_t result;
+
+    AuditEvent event;
+    uint8_t reserved;
+
+    union {
+        AuditPacket packet;
+        AuditBatch batch;
+        AuditUsage usage;
+        AuditDropped dropped;
+    };
+};
+
+static_assert(sizeof(AuditRecord) == 64, "AuditRecord is an on-disk format");
+static_assert(std::is_trivially_copyable<AuditRecord>::value, "AuditRecord is copied as raw bytes");
+
+namespace audit {
+
+/** @brief First bytes of every segment file. */
+constexpr char kMagic[8] = { 'C', 'T', 'F', 'A', 'U', 'D', 'I', 'T' };
+/** @brief Version 2 gave BATCH and USAGE fields of their own instead of reusing the packet ones. */
+constexpr uint32_t kVersion = 2;
+
+/**
+ * @brief Header at the start of each segment; records follow it back to back.
+ */
+struct SegmentHeader {
+    char magic[8];
+    uint32_t version;
+    /** @brief sizeof(AuditRecord), so readers can reject a layout they do not know. */
+    uint32_t recordSize;
+    /** @brief Creation time in nanoseconds. Every record in the previous segment is older. */
+    uint64_t created;
+    uint64_t sequence;
+    uint8_t reserved[32];
+};
+
+static_assert(sizeof(SegmentHeader) == 64, "SegmentHeader is an on-disk format");
+
+/** @brief Current wall-clock time in nanoseconds since the epoch. */
+inline uint64_t now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+/** @brief File name of a segment, e.g. "audit-00000042.seg". */
+inline std::string segmentName(uint64_t sequence) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "audit-%08llu.seg", static_cast<unsigned long long>(sequence));
+    return buf;
+}
+
+/** @brief Suffix added to a segment's name once it is compressed. */
+constexpr char kCompressedSuffix[] = ".gz";
+
+/** @brief Whether a segment path names a compressed segment. */
+inline bool isCompressed(const std::string& path) {
+    return path.size() > 3 && path.compare(path.size() - 3, 3, kCompressedSuffix) == 0;
+}
+
+/**
+ * @brief Recovers the sequence number from a segment file name, compressed or not.
+ * @return False if the name was not made by segmentName(), with or without kCompressedSuffix.
+ */
+inline bool parseSegmentName(const std::string& name, uint64_t& sequence) {
+    size_t end = isCompressed(name) ? name.size() - 3 : name.size();
+    if (end < 11 || name.compare(0, 6, "audit-") != 0 || name.compare(end - 4, 4, ".seg") != 0) {
+        return false;
+    }
+    sequence = 0;
+    for (size_t i = 6; i < end - 4; i++) {
+        if (name[i] < '0' || name[i] > '9') return false;
+        sequence = sequence * 10 + static_cast<uint64_t>(name[i] - '0');
+    }
+    return true;
+}
+
+/**
+ * @brief Lists the segment files in a directory, oldest first.
+ *
+ * While a segment is being compressed both files can exist for a moment;
+ * the uncompressed one is listed.
+ *
+ * @return Pairs of sequence number and path; empty if the directory does not exist.
+ */
+inline std::vector<std::pair<uint64_t, std::string>> listSegments(const std::string& dir) {
+    std::vector<std::pair<uint64_t, std::string>> segments;
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr) return segments;
+    while (dirent* entry = readdir(d)) {
+        uint64_t sequence;
+        if (parseSegmentName(entry->d_name, sequence)) segments.emplace_back(sequence, dir + "/" + entry->d_name);
+    }
+    closedir(d);
+    // ".seg" sorts before ".seg.gz", so the uncompressed copy of a sequence comes first.
+    std::sort(segments.begin(), segments.end());
+    segments.erase(std::unique(segments.begin(), segments.end(),
+                               [](const auto& a, const auto& b) { return a.first == b.first; }),
+                   segments.end());
+    return segments;
+}
+
+/** @brief Parses a textual IPv4 or IPv6 address; all zeros if it is neither. */
+inline std::array<uint8_t, 16> parsePeer(const std::string& ip) {
+    std::array<uint8_t, 16> peer{};
+    in_addr v4;
+    if (inet_pton(AF_INET, ip.c_str(), &v4) == 1) {
+        peer[10] = peer[11] = 0xFF;
+        std::memcpy(peer.data() + 12, &v4, 4);
+    } else {
+        inet_pton(AF_INET6, ip.c_str(), peer.data());
+    }
+    return peer;
+}
+
+/** @brief Formats a stored peer address, unmapping IPv4. */
+inline std::string peerString(const std::array<uint8_t, 16>& peer) {
+    static const uint8_t mapped[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF };
+    char buf[INET6_ADDRSTRLEN];
+    bool v4 = std::memcmp(peer.data(), mapped, sizeof(mapped)) == 0;
+    if (inet_ntop(v4 ? AF_INET : AF_INET6, v4 ? peer.data() + 12 : peer.data(), buf, sizeof(buf)) == nullptr) {
+        return "?";
+    }
+    return buf;
+}
+
+/** @brief Name of an event as printed in audit lines. */
+inline const char* eventName(AuditEvent event) {
+    switch (event) {
+        case AuditEvent::RECEIVED: return "RECEIVED";
+        case AuditEvent::SENT: return "SENT";
+        case AuditEvent::SENT_STREAM: return "SENT STREAM";
+        case AuditEvent::BATCH: return "BATCH";
+        case AuditEvent::DROPPED: return "DROPPED";
+        case AuditEvent::USAGE: return "USAGE";
+    }
+    return "UNKNOWN";
+}
+
+/**
+ * @brief Formats one record as a text line.
+ * @param record The record.
+ * @param out Receives the line, including its newline.
+ */
+inline void format(const AuditRecord& record, std::string& out) {
+    std::time_t seconds = static_cast<std::time_t>(record.timestamp / 1000000000);
+    std::tm utc{};
+    gmtime_r(&seconds, &utc);
+    char time[32];
+    size_t length = std::strftime(time, sizeof(time), "%Y-%m-%dT%H:%M:%S", &utc);
+    std::snprintf(time + length, sizeof(time) - length, ".%06uZ",
+                  static_cast<unsigned>(record.timestamp % 1000000000 / 1000));
+
+    char line[256];
+    int n;
+    if (record.event == AuditEvent::DROPPED) {
+        n = std::snprintf(line, sizeof(line), "%s [DROPPED] Count:%llu\n", time,
+                          static_cast<unsigned long long>(record.dropped.records));
+    } else if (record.event == AuditEvent::BATCH) {
+        n = std::snprintf(line, sizeof(line),
+                          "%s conn=%llu peer=%s [BATCH] Cmd:%u Count:%u OK:%u ERR:%u Size:%llu CRC:0x%x "
+                          "ReplySize:%u Latency:%uus\n",
+                          time, static_cast<unsigned long long>(record.connection), peerString(record.peer).c_str(),
+                          record.command, record.batch.entries, record.batch.entries - record.batch.failures,
+                          record.batch.failures, static_cast<unsigned long long>(record.batch.size), record.batch.crc,
+                          record.batch.replySize, record.batch.latency);
+    } else if (record.event == AuditEvent::USAGE) {
+        n = std::snprintf(line, sizeof(line),
+                          "%s conn=%llu peer=%s [USAGE] Cmd:%u Allocs:%u AllocBytes:%llu Syscalls:%u\n", time,
+                          static_cast<unsigned long long>(record.connection), peerString(record.peer).c_str(),
+                          record.command, record.usage.allocations,
+                          static_cast<unsigned long long>(record.usage.allocatedBytes), record.usage.syscalls);
+    } else {
+        n = std::snprintf(line, sizeof(line), "%s conn=%llu peer=%s [%s] Cmd:%u Size:%llu CRC:0x%x", time,
+                          static_cast<unsigned long long>(record.connection), peerString(record.peer).c_str(),
+                          eventName(record.event), record.command,
+                          static_cast<unsigned long long>(record.packet.size), record.packet.crc);
+        if (n > 0 && record.event != AuditEvent::RECEIVED && static_cast<size_t>(n) < sizeof(line)) {
+            n += std::snprintf(line + n, sizeof(line) - n, " Result:%u Latency:%uus", record.result,
+                               record.packet.latency);
+        }
+        if (n > 0 && static_cast<size_t>(n) < sizeof(line) - 1) {
+            line[n++] = '\n';
+            line[n] = '\0';
+        }
+    }
+    if (n > 0) out.append(line, std::min<size_t>(static_cast<size_t>(n), sizeof(line) - 1));
+}
+
+/**
+ * @brief Reads just the header of a segment, compressed or not.
+ * @return False if the file cannot be read or is too short.
+ */
+inline bool readHeader(const std::string& path, SegmentHeader& header) {
+    gzFile file = gzopen(path.c_str(), "rb");
+    if (file == nullptr) return false;
+    int n = gzread(file, &header, sizeof(header));
+    gzclose(file);
+    return n == static_cast<int>(sizeof(header));
+}
+
+/**
+ * @brief A segment file mapped read-only.
+ *
+ * Compressed segments are inflated into memory instead. A trailing partial
+ * record (a write cut short by a crash) is ignored.
+ */
+class MappedSegment {
+public:
+    /**
+     * @brief Maps a segment and checks its header.
+     * @param path Segment file.
+     * @throw std::runtime_error If the file cannot be mapped or is not a segment of this version.
+     */
+    explicit MappedSegment(const std::string& path) : data(nullptr), length(0) {
+        if (isCompressed(path)) {
+            inflate(path);
+            return;
+        }
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw std::runtime_error("Cannot open " + path);
+        struct stat st {};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SegmentHeader)) {
+            ::close(fd);
+            throw std::runtime_error("Not an audit segment: " + path);
+        }
+        length = static_cast<size_t>(st.st_size);
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) throw std::runtime_error("Cannot map " + path);
+        data = static_cast<const uint8_t*>(mapped);
+        madvise(mapped, length, MADV_SEQUENTIAL);
+        if (!supported(header())) {
+            munmap(mapped, length);
+            throw std::runtime_error("Unsupported audit segment: " + path);
+        }
+    }
+
+    ~MappedSegment() {
+        if (data != nullptr && inflated.empty()) munmap(const_cast<uint8_t*>(data), length);
+    }
+
+    MappedSegment(const MappedSegment&) = delete;
+    MappedSegment& operator=(const MappedSegment&) = delete;
+
+    const SegmentHeader& header() const { return *reinterpret_cast<const SegmentHeader*>(data); }
+
+    /** @brief Complete records in the segment. */
+    size_t size() const { return (length - sizeof(SegmentHeader)) / sizeof(AuditRecord); }
+
+    const AuditRecord* begin() const { return reinterpret_cast<const AuditRecord*>(data + sizeof(SegmentHeader)); }
+    const AuditRecord* end() const { return begin() + size(); }
+
+private:
+    const uint8_t* data;
+    size_t length;
+    std::vector<uint8_t> inflated;
+
+    static bool supported(const SegmentHeader& h) {
+        return std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 && h.version == kVersion &&
+               h.recordSize == sizeof(AuditRecord);
+    }
+
+    void inflate(const std::string& path) {
+        gzFile file = gzopen(path.c_str(), "rb");
+        if (file == nullptr) throw std::runtime_error("Cannot open " + path);
+        gzbuffer(file, 128 * 1024);
+        size_t used = 0;
+        inflated.resize(1 << 20);
+        int n;
+        while ((n = gzread(file, inflated.data() + used, static_cast<unsigned>(inflated.size() - used))) > 0) {
+            used += static_cast<size_t>(n);
+            if (used == inflated.size()) inflated.resize(inflated.size() * 2);
+        }
+        gzclose(file);
+        // A truncated stream (crash while compressing) still yields its complete records.
+        if (used < sizeof(SegmentHeader)) throw std::runtime_error("Not an audit segment: " + path);
+        inflated.resize(used);
+        data = inflated.data();
+        length = used;
+        if (!supported(header())) throw std::runtime_error("Unsupported audit segment: " + path);
+    }
+};
+
+} // namespace audit
+
+/**
+ * @brief Counters describing the audit logger.
+ */
+struct AuditStats {
+    /** @brief Records accepted into a ring. */
+    uint64_t logged;
+
+    /** @brief Records lost because their thread's ring was full. */
+    uint64_t dropped;
+
+    /** @brief Records written to segments. */
+    uint64_t written;
+
+    /** @brief write() calls made. */
+    uint64_t writes;
+
+    /** @brief Bytes written, including segment headers. */
+    uint64_t bytes;
+
+    /** @brief Segment files started. */
+    uint64_t segments;
+
+    /** @brief Closed segments compressed. */
+    uint64_t compressed;
+
+    /** @brief Segments deleted to stay within the disk budget. */
+    uint64_t deleted;
+
+    /** @brief Threads that currently own a ring. */
+    size_t threads;
+};
+
+/**
+ * @brief Single-producer, single-consumer ring owned by one logging thread.
+ *
+ * Only the owning thread advances tail and only the writer advances head,
+ * so a push is a slot copy and one release store. The producer keeps its
+ * own copy of head and only rereads the shared one when the ring looks full.
+ */
+class AuditRing {
+public:
+    /** @param capacity Minimum number of records; rounded up to a power of two. */
+    explicit AuditRing(size_t capacity) : mask(roundUp(capacity) - 1), records(new AuditRecord[mask + 1]) {}
+
+    /** @brief Appends a record (owning thread only); false, and counted as dropped, if the ring is full. */
+    bool push(const AuditRecord& record) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead > mask) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead > mask) {
+                dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        records[t & mask] = record;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Hands every buffered record to a callback (writer thread only).
+     * @return Records consumed.
+     */
+    template <typename F>
+    size_t drain(F&& consume) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        uint64_t t = tail.load(std::memory_order_acquire);
+        for (uint64_t i = h; i != t; i++) consume(records[i & mask]);
+        head.store(t, std::memory_order_release);
+        return static_cast<size_t>(t - h);
+    }
+
+    /** @brief Records dropped so far. */
+    uint64_t drops() const { return dropped.load(std::memory_order_relaxed); }
+
+    /** @brief Set by the owning thread on exit; the writer frees the ring once it is empty. */
+    std::atomic<bool> retired{ false };
+
+    /** @brief Set when the logger is destroyed, so threads stop caching the ring. */
+    std::atomic<bool> closed{ false };
+
+private:
+    // Writer-side and producer-side cursors on separate cache lines.
+    alignas(64) std::atomic<uint64_t> head{ 0 };
+    alignas(64) std::atomic<uint64_t> tail{ 0 };
+    uint64_t cachedHead = 0;
+    std::atomic<uint64_t> dropped{ 0 };
+    alignas(64) size_t mask;
+    std::unique_ptr<AuditRecord[]> records;
+
+    static size_t roundUp(size_t n) {
+        size_t size = 2;
+        while (size < n) size <<= 1;
+        return size;
+    }
+};
+
+/**
+ * @brief Writes the packet audit log off the request path.
+ *
+ * Every thread that logs gets its own AuditRing on first use, so log() is a
+ * timestamp and a few stores with no lock, syscall or shared cache line.
+ * One writer thread wakes every flushInterval, copies whatever the rings
+ * hold and appends it with a single write() to the current segment file
+ * (opened once with O_APPEND). Records are fixed-width binary (see
+ * AuditRecord); segments are named audit-NNNNNNNN.seg and a new one is
+ * started each time the current one reaches segmentBytes or rotateInterval
+ * of age, and on restart. ctf_auditq reads them back.
+ *
+ * Closed segments are handed to a maintenance thread running at the lowest
+ * CPU and I/O priority, which gzips them (audit-NNNNNNNN.seg.gz) and then
+ * deletes the oldest segments while the directory exceeds diskBudget. The
+ * writer only queues a sequence number, so neither step can hold up
+ * logging; segments left uncompressed by a restart are picked up at start.
+ *
+ * Loss is bounded rather than blocking: when a ring is full the record is
+ * dropped and counted, and the writer stores each gap as a DROPPED record.
+ * With preallocate set, space ahead of the end of the segment is reserved
+ * with fallocate(FALLOC_FL_KEEP_SIZE), so appends do not allocate blocks one
+ * at a time and the file size stays exact.
+ */
+class AuditLogger {
+public:
+    /**
+     * @brief Opens a new segment and starts the writer thread.
+     * @param config Directory, segment size, ring size, flush interval and preallocation.
+     */
+    explicit AuditLogger(AuditConfig config)
+        : config(std::move(config)), id(nextId()), active(false), fd(-1), sequence(0), fileSize(0), allocatedEnd(0),
+          retiredDrops(0), reportedDrops(0), logged(0), written(0), writes(0), bytes(0), segments(0), compressed(0),
+          deleted(0), segmentCreated(0), openSequence(0), stopping(false), maintenanceStopping(false) {
+        if (!this->config.enabled) return;
+        this->config.segmentBytes = std::max<uint64_t>(this->config.segmentBytes,
+                                                       sizeof(audit::SegmentHeader) + sizeof(AuditRecord));
+        if (::mkdir(this->config.dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            std::cerr << "Audit log: cannot create " << this->config.dir << ", auditing disabled\n";
+            return;
+        }
+        auto existing = audit::listSegments(this->config.dir);
+        sequence = existing.empty() ? 0 : existing.back().first;
+        for (const auto& segment : existing) {
+            if (!audit::isCompressed(segment.second)) closedSegments.push_back(segment.first);
+        }
+        if (!openSegment()) {
+            std::cerr << "Audit log: cannot open a segment in " << this->config.dir << ", auditing disabled\n";
+            return;
+        }
+        active = true;
+        thread = std::thread(&AuditLogger::run, this);
+        maintenanceThread = std::thread(&AuditLogger::maintain, this);
+    }
+
+    ~AuditLogger() {
+        if (thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(wakeMutex);
+                stopping = true;
+            }
+            wakeCv.notify_one();
+            thread.join();
+        }
+        if (maintenanceThread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(maintenanceMutex);
+                maintenanceStopping = true;
+            }
+            maintenanceCv.notify_one();
+            maintenanceThread.join();
+        }
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (auto& ring : rings) ring->closed.store(true, std::memory_order_release);
+        if (fd >= 0) ::close(fd);
+    }
+
+    AuditLogger(const AuditLogger&) = delete;
+    AuditLogger& operator=(const AuditLogger&) = delete;
+
+    /**
+     * @brief Timestamps a record and queues it for the writer. Never blocks.
+     * @return False if the record was dropped (ring full or auditing disabled).
+     */
+    bool log(AuditRecord record) {
+        if (!active) return false;
+        record.timestamp = audit::now();
+        if (!ring().push(record)) return false;
+        logged.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Retrieves the logger's counters.
+     * @return A snapshot of the counters.
+     */
+    AuditStats stats() const {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        uint64_t dropped = retiredDrops;
+        for (const auto& ring : rings) dropped += ring->drops();
+        return AuditStats{ logged.load(), dropped, written.load(), writes.load(), bytes.load(), segments.load(),
+                           compressed.load(), deleted.load(), rings.size() };
+    }
+
+private:
+    // Rings a thread has registered, one per live logger; released when the thread exits.
+    struct ThreadRings {
+        std::vector<std::pair<uint64_t, std::shared_ptr<AuditRing>>> rings;
+
+        ~ThreadRings() {
+            for (auto& entry : rings) entry.second->retired.store(true, std::memory_order_release);
+        }
+    };
+
+    AuditConfig config;
+    const uint64_t id;
+    bool active;
+    int fd;
+    uint64_t sequence;
+    uint64_t fileSize;
+    uint64_t allocatedEnd;
+    mutable std::mutex ringsMutex;
+    std::vector<std::shared_ptr<AuditRing>> rings;
+    uint64_t retiredDrops;
+    uint64_t reportedDrops;
+    std::atomic<uint64_t> logged;
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> writes;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> segments;
+    std::atomic<uint64_t> compressed;
+    std::atomic<uint64_t> deleted;
+    /** @brief When the open segment was created, for rotateInterval. */
+    uint64_t segmentCreated;
+    /** @brief Sequence of the segment being written, 0 if none; never compressed or deleted. */
+    std::atomic<uint64_t> openSequence;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCv;
+    bool stopping;
+    std::thread thread;
+    std::mutex maintenanceMutex;
+    std::condition_variable maintenanceCv;
+    /** @brief Segments closed by the writer and not yet compressed. */
+    std::deque<uint64_t> closedSegments;
+    bool maintenanceStopping;
+    std::thread maintenanceThread;
+
+    static uint64_t nextId() {
+        static std::atomic<uint64_t> counter{ 0 };
+        return ++counter;
+    }
+
+    /** @brief The calling thread's ring, registering one on first use. */
+    AuditRing& ring() {
+        thread_local ThreadRings local;
+        for (auto& entry : local.rings) {
+            if (entry.first == id) return *entry.second;
+        }
+        // First record from this thread: forget rings of loggers that no longer exist.
+        auto& cached = local.rings;
+        for (size_t i = cached.size(); i-- > 0;) {
+            if (cached[i].second->closed.load(std::memory_order_acquire)) cached.erase(cached.begin() + i);
+        }
+        auto created = std::make_shared<AuditRing>(config.ringCapacity);
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            rings.push_back(created);
+        }
+        cached.emplace_back(id, created);
+        return *created;
+    }
+
+    void run() {
+        std::vector<AuditRecord> batch;
+        std::vector<std::shared_ptr<AuditRing>> snapshot;
+        while (true) {
+            bool stop;
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wakeCv.wait_for(lock, config.flushInterval, [this] { return stopping; });
+                stop = stopping;
+            }
+            collect(snapshot, batch);
+            if (!batch.empty()) writeRecords(batch);
+            // An idle segment is closed once it is old enough; the next record opens a new one.
+            if (fd >= 0 && fileSize > sizeof(audit::SegmentHeader) && config.rotateInterval.count() > 0 &&
+                audit::now() - segmentCreated >= static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(config.rotateInterval).count())) {
+                closeSegment();
+            }
+            if (stop) return;
+        }
+    }
+
+    /** @brief Copies every buffered record into batch and frees rings of exited threads. */
+    void collect(std::vector<std::shared_ptr<AuditRing>>& snapshot, std::vector<AuditRecord>& batch) {
+        batch.clear();
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            snapshot = rings;
+        }
+        uint64_t records = 0;
+        std::vector<AuditRing*> finished;
+        for (const auto& ring : snapshot) {
+            // Read retired before draining: a retired thread pushes nothing more, so one drain empties it.
+            bool gone = ring->retired.load(std::memory_order_acquire);
+            records += ring->drain([&batch](const AuditRecord& record) { batch.push_back(record); });
+            if (gone) finished.push_back(ring.get());
+        }
+        written += records;
+
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (AuditRing* ring : finished) {
+            for (size_t i = 0; i < rings.size(); i++) {
+                if (rings[i].get() != ring) continue;
+                retiredDrops += ring->drops();
+                rings.erase(rings.begin() + i);
+                break;
+            }
+        }
+        uint64_t totalDrops = retiredDrops;
+        for (const auto& ring : rings) totalDrops += ring->drops();
+        if (totalDrops > reportedDrops) {
+            AuditRecord gap{};
+            gap.timestamp = audit::now();
+            gap.event = AuditEvent::DROPPED;
+            gap.dropped.records = totalDrops - reportedDrops;
+            batch.push_back(gap);
+            reportedDrops = totalDrops;
+        }
+    }
+
+    /** @brief Appends records, starting new segments as they fill up. */
+    void writeRecords(const std::vector<AuditRecord>& batch) {
+        size_t done = 0;
+        while (done < batch.size()) {
+            if (fd < 0 || fileSize + sizeof(AuditRecord) > config.segmentBytes) {
+                if (fd >= 0) closeSegment();
+                if (!openSegment()) {
+                    std::cerr << "Audit log: cannot open a new segment, " << (batch.size() - done)
+                              << " records lost\n";
+                    return;
+                }
+            }
+            size_t room = static_cast<size_t>((config.segmentBytes - fileSize) / sizeof(AuditRecord));
+            size_t count = std::min(room, batch.size() - done);
+            if (!append(&batch[done], count * sizeof(AuditRecord))) {
+                std::cerr << "Audit log: write failed, " << (batch.size() - done) << " records lost\n";
+                return;
+            }
+            done += count;
+        }
+    }
+
+    /** @brief Closes the open segment and queues it for compression and the disk budget. */
+    void closeSegment() {
+        ::close(fd);
+        fd = -1;
+        openSequence.store(0);
+        {
+            std::lock_guard<std::mutex> lock(maintenanceMutex);
+            closedSegments.push_back(sequence);
+        }
+        maintenanceCv.notify_one();
+    }
+
+    /** @brief Creates the next segment and writes its header. */
+    bool openSegment() {
+        for (int attempt = 0; attempt < 16; attempt++) {
+            sequence++;
+            std::string path = config.dir + "/" + audit::segmentName(sequence);
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+            if (fd >= 0) break;
+            if (errno != EEXIST) return false;
+        }
+        if (fd < 0) return false;
+        fileSize = allocatedEnd = 0;
+        audit::SegmentHeader header{};
+        std::memcpy(header.magic, audit::kMagic, sizeof(header.magic));
+        header.version = audit::kVersion;
+        header.recordSize = sizeof(AuditRecord);
+        header.created = segmentCreated = audit::now();
+        header.sequence = sequence;
+        if (!append(&header, sizeof(header))) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        openSequence.store(sequence);
+        segments++;
+        return true;
+    }
+
+    /** @brief Maintenance thread: compresses closed segments and enforces the disk budget. */
+    void maintain() {
+        // Lowest CPU and I/O priority for this thread only, so compression yields to request handling.
+        setpriority(PRIO_PROCESS, static_cast<id_t>(::syscall(SYS_gettid)), 19);
+#ifdef SYS_ioprio_set
+        ::syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, 0, 3 << 13 /* IOPRIO_CLASS_IDLE */);
+#endif
+        removeTemporaries();
+        enforceBudget();
+        while (true) {
+            uint64_t next;
+            {
+                std::unique_lock<std::mutex> lock(maintenanceMutex);
+                maintenanceCv.wait(lock, [this] { return maintenanceStopping || !closedSegments.empty(); });
+                if (maintenanceStopping) return;
+                next = closedSegments.front();
+                closedSegments.pop_front();
+            }
+            if (config.compress) compressSegment(next);
+            enforceBudget();
+        }
+    }
+
+    bool maintenanceStopRequested() {
+        std::lock_guard<std::mutex> lock(maintenanceMutex);
+        return maintenanceStopping;
+    }
+
+    /** @brief Deletes partial compressed files left by a stop or crash mid-compression. */
+    void removeTemporaries() {
+        DIR* d = opendir(config.dir.c_str());
+        if (d == nullptr) return;
+        std::vector<std::string> stale;
+        while (dirent* entry = readdir(d)) {
+            std::string name = entry->d_name;
+            if (name.size() > 11 && name.compare(0, 6, "audit-") == 0 &&
+                name.compare(name.size() - 11, 11, ".seg.gz.tmp") == 0) {
+                stale.push_back(config.dir + "/" + name);
+            }
+        }
+        closedir(d);
+        for (const std::string& path : stale) std::remove(path.c_str());
+    }
+
+    /**
+     * @brief Gzips a closed segment into a temporary file, then renames it over and removes the original.
+     *
+     * Readers see either the old or the new file. Stopping abandons the
+     * segment; the next start compresses it again.
+     */
+    void compressSegment(uint64_t seq) {
+        std::string path = config.dir + "/" + audit::segmentName(seq);
+        std::string target = path + audit::kCompressedSuffix;
+        std::string temp = target + ".tmp";
+        int in = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0) return;  // already deleted by the budget
+        posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+        char mode[4] = { 'w', 'b', static_cast<char>('0' + std::clamp(config.compressLevel, 1, 9)), '\0' };
+        gzFile out = gzopen(temp.c_str(), mode);
+        if (out == nullptr) {
+            ::close(in);
+            std::cerr << "Audit log: cannot create " << temp << "\n";
+            return;
+        }
+        std::vector<char> buffer(256 * 1024);
+        bool ok = true;
+        ssize_t n;
+        while ((n = ::read(in, buffer.data(), buffer.size())) != 0) {
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                ok = false;
+                break;
+            }
+            if (gzwrite(out, buffer.data(), static_cast<unsigned>(n)) != static_cast<int>(n) ||
+                maintenanceStopRequested()) {
+                ok = false;
+                break;
+            }
+        }
+        // Done reading: the segment's pages need not stay cached.
+        posix_fadvise(in, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(in);
+        if (gzclose(out) != Z_OK) ok = false;
+        if (!ok || std::rename(temp.c_str(), target.c_str()) != 0) {
+            std::remove(temp.c_str());
+            return;
+        }
+        std::remove(path.c_str());
+        compressed++;
+    }
+
+    /** @brief Deletes the oldest closed segments until all of them fit in diskBudget. */
+    void enforceBudget() {
+        if (config.diskBudget == 0) return;
+        std::vector<std::pair<std::string, uint64_t>> files;
+        uint64_t total = 0;
+        for (const auto& segment : audit::listSegments(config.dir)) {
+            struct stat st {};
+            if (::stat(segment.second.c_str(), &st) != 0) continue;
+            total += static_cast<uint64_t>(st.st_size);
+            if (segment.first != openSequence.load()) files.emplace_back(segment.second, st.st_size);
+        }
+        for (const auto& [path, size] : files) {
+            if (total <= config.diskBudget) break;
+            if (std::remove(path.c_str()) != 0) continue;
+            total -= size;
+            deleted++;
+        }
+    }
+
+    bool append(const void* data, size_t size) {
+        reserve(size);
+        const char* bytesOut = static_cast<const char*>(data);
+        size_t offset = 0;
+        while (offset < size) {
+            ssize_t n = ::write(fd, bytesOut + offset, size - offset);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            offset += static_cast<size_t>(n);
+            writes++;
+        }
+        fileSize += offset;
+        bytes += offset;
+        return offset == size;
+    }
+
+    /** @brief Extends the preallocated region when the next write would run past it. */
+    void reserve(size_t size) {
+        if (config.preallocate == 0 || fileSize + size <= allocatedEnd) return;
+        uint64_t length = std::min<uint64_t>(std::max<uint64_t>(config.preallocate, size),
+                                             std::max<uint64_t>(config.segmentBytes - fileSize, size));
+#ifdef FALLOC_FL_KEEP_SIZE
+        if (::fallocate(fd, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(fileSize), static_cast<off_t>(length)) != 0) {
+            // Filesystem without fallocate support: stop trying.
+            config.preallocate = 0;
+            return;
+        }
+#endif
+        allocatedEnd = fileSize + length;
+    }
+};
+
+#endif // AUDIT_LOG_H
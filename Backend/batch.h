@@ -0,0 +1,111 @@
+/**
+ * @file batch.h
+ * @brief Framing for BATCH packets, which carry several sub-packets in one payload.
+ *
+ * Both the BATCH request and its ACK use the same payload layout: a sequence of
+ *
+ *   | length (4, big-endian) | sub-packet (12-byte header + payload) |
+ *
+ * Sub-replies appear in the same order as the sub-requests.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "checksum.h"
+#include "packet.h"
+
+namespace batch {
+
+/** @brief Most sub-requests accepted in one BATCH. */
+constexpr size_t kMaxEntries = 64;
+
+/** @brief Size of the length prefix before each sub-packet. */
+constexpr size_t kPrefixSize = sizeof(uint32_t);
+
+/**
+ * @brief One sub-packet inside a BATCH payload, pointing into the original buffer.
+ */
+struct Entry {
+    /** @brief The sub-packet's decoded header. */
+    Header header;
+
+    /** @brief The sub-packet's flags. */
+    uint16_t flags;
+
+    /** @brief Pointer to the sub-packet's payload. */
+    const uint8_t* payload;
+};
+
+/**
+ * @brief Splits a BATCH payload into its sub-packets without copying them.
+ * @param data The BATCH payload.
+ * @param length The payload size.
+ * @return The sub-packets in order.
+ * @throw std::runtime_error If a length prefix or sub-header is inconsistent,
+ *        or the batch holds no entries or more than kMaxEntries.
+ */
+inline std::vector<Entry> split(const uint8_t* data, size_t length) {
+    std::vector<Entry> entries;
+    size_t offset = 0;
+    while (offset < length) {
+        if (length - offset < kPrefixSize) {
+            throw std::runtime_error("Truncated batch length prefix");
+        }
+        uint32_t netSize;
+        std::memcpy(&netSize, data + offset, kPrefixSize);
+        uint32_t size = ntohl(netSize);
+        offset += kPrefixSize;
+
+        if (size < sizeof(Header) || size > length - offset) {
+            throw std::runtime_error("Batch entry exceeds batch payload");
+        }
+        Entry entry;
+        entry.header = NetworkPacket::parseHeader(data + offset);
+        entry.flags = NetworkPacket::parseFlags(data + offset);
+        entry.payload = data + offset + sizeof(Header);
+        if (entry.header.payloadSize != size - sizeof(Header)) {
+            throw std::runtime_error("Batch entry size does not match its header");
+        }
+        if (entries.size() == kMaxEntries) {
+            throw std::runtime_error("Too many batch entries");
+        }
+        entries.push_back(entry);
+        offset += size;
+    }
+    if (entries.empty()) {
+        throw std::runtime_error("Empty batch");
+    }
+    return entries;
+}
+
+/**
+ * @brief Appends a length-prefixed packet to a BATCH payload being built.
+ * @param out The payload under construction.
+ * @param packet The sub-packet to append.
+ * @param checksumType Algorithm for the sub-header's payloadCRC, matching the connection.
+ */
+inline void append(std::vector<uint8_t>& out, const NetworkPacket& packet,
+                   ChecksumType checksumType = ChecksumType::CRC32) {
+    uint32_t size = static_cast<uint32_t>(sizeof(Header) + packet.getPayloadSize());
+    uint32_t netSize = htonl(size);
+    size_t offset = out.size();
+    out.resize(offset + kPrefixSize + size);
+    uint32_t crc = checksumType == ChecksumType::CRC32
+        ? packet.getPayloadCrc()
+        : checksum::compute(checksumType, packet.getPayload(), packet.getPayloadSize());
+    std::memcpy(out.data() + offset, &netSize, kPrefixSize);
+    NetworkPacket::encodeHeader(out.data() + offset + kPrefixSize, packet.getCommandID(), packet.getFlags(),
+                                packet.getPayloadSize(), crc);
+    if (packet.getPayloadSize() > 0) {
+        std::memcpy(out.data() + offset + kPrefixSize + sizeof(Header), packet.getPayload(), packet.getPayloadSize());
+    }
+}
+
+} // namespace batch
+
+#endif // BATCH_H
@@ -0,0 +1,137 @@
+/**
+ * @file bench_db_insert.cpp
+ * @brief Compares ways of inserting login attempts against a live PostgreSQL server.
+ *
+ * Usage: db_insert_bench [conninfo] [rows]
+ *
+ * Each method runs inside a transaction that is rolled back, so the
+ * benchmark leaves ctf.login_attempts unchanged.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <libpq-fe.h>
+#include "../pg_binary.h"
+#include "../pipeline.h"
+#include "../statements.h"
+
+namespace {
+
+std::string username(size_t i) { return "bench_user_" + std::to_string(i); }
+std::string password(size_t i) { return "hunter" + std::to_string(i % 1000); }
+std::string address(size_t i) { return "10." + std::to_string((i >> 16) & 0xFF) + "." +
+                                       std::to_string((i >> 8) & 0xFF) + "." + std::to_string(i & 0xFF); }
+
+bool exec(PGconn* conn, const char* sql) {
+    PGresult* res = PQexec(conn, sql);
+    bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+    if (!ok) std::cerr << sql << ": " << PQerrorMessage(conn);
+    PQclear(res);
+    return ok;
+}
+
+bool sequentialText(PGconn* conn, size_t rows) {
+    for (size_t i = 0; i < rows; i++) {
+        std::string user = username(i), pass = password(i), ip = address(i);
+        const char* params[] = { user.c_str(), pass.c_str(), ip.c_str() };
+        PGresult* res = PQexecParams(conn,
+            "INSERT INTO ctf.login_attempts (username, password, ip_address) VALUES ($1, $2, $3)",
+            3, nullptr, params, nullptr, nullptr, 0);
+        bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+        PQclear(res);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+bool sequentialPrepared(PGconn* conn, size_t rows) {
+    for (size_t i = 0; i < rows; i++) {
+        PGresult* res = StatementParams().text(username(i)).text(password(i)).inet(address(i))
+                            .execute(conn, Statement::INSERT_LOGIN_ATTEMPT);
+        bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+        PQclear(res);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+bool pipelined(PGconn* conn, size_t rows) {
+    Pipeline pipeline;
+    size_t inserted = 0;
+    for (size_t i = 0; i < rows; i++) {
+        pipeline.add(Statement::INSERT_LOGIN_ATTEMPT,
+                     StatementParams().text(username(i)).text(password(i)).inet(address(i)),
+                     [&inserted](const PGresult* res) {
+                         if (res != nullptr && PQresultStatus(res) == PGRES_COMMAND_OK) inserted++;
+                     });
+    }
+    return pipeline.run(conn) && inserted == rows;
+}
+
+bool copyBinary(PGconn* conn, size_t rows) {
+    pgbinary::CopyEncoder encoder;
+    for (size_t i = 0; i < rows; i++) {
+        encoder.beginRow(3);
+        encoder.addText(username(i));
+        encoder.addText(password(i));
+        encoder.addInet(address(i));
+    }
+    encoder.finish();
+
+    PGresult* res = PQexec(conn, "COPY ctf.login_attempts (username, password, ip_address) FROM STDIN (FORMAT binary)");
+    bool ready = PQresultStatus(res) == PGRES_COPY_IN;
+    PQclear(res);
+    if (!ready) return false;
+    const std::vector<uint8_t>& data = encoder.data();
+    if (PQputCopyData(conn, reinterpret_cast<const char*>(data.data()), static_cast<int>(data.size())) != 1) return false;
+    if (PQputCopyEnd(conn, nullptr) != 1) return false;
+    bool ok = true;
+    while ((res = PQgetResult(conn)) != nullptr) {
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) ok = false;
+        PQclear(res);
+    }
+    return ok;
+}
+
+void run(PGconn* conn, const char* name, size_t rows, const std::function<bool(PGconn*, size_t)>& method) {
+    if (!exec(conn, "BEGIN")) return;
+    auto start = std::chrono::steady_clock::now();
+    bool ok = method(conn, rows);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    exec(conn, "ROLLBACK");
+
+    std::cout << std::left << std::setw(24) << name;
+    if (!ok) {
+        std::cout << "FAILED: " << PQerrorMessage(conn) << "\n";
+        return;
+    }
+    std::cout << std::right << std::setw(10) << std::fixed << std::setprecision(1) << seconds * 1000 << " ms"
+              << std::setw(14) << std::setprecision(0) << rows / seconds << " rows/s\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* conninfo = argc > 1 ? argv[1] : "dbname=ctf";
+    size_t rows = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10000;
+
+    PGconn* conn = PQconnectdb(conninfo);
+    if (PQstatus(conn) != CONNECTION_OK || !prepareStatements(conn)) {
+        std::cerr << "Connection failed: " << PQerrorMessage(conn);
+        PQfinish(conn);
+        return 1;
+    }
+
+    std::cout << "Inserting " << rows << " rows per method\n";
+    run(conn, "PQexecParams (text)", rows, sequentialText);
+    run(conn, "PQexecPrepared", rows, sequentialPrepared);
+    run(conn, "Pipeline", rows, pipelined);
+    run(conn, "COPY (binary)", rows, copyBinary);
+
+    PQfinish(conn);
+    return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * @file bench_login_store.cpp
+ * @brief Compares sustained insert rate and memory of the PostgreSQL and SQLite login stores.
+ *
+ * Usage: login_store_bench [rows] [batch] [sqlite_path] [conninfo]
+ *
+ * Each backend runs in its own child process so that its peak RSS is not
+ * inflated by the other. For PostgreSQL the peak RSS of the server backend
+ * serving the connection is reported too when it runs on this machine,
+ * since that is the memory a local install costs. Rows written to
+ * PostgreSQL are deleted afterwards; the SQLite file is removed.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <libpq-fe.h>
+#include "../pg_login_store.h"
+#include "../sqlite_login_store.h"
+
+namespace {
+
+std::vector<LoginAttempt> makeBatch(size_t first, size_t count) {
+    std::vector<LoginAttempt> batch;
+    batch.reserve(count);
+    for (size_t i = first; i < first + count; i++) {
+        batch.push_back(LoginAttempt{ "bench_user_" + std::to_string(i), "hunter" + std::to_string(i % 1000),
+                                      "10." + std::to_string((i >> 16) & 0xFF) + "." +
+                                          std::to_string((i >> 8) & 0xFF) + "." + std::to_string(i & 0xFF) });
+    }
+    return batch;
+}
+
+/** @brief Peak resident set size of a process in KiB, or 0 if it cannot be read. */
+long peakRssKb(const std::string& pid) {
+    std::ifstream status("/proc/" + pid + "/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) return std::strtol(line.c_str() + 6, nullptr, 10);
+    }
+    return 0;
+}
+
+bool writeAll(LoginStore& store, size_t rows, size_t batchSize, double& seconds) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t done = 0; done < rows; done += batchSize) {
+        size_t rejected = 0;
+        if (!store.store(makeBatch(done, std::min(batchSize, rows - done)), rejected) || rejected > 0) return false;
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+void report(const char* name, size_t rows, double seconds, long clientKb, long serverKb) {
+    std::cout << std::left << std::setw(12) << name << std::right << std::setw(10) << std::fixed
+              << std::setprecision(1) << seconds * 1000 << " ms" << std::setw(12) << std::setprecision(0)
+              << rows / seconds << " rows/s" << std::setw(10) << clientKb << " KiB client";
+    if (serverKb > 0) std::cout << std::setw(10) << serverKb << " KiB server";
+    std::cout << "\n";
+}
+
+int benchSqlite(size_t rows, size_t batchSize, const std::string& path) {
+    for (const char* suffix : { "", "-wal", "-shm" }) std::remove((path + suffix).c_str());
+    double seconds = 0;
+    bool ok;
+    {
+        SqliteConfig config;
+        config.path = path;
+        SqliteLoginStore store(config);
+        ok = writeAll(store, rows, batchSize, seconds);
+    }
+    for (const char* suffix : { "", "-wal", "-shm" }) std::remove((path + suffix).c_str());
+    if (!ok) {
+        std::cout << "sqlite      FAILED\n";
+        return 1;
+    }
+    report("sqlite", rows, seconds, peakRssKb("self"), 0);
+    return 0;
+}
+
+int benchPostgres(size_t rows, size_t batchSize, const std::string& conninfo) {
+    PoolConfig poolConfig;
+    poolConfig.size = 1;
+    PgConnectionPool pool(conninfo, poolConfig, prepareStatements);
+    std::string backendPid;
+    {
+        PgConnectionPool::Lease conn = pool.acquire();
+        if (!conn) {
+            std::cout << "postgres    skipped (no connection)\n";
+            return 0;
+        }
+        backendPid = std::to_string(PQbackendPID(conn.get()));
+    }
+    PgLoginStore store(pool);
+    double seconds = 0;
+    bool ok = writeAll(store, rows, batchSize, seconds);
+    long serverKb = peakRssKb(backendPid);
+    {
+        PgConnectionPool::Lease conn = pool.acquire();
+        if (conn) PQclear(PQexec(conn.get(), "DELETE FROM ctf.login_attempts WHERE username LIKE 'bench_user_%'"));
+    }
+    if (!ok) {
+        std::cout << "postgres    FAILED\n";
+        return 1;
+    }
+    report("postgres", rows, seconds, peakRssKb("self"), serverKb);
+    return 0;
+}
+
+int inChild(const std::function<int()>& body) {
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int code = body();
+        std::cout.flush();
+        _exit(code);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t rows = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+    size_t batchSize = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000;
+    std::string sqlitePath = argc > 3 ? argv[3] : "login_store_bench.db";
+    std::string conninfo = argc > 4 ? argv[4] : "dbname=ctf";
+    if (batchSize == 0) batchSize = 1;
+
+    std::cout << "Storing " << rows << " rows in batches of " << batchSize << "\n";
+    int failures = inChild([&] { return benchSqlite(rows, batchSize, sqlitePath); });
+    failures += inChild([&] { return benchPostgres(rows, batchSize, conninfo); });
+    return failures == 0 ? 0 : 1;
+}
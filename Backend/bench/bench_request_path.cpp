@@ -0,0 +1,178 @@
+/**
+ * @file bench_request_path.cpp
+ * @brief Drives LOGIN requests at a running server and reports their rate, latency and per-request cost.
+ *
+ * Usage: request_path_bench [host] [port] [requests] [max_login_allocs]
+ *
+ * Sends the LOGINs back to back on one connection, waiting for each ACK.
+ * If the server was built with CTF_ACCOUNTING, the heap allocations, bytes
+ * and socket syscalls it charged per request are read from STATS before
+ * and after the run and printed per command; STATS is an admin command, so
+ * CTF_ADMIN_TOKEN must hold the server's admin.token. When max_login_allocs is
+ * given, the exit status is 1 if a LOGIN cost more allocations than that,
+ * so a CI job can hold the LOGIN -> ACK path to its budget (0 for
+ * allocation-free).
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+#include "../packet.h"
+
+namespace {
+
+bool sendAll(int fd, const std::vector<uint8_t>& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool recvAll(int fd, uint8_t* buffer, size_t size) {
+    size_t received = 0;
+    while (received < size) {
+        ssize_t n = recv(fd, buffer + received, size - received, 0);
+        if (n <= 0) return false;
+        received += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/** @brief Sends one request and reads its reply; false if the connection failed. */
+bool roundTrip(int fd, Command cmd, const std::string& payload, Command& reply, std::string& replyPayload) {
+    NetworkPacket request(cmd, static_cast<uint32_t>(payload.size()));
+    request.writePayload(reinterpret_cast<const uint8_t*>(payload.data()), static_cast<uint32_t>(payload.size()));
+    if (!sendAll(fd, request.serialize())) return false;
+    uint8_t header[sizeof(Header)];
+    if (!recvAll(fd, header, sizeof(header))) return false;
+    Header parsed = NetworkPacket::parseHeader(header);
+    replyPayload.resize(parsed.payloadSize);
+    if (parsed.payloadSize > 0 &&
+        !recvAll(fd, reinterpret_cast<uint8_t*>(&replyPayload[0]), parsed.payloadSize)) {
+        return false;
+    }
+    reply = parsed.commandID;
+    return true;
+}
+
+/** @brief Totals per command from STATS "usage" (means times requests); empty if the server does not account. */
+std::map<std::string, std::vector<double>> usageTotals(int fd, const std::string& token, bool& accounted) {
+    std::map<std::string, std::vector<double>> totals;
+    Command reply;
+    std::string payload;
+    accounted = false;
+    if (!roundTrip(fd, Command::STATS, token, reply, payload)) return totals;
+    if (reply != Command::ACK) {
+        std::cerr << "STATS refused: " << payload << " (set CTF_ADMIN_TOKEN to the server's admin.token)\n";
+        return totals;
+    }
+    nlohmann::json stats = nlohmann::json::parse(payload, nullptr, false);
+    if (stats.is_discarded() || !stats.contains("usage")) return totals;
+    accounted = true;
+    for (const auto& [command, usage] : stats["usage"].items()) {
+        double requests = usage["requests"].get<double>();
+        totals[command] = { requests, usage["allocations"].get<double>() * requests,
+                            usage["bytes"].get<double>() * requests, usage["syscalls"].get<double>() * requests };
+    }
+    return totals;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string host = argc > 1 ? argv[1] : "127.0.0.1";
+    int port = argc > 2 ? std::atoi(argv[2]) : 8080;
+    size_t requests = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 10000;
+    bool guarded = argc > 4;
+    double maxLoginAllocs = guarded ? std::strtod(argv[4], nullptr) : 0;
+    if (requests == 0) requests = 1;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (fd < 0 || inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+        connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "Cannot connect to " << host << ":" << port << "\n";
+        return 1;
+    }
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    Command reply;
+    std::string payload;
+    // STATS needs an authenticated connection as well as the admin token.
+    if (!roundTrip(fd, Command::LOGIN, "bench_user:bench", reply, payload) || reply != Command::ACK) {
+        std::cerr << "LOGIN failed\n";
+        return 1;
+    }
+    const char* token = std::getenv("CTF_ADMIN_TOKEN");
+    std::string adminToken = token != nullptr ? token : "";
+    bool accounted = false;
+    std::map<std::string, std::vector<double>> before = usageTotals(fd, adminToken, accounted);
+
+    std::vector<double> latencies;
+    latencies.reserve(requests);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < requests; i++) {
+        auto sent = std::chrono::steady_clock::now();
+        if (!roundTrip(fd, Command::LOGIN, "bench_user:hunter" + std::to_string(i % 1000), reply, payload) ||
+            reply != Command::ACK) {
+            std::cerr << "LOGIN " << i << " failed\n";
+            return 1;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - sent;
+        latencies.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::sort(latencies.begin(), latencies.end());
+    auto at = [&latencies](double p) { return latencies[std::min(latencies.size() - 1,
+                                                                  static_cast<size_t>(p * latencies.size()))]; };
+    std::cout << requests << " LOGIN requests in " << std::fixed << std::setprecision(1) << seconds * 1000 << " ms, "
+              << std::setprecision(0) << requests / seconds << " req/s, p50 " << std::setprecision(1) << at(0.5)
+              << " us, p99 " << at(0.99) << " us\n";
+
+    std::map<std::string, std::vector<double>> after = usageTotals(fd, adminToken, accounted);
+    close(fd);
+    if (!accounted) {
+        std::cout << "No usage from STATS (server not built with CTF_ACCOUNTING, or no admin token): "
+                     "no allocation or syscall counts\n";
+        return guarded ? 1 : 0;
+    }
+
+    // The first STATS is counted only after building its reply, so it shows up here as one STATS request.
+    std::cout << "\n" << std::left << std::setw(20) << "command" << std::right << std::setw(10) << "requests"
+              << std::setw(12) << "allocs/req" << std::setw(12) << "bytes/req" << std::setw(14) << "syscalls/req"
+              << "\n";
+    double loginAllocs = 0;
+    for (const auto& [command, total] : after) {
+        std::vector<double> delta = total;
+        auto it = before.find(command);
+        for (size_t i = 0; it != before.end() && i < delta.size(); i++) delta[i] -= it->second[i];
+        if (delta[0] < 0.5) continue;
+        double n = delta[0];
+        std::cout << std::left << std::setw(20) << command << std::right << std::setw(10) << std::setprecision(0) << n
+                  << std::setprecision(1) << std::setw(12) << delta[1] / n << std::setw(12) << delta[2] / n
+                  << std::setw(14) << delta[3] / n << "\n";
+        if (command == "LOGIN") loginAllocs = delta[1] / n;
+    }
+    if (guarded && loginAllocs > maxLoginAllocs) {
+        std::cout << "LOGIN allocates " << loginAllocs << " times per request, budget is " << maxLoginAllocs << "\n";
+        return 1;
+    }
+    return 0;
+}
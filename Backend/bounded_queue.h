@@ -0,0 +1,130 @@
+/**
+ * @file bounded_queue.h
+ * @brief Fixed-capacity lock-free queue for handing work between threads.
+ */
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+/**
+ * @brief Multi-producer, multi-consumer ring buffer with per-cell sequence numbers.
+ *
+ * Each cell carries a sequence counter that tells producers and consumers
+ * whether it is free or filled for their lap of the ring, so push and pop
+ * each take a single compare-and-swap on the fast path and never block.
+ * When the ring is full, tryPush() fails instead of waiting; the caller
+ * decides whether to drop or retry.
+ *
+ * @tparam T The element type; must be default constructible and movable.
+ */
+template <typename T>
+class BoundedQueue {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    // Keep producer and consumer cursors on separate cache lines.
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) size_t mask;
+    std::unique_ptr<Cell[]> cells;
+
+    static size_t roundUp(size_t n) {
+        size_t size = 2;
+        while (size < n) size <<= 1;
+        return size;
+    }
+
+public:
+    /**
+     * @brief Allocates the ring.
+     * @param capacity Minimum number of elements; rounded up to a power of two.
+     */
+    explicit BoundedQueue(size_t capacity)
+        : head(0), tail(0), mask(roundUp(capacity) - 1), cells(new Cell[mask + 1]) {
+        for (size_t i = 0; i <= mask; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * @brief Appends an element if there is room.
+     * @param value The element to move into the queue.
+     * @return False if the queue was full; value is left untouched.
+     */
+    bool tryPush(T&& value) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Removes the oldest element.
+     * @return The element, or std::nullopt if the queue was empty.
+     */
+    std::optional<T> tryPop() {
+        size_t pos = head.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    std::optional<T> result(std::move(cell.value));
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return result;
+                }
+            } else if (diff < 0) {
+                return std::nullopt;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Approximate number of queued elements (exact when no push or pop is in flight).
+     * @return The element count.
+     */
+    size_t size() const {
+        size_t t = tail.load(std::memory_order_acquire);
+        size_t h = head.load(std::memory_order_acquire);
+        return t > h ? t - h : 0;
+    }
+
+    /**
+     * @brief Retrieves the ring capacity.
+     * @return The number of cells.
+     */
+    size_t capacity() const {
+        return mask + 1;
+    }
+};
+
+#endif // BOUNDED_QUEUE_H
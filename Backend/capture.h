@@ -0,0 +1,535 @@
+/**
+ * @file capture.h
+ * @brief Optional pcapng capture of protocol frames with synthesized TCP/IP headers.
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "bounded_queue.h"
+
+/**
+ * @brief Settings of PacketCapture, read from the "capture" block of db_config.json.
+ */
+struct CaptureConfig {
+    /** @brief Capture at all; off by default. */
+    bool enabled = false;
+
+    /** @brief Directory holding the capture files; created if missing. */
+    std::string dir = "capture";
+
+    /** @brief A new file is started once the current one reaches this size. */
+    uint64_t fileBytes = 16ull << 20;
+
+    /** @brief Files kept; the oldest is deleted when a new one starts. 0 keeps every file. */
+    size_t files = 8;
+
+    /** @brief Capture one connection in this many (whole connections, so streams stay complete). */
+    uint64_t sampleEvery = 1;
+
+    /** @brief Bytes kept of each synthesized packet, headers included; longer packets are truncated. */
+    uint32_t snaplen = 65535;
+
+    /**
+     * @brief Frames buffered for the writer thread. Data frames beyond this are dropped (their bytes show as a
+     * gap in the stream); a connection's start and end wait for room instead.
+     */
+    size_t queueCapacity = 8192;
+};
+
+/**
+ * @brief Counters describing the capture.
+ */
+struct CaptureStats {
+    /** @brief Frames handed to the writer. */
+    uint64_t frames;
+
+    /** @brief Data frames lost because the queue was full or their connection was never opened. */
+    uint64_t dropped;
+
+    /** @brief Bytes written to capture files. */
+    uint64_t bytes;
+
+    /** @brief Capture files started. */
+    uint64_t files;
+};
+
+namespace capture {
+
+/** @brief pcapng block types and the link type used (raw IP, no link-layer header). */
+constexpr uint32_t kSectionHeader = 0x0A0D0D0A;
+constexpr uint32_t kInterfaceDescription = 1;
+constexpr uint32_t kEnhancedPacket = 6;
+constexpr uint16_t kLinkTypeRaw = 101;
+
+constexpr size_t kIpHeader = 20;
+constexpr size_t kTcpHeader = 20;
+/** @brief Largest TCP payload of one synthesized packet (IPv4 total length is 16 bits). */
+constexpr size_t kMaxSegment = 65535 - kIpHeader - kTcpHeader;
+
+constexpr uint8_t kFin = 0x01;
+constexpr uint8_t kSyn = 0x02;
+constexpr uint8_t kPsh = 0x08;
+constexpr uint8_t kAck = 0x10;
+
+/** @brief An IPv4 endpoint, address and port in network byte order. */
+struct Endpoint {
+    uint32_t address = 0;
+    uint16_t port = 0;
+};
+
+/** @brief File name of a capture file, e.g. "capture-00000042.pcapng". */
+inline std::string fileName(uint64_t sequence) {
+    char buf[40];
+    std::snprintf(buf, sizeof(buf), "capture-%08llu.pcapng", static_cast<unsigned long long>(sequence));
+    return buf;
+}
+
+/**
+ * @brief Recovers the sequence number from a capture file name.
+ * @return False if the name was not made by fileName().
+ */
+inline bool parseFileName(const std::string& name, uint64_t& sequence) {
+    if (name.size() < 16 || name.compare(0, 8, "capture-") != 0 ||
+        name.compare(name.size() - 7, 7, ".pcapng") != 0) {
+        return false;
+    }
+    sequence = 0;
+    for (size_t i = 8; i < name.size() - 7; i++) {
+        if (name[i] < '0' || name[i] > '9') return false;
+        sequence = sequence * 10 + static_cast<uint64_t>(name[i] - '0');
+    }
+    return true;
+}
+
+/** @brief Capture files in a directory, oldest first. */
+inline std::vector<std::pair<uint64_t, std::string>> listFiles(const std::string& dir) {
+    std::vector<std::pair<uint64_t, std::string>> files;
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr) return files;
+    while (dirent* entry = readdir(d)) {
+        uint64_t sequence;
+        if (parseFileName(entry->d_name, sequence)) files.emplace_back(sequence, dir + "/" + entry->d_name);
+    }
+    closedir(d);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+/** @brief Internet checksum over data, continuing from a partial sum. */
+inline uint32_t sum(const uint8_t* data, size_t size, uint32_t acc = 0) {
+    for (size_t i = 0; i + 1 < size; i += 2) acc += static_cast<uint32_t>(data[i] << 8 | data[i + 1]);
+    if (size & 1) acc += static_cast<uint32_t>(data[size - 1] << 8);
+    return acc;
+}
+
+inline uint16_t fold(uint32_t acc) {
+    while (acc >> 16) acc = (acc & 0xFFFF) + (acc >> 16);
+    return static_cast<uint16_t>(~acc);
+}
+
+inline void put16(uint8_t* p, uint16_t v) {
+    p[0] = static_cast<uint8_t>(v >> 8);
+    p[1] = static_cast<uint8_t>(v);
+}
+
+inline void put32(uint8_t* p, uint32_t v) {
+    put16(p, static_cast<uint16_t>(v >> 16));
+    put16(p + 2, static_cast<uint16_t>(v));
+}
+
+/**
+ * @brief Builds an IPv4/TCP packet carrying a payload, with valid checksums.
+ * @param out Receives the packet (replaced).
+ */
+inline void buildPacket(std::vector<uint8_t>& out, const Endpoint& from, const Endpoint& to, uint32_t seq,
+                        uint32_t ack, uint8_t flags, uint16_t ipId, const uint8_t* payload, size_t size) {
+    out.assign(kIpHeader + kTcpHeader + size, 0);
+    uint8_t* ip = out.data();
+    ip[0] = 0x45;
+    put16(ip + 2, static_cast<uint16_t>(out.size()));
+    put16(ip + 4, ipId);
+    put16(ip + 6, 0x4000);  // don't fragment
+    ip[8] = 64;
+    ip[9] = 6;  // TCP
+    std::memcpy(ip + 12, &from.address, 4);
+    std::memcpy(ip + 16, &to.address, 4);
+    put16(ip + 10, fold(sum(ip, kIpHeader)));
+
+    uint8_t* tcp = ip + kIpHeader;
+    std::memcpy(tcp, &from.port, 2);
+    std::memcpy(tcp + 2, &to.port, 2);
+    put32(tcp + 4, seq);
+    put32(tcp + 8, ack);
+    tcp[12] = 5 << 4;
+    tcp[13] = flags;
+    put16(tcp + 14, 65535);
+    if (size > 0) std::memcpy(tcp + kTcpHeader, payload, size);
+    // Pseudo-header: addresses, protocol and TCP length.
+    uint32_t acc = sum(ip + 12, 8);
+    acc += 6 + static_cast<uint32_t>(kTcpHeader + size);
+    put16(tcp + 16, fold(sum(tcp, kTcpHeader + size, acc)));
+}
+
+} // namespace capture
+
+/**
+ * @brief Writes protocol frames to pcapng files that Wireshark can open.
+ *
+ * Connection threads hand over the exact bytes they receive and send; each
+ * frame is copied into a bounded queue and a background thread wraps it in
+ * synthesized IPv4/TCP headers (with a SYN handshake when the connection
+ * opens, running sequence numbers per direction and a FIN when it closes),
+ * so Wireshark shows one TCP stream per connection and can reassemble
+ * frames across packets. A frame whose payload was skipped rather than read
+ * advances the sequence number, so the gap shows as missing bytes.
+ *
+ * Affordable in production: whole connections are sampled (one in
+ * sampleEvery, decided once at accept, so an unsampled connection costs one
+ * branch per frame), packets are cut to snaplen, data frames are dropped
+ * and counted when the writer falls behind, and files rotate as a ring of
+ * `files` files of fileBytes each. A dropped frame's bytes still advance its
+ * stream's sequence number, like skipped payload, and a connection's OPEN
+ * and CLOSE are never dropped (they wait for room, and data frames leave
+ * part of the queue free for them), so no stream is left without its end.
+ */
+class PacketCapture {
+public:
+    /** @brief Direction of a frame. */
+    enum class Direction { FROM_CLIENT, FROM_SERVER };
+
+    /**
+     * @brief Opens the first file and starts the writer thread.
+     * @param config Directory, rotation, sampling and snaplen.
+     */
+    explicit PacketCapture(CaptureConfig config)
+        : config(std::move(config)), queue(this->config.queueCapacity), controlReserve(queue.capacity() / 8), fd(-1),
+          sequence(0), fileSize(0), frames(0), dropped(0), bytes(0), filesStarted(0), gapsPending(false),
+          stopping(false), draining(false) {
+        if (this->config.sampleEvery == 0) this->config.sampleEvery = 1;
+        this->config.snaplen = std::max<uint32_t>(this->config.snaplen, capture::kIpHeader + capture::kTcpHeader);
+        if (::mkdir(this->config.dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::runtime_error("Cannot create capture directory " + this->config.dir);
+        }
+        auto existing = capture::listFiles(this->config.dir);
+        sequence = existing.empty() ? 0 : existing.back().first;
+        if (!openFile()) throw std::runtime_error("Cannot open a capture file in " + this->config.dir);
+        thread = std::thread(&PacketCapture::run, this);
+    }
+
+    ~PacketCapture() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wakeCv.notify_one();
+        thread.join();
+        if (fd >= 0) ::close(fd);
+    }
+
+    PacketCapture(const PacketCapture&) = delete;
+    PacketCapture& operator=(const PacketCapture&) = delete;
+
+    /**
+     * @brief Decides whether a connection is captured.
+     * @param connection Connection number, counted from 1.
+     */
+    bool sample(uint64_t connection) const {
+        return connection % config.sampleEvery == 0;
+    }
+
+    /**
+     * @brief Starts a connection's stream. Call once, before its first frame.
+     * @param client Peer address and port.
+     * @param server Local address and port.
+     */
+    void open(uint64_t connection, const capture::Endpoint& client, const capture::Endpoint& server) {
+        Event event;
+        event.type = Event::OPEN;
+        event.connection = connection;
+        event.client = client;
+        event.server = server;
+        push(std::move(event));
+    }
+
+    /**
+     * @brief Captures bytes as they went over the wire.
+     * @param iov Pieces of the frame, in order.
+     * @param count Number of pieces.
+     * @param skipped Bytes that followed on the wire but were discarded unread.
+     */
+    void frame(uint64_t connection, Direction direction, const iovec* iov, int count, uint64_t skipped = 0) {
+        Event event;
+        event.type = Event::DATA;
+        event.connection = connection;
+        event.direction = direction;
+        event.skipped = skipped;
+        size_t size = 0;
+        for (int i = 0; i < count; i++) size += iov[i].iov_len;
+        event.data.reserve(size);
+        for (int i = 0; i < count; i++) {
+            const uint8_t* base = static_cast<const uint8_t*>(iov[i].iov_base);
+            event.data.insert(event.data.end(), base, base + iov[i].iov_len);
+        }
+        push(std::move(event));
+    }
+
+    /** @brief Ends a connection's stream. */
+    void close(uint64_t connection) {
+        Event event;
+        event.type = Event::CLOSE;
+        event.connection = connection;
+        push(std::move(event));
+    }
+
+    /**
+     * @brief Retrieves the capture's counters.
+     * @return A snapshot of the counters.
+     */
+    CaptureStats stats() const {
+        return CaptureStats{ frames.load(), dropped.load(), bytes.load(), filesStarted.load() };
+    }
+
+private:
+    struct Event {
+        enum Type { OPEN, DATA, CLOSE } type = DATA;
+        uint64_t connection = 0;
+        Direction direction = Direction::FROM_CLIENT;
+        uint64_t timestamp = 0;
+        uint64_t skipped = 0;
+        /** @brief Bytes of this connection's dropped frames before this event, per Direction. */
+        std::array<uint64_t, 2> gap{};
+        capture::Endpoint client;
+        capture::Endpoint server;
+        std::vector<uint8_t> data;
+    };
+
+    struct Stream {
+        capture::Endpoint client;
+        capture::Endpoint server;
+        uint32_t clientSeq;
+        uint32_t serverSeq;
+    };
+
+    CaptureConfig config;
+    BoundedQueue<Event> queue;
+    /** @brief Queue slots data frames leave free for OPEN and CLOSE. */
+    size_t controlReserve;
+    int fd;
+    uint64_t sequence;
+    uint64_t fileSize;
+    std::unordered_map<uint64_t, Stream> streams;
+    uint16_t ipId = 0;
+    std::vector<uint8_t> packet;
+    std::string buffer;
+    std::atomic<uint64_t> frames;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> filesStarted;
+    /** @brief Bytes of dropped frames per connection, not yet carried by a queued event. */
+    std::mutex gapMutex;
+    std::unordered_map<uint64_t, std::array<uint64_t, 2>> gaps;
+    std::atomic<bool> gapsPending;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCv;
+    bool stopping;
+    bool draining;
+    std::thread thread;
+
+    void push(Event&& event) {
+        event.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        if (gapsPending.load(std::memory_order_acquire)) takeGap(event);
+        if (event.type != Event::DATA) {
+            // tryPush leaves the event untouched on failure; wake the writer and wait for it to make room.
+            while (!queue.tryPush(std::move(event))) {
+                {
+                    std::lock_guard<std::mutex> lock(wakeMutex);
+                    draining = true;
+                }
+                wakeCv.notify_one();
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            return;
+        }
+        if (queue.size() + controlReserve >= queue.capacity() || !queue.tryPush(std::move(event))) {
+            event.gap[static_cast<size_t>(event.direction)] += event.data.size() + event.skipped;
+            putGap(event);
+            dropped++;
+            return;
+        }
+        frames++;
+    }
+
+    /** @brief Moves the connection's pending gap, if any, into the event. */
+    void takeGap(Event& event) {
+        std::lock_guard<std::mutex> lock(gapMutex);
+        auto it = gaps.find(event.connection);
+        if (it == gaps.end()) return;
+        for (size_t i = 0; i < 2; i++) event.gap[i] += it->second[i];
+        gaps.erase(it);
+        if (gaps.empty()) gapsPending.store(false, std::memory_order_release);
+    }
+
+    /** @brief Keeps a dropped event's gap for the connection's next queued event. */
+    void putGap(const Event& event) {
+        std::lock_guard<std::mutex> lock(gapMutex);
+        auto& gap = gaps[event.connection];
+        for (size_t i = 0; i < 2; i++) gap[i] += event.gap[i];
+        gapsPending.store(true, std::memory_order_release);
+    }
+
+    void run() {
+        while (true) {
+            bool stop;
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wakeCv.wait_for(lock, std::chrono::milliseconds(50), [this] { return stopping || draining; });
+                stop = stopping;
+                draining = false;
+            }
+            while (std::optional<Event> event = queue.tryPop()) handle(*event);
+            flush();
+            if (stop) return;
+        }
+    }
+
+    void handle(const Event& event) {
+        using namespace capture;
+        if (event.type == Event::OPEN) {
+            // Arbitrary but stable initial sequence numbers per connection.
+            uint32_t isn = static_cast<uint32_t>(event.connection * 2654435761u);
+            Stream& s = streams[event.connection];
+            s = Stream{ event.client, event.server, isn, ~isn };
+            emit(event.timestamp, s.client, s.server, s.clientSeq, 0, kSyn, nullptr, 0);
+            emit(event.timestamp, s.server, s.client, s.serverSeq, s.clientSeq + 1, kSyn | kAck, nullptr, 0);
+            s.clientSeq++;
+            s.serverSeq++;
+            emit(event.timestamp, s.client, s.server, s.clientSeq, s.serverSeq, kAck, nullptr, 0);
+            return;
+        }
+        auto it = streams.find(event.connection);
+        if (it == streams.end()) {
+            // Never opened (or already closed); without addresses there is no stream to add to.
+            if (event.type == Event::DATA) dropped++;
+            return;
+        }
+        Stream& s = it->second;
+        s.clientSeq += static_cast<uint32_t>(event.gap[static_cast<size_t>(Direction::FROM_CLIENT)]);
+        s.serverSeq += static_cast<uint32_t>(event.gap[static_cast<size_t>(Direction::FROM_SERVER)]);
+        if (event.type == Event::CLOSE) {
+            emit(event.timestamp, s.client, s.server, s.clientSeq, s.serverSeq, kFin | kAck, nullptr, 0);
+            emit(event.timestamp, s.server, s.client, s.serverSeq, s.clientSeq + 1, kFin | kAck, nullptr, 0);
+            streams.erase(it);
+            return;
+        }
+        bool fromClient = event.direction == Direction::FROM_CLIENT;
+        uint32_t& seq = fromClient ? s.clientSeq : s.serverSeq;
+        uint32_t ack = fromClient ? s.serverSeq : s.clientSeq;
+        const Endpoint& from = fromClient ? s.client : s.server;
+        const Endpoint& to = fromClient ? s.server : s.client;
+        for (size_t offset = 0; offset < event.data.size(); offset += kMaxSegment) {
+            size_t size = std::min(kMaxSegment, event.data.size() - offset);
+            emit(event.timestamp, from, to, seq, ack, kPsh | kAck, event.data.data() + offset, size);
+            seq += static_cast<uint32_t>(size);
+        }
+        seq += static_cast<uint32_t>(event.skipped);
+    }
+
+    /** @brief Appends one Enhanced Packet Block, rotating first if the file is full. */
+    void emit(uint64_t timestamp, const capture::Endpoint& from, const capture::Endpoint& to, uint32_t seq,
+              uint32_t ack, uint8_t flags, const uint8_t* payload, size_t size) {
+        capture::buildPacket(packet, from, to, seq, ack, flags, ipId++, payload, size);
+        uint32_t captured = std::min<uint32_t>(static_cast<uint32_t>(packet.size()), config.snaplen);
+        uint32_t padded = (captured + 3) & ~3u;
+        uint32_t length = 32 + padded;
+        if (fileSize + buffer.size() + length > config.fileBytes && fileSize + buffer.size() > 0) rotate();
+        size_t start = buffer.size();
+        buffer.resize(start + length, '\0');
+        uint8_t* p = reinterpret_cast<uint8_t*>(&buffer[start]);
+        uint32_t fields[7] = { capture::kEnhancedPacket, length, 0, static_cast<uint32_t>(timestamp >> 32),
+                               static_cast<uint32_t>(timestamp), captured, static_cast<uint32_t>(packet.size()) };
+        std::memcpy(p, fields, sizeof(fields));
+        std::memcpy(p + 28, packet.data(), captured);
+        std::memcpy(p + 28 + padded, &length, 4);
+    }
+
+    void flush() {
+        if (buffer.empty() || fd < 0) {
+            buffer.clear();
+            return;
+        }
+        size_t offset = 0;
+        while (offset < buffer.size()) {
+            ssize_t n = ::write(fd, buffer.data() + offset, buffer.size() - offset);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "Capture: write failed, " << (buffer.size() - offset) << " bytes lost\n";
+                break;
+            }
+            offset += static_cast<size_t>(n);
+        }
+        fileSize += offset;
+        bytes += offset;
+        buffer.clear();
+    }
+
+    void rotate() {
+        flush();
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        if (!openFile()) std::cerr << "Capture: cannot open a new file\n";
+    }
+
+    /** @brief Starts the next file with its section and interface headers, deleting the oldest beyond the ring. */
+    bool openFile() {
+        sequence++;
+        std::string path = config.dir + "/" + capture::fileName(sequence);
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return false;
+        fileSize = 0;
+        filesStarted++;
+
+        // Section Header Block: byte-order magic, version 1.0, unknown section length.
+        uint32_t shb[7] = { capture::kSectionHeader, 28, 0x1A2B3C4D, 0, 0xFFFFFFFF, 0xFFFFFFFF, 28 };
+        uint16_t version[2] = { 1, 0 };
+        std::memcpy(shb + 3, version, sizeof(version));
+        // Interface Description Block: raw IP, snaplen, if_tsresol = 9 (nanoseconds).
+        uint32_t idb[8] = { capture::kInterfaceDescription, 32, capture::kLinkTypeRaw, config.snaplen,
+                            (1u << 16) | 9u, 9u, 0u, 32 };
+        buffer.insert(0, reinterpret_cast<const char*>(idb), sizeof(idb));
+        buffer.insert(0, reinterpret_cast<const char*>(shb), sizeof(shb));
+
+        if (config.files > 0) {
+            auto files = capture::listFiles(config.dir);
+            for (size_t i = 0; i + config.files < files.size(); i++) std::remove(files[i].second.c_str());
+        }
+        return true;
+    }
+};
+
+#endif // CAPTURE_H
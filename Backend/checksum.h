@@ -0,0 +1,115 @@
+/**
+ * @file checksum.h
+ * @brief Payload checksum algorithms that can be negotiated with HELLO.
+ */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "packet.h"
+
+#if defined(__SSE4_2__)
+    #include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+    #include <arm_acle.h>
+#endif
+
+/**
+ * @brief Algorithm used for the payloadCRC header field on a connection.
+ *
+ * Legacy connections always use CRC32.
+ */
+enum class ChecksumType : uint8_t {
+    CRC32,  /**< IEEE CRC32, as produced by NetworkPacket::checksum. */
+    CRC32C, /**< Castagnoli CRC32, hardware accelerated on SSE4.2 and ARMv8. */
+    NONE    /**< No checksum; the field is sent as 0 and ignored (TCP already checksums). */
+};
+
+namespace checksum {
+
+namespace detail {
+constexpr std::array<uint32_t, 256> makeCrc32cTable() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc >> 1) ^ (0x82F63B78 & (-(crc & 1)));
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint32_t, 256> kCrc32cTable = makeCrc32cTable();
+}
+
+/**
+ * @brief Extends a CRC32C with more data.
+ * @param previous The CRC of the data seen so far (0 for none).
+ * @param data Pointer to the next bytes.
+ * @param length The number of bytes.
+ * @return The CRC32C of all data seen so far.
+ */
+inline uint32_t updateCrc32c(uint32_t previous, const uint8_t* data, size_t length) {
+    uint32_t crc = ~previous;
+#if defined(__SSE4_2__) && defined(__x86_64__)
+    while (length >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        crc = static_cast<uint32_t>(_mm_crc32_u64(crc, word));
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0) crc = _mm_crc32_u8(crc, *data++);
+#elif defined(__ARM_FEATURE_CRC32)
+    while (length >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        crc = __crc32cd(crc, word);
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0) crc = __crc32cb(crc, *data++);
+#else
+    for (size_t i = 0; i < length; i++) {
+        crc = detail::kCrc32cTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+#endif
+    return ~crc;
+}
+
+/**
+ * @brief Extends a checksum of the given type with more data.
+ * @param type The negotiated algorithm.
+ * @param previous The checksum of the data seen so far (0 for none).
+ * @param data Pointer to the next bytes.
+ * @param length The number of bytes.
+ * @return The checksum of all data seen so far (always 0 for ChecksumType::NONE).
+ */
+inline uint32_t update(ChecksumType type, uint32_t previous, const uint8_t* data, size_t length) {
+    switch (type) {
+        case ChecksumType::CRC32: return NetworkPacket::updateChecksum(previous, data, length);
+        case ChecksumType::CRC32C: return updateCrc32c(previous, data, length);
+        case ChecksumType::NONE: return 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Computes a checksum of the given type.
+ * @param type The negotiated algorithm.
+ * @param data Pointer to the bytes.
+ * @param length The number of bytes.
+ * @return The checksum (always 0 for ChecksumType::NONE).
+ */
+inline uint32_t compute(ChecksumType type, const uint8_t* data, size_t length) {
+    return update(type, 0, data, length);
+}
+
+} // namespace checksum
+
+#endif // CHECKSUM_H
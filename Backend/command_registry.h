@@ -0,0 +1,210 @@
+/**
+ * @file command_registry.h
+ * @brief Compile-time traits and dense lookup table for client request commands.
+ */
+
+#ifndef COMMAND_REGISTRY_H
+#define COMMAND_REGISTRY_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "packet.h"
+
+/**
+ * @brief Where the server executes the handler for a command.
+ */
+enum class Dispatch {
+    INLINE, /**< Runs directly on the connection thread (cheap, non-blocking work). */
+    WORKER  /**< Runs on the shared worker pool (blocking I/O such as DB or file access). */
+};
+
+/**
+ * @brief Longest admin token, which admin commands carry ahead of their arguments ("<token> <arguments>").
+ *
+ * LOGIN accepts any credentials, so being logged in says nothing about who
+ * is asking; commands that expose collected data or cost the host CPU and
+ * disk also need the token configured as admin.token.
+ */
+constexpr uint32_t kMaxAdminToken = 64;
+
+/**
+ * @brief Per-command protocol traits, specialised for every request command.
+ *
+ * The primary template describes an unknown command: it is not accepted,
+ * requires authentication and may not carry a payload.
+ *
+ * @tparam C The command being described.
+ */
+template <Command C>
+struct CommandTraits {
+    static constexpr bool known = false;
+    static constexpr bool requiresAuth = true;
+    static constexpr uint32_t maxPayload = 0;
+    static constexpr Dispatch dispatch = Dispatch::INLINE;
+    static constexpr const char* name = "UNKNOWN";
+};
+
+template <>
+struct CommandTraits<Command::LOGIN> {
+    static constexpr bool known = true;
+    static constexpr bool requiresAuth = false;
+    /** @brief "username:password" - anything larger is not a login attempt. */
+    static constexpr uint32_t maxPayload = 512;
+    /** @brief Only queues the attempt for LoginWriter, so it never waits on the database. */
+    static constexpr Dispatch dispatch = Dispatch::INLINE;
+    static constexpr const char* name = "LOGIN";
+};
+
+template <>
+struct CommandTraits<Command::TOGGLE_MAINTENANCE> {
+    static constexpr bool known = true;
+    static constexpr bool requiresAuth = true;
+    static constexpr uint32_t maxPayload = 0;
+    static constexpr Dispatch dispatch = Dispatch::INLINE;
+    static constexpr const char* name = "TOGGLE_MAINTENANCE";
+};
+
+template <>
+struct CommandTraits<Command::SET_ONLINE> {
+    static constexpr bool known = true;
+    static constexpr bool requiresAuth = true;
+    static constexpr uint32_t maxPayload = 0;
+    static constexpr Dispatch dispatch = Dispatch::INLINE;
+    static constexpr const char* name = "SET_ONLINE";
+};
+
+template <>
+struct CommandTraits<Command::REQUEST_FLAG_IMAGE> {
+    static constexpr bool known = true;
+    static constexpr bool requiresAuth = true;
+    static constexpr uint32_t maxPayload = 0;
+    static constexpr Dispatch dispatch = Dispatch::WORKER;
+    static constexpr const char* name = "REQUEST_FLAG_IMAGE";
+};
+
+template <>
+struct CommandTraits<Command::HELLO> {
+    static constexpr bool known = true;
+    static constexpr bool requiresAuth = false;
+    /** @brief Fixed-size capability block, see handshake.h. */
+    static constexpr uint32_t maxPayload = 12;
+    static constexpr Dispatch dispatch = Dispatch::INLINE;
+    static constexpr const char* name = "HELLO";
+};
+
+template <>
+struct CommandTraits<Command::BATCH> {
+    static constexpr bool known = true;
+    /** @brief Sub-requests are checked individually, so a batch may start with LOGIN. */
+    static constexpr bool requiresAuth = false;
+    static constexpr uint32_t maxPayload = 64 * 1024;
+    static constexpr Dispatch dispatch = Dispatch::WORKER;
+    static constexpr const char* name = "BATCH";
+};
+
+template <>
+struct CommandTraits<Command::STATS> {
+    static constexpr bool known = true;
+    static constexpr bool requiresAuth = true;
+    /** @brief Admin token, then an optional decimal length of the top lists. */
+    static constexpr uint32_t maxPayload = kMaxAdminToken + 1 + 8;
+    /** @brief Reads in-memory sketches only. */
+    static constexpr Dispatch dispatch = Dispatch::INLINE;
+    static constexpr const char* name = "STATS";
+};
+
+template <>
+struct CommandTraits<Command::PROFILE> {
+    static constexpr bool known = true;
+    static constexpr bool requiresAuth = true;
+    /** @brief Admin token, then "start", "start <hz>" or "stop". */
+    static constexpr uint32_t maxPayload = kMaxAdminToken + 1 + 16;
+    /** @brief Stopping symbolizes the samples and writes a file. */
+    static constexpr Dispatch dispatch = Dispatch::WORKER;
+    static constexpr const char* name = "PROFILE";
+};
+
+/**
+ * @brief Runtime view of a command's traits, stored in the dense command table.
+ */
+struct CommandInfo {
+    /** @brief The command this entry describes. */
+    Command command;
+
+    /** @brief Whether the client must have logged in before sending it. */
+    bool requiresAuth;
+
+    /** @brief Largest payload the parser will read for this command. */
+    uint32_t maxPayload;
+
+    /** @brief Where the handler is executed. */
+    Dispatch dispatch;
+
+    /** @brief Human readable name used in logs. */
+    const char* name;
+};
+
+/**
+ * @brief Builds the runtime table entry for a command from its compile-time traits.
+ */
+template <Command C>
+constexpr CommandInfo makeCommandInfo() {
+    static_assert(CommandTraits<C>::known, "Command has no CommandTraits specialisation");
+    return CommandInfo{ C, CommandTraits<C>::requiresAuth, CommandTraits<C>::maxPayload,
+                        CommandTraits<C>::dispatch, CommandTraits<C>::name };
+}
+
+/** @brief First request command ID; request IDs are allocated contiguously from here. */
+constexpr uint32_t kFirstRequestCommand = static_cast<uint32_t>(Command::LOGIN);
+
+/**
+ * @brief Dense table of every request command, indexed by (commandID - kFirstRequestCommand).
+ */
+constexpr std::array<CommandInfo, 8> kCommandTable = {
+    makeCommandInfo<Command::LOGIN>(),
+    makeCommandInfo<Command::TOGGLE_MAINTENANCE>(),
+    makeCommandInfo<Command::SET_ONLINE>(),
+    makeCommandInfo<Command::REQUEST_FLAG_IMAGE>(),
+    makeCommandInfo<Command::HELLO>(),
+    makeCommandInfo<Command::BATCH>(),
+    makeCommandInfo<Command::STATS>(),
+    makeCommandInfo<Command::PROFILE>(),
+};
+
+/** @brief Number of request commands the server can dispatch. */
+constexpr size_t kCommandCount = kCommandTable.size();
+
+/**
+ * @brief Maps a command to its slot in the dense table.
+ * @param cmd The command received from the wire.
+ * @return The table index, or -1 if the command is not a request command.
+ */
+constexpr int commandIndex(Command cmd) {
+    uint32_t slot = static_cast<uint32_t>(cmd) - kFirstRequestCommand;
+    if (slot >= kCommandCount) return -1;
+    return static_cast<int>(slot);
+}
+
+/**
+ * @brief Looks up the traits of a command.
+ * @param cmd The command received from the wire.
+ * @return A pointer into the command table, or nullptr for unknown commands.
+ */
+constexpr const CommandInfo* findCommand(Command cmd) {
+    int index = commandIndex(cmd);
+    return index < 0 ? nullptr : &kCommandTable[index];
+}
+
+namespace detail {
+constexpr bool commandTableIsDense() {
+    for (size_t i = 0; i < kCommandCount; i++) {
+        if (static_cast<uint32_t>(kCommandTable[i].command) != kFirstRequestCommand + i) return false;
+    }
+    return true;
+}
+}
+
+static_assert(detail::commandTableIsDense(), "kCommandTable must list request commands in ID order without gaps");
+
+#endif // COMMAND_REGISTRY_H
@@ -0,0 +1,102 @@
+/**
+ * @file compression.h
+ * @brief zlib payload codec used for packets carrying FLAG_COMPRESSED.
+ *
+ * A compressed payload is a 4-byte big-endian uncompressed length followed
+ * by a zlib (RFC 1950) stream, so receivers can size their buffer up front.
+ */
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <zlib.h>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+#else
+    #include <arpa/inet.h>
+#endif
+
+namespace compression {
+
+/** @brief Payloads smaller than this are never worth compressing. */
+constexpr size_t kMinCompressSize = 256;
+
+/** @brief Size of the uncompressed-length prefix. */
+constexpr size_t kPrefixSize = sizeof(uint32_t);
+
+/**
+ * @brief Compresses a payload if doing so makes it smaller.
+ * @param data The raw payload.
+ * @param length The number of raw bytes.
+ * @param out Receives the encoded payload (length prefix + zlib stream).
+ * @param level zlib compression level (1 = fastest, 9 = smallest).
+ * @return True if out holds a payload strictly smaller than the input.
+ */
+inline bool compress(const uint8_t* data, size_t length, std::vector<uint8_t>& out, int level = Z_DEFAULT_COMPRESSION) {
+    out.clear();
+    if (length < kMinCompressSize || length > UINT32_MAX) return false;
+
+    uLongf bound = compressBound(static_cast<uLong>(length));
+    out.resize(kPrefixSize + bound);
+    uint32_t netLength = htonl(static_cast<uint32_t>(length));
+    std::memcpy(out.data(), &netLength, kPrefixSize);
+
+    uLongf written = bound;
+    if (compress2(out.data() + kPrefixSize, &written, data, static_cast<uLong>(length), level) != Z_OK) {
+        out.clear();
+        return false;
+    }
+    out.resize(kPrefixSize + written);
+    if (out.size() >= length) {
+        out.clear();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Reads the uncompressed length from an encoded payload.
+ * @param data The encoded payload.
+ * @param length The number of encoded bytes.
+ * @return The declared uncompressed size.
+ * @throw std::runtime_error If the payload is too small to hold the prefix.
+ */
+inline uint32_t decodedSize(const uint8_t* data, size_t length) {
+    if (length < kPrefixSize) {
+        throw std::runtime_error("Compressed payload too small");
+    }
+    uint32_t netLength;
+    std::memcpy(&netLength, data, kPrefixSize);
+    return ntohl(netLength);
+}
+
+/**
+ * @brief Decompresses an encoded payload.
+ * @param data The encoded payload (length prefix + zlib stream).
+ * @param length The number of encoded bytes.
+ * @param maxSize Largest uncompressed size the caller is willing to allocate.
+ * @return The original payload bytes.
+ * @throw std::runtime_error If the payload is malformed or exceeds maxSize.
+ */
+inline std::vector<uint8_t> decompress(const uint8_t* data, size_t length, uint32_t maxSize) {
+    uint32_t size = decodedSize(data, length);
+    if (size > maxSize) {
+        throw std::runtime_error("Compressed payload expands beyond limit");
+    }
+    std::vector<uint8_t> out(size);
+    uLongf written = size;
+    int rc = uncompress(out.data(), &written, data + kPrefixSize, static_cast<uLong>(length - kPrefixSize));
+    if (rc != Z_OK || written != size) {
+        throw std::runtime_error("Corrupt compressed payload");
+    }
+    return out;
+}
+
+} // namespace compression
+
+#endif // COMPRESSION_H
@@ -0,0 +1,195 @@
+/**
+ * @file credential_aggregator.h
+ * @brief Sharded in-memory counts of repeated (username, password, ip) login attempts.
+ */
+
+#ifndef CREDENTIAL_AGGREGATOR_H
+#define CREDENTIAL_AGGREGATOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "login_attempt.h"
+#include "login_store.h"
+
+/**
+ * @brief Settings of CredentialAggregator, read from the "aggregation" block of db_config.json.
+ */
+struct AggregatorConfig {
+    /** @brief Count credentials instead of storing every attempt as a row. */
+    bool enabled = false;
+
+    /** @brief Independently locked hash tables; more shards means less contention between handlers. */
+    size_t shards = 16;
+
+    /** @brief Deltas are upserted this often. */
+    std::chrono::milliseconds flushInterval{ 5000 };
+
+    /** @brief One attempt in this many is still stored as a raw row for forensics; 0 keeps none. */
+    uint64_t sampleEvery = 100;
+
+    /** @brief Distinct credentials held between flushes; beyond this, attempts are stored raw. */
+    size_t maxEntries = 1000000;
+};
+
+/**
+ * @brief Counters describing the aggregator.
+ */
+struct AggregatorStats {
+    /** @brief Attempts counted. */
+    uint64_t recorded;
+
+    /** @brief Attempts also passed on as raw rows (sampled or table full). */
+    uint64_t raw;
+
+    /** @brief Distinct credentials waiting for the next flush. */
+    uint64_t pending;
+
+    /** @brief Deltas handed to the store. */
+    uint64_t flushed;
+};
+
+/**
+ * @brief Collapses repeated attempts into one counter per credential.
+ *
+ * Scanners replay the same username:password pairs from the same address
+ * thousands of times. Instead of a row per attempt, record() bumps a count
+ * and the last-seen time in one of several mutex-protected hash tables
+ * (picked by the credential's hash), and drain() periodically hands the
+ * accumulated deltas to LoginStore::storeCounts as upserts. Write volume then
+ * scales with distinct credentials per flush interval rather than attempts.
+ */
+class CredentialAggregator {
+public:
+    /**
+     * @brief Creates the shards.
+     * @param config Shard count, sampling and size limit.
+     */
+    explicit CredentialAggregator(AggregatorConfig config)
+        : config(config), shards(config.shards == 0 ? 1 : config.shards), entries(0), recorded(0), raw(0), flushed(0) {}
+
+    CredentialAggregator(const CredentialAggregator&) = delete;
+    CredentialAggregator& operator=(const CredentialAggregator&) = delete;
+
+    /**
+     * @brief Counts an attempt.
+     * @param attempt The attempt.
+     * @return True if the attempt should also be stored as a raw row.
+     */
+    bool record(const LoginAttempt& attempt) {
+        uint64_t n = ++recorded;
+        bool sample = config.sampleEvery > 0 && n % config.sampleEvery == 1 % config.sampleEvery;
+        if (!add(attempt, 1, Clock::now(), Clock::now())) sample = true;
+        if (sample) raw++;
+        return sample;
+    }
+
+    /**
+     * @brief Takes every pending delta, leaving the tables empty.
+     * @return The deltas, one per distinct credential.
+     */
+    std::vector<CredentialCount> drain() {
+        std::vector<CredentialCount> counts;
+        counts.reserve(entries.load(std::memory_order_relaxed));
+        for (Shard& shard : shards) {
+            Map taken;
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                taken.swap(shard.map);
+            }
+            entries -= taken.size();
+            for (auto& [credential, entry] : taken) {
+                counts.push_back(CredentialCount{ credential, entry.attempts, entry.firstSeen, entry.lastSeen });
+            }
+        }
+        flushed += counts.size();
+        return counts;
+    }
+
+    /**
+     * @brief Puts deltas that could not be stored back, merging with anything counted since.
+     * @param counts Deltas returned by drain().
+     */
+    void restore(const std::vector<CredentialCount>& counts) {
+        flushed -= counts.size();
+        for (const CredentialCount& count : counts) {
+            add(count.credential, count.attempts, count.firstSeen, count.lastSeen, true);
+        }
+    }
+
+    /**
+     * @brief Retrieves the aggregator's counters.
+     * @return A snapshot of the counters.
+     */
+    AggregatorStats stats() const {
+        return AggregatorStats{ recorded.load(), raw.load(), entries.load(), flushed.load() };
+    }
+
+private:
+    using Clock = std::chrono::system_clock;
+
+    struct Entry {
+        uint64_t attempts;
+        Clock::time_point firstSeen;
+        Clock::time_point lastSeen;
+    };
+
+    struct CredentialHash {
+        size_t operator()(const LoginAttempt& a) const {
+            std::hash<std::string> h;
+            size_t seed = h(a.username);
+            seed ^= h(a.password) + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+            seed ^= h(a.ip) + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+            return seed;
+        }
+    };
+
+    struct CredentialEqual {
+        bool operator()(const LoginAttempt& a, const LoginAttempt& b) const {
+            return a.username == b.username && a.password == b.password && a.ip == b.ip;
+        }
+    };
+
+    using Map = std::unordered_map<LoginAttempt, Entry, CredentialHash, CredentialEqual>;
+
+    // Shards sit on their own cache lines so handlers on different shards do not contend.
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        Map map;
+    };
+
+    AggregatorConfig config;
+    std::vector<Shard> shards;
+    std::atomic<uint64_t> entries;
+    std::atomic<uint64_t> recorded;
+    std::atomic<uint64_t> raw;
+    std::atomic<uint64_t> flushed;
+
+    /** @brief Adds to a credential's counter; false if the table is full and the credential is new. */
+    bool add(const LoginAttempt& credential, uint64_t attempts, Clock::time_point firstSeen,
+             Clock::time_point lastSeen, bool force = false) {
+        size_t hash = CredentialHash()(credential);
+        Shard& shard = shards[hash % shards.size()];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(credential);
+        if (it != shard.map.end()) {
+            Entry& entry = it->second;
+            entry.attempts += attempts;
+            if (firstSeen < entry.firstSeen) entry.firstSeen = firstSeen;
+            if (lastSeen > entry.lastSeen) entry.lastSeen = lastSeen;
+            return true;
+        }
+        if (!force && entries.load(std::memory_order_relaxed) >= config.maxEntries) return false;
+        shard.map.emplace(credential, Entry{ attempts, firstSeen, lastSeen });
+        entries++;
+        return true;
+    }
+};
+
+#endif // CREDENTIAL_AGGREGATOR_H
@@ -0,0 +1,467 @@
+/**
+ * @file db_event_loop.h
+ * @brief Single-threaded epoll loop driving non-blocking libpq connections.
+ */
+
+#ifndef DB_EVENT_LOOP_H
+#define DB_EVENT_LOOP_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <libpq-fe.h>
+#include "bounded_queue.h"
+#include "db_pool.h"
+#include "statements.h"
+
+/**
+ * @brief Tuning knobs for DbEventLoop, read from the "event_loop" block of db_config.json.
+ */
+struct DbEventLoopConfig {
+    /** @brief Connections driven by the loop. */
+    size_t connections = 2;
+
+    /** @brief Queries sent on one connection (in pipeline mode) before their results are back. */
+    size_t pipelineDepth = 64;
+
+    /** @brief Queries waiting for room on a connection before submit() refuses new ones. */
+    size_t queueCapacity = 4096;
+
+    /** @brief Delay before the first reconnect attempt of a failed connection. */
+    std::chrono::milliseconds initialBackoff{ 100 };
+
+    /** @brief Upper bound for the reconnect delay. */
+    std::chrono::milliseconds maxBackoff{ 30000 };
+};
+
+/**
+ * @brief Counters describing the loop's progress.
+ */
+struct DbEventLoopStats {
+    /** @brief Queries accepted by submit(). */
+    uint64_t submitted;
+
+    /** @brief Queries whose callback received a result. */
+    uint64_t completed;
+
+    /** @brief Queries whose callback received nullptr (connection lost or loop stopped). */
+    uint64_t failed;
+
+    /** @brief Queries refused because the queue was full. */
+    uint64_t rejected;
+
+    /** @brief Successful connects, including the first one of each connection. */
+    uint64_t connects;
+};
+
+/**
+ * @brief Runs prepared statements without blocking any thread on the database.
+ *
+ * submit() queues a statement and returns at once. One loop thread owns all
+ * connections and keeps them in libpq pipeline mode: it sends up to
+ * pipelineDepth queries per connection with PQsendQueryPrepared, each
+ * followed by its own PQpipelineSync so a failing statement does not abort
+ * the ones behind it, and registers the connection's socket with epoll.
+ * Results come back in the order the queries were sent, so each one
+ * completes the oldest outstanding query on its connection (FIFO). A slow
+ * database therefore only lengthens the queue; no handler or worker thread
+ * waits on it. Connecting, reconnecting (with exponential backoff) and
+ * preparing statements are non-blocking too. While every connection is
+ * backing off, queued queries fail immediately rather than waiting for the
+ * database to return; a connection that drops fails every query it carried.
+ *
+ * Callbacks run on the loop thread and must not block for long.
+ */
+class DbEventLoop {
+public:
+    /** @brief Receives the query's result, or nullptr if it could not be completed. */
+    using Callback = std::function<void(const PGresult*)>;
+
+    /**
+     * @brief Starts connecting and launches the loop thread.
+     * @param conninfo libpq connection string.
+     * @param config Connection count, queue size and backoff limits.
+     * @throw std::runtime_error If epoll or eventfd cannot be created.
+     */
+    DbEventLoop(std::string conninfo, DbEventLoopConfig config)
+        : conninfo(std::move(conninfo)), config(config), queue(config.queueCapacity),
+          conns(std::max<size_t>(1, config.connections)), stopping(false),
+          submitted(0), completed(0), failed(0), rejected(0), connects(0) {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFd < 0 || wakeFd < 0) {
+            if (epollFd >= 0) close(epollFd);
+            if (wakeFd >= 0) close(wakeFd);
+            throw std::runtime_error("Cannot create DB event loop");
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = kWakeKey;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+        thread = std::thread(&DbEventLoop::run, this);
+    }
+
+    /**
+     * @brief Stops the loop; queued and in-flight queries receive nullptr.
+     */
+    ~DbEventLoop() {
+        stopping = true;
+        wake();
+        thread.join();
+        close(wakeFd);
+        close(epollFd);
+    }
+
+    DbEventLoop(const DbEventLoop&) = delete;
+    DbEventLoop& operator=(const DbEventLoop&) = delete;
+
+    /**
+     * @brief Queues a prepared statement.
+     * @param statement The statement to run.
+     * @param params Its parameters.
+     * @param callback Invoked on the loop thread with the result.
+     * @return False if the queue was full; the callback will not be invoked.
+     */
+    bool submit(Statement statement, StatementParams params, Callback callback) {
+        if (stopping || !queue.tryPush(Op{ statement, std::move(params), std::move(callback) })) {
+            rejected++;
+            return false;
+        }
+        submitted++;
+        wake();
+        return true;
+    }
+
+    /**
+     * @brief Retrieves the loop's counters.
+     * @return A snapshot of the counters.
+     */
+    DbEventLoopStats stats() const {
+        return DbEventLoopStats{ submitted.load(), completed.load(), failed.load(), rejected.load(), connects.load() };
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr uint64_t kWakeKey = ~0ull;
+
+    struct Op {
+        Statement statement{};
+        StatementParams params;
+        Callback callback;
+    };
+
+    enum class State { BACKOFF, CONNECTING, PREPARING, READY };
+
+    struct Conn {
+        PGconn* conn = nullptr;
+        State state = State::BACKOFF;
+        int fd = -1;
+        size_t prepared = 0;
+        /** @brief Queries sent and waiting for their results, oldest first. */
+        std::deque<Op> inflight;
+        /** @brief Latest result of the oldest query (or of the statement being prepared). */
+        PGresult* result = nullptr;
+        unsigned failures = 0;
+        Clock::time_point retryAt;
+    };
+
+    std::string conninfo;
+    DbEventLoopConfig config;
+    BoundedQueue<Op> queue;
+    std::vector<Conn> conns;
+    std::atomic<bool> stopping;
+    std::atomic<uint64_t> submitted;
+    std::atomic<uint64_t> completed;
+    std::atomic<uint64_t> failed;
+    std::atomic<uint64_t> rejected;
+    std::atomic<uint64_t> connects;
+    int epollFd;
+    int wakeFd;
+    std::thread thread;
+
+    void wake() {
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+
+    void run() {
+        for (size_t i = 0; i < conns.size(); i++) startConnect(i);
+        epoll_event events[16];
+        while (!stopping) {
+            int n = epoll_wait(epollFd, events, 16, nextTimeoutMs());
+            for (int e = 0; e < n; e++) {
+                if (events[e].data.u64 == kWakeKey) {
+                    uint64_t count;
+                    ssize_t got = read(wakeFd, &count, sizeof(count));
+                    (void)got;
+                    continue;
+                }
+                handle(static_cast<size_t>(events[e].data.u64), events[e].events);
+            }
+            Clock::time_point now = Clock::now();
+            for (size_t i = 0; i < conns.size(); i++) {
+                if (conns[i].state == State::BACKOFF && now >= conns[i].retryAt) startConnect(i);
+            }
+            dispatch();
+        }
+        shutdownAll();
+    }
+
+    int nextTimeoutMs() const {
+        bool waiting = false;
+        Clock::time_point earliest = Clock::time_point::max();
+        for (const Conn& c : conns) {
+            if (c.state == State::BACKOFF && c.retryAt < earliest) {
+                earliest = c.retryAt;
+                waiting = true;
+            }
+        }
+        if (!waiting) return -1;
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(earliest - Clock::now()).count();
+        return ms < 0 ? 0 : static_cast<int>(ms + 1);
+    }
+
+    void watch(size_t i, uint32_t events) {
+        Conn& c = conns[i];
+        int fd = PQsocket(c.conn);
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = i;
+        // The socket can change while connecting (e.g. when trying several hosts).
+        if (fd != c.fd) {
+            if (c.fd >= 0) epoll_ctl(epollFd, EPOLL_CTL_DEL, c.fd, nullptr);
+            c.fd = fd;
+            if (fd >= 0) epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+        } else if (fd >= 0 && epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) != 0 && errno == ENOENT) {
+            // libpq closed and reopened the socket under the same number; closing dropped the registration.
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+
+    void startConnect(size_t i) {
+        Conn& c = conns[i];
+        c.conn = PQconnectStart(conninfo.c_str());
+        if (c.conn == nullptr || PQstatus(c.conn) == CONNECTION_BAD) {
+            fail(i);
+            return;
+        }
+        c.state = State::CONNECTING;
+        watch(i, EPOLLOUT);
+    }
+
+    void fail(size_t i) {
+        Conn& c = conns[i];
+        if (c.conn != nullptr && c.state != State::BACKOFF) {
+            std::cerr << "DB error: " << PQerrorMessage(c.conn) << "\n";
+        }
+        failInflight(c);
+        if (c.fd >= 0) epoll_ctl(epollFd, EPOLL_CTL_DEL, c.fd, nullptr);
+        c.fd = -1;
+        if (c.conn != nullptr) PQfinish(c.conn);
+        c.conn = nullptr;
+        c.failures++;
+        c.retryAt = Clock::now() + PgConnectionPool::backoff(c.failures, config.initialBackoff, config.maxBackoff);
+        c.state = State::BACKOFF;
+    }
+
+    /** @brief Completes the oldest query on a connection with the result collected for it. */
+    void finishFront(Conn& c) {
+        Op op = std::move(c.inflight.front());
+        c.inflight.pop_front();
+        if (c.result != nullptr) completed++;
+        else failed++;
+        if (op.callback) op.callback(c.result);
+        if (c.result != nullptr) PQclear(c.result);
+        c.result = nullptr;
+    }
+
+    void failInflight(Conn& c) {
+        if (c.result != nullptr) PQclear(c.result);
+        c.result = nullptr;
+        while (!c.inflight.empty()) finishFront(c);
+    }
+
+    void handle(size_t i, uint32_t events) {
+        Conn& c = conns[i];
+        switch (c.state) {
+            case State::CONNECTING: pollConnect(i); return;
+            case State::PREPARING:
+            case State::READY: {
+                if ((events & EPOLLOUT) && !flush(i)) return;
+                // With nothing in flight this only sees notices or a server-side disconnect.
+                if ((events & (EPOLLIN | EPOLLERR | EPOLLHUP)) &&
+                    (PQconsumeInput(c.conn) == 0 || PQstatus(c.conn) != CONNECTION_OK)) {
+                    fail(i);
+                    return;
+                }
+                collect(i);
+                return;
+            }
+            case State::BACKOFF:
+                return;
+        }
+    }
+
+    void pollConnect(size_t i) {
+        Conn& c = conns[i];
+        switch (PQconnectPoll(c.conn)) {
+            case PGRES_POLLING_READING: watch(i, EPOLLIN); return;
+            case PGRES_POLLING_WRITING: watch(i, EPOLLOUT); return;
+            case PGRES_POLLING_OK:
+                if (PQsetnonblocking(c.conn, 1) != 0) {
+                    fail(i);
+                    return;
+                }
+                connects++;
+                c.state = State::PREPARING;
+                c.prepared = 0;
+                sendPrepare(i);
+                return;
+            default:
+                fail(i);
+                return;
+        }
+    }
+
+    void sendPrepare(size_t i) {
+        Conn& c = conns[i];
+        if (c.prepared == kStatements.size()) {
+            if (PQenterPipelineMode(c.conn) != 1) {
+                fail(i);
+                return;
+            }
+            c.state = State::READY;
+            c.failures = 0;
+            watch(i, EPOLLIN);
+            return;
+        }
+        const StatementInfo& info = kStatements[c.prepared];
+        if (PQsendPrepare(c.conn, info.name, info.sql, info.paramCount, info.paramTypes.data()) != 1) {
+            fail(i);
+            return;
+        }
+        flush(i);
+    }
+
+    /** @brief Pushes queued output; keeps EPOLLOUT armed until libpq's buffer is empty. */
+    bool flush(size_t i) {
+        int pending = PQflush(conns[i].conn);
+        if (pending < 0) {
+            fail(i);
+            return false;
+        }
+        watch(i, pending == 1 ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+        return true;
+    }
+
+    /**
+     * @brief Reads every complete result.
+     *
+     * The nullptr that ends a query's results completes the oldest query in
+     * flight; the PGRES_PIPELINE_SYNC that follows it is skipped.
+     */
+    void collect(size_t i) {
+        Conn& c = conns[i];
+        while (PQisBusy(c.conn) == 0) {
+            PGresult* res = PQgetResult(c.conn);
+            if (res != nullptr) {
+                if (PQresultStatus(res) == PGRES_PIPELINE_SYNC) {
+                    PQclear(res);
+                    continue;
+                }
+                if (c.result != nullptr) PQclear(c.result);
+                c.result = res;
+                continue;
+            }
+            if (c.state == State::PREPARING) {
+                bool ok = c.result != nullptr && PQresultStatus(c.result) == PGRES_COMMAND_OK;
+                if (!ok) {
+                    std::cerr << "Prepare error (" << kStatements[c.prepared].name << "): "
+                              << PQerrorMessage(c.conn) << "\n";
+                    if (!kStatements[c.prepared].optional) {
+                        fail(i);
+                        return;
+                    }
+                }
+                PQclear(c.result);
+                c.result = nullptr;
+                c.prepared++;
+                sendPrepare(i);
+                if (c.state != State::PREPARING) return;
+                continue;
+            }
+            // Every query yields at least one result before its nullptr; a bare nullptr means none is ready.
+            if (c.result == nullptr || c.inflight.empty()) return;
+            finishFront(c);
+        }
+    }
+
+    void dispatch() {
+        bool allDown = std::all_of(conns.begin(), conns.end(), [](const Conn& c) { return c.state == State::BACKOFF; });
+        if (allDown) {
+            failQueued();
+            return;
+        }
+        // Deal queries out one at a time so the connections share the load.
+        size_t depth = std::max<size_t>(1, config.pipelineDepth);
+        std::vector<bool> sent(conns.size(), false);
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            for (size_t i = 0; i < conns.size(); i++) {
+                Conn& c = conns[i];
+                if (c.state != State::READY || c.inflight.size() >= depth) continue;
+                std::optional<Op> op = queue.tryPop();
+                if (!op) break;
+                c.inflight.push_back(std::move(*op));
+                const Op& queued = c.inflight.back();
+                if (!queued.params.send(c.conn, queued.statement) || PQpipelineSync(c.conn) != 1) {
+                    fail(i);
+                    continue;
+                }
+                sent[i] = true;
+                progress = true;
+            }
+        }
+        for (size_t i = 0; i < conns.size(); i++) {
+            if (sent[i] && conns[i].state == State::READY) flush(i);
+        }
+    }
+
+    void shutdownAll() {
+        for (size_t i = 0; i < conns.size(); i++) {
+            Conn& c = conns[i];
+            failInflight(c);
+            if (c.fd >= 0) epoll_ctl(epollFd, EPOLL_CTL_DEL, c.fd, nullptr);
+            if (c.conn != nullptr) PQfinish(c.conn);
+            c.conn = nullptr;
+            c.fd = -1;
+            c.state = State::BACKOFF;
+        }
+        failQueued();
+    }
+
+    void failQueued() {
+        while (std::optional<Op> op = queue.tryPop()) {
+            failed++;
+            if (op->callback) op->callback(nullptr);
+        }
+    }
+};
+
+#endif // DB_EVENT_LOOP_H
@@ -0,0 +1,348 @@
+/**
+ * @file db_pool.h
+ * @brief Bounded pool of long-lived PostgreSQL connections.
+ */
+
+#ifndef DB_POOL_H
+#define DB_POOL_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <libpq-fe.h>
+#include "instrumented_mutex.h"
+#include "trace.h"
+
+/**
+ * @brief Tuning knobs for PgConnectionPool, read from the "pool" block of db_config.json.
+ */
+struct PoolConfig {
+    /** @brief Number of connections opened at startup. */
+    size_t size = 4;
+
+    /** @brief Longest a caller waits for a free connection. */
+    std::chrono::milliseconds acquireTimeout{ 2000 };
+
+    /** @brief Delay before the first reconnect attempt of a failed connection. */
+    std::chrono::milliseconds initialBackoff{ 100 };
+
+    /** @brief Upper bound for the reconnect delay. */
+    std::chrono::milliseconds maxBackoff{ 30000 };
+
+    /** @brief Idle connections older than this are pinged before being handed out. */
+    std::chrono::milliseconds healthCheckIdle{ 30000 };
+};
+
+/**
+ * @brief Snapshot of the pool's counters.
+ */
+struct PoolStats {
+    /** @brief Configured number of connections. */
+    size_t size;
+
+    /** @brief Connections currently idle and healthy. */
+    size_t idle;
+
+    /** @brief Successful acquisitions. */
+    uint64_t acquired;
+
+    /** @brief Acquisitions that gave up, either on timeout or because every connection was down. */
+    uint64_t failed;
+
+    /** @brief Successful (re)connects after startup. */
+    uint64_t reconnects;
+
+    /** @brief Failed connect attempts, including at startup. */
+    uint64_t connectFailures;
+
+    /** @brief Sum of time spent waiting for a connection. */
+    uint64_t totalWaitMicros;
+
+    /** @brief Longest single wait for a connection. */
+    uint64_t maxWaitMicros;
+};
+
+/**
+ * @brief Fixed set of PGconn handles shared by the worker threads.
+ *
+ * All connections are opened in the constructor so that the first login does
+ * not pay for the TCP and authentication handshake. A connection found broken
+ * (on acquire or after use) is reconnected lazily with exponential backoff;
+ * while a connection is backing off it is skipped, and if no connection is
+ * usable acquire() fails immediately instead of stalling the worker pool.
+ */
+class PgConnectionPool {
+public:
+    /** @brief Per-session initialisation (e.g. preparing statements); false marks the connect as failed. */
+    using Setup = std::function<bool(PGconn*)>;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Slot {
+        PGconn* conn = nullptr;
+        /** @brief Connected and set up; PQstatus alone cannot tell whether setup ran. */
+        bool ready = false;
+        bool busy = false;
+        unsigned failures = 0;
+        Clock::time_point nextAttempt;
+        Clock::time_point lastUsed;
+    };
+
+    std::string conninfo;
+    PoolConfig config;
+    Setup setup;
+    std::vector<Slot> slots;
+    mutable InstrumentedMutex poolMutex{ locks::site("db_pool") };
+    std::condition_variable_any poolCv;
+    PoolStats counters{};
+
+    static bool healthy(const Slot& slot) {
+        // A connection left in pipeline mode by a failed batch would reject ordinary queries.
+        return slot.ready && PQstatus(slot.conn) == CONNECTION_OK && PQpipelineStatus(slot.conn) == PQ_PIPELINE_OFF;
+    }
+
+    /** @brief Opens or resets a slot's connection; called without the pool lock held. */
+    bool connect(Slot& slot) {
+        trace::Span span("db.connect");
+        if (slot.conn == nullptr) {
+            slot.conn = PQconnectdb(conninfo.c_str());
+        } else {
+            PQreset(slot.conn);
+        }
+        slot.ready = PQstatus(slot.conn) == CONNECTION_OK;
+        if (!slot.ready) {
+            std::cerr << "DB error: " << PQerrorMessage(slot.conn) << "\n";
+        } else if (setup && !setup(slot.conn)) {
+            slot.ready = false;
+        }
+        return slot.ready;
+    }
+
+    /** @brief An empty query is the cheapest round trip that proves the server is still there. */
+    static bool ping(PGconn* conn) {
+        trace::Span span("db.ping");
+        PGresult* res = PQexec(conn, "");
+        bool ok = PQresultStatus(res) == PGRES_EMPTY_QUERY;
+        PQclear(res);
+        return ok && PQstatus(conn) == CONNECTION_OK;
+    }
+
+    void recordConnect(Slot& slot, bool ok, Clock::time_point now, bool startup) {
+        if (ok) {
+            if (!startup) counters.reconnects++;
+            slot.failures = 0;
+        } else {
+            counters.connectFailures++;
+            slot.failures++;
+            slot.nextAttempt = now + backoff(slot.failures, config.initialBackoff, config.maxBackoff);
+        }
+        slot.lastUsed = now;
+    }
+
+    /** @brief Picks a healthy idle slot, else (if allowed) one whose backoff has expired; -1 if neither. */
+    int pickSlot(Clock::time_point now, bool allowRetry) const {
+        int retry = -1;
+        for (size_t i = 0; i < slots.size(); i++) {
+            const Slot& slot = slots[i];
+            if (slot.busy) continue;
+            if (healthy(slot)) return static_cast<int>(i);
+            if (allowRetry && retry < 0 && now >= slot.nextAttempt) retry = static_cast<int>(i);
+        }
+        return retry;
+    }
+
+    bool anyIdle() const {
+        for (const Slot& slot : slots) {
+            if (!slot.busy) return true;
+        }
+        return false;
+    }
+
+    void release(size_t index, bool broken) {
+        {
+            std::lock_guard<InstrumentedMutex> lock(poolMutex);
+            Slot& slot = slots[index];
+            slot.busy = false;
+            slot.lastUsed = Clock::now();
+            // The next acquire() resets it instead of handing it out.
+            if (broken) slot.ready = false;
+        }
+        poolCv.notify_one();
+    }
+
+public:
+    /**
+     * @brief Exclusive use of one pooled connection, returned to the pool on destruction.
+     */
+    class Lease {
+    public:
+        Lease() : pool(nullptr), index(0), conn(nullptr), broken(false) {}
+        Lease(PgConnectionPool* pool, size_t index, PGconn* conn)
+            : pool(pool), index(index), conn(conn), broken(false) {}
+        Lease(Lease&& other) noexcept : pool(other.pool), index(other.index), conn(other.conn), broken(other.broken) {
+            other.pool = nullptr;
+            other.conn = nullptr;
+        }
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                reset();
+                pool = other.pool;
+                index = other.index;
+                conn = other.conn;
+                broken = other.broken;
+                other.pool = nullptr;
+                other.conn = nullptr;
+            }
+            return *this;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { reset(); }
+
+        /** @brief The leased connection, or nullptr if acquisition failed. */
+        PGconn* get() const { return conn; }
+
+        explicit operator bool() const { return conn != nullptr; }
+
+        /** @brief Has the connection reset before anyone uses it again, e.g. when it is stuck in pipeline mode. */
+        void markBroken() { broken = true; }
+
+        /** @brief Returns the connection early. */
+        void reset() {
+            if (pool != nullptr) pool->release(index, broken);
+            pool = nullptr;
+            conn = nullptr;
+            broken = false;
+        }
+
+    private:
+        PgConnectionPool* pool;
+        size_t index;
+        PGconn* conn;
+        bool broken;
+    };
+
+    /**
+     * @brief Opens every connection up front.
+     *
+     * Connections that fail here are not fatal: they start in backoff and are
+     * retried by later acquire() calls.
+     *
+     * @param conninfo libpq connection string.
+     * @param config Pool size, timeouts and backoff limits.
+     * @param setup Run on every new or reset session before it is handed out.
+     */
+    PgConnectionPool(std::string conninfo, PoolConfig config, Setup setup = nullptr)
+        : conninfo(std::move(conninfo)), config(config), setup(std::move(setup)),
+          slots(std::max<size_t>(1, config.size)) {
+        counters.size = slots.size();
+        for (Slot& slot : slots) {
+            recordConnect(slot, connect(slot), Clock::now(), true);
+        }
+    }
+
+    ~PgConnectionPool() {
+        for (Slot& slot : slots) {
+            if (slot.conn != nullptr) PQfinish(slot.conn);
+        }
+    }
+
+    PgConnectionPool(const PgConnectionPool&) = delete;
+    PgConnectionPool& operator=(const PgConnectionPool&) = delete;
+
+    /**
+     * @brief Delay before the next reconnect after a number of consecutive failures.
+     * @param failures Consecutive failed attempts (at least 1).
+     * @param initial Delay after the first failure.
+     * @param max Upper bound.
+     * @return initial * 2^(failures - 1), capped at max.
+     */
+    static std::chrono::milliseconds backoff(unsigned failures, std::chrono::milliseconds initial,
+                                             std::chrono::milliseconds max) {
+        std::chrono::milliseconds delay = initial;
+        for (unsigned i = 1; i < failures && delay < max; i++) delay *= 2;
+        return std::min(delay, max);
+    }
+
+    /**
+     * @brief Borrows a healthy connection.
+     *
+     * Waits up to the acquire timeout for a connection to become idle. A broken
+     * connection whose backoff has expired is reconnected on the caller's
+     * thread, at most once per call; idle connections unused for longer than the health check
+     * interval are pinged first.
+     *
+     * @return A lease, which is empty if no connection could be provided.
+     */
+    Lease acquire() {
+        // Covers the wait for a free connection plus any ping or reconnect it needs.
+        trace::Span span("db.acquire");
+        Clock::time_point start = Clock::now();
+        Clock::time_point deadline = start + config.acquireTimeout;
+        bool allowRetry = true;
+        std::unique_lock<InstrumentedMutex> lock(poolMutex);
+        while (true) {
+            if (!poolCv.wait_until(lock, deadline, [this] { return anyIdle(); })) {
+                counters.failed++;
+                return Lease();
+            }
+            Clock::time_point now = Clock::now();
+            int index = pickSlot(now, allowRetry);
+            if (index < 0) {
+                // Every idle connection is backing off; failing now keeps the worker free.
+                counters.failed++;
+                return Lease();
+            }
+            Slot& slot = slots[index];
+            slot.busy = true;
+            bool wasHealthy = healthy(slot);
+            bool stale = now - slot.lastUsed > config.healthCheckIdle;
+            lock.unlock();
+
+            bool ok = wasHealthy && (!stale || ping(slot.conn));
+            bool reconnected = false;
+            if (!ok) {
+                ok = connect(slot);
+                reconnected = true;
+            }
+
+            lock.lock();
+            now = Clock::now();
+            if (reconnected) recordConnect(slot, ok, now, false);
+            if (ok) {
+                uint64_t waited = static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(now - start).count());
+                counters.acquired++;
+                counters.totalWaitMicros += waited;
+                counters.maxWaitMicros = std::max(counters.maxWaitMicros, waited);
+                return Lease(this, static_cast<size_t>(index), slot.conn);
+            }
+            slot.busy = false;
+            allowRetry = false;
+            poolCv.notify_one();
+        }
+    }
+
+    /**
+     * @brief Retrieves a snapshot of the pool counters.
+     * @return The current statistics.
+     */
+    PoolStats stats() const {
+        std::lock_guard<InstrumentedMutex> lock(poolMutex);
+        PoolStats result = counters;
+        result.idle = 0;
+        for (const Slot& slot : slots) {
+            if (!slot.busy && healthy(slot)) result.idle++;
+        }
+        return result;
+    }
+};
+
+#endif // DB_POOL_H
@@ -0,0 +1,198 @@
+/**
+ * @file handshake.h
+ * @brief HELLO capability exchange and negotiation of per-connection protocol options.
+ *
+ * A client may send HELLO as its first packet. Both HELLO and its ACK carry
+ * the same 12-byte big-endian payload:
+ *
+ *   | version (2) | checksums (2) | compression (2) | features (2) | maxFrameSize (4) |
+ *
+ * In the request each field lists what the client supports. In the ACK each
+ * field holds the single option the server selected. The ACK itself still
+ * uses legacy framing; the negotiated options apply from the next packet
+ * onwards. Clients that never send HELLO keep protocol version 1.
+ */
+
+#ifndef HANDSHAKE_H
+#define HANDSHAKE_H
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "checksum.h"
+#include "packet.h"
+#include "stream.h"
+
+namespace handshake {
+
+/** @brief Legacy framing: 12-byte header, CRC32, replies in request order. */
+constexpr uint16_t kLegacyVersion = 1;
+
+/** @brief Adds a 4-byte request ID after every header, echoed in the reply. */
+constexpr uint16_t kRequestIdVersion = 2;
+
+/** @brief Newest version this build speaks. */
+constexpr uint16_t kMaxVersion = kRequestIdVersion;
+
+/** @brief Size of the HELLO payload. */
+constexpr uint32_t kHelloSize = 12;
+
+/** @brief Smallest frame size a peer may negotiate. */
+constexpr uint32_t kMinFrameSize = 1024;
+
+/** @brief Bits of the checksums field. */
+enum ChecksumBits : uint16_t {
+    CHECKSUM_CRC32 = 0x0001,
+    CHECKSUM_CRC32C = 0x0002,
+    CHECKSUM_NONE = 0x0004
+};
+
+/** @brief Bits of the compression field. */
+enum CompressionBits : uint16_t {
+    COMPRESSION_ZLIB = 0x0001
+};
+
+/** @brief Bits of the features field. */
+enum FeatureBits : uint16_t {
+    /** @brief Large replies may be sent as chunked streams (see stream.h). */
+    FEATURE_STREAM = 0x0001,
+    /** @brief Replies to worker-dispatched commands may arrive out of order; requires version 2. */
+    FEATURE_MULTIPLEX = 0x0002
+};
+
+/**
+ * @brief Contents of a HELLO payload.
+ */
+struct Hello {
+    uint16_t version;
+    uint16_t checksums;
+    uint16_t compression;
+    uint16_t features;
+    uint32_t maxFrameSize;
+};
+
+/**
+ * @brief Options a connection runs with after negotiation.
+ */
+struct Options {
+    /** @brief Protocol version; kRequestIdVersion adds the request ID to every header. */
+    uint16_t version;
+
+    /** @brief Algorithm for the payloadCRC field in both directions. */
+    ChecksumType checksum;
+
+    /** @brief Whether replies may be compressed without a per-request flag. */
+    bool compression;
+
+    /** @brief Whether large replies may be streamed without a per-request flag. */
+    bool streaming;
+
+    /** @brief Whether worker replies may be sent out of order. */
+    bool multiplex;
+
+    /** @brief Largest DATA chunk the server sends. */
+    uint32_t maxFrameSize;
+};
+
+/**
+ * @brief Options of a connection that never sent HELLO.
+ */
+constexpr Options legacyOptions() {
+    return Options{ kLegacyVersion, ChecksumType::CRC32, false, false, false, stream::kDefaultChunkSize };
+}
+
+/**
+ * @brief Everything this server build supports.
+ */
+constexpr Hello serverCapabilities() {
+    return Hello{ kMaxVersion,
+                  static_cast<uint16_t>(CHECKSUM_CRC32 | CHECKSUM_CRC32C | CHECKSUM_NONE),
+                  COMPRESSION_ZLIB,
+                  static_cast<uint16_t>(FEATURE_STREAM | FEATURE_MULTIPLEX),
+                  stream::kMaxChunkSize };
+}
+
+/**
+ * @brief Decodes a HELLO payload.
+ * @param data The payload bytes.
+ * @param length The payload size.
+ * @return The decoded capabilities.
+ * @throw std::runtime_error If the payload has the wrong size.
+ */
+inline Hello decode(const uint8_t* data, size_t length) {
+    if (length != kHelloSize) {
+        throw std::runtime_error("Malformed HELLO");
+    }
+    uint16_t shorts[4];
+    uint32_t frame;
+    std::memcpy(shorts, data, sizeof(shorts));
+    std::memcpy(&frame, data + sizeof(shorts), sizeof(frame));
+    return Hello{ ntohs(shorts[0]), ntohs(shorts[1]), ntohs(shorts[2]), ntohs(shorts[3]), ntohl(frame) };
+}
+
+/**
+ * @brief Encodes a HELLO payload.
+ * @param hello The fields to encode.
+ * @param out Destination for kHelloSize bytes.
+ */
+inline void encode(const Hello& hello, uint8_t* out) {
+    uint16_t shorts[4] = { htons(hello.version), htons(hello.checksums), htons(hello.compression), htons(hello.features) };
+    uint32_t frame = htonl(hello.maxFrameSize);
+    std::memcpy(out, shorts, sizeof(shorts));
+    std::memcpy(out + sizeof(shorts), &frame, sizeof(frame));
+}
+
+/**
+ * @brief Picks the cheapest mode both peers support.
+ *
+ * Checksums are preferred in the order NONE, CRC32C, CRC32; CRC32 is used if
+ * the peers share nothing else. Multiplexing needs request IDs and is
+ * dropped below version 2.
+ *
+ * @param client What the client offered.
+ * @param server What the server offers.
+ * @return The selections, encoded as a HELLO for the ACK.
+ * @throw std::runtime_error If the client offers no usable version.
+ */
+inline Hello negotiate(const Hello& client, const Hello& server) {
+    if (client.version < kLegacyVersion) {
+        throw std::runtime_error("Unsupported protocol version");
+    }
+    Hello chosen{};
+    chosen.version = client.version < server.version ? client.version : server.version;
+
+    uint16_t checksums = client.checksums & server.checksums;
+    if (checksums & CHECKSUM_NONE) chosen.checksums = CHECKSUM_NONE;
+    else if (checksums & CHECKSUM_CRC32C) chosen.checksums = CHECKSUM_CRC32C;
+    else chosen.checksums = CHECKSUM_CRC32;
+
+    chosen.compression = (client.compression & server.compression & COMPRESSION_ZLIB) ? COMPRESSION_ZLIB : 0;
+
+    chosen.features = client.features & server.features;
+    if (chosen.version < kRequestIdVersion) chosen.features &= ~FEATURE_MULTIPLEX;
+
+    uint32_t frame = client.maxFrameSize < server.maxFrameSize ? client.maxFrameSize : server.maxFrameSize;
+    chosen.maxFrameSize = frame < kMinFrameSize ? kMinFrameSize : frame;
+    return chosen;
+}
+
+/**
+ * @brief Converts negotiated selections into connection options.
+ * @param chosen The result of negotiate().
+ * @return The options the connection runs with.
+ */
+inline Options toOptions(const Hello& chosen) {
+    Options options = legacyOptions();
+    options.version = chosen.version;
+    if (chosen.checksums == CHECKSUM_NONE) options.checksum = ChecksumType::NONE;
+    else if (chosen.checksums == CHECKSUM_CRC32C) options.checksum = ChecksumType::CRC32C;
+    options.compression = (chosen.compression & COMPRESSION_ZLIB) != 0;
+    options.streaming = (chosen.features & FEATURE_STREAM) != 0;
+    options.multiplex = (chosen.features & FEATURE_MULTIPLEX) != 0;
+    options.maxFrameSize = chosen.maxFrameSize;
+    return options;
+}
+
+} // namespace handshake
+
+#endif // HANDSHAKE_H
@@ -0,0 +1,227 @@
+/**
+ * @file instrumented_mutex.h
+ * @brief Mutex that records wait time, hold time and contention per lock site.
+ */
+
+#ifndef INSTRUMENTED_MUTEX_H
+#define INSTRUMENTED_MUTEX_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "latency.h"
+#include "metrics.h"
+
+/**
+ * @brief Snapshot of a lock site's counters.
+ */
+struct LockSiteStats {
+    /** @brief Successful lock() and try_lock() calls. */
+    uint64_t acquisitions;
+
+    /** @brief Acquisitions that found the lock held and had to wait. */
+    uint64_t contended;
+
+    /** @brief Total time spent waiting, in nanoseconds. */
+    uint64_t waitNanos;
+};
+
+class InstrumentedMutex;
+
+/**
+ * @brief Statistics shared by every mutex guarding the same kind of data, e.g. all sessions' send locks.
+ *
+ * Each mutex counts its own acquisitions while holding itself, so the
+ * uncontended path has no atomic read-modify-write beyond the lock itself;
+ * the site adds up its live mutexes (and those already destroyed) when
+ * read. Waits are timed only when the lock was contended, and hold times
+ * for one acquisition in kHoldSampleEvery.
+ */
+class LockSite {
+public:
+    /** @brief Hold times are measured for one acquisition in this many (a power of two). */
+    static constexpr uint64_t kHoldSampleEvery = 64;
+
+    explicit LockSite(std::string name) : siteName(std::move(name)), retired(0) {}
+
+    LockSite(const LockSite&) = delete;
+    LockSite& operator=(const LockSite&) = delete;
+
+    const std::string& name() const { return siteName; }
+
+    LockSiteStats stats() const;
+
+    /** @brief Waits of contended acquisitions. */
+    const LatencyHistogram& waits() const { return waitHistogram; }
+
+    /** @brief Sampled hold times. */
+    const LatencyHistogram& holds() const { return holdHistogram; }
+
+private:
+    friend class InstrumentedMutex;
+
+    std::string siteName;
+    Counter contended;
+    Counter waitNanos;
+    LatencyHistogram waitHistogram;
+    LatencyHistogram holdHistogram;
+    mutable std::mutex membersMutex;
+    std::unordered_set<const InstrumentedMutex*> members;
+    /** @brief Acquisitions of mutexes already destroyed. */
+    uint64_t retired;
+
+    void attach(const InstrumentedMutex* mutex) {
+        std::lock_guard<std::mutex> lock(membersMutex);
+        members.insert(mutex);
+    }
+
+    void detach(const InstrumentedMutex* mutex, uint64_t acquisitions) {
+        std::lock_guard<std::mutex> lock(membersMutex);
+        members.erase(mutex);
+        retired += acquisitions;
+    }
+};
+
+/**
+ * @brief Drop-in replacement for std::mutex (Lockable, so it works with
+ *        lock_guard and unique_lock) that reports to a LockSite.
+ *
+ * Wait on it with std::condition_variable_any. Time spent inside wait() is
+ * not held time; reacquiring after a wakeup counts as an acquisition, and as
+ * contended if another thread holds the lock by then.
+ */
+class InstrumentedMutex {
+public:
+    explicit InstrumentedMutex(LockSite& site) : site(site), acquisitions(0), holdStart() { site.attach(this); }
+
+    ~InstrumentedMutex() { site.detach(this, acquisitions.load(std::memory_order_relaxed)); }
+
+    InstrumentedMutex(const InstrumentedMutex&) = delete;
+    InstrumentedMutex& operator=(const InstrumentedMutex&) = delete;
+
+    void lock() {
+        if (!mutex.try_lock()) {
+            auto start = std::chrono::steady_clock::now();
+            mutex.lock();
+            auto waited = std::chrono::steady_clock::now() - start;
+            auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count();
+            site.contended.inc();
+            site.waitNanos.inc(static_cast<uint64_t>(nanos));
+            site.waitHistogram.record(waited);
+        }
+        acquired();
+    }
+
+    bool try_lock() {
+        if (!mutex.try_lock()) return false;
+        acquired();
+        return true;
+    }
+
+    void unlock() {
+        // Read under the lock: only the holder writes holdStart.
+        std::chrono::steady_clock::time_point start = holdStart;
+        holdStart = std::chrono::steady_clock::time_point();
+        mutex.unlock();
+        if (start != std::chrono::steady_clock::time_point()) {
+            site.holdHistogram.record(std::chrono::steady_clock::now() - start);
+        }
+    }
+
+    /** @brief Acquisitions of this mutex so far. */
+    uint64_t count() const { return acquisitions.load(std::memory_order_relaxed); }
+
+private:
+    std::mutex mutex;
+    LockSite& site;
+    /** @brief Written only by the holder, so a plain load and store suffice; atomic so the site can read it. */
+    std::atomic<uint64_t> acquisitions;
+    std::chrono::steady_clock::time_point holdStart;
+
+    void acquired() {
+        uint64_t n = acquisitions.load(std::memory_order_relaxed) + 1;
+        acquisitions.store(n, std::memory_order_relaxed);
+        if ((n & (LockSite::kHoldSampleEvery - 1)) == 0) holdStart = std::chrono::steady_clock::now();
+    }
+};
+
+inline LockSiteStats LockSite::stats() const {
+    uint64_t acquisitions;
+    {
+        std::lock_guard<std::mutex> lock(membersMutex);
+        acquisitions = retired;
+        for (const InstrumentedMutex* mutex : members) acquisitions += mutex->count();
+    }
+    return LockSiteStats{ acquisitions, contended.get(), waitNanos.get() };
+}
+
+namespace locks {
+
+/** @brief Every site, in creation order; entries live for the whole process. */
+class SiteRegistry {
+public:
+    LockSite& site(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (LockSite& existing : sites) {
+            if (existing.name() == name) return existing;
+        }
+        sites.emplace_back(name);
+        return sites.back();
+    }
+
+    std::vector<LockSite*> all() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<LockSite*> out;
+        for (LockSite& existing : sites) out.push_back(&existing);
+        return out;
+    }
+
+private:
+    std::mutex mutex;
+    // A deque keeps sites at stable addresses as more are added.
+    std::deque<LockSite> sites;
+};
+
+/** @brief The process-wide registry; never destroyed, so locks in static objects can use it to the end. */
+inline SiteRegistry& registry() {
+    static SiteRegistry* instance = new SiteRegistry();
+    return *instance;
+}
+
+/** @brief The site with this name, created on first use. */
+inline LockSite& site(const std::string& name) {
+    return registry().site(name);
+}
+
+/**
+ * @brief Exports every site that exists now to a metrics registry.
+ *
+ * Sites are labelled lock="<name>"; call this after the objects owning the
+ * locks have been constructed.
+ */
+inline void registerMetrics(MetricsRegistry& metrics) {
+    for (LockSite* lockSite : registry().all()) {
+        std::string labels = metrics::label("lock", lockSite->name());
+        metrics.sampled("ctf_lock_acquisitions_total", "Lock acquisitions by lock site.", metrics::Type::COUNTER,
+                        [lockSite] { return static_cast<double>(lockSite->stats().acquisitions); }, labels);
+        metrics.sampled("ctf_lock_contended_total", "Lock acquisitions that had to wait, by lock site.",
+                        metrics::Type::COUNTER,
+                        [lockSite] { return static_cast<double>(lockSite->stats().contended); }, labels);
+        metrics.sampled("ctf_lock_wait_seconds_total", "Time spent waiting for locks, by lock site.",
+                        metrics::Type::COUNTER,
+                        [lockSite] { return static_cast<double>(lockSite->stats().waitNanos) / 1e9; }, labels);
+        metrics.summary("ctf_lock_wait_seconds", "Waits of contended lock acquisitions, by lock site.",
+                        [lockSite] { return summarize(lockSite->waits().snapshot()); }, labels);
+        metrics.summary("ctf_lock_hold_seconds", "Sampled lock hold times, by lock site.",
+                        [lockSite] { return summarize(lockSite->holds().snapshot()); }, labels);
+    }
+}
+
+} // namespace locks
+
+#endif // INSTRUMENTED_MUTEX_H
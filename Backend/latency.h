@@ -0,0 +1,229 @@
+/**
+ * @file latency.h
+ * @brief Log-linear latency histograms, recorded per thread and merged on read.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "command_registry.h"
+#include "metrics.h"
+
+/**
+ * @brief A merged view of a histogram.
+ */
+struct HistogramSnapshot {
+    /** @brief Samples per bucket (see LatencyHistogram::bucketOf()). */
+    std::vector<uint64_t> counts;
+
+    /** @brief Number of samples. */
+    uint64_t count = 0;
+
+    /** @brief Sum of all samples, in nanoseconds. */
+    uint64_t sum = 0;
+
+    /** @brief Largest sample, in nanoseconds. */
+    uint64_t max = 0;
+
+    /**
+     * @brief Estimates a percentile.
+     * @param p Fraction of samples at or below the result, e.g. 0.99.
+     * @return The upper bound of the bucket holding that rank (at most max), in nanoseconds; 0 if empty.
+     */
+    uint64_t percentile(double p) const;
+};
+
+/**
+ * @brief Histogram of durations with HDR-style log-linear buckets.
+ *
+ * Values below 2^kSubBits nanoseconds get a bucket each; above that every
+ * power of two is split into 2^kSubBits equal buckets, so a bucket is never
+ * wider than 1/16 of its values (6.25%) across the whole range, up to
+ * about 18 minutes. Larger values land in the last bucket.
+ *
+ * Recording is a relaxed increment in the calling thread's shard (see
+ * metrics::shard()), allocated on that shard's first sample so unused
+ * histograms cost a pointer per shard. snapshot() adds the shards up.
+ */
+class LatencyHistogram {
+public:
+    static constexpr unsigned kSubBits = 4;
+    static constexpr unsigned kMaxExponent = 40;
+    static constexpr size_t kSubBuckets = size_t{ 1 } << kSubBits;
+    static constexpr size_t kBuckets = (kMaxExponent - kSubBits + 2) * kSubBuckets;
+
+    LatencyHistogram() : shards(new std::atomic<Shard*>[metrics::shardCount()]) {
+        for (size_t i = 0; i < metrics::shardCount(); i++) shards[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~LatencyHistogram() {
+        for (size_t i = 0; i < metrics::shardCount(); i++) delete shards[i].load(std::memory_order_relaxed);
+    }
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    /** @brief Bucket index of a value in nanoseconds. */
+    static size_t bucketOf(uint64_t value) {
+        if (value < kSubBuckets) return static_cast<size_t>(value);
+        unsigned exponent = 63 - static_cast<unsigned>(__builtin_clzll(value));
+        if (exponent > kMaxExponent) return kBuckets - 1;
+        size_t sub = static_cast<size_t>(value >> (exponent - kSubBits)) - kSubBuckets;
+        return (exponent - kSubBits + 1) * kSubBuckets + sub;
+    }
+
+    /** @brief Largest value, in nanoseconds, that falls in a bucket. */
+    static uint64_t bucketUpper(size_t index) {
+        if (index < kSubBuckets) return index;
+        unsigned exponent = static_cast<unsigned>(index / kSubBuckets) + kSubBits - 1;
+        uint64_t mantissa = index % kSubBuckets + kSubBuckets;
+        return ((mantissa + 1) << (exponent - kSubBits)) - 1;
+    }
+
+    /** @brief Adds one sample, in nanoseconds. */
+    void record(uint64_t nanos) {
+        Shard& s = shard();
+        s.counts[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+        s.sum.fetch_add(nanos, std::memory_order_relaxed);
+        uint64_t seen = s.max.load(std::memory_order_relaxed);
+        while (nanos > seen && !s.max.compare_exchange_weak(seen, nanos, std::memory_order_relaxed)) {
+        }
+    }
+
+    /** @brief Adds one sample. */
+    void record(std::chrono::steady_clock::duration elapsed) {
+        auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        record(static_cast<uint64_t>(std::max<int64_t>(nanos, 0)));
+    }
+
+    /** @brief Merges every shard. */
+    HistogramSnapshot snapshot() const {
+        HistogramSnapshot merged;
+        merged.counts.assign(kBuckets, 0);
+        for (size_t i = 0; i < metrics::shardCount(); i++) {
+            const Shard* s = shards[i].load(std::memory_order_acquire);
+            if (s == nullptr) continue;
+            for (size_t b = 0; b < kBuckets; b++) {
+                uint64_t n = s->counts[b].load(std::memory_order_relaxed);
+                merged.counts[b] += n;
+                merged.count += n;
+            }
+            merged.sum += s->sum.load(std::memory_order_relaxed);
+            merged.max = std::max(merged.max, s->max.load(std::memory_order_relaxed));
+        }
+        return merged;
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, kBuckets> counts{};
+        std::atomic<uint64_t> sum{ 0 };
+        std::atomic<uint64_t> max{ 0 };
+    };
+
+    std::unique_ptr<std::atomic<Shard*>[]> shards;
+
+    Shard& shard() {
+        std::atomic<Shard*>& slot = shards[metrics::shard()];
+        Shard* s = slot.load(std::memory_order_acquire);
+        if (s != nullptr) return *s;
+        Shard* created = new Shard();
+        if (slot.compare_exchange_strong(s, created, std::memory_order_acq_rel)) return *created;
+        // Another thread dealt the same shard got there first.
+        delete created;
+        return *s;
+    }
+};
+
+inline uint64_t HistogramSnapshot::percentile(double p) const {
+    if (count == 0) return 0;
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p * static_cast<double>(count))));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < counts.size(); b++) {
+        seen += counts[b];
+        if (seen >= rank) return std::min(LatencyHistogram::bucketUpper(b), max);
+    }
+    return max;
+}
+
+/** @brief A histogram as a metrics summary: p50, p99 and p99.9, with sum and count in seconds. */
+inline metrics::Summary summarize(const HistogramSnapshot& snapshot) {
+    metrics::Summary summary;
+    for (double q : { 0.5, 0.99, 0.999 }) summary.quantiles.emplace_back(q, snapshot.percentile(q) / 1e9);
+    summary.sum = static_cast<double>(snapshot.sum) / 1e9;
+    summary.count = snapshot.count;
+    return summary;
+}
+
+/** @brief Stages of a request that are timed separately. */
+enum class Stage : uint8_t {
+    HEADER_READ,  /**< From the first header byte arriving to the whole header (and request ID) read. */
+    PAYLOAD_READ, /**< From the header to the whole payload read. */
+    PROCESS,      /**< Running the handler, including any wait for a worker thread. */
+    DB,           /**< Queueing a login for the writer, or waiting for the event loop to commit it. */
+    SEND,         /**< Writing one frame, including the wait for the connection's send lock. */
+    TOTAL,        /**< From the header being read to the reply being sent. */
+};
+
+constexpr size_t kStageCount = 6;
+
+/** @brief Name of a stage in metric labels and STATS. */
+inline const char* stageName(Stage stage) {
+    switch (stage) {
+        case Stage::HEADER_READ: return "header_read";
+        case Stage::PAYLOAD_READ: return "payload_read";
+        case Stage::PROCESS: return "process";
+        case Stage::DB: return "db";
+        case Stage::SEND: return "send";
+        case Stage::TOTAL: return "total";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief One latency histogram per command and stage.
+ *
+ * Commands are indexed as in kCommandTable, with one extra slot for frames
+ * whose command is not known (rejections, replies to unknown requests).
+ */
+class RequestLatency {
+public:
+    static constexpr size_t kSlots = kCommandCount + 1;
+
+    /** @brief Slot of a command; the last slot for anything not in kCommandTable. */
+    static size_t slot(Command cmd) {
+        const CommandInfo* info = findCommand(cmd);
+        return info != nullptr ? commandIndex(info->command) : kCommandCount;
+    }
+
+    /** @brief Name of a slot in metric labels and STATS. */
+    static const char* slotName(size_t slot) {
+        return slot < kCommandCount ? kCommandTable[slot].name : "unknown";
+    }
+
+    void record(Command cmd, Stage stage, std::chrono::steady_clock::duration elapsed) {
+        grid[slot(cmd)][static_cast<size_t>(stage)].record(elapsed);
+    }
+
+    /** @brief Records the time from start until now. */
+    void since(Command cmd, Stage stage, std::chrono::steady_clock::time_point start) {
+        record(cmd, stage, std::chrono::steady_clock::now() - start);
+    }
+
+    const LatencyHistogram& histogram(size_t slot, Stage stage) const {
+        return grid[slot][static_cast<size_t>(stage)];
+    }
+
+private:
+    std::array<std::array<LatencyHistogram, kStageCount>, kSlots> grid;
+};
+
+#endif // LATENCY_H
@@ -0,0 +1,20 @@
+/**
+ * @file login_attempt.h
+ * @brief A captured LOGIN, as stored by every persistence path.
+ */
+
+#ifndef LOGIN_ATTEMPT_H
+#define LOGIN_ATTEMPT_H
+
+#include <string>
+
+/**
+ * @brief One captured LOGIN.
+ */
+struct LoginAttempt {
+    std::string username;
+    std::string password;
+    std::string ip;
+};
+
+#endif // LOGIN_ATTEMPT_H
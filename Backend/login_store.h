@@ -0,0 +1,58 @@
+/**
+ * @file login_store.h
+ * @brief Interface of the backends that persist login attempts.
+ */
+
+#ifndef LOGIN_STORE_H
+#define LOGIN_STORE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "login_attempt.h"
+
+/**
+ * @brief Attempts with one (username, password, ip) seen since the last flush.
+ */
+struct CredentialCount {
+    LoginAttempt credential;
+    uint64_t attempts;
+    std::chrono::system_clock::time_point firstSeen;
+    std::chrono::system_clock::time_point lastSeen;
+};
+
+/**
+ * @brief Where LoginWriter sends its batches.
+ *
+ * Implementations are driven by a single writer thread and need not be
+ * thread safe.
+ */
+class LoginStore {
+public:
+    virtual ~LoginStore() = default;
+
+    /**
+     * @brief Persists one batch of attempts.
+     * @param batch The attempts, in arrival order.
+     * @param rejected Receives the number of rows the backend refused (e.g. a constraint violation).
+     * @return False if the backend could not be reached; then nothing was stored and the batch may be retried.
+     */
+    virtual bool store(const std::vector<LoginAttempt>& batch, size_t& rejected) = 0;
+
+    /**
+     * @brief Adds aggregated counts to the per-credential totals (login_credentials).
+     *
+     * Existing rows have attempts added, first_seen lowered and last_seen raised.
+     *
+     * @param counts Deltas since the last call, one per credential.
+     * @param retry Receives the deltas that never reached the backend (connection lost), to be sent again.
+     * @return Number of deltas stored; the rest not in retry were refused by the backend.
+     */
+    virtual size_t storeCounts(const std::vector<CredentialCount>& counts, std::vector<CredentialCount>& retry) = 0;
+
+    /** @brief Short backend name for log messages. */
+    virtual const char* name() const = 0;
+};
+
+#endif // LOGIN_STORE_H
@@ -0,0 +1,289 @@
+/**
+ * @file login_writer.h
+ * @brief Background writer that stores login attempts in batches.
+ */
+
+#ifndef LOGIN_WRITER_H
+#define LOGIN_WRITER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bounded_queue.h"
+#include "credential_aggregator.h"
+#include "login_attempt.h"
+#include "login_store.h"
+#include "spool.h"
+
+/**
+ * @brief Tuning knobs for LoginWriter, read from the "login_writer" block of db_config.json.
+ */
+struct LoginWriterConfig {
+    /** @brief Attempts buffered before new ones are dropped. */
+    size_t queueCapacity = 16384;
+
+    /** @brief A flush starts as soon as this many attempts are queued. */
+    size_t batchSize = 1000;
+
+    /** @brief Longest an attempt waits in the queue when traffic is light. */
+    std::chrono::milliseconds flushInterval{ 200 };
+
+    /** @brief Durable overflow used while the database is unreachable or the queue is full. */
+    SpoolConfig spool;
+
+    /** @brief Spooled batches replayed per writer cycle once the database is back. */
+    size_t replayBatchesPerCycle = 8;
+
+    /** @brief Count repeated credentials instead of writing a row per attempt. */
+    AggregatorConfig aggregation;
+};
+
+/**
+ * @brief Counters describing the writer's progress.
+ */
+struct LoginWriterStats {
+    /** @brief Attempts accepted into the queue. */
+    uint64_t queued;
+
+    /** @brief Attempts lost because the queue was full and there is no spool. */
+    uint64_t dropped;
+
+    /** @brief Attempts committed to the store. */
+    uint64_t written;
+
+    /** @brief Attempts the database rejected, or that could not be written and had no spool to go to. */
+    uint64_t failed;
+
+    /** @brief Batches committed. */
+    uint64_t batches;
+
+    /** @brief Time spent in the store writing batches, in nanoseconds. */
+    uint64_t writeNanos;
+
+    /** @brief Spool depth and replay progress; all zero when the spool is disabled. */
+    SpoolStats spool;
+
+    /** @brief Aggregation counters; all zero when aggregation is disabled. */
+    AggregatorStats aggregation;
+};
+
+/**
+ * @brief Decouples LOGIN handling from the database.
+ *
+ * Handlers push attempts onto a lock-free queue and return immediately. A
+ * single writer thread drains the queue whenever batchSize attempts are
+ * waiting or flushInterval has passed, and hands each batch to the
+ * LoginStore (PostgreSQL COPY or a SQLite transaction). Rows are therefore
+ * timestamped by the database when the batch lands, at most flushInterval
+ * after the attempt (under normal load).
+ *
+ * Attempts that cannot reach the database - the queue is full, or a batch
+ * failed because the connection did - go to a LoginSpool instead of being
+ * dropped. Each cycle the writer group-commits the spool and, while the
+ * database accepts writes, replays a few spooled batches alongside live
+ * traffic. Replayed rows are timestamped when they are replayed.
+ *
+ * With aggregation enabled, submit() only counts the credential in a
+ * CredentialAggregator and queues a sampled subset as raw rows; the writer
+ * thread upserts the accumulated counts every aggregation.flushInterval.
+ * Counts that cannot be stored are kept in memory for the next flush.
+ */
+class LoginWriter {
+private:
+    LoginStore& store;
+    LoginWriterConfig config;
+    BoundedQueue<LoginAttempt> queue;
+    std::atomic<uint64_t> queued;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> written;
+    std::atomic<uint64_t> failed;
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> writeNanos;
+    std::unique_ptr<LoginSpool> spool;
+    std::unique_ptr<CredentialAggregator> aggregator;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCv;
+    bool stopping;
+    std::thread thread;
+
+    void run() {
+        std::vector<LoginAttempt> batch;
+        auto lastAggregate = std::chrono::steady_clock::now();
+        while (true) {
+            bool stop;
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wakeCv.wait_for(lock, config.flushInterval, [this] {
+                    return stopping || queue.size() >= config.batchSize;
+                });
+                stop = stopping;
+            }
+            // Drain in batchSize pieces so a backlog does not build one huge batch.
+            while (drain(batch) > 0) {
+                flush(batch);
+            }
+            if (aggregator &&
+                (stop || std::chrono::steady_clock::now() - lastAggregate >= config.aggregation.flushInterval)) {
+                flushCounts(stop);
+                lastAggregate = std::chrono::steady_clock::now();
+            }
+            if (spool) {
+                spool->sync();
+                if (!stop && spool->pending()) replaySpool();
+            }
+            if (stop) return;
+        }
+    }
+
+    size_t drain(std::vector<LoginAttempt>& batch) {
+        batch.clear();
+        while (batch.size() < config.batchSize) {
+            std::optional<LoginAttempt> attempt = queue.tryPop();
+            if (!attempt) break;
+            batch.push_back(std::move(*attempt));
+        }
+        return batch.size();
+    }
+
+    void flush(const std::vector<LoginAttempt>& batch) {
+        if (write(batch)) return;
+        if (spool) {
+            spool->append(batch);
+            return;
+        }
+        std::cerr << "Login writer: lost batch of " << batch.size() << " attempts\n";
+        failed += batch.size();
+    }
+
+    void flushCounts(bool final) {
+        std::vector<CredentialCount> counts = aggregator->drain();
+        if (counts.empty()) return;
+        std::vector<CredentialCount> retry;
+        store.storeCounts(counts, retry);
+        if (retry.empty()) return;
+        if (final) {
+            std::cerr << "Login writer: lost " << retry.size() << " credential counts\n";
+            return;
+        }
+        aggregator->restore(retry);
+    }
+
+    void replaySpool() {
+        size_t replayed = spool->replay([this](const std::vector<LoginAttempt>& batch) {
+            return write(batch);
+        }, config.replayBatchesPerCycle);
+        if (replayed > 0) {
+            SpoolStats stats = spool->stats();
+            std::cout << "Login spool: replayed " << replayed << " attempts at "
+                      << static_cast<uint64_t>(stats.replayRate) << "/s, " << stats.depth << " left\n";
+        }
+    }
+
+    /** @brief Stores one batch; false only if the store could not be reached. */
+    bool write(const std::vector<LoginAttempt>& batch) {
+        size_t rejected = 0;
+        auto start = std::chrono::steady_clock::now();
+        bool stored = store.store(batch, rejected);
+        writeNanos += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        if (!stored) return false;
+        written += batch.size() - rejected;
+        failed += rejected;
+        batches++;
+        return true;
+    }
+
+public:
+    /**
+     * @brief Starts the writer thread.
+     * @param store Backend each batch is written to; must outlive the writer.
+     * @param config Queue size, batch size, flush interval and spool settings.
+     */
+    LoginWriter(LoginStore& store, LoginWriterConfig config)
+        : store(store), config(config), queue(config.queueCapacity), queued(0), dropped(0),
+          written(0), failed(0), batches(0), writeNanos(0), stopping(false) {
+        if (this->config.batchSize == 0) this->config.batchSize = 1;
+        if (this->config.aggregation.enabled) {
+            aggregator = std::make_unique<CredentialAggregator>(this->config.aggregation);
+        }
+        if (!this->config.spool.path.empty()) {
+            try {
+                spool = std::make_unique<LoginSpool>(this->config.spool);
+                SpoolStats stats = spool->stats();
+                if (stats.depth > 0) std::cout << "Login spool: " << stats.depth << " attempts waiting for replay\n";
+                if (stats.discarded > 0) std::cerr << "Login spool: discarded " << stats.discarded << " torn bytes\n";
+            } catch (const std::exception& e) {
+                std::cerr << "Login spool disabled: " << e.what() << "\n";
+            }
+        }
+        thread = std::thread(&LoginWriter::run, this);
+    }
+
+    /**
+     * @brief Flushes everything still queued and stops the writer thread.
+     *
+     * Attempts that cannot be written are committed to the spool for the next start.
+     */
+    ~LoginWriter() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wakeCv.notify_one();
+        thread.join();
+    }
+
+    LoginWriter(const LoginWriter&) = delete;
+    LoginWriter& operator=(const LoginWriter&) = delete;
+
+    /**
+     * @brief Queues an attempt without blocking.
+     *
+     * With aggregation enabled the attempt is counted, and only queued as a raw row if sampled.
+     *
+     * @param attempt The attempt to store.
+     * @return False if the queue was full and the attempt was dropped.
+     */
+    bool submit(LoginAttempt attempt) {
+        if (aggregator && !aggregator->record(attempt)) return true;
+        if (!queue.tryPush(std::move(attempt))) {
+            // tryPush leaves the attempt untouched on failure. The spool only buffers it here;
+            // the writer thread does the write and fdatasync.
+            if (spool) {
+                if (spool->append(attempt)) wakeCv.notify_one();
+                return true;
+            }
+            dropped++;
+            return false;
+        }
+        // Wake the writer once per batchSize pushes; lighter traffic is picked up by the timer.
+        if (++queued % config.batchSize == 0) wakeCv.notify_one();
+        return true;
+    }
+
+    /** @brief Attempts waiting in the queue for the writer. */
+    size_t depth() const {
+        return queue.size();
+    }
+
+    /**
+     * @brief Retrieves the writer's counters.
+     * @return A snapshot of the counters.
+     */
+    LoginWriterStats stats() const {
+        return LoginWriterStats{ queued.load(), dropped.load(), written.load(), failed.load(), batches.load(),
+                                 writeNanos.load(),
+                                 spool ? spool->stats() : SpoolStats{},
+                                 aggregator ? aggregator->stats() : AggregatorStats{} };
+    }
+};
+
+#endif // LOGIN_WRITER_H
@@ -0,0 +1,284 @@
+/**
+ * @file metrics.h
+ * @brief Sharded counters and gauges with Prometheus text exposition.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace metrics {
+
+/** @brief Kind of a metric, as written on its # TYPE line. */
+enum class Type { COUNTER, GAUGE, SUMMARY };
+
+/** @brief What a summary series reports on each scrape. */
+struct Summary {
+    /** @brief Pairs of quantile (e.g. 0.99) and value. */
+    std::vector<std::pair<double, double>> quantiles;
+    double sum = 0;
+    uint64_t count = 0;
+};
+
+/** @brief Number of shards per metric: the core count rounded up to a power of two, at most 64. */
+inline size_t shardCount() {
+    static const size_t count = [] {
+        size_t cores = std::max(1u, std::thread::hardware_concurrency());
+        size_t n = 1;
+        while (n < cores && n < 64) n <<= 1;
+        return n;
+    }();
+    return count;
+}
+
+/**
+ * @brief The calling thread's shard.
+ *
+ * Threads are dealt shards round-robin on first use, so up to shardCount()
+ * threads update disjoint cache lines, and beyond that a line is shared by
+ * few threads.
+ */
+inline size_t shard() {
+    static std::atomic<size_t> next{ 0 };
+    thread_local const size_t index = next.fetch_add(1, std::memory_order_relaxed) & (shardCount() - 1);
+    return index;
+}
+
+/** @brief One shard's value, alone on its cache line. */
+struct alignas(64) Cell {
+    std::atomic<int64_t> value{ 0 };
+};
+
+/**
+ * @brief A value split across per-thread cells and summed on read.
+ *
+ * An update is one relaxed fetch_add on the caller's own cache line; reads
+ * are rare (a scrape) and add up every cell.
+ */
+class ShardedValue {
+public:
+    ShardedValue() : cells(new Cell[shardCount()]) {}
+
+    void add(int64_t n) { cells[shard()].value.fetch_add(n, std::memory_order_relaxed); }
+
+    int64_t sum() const {
+        int64_t total = 0;
+        for (size_t i = 0; i < shardCount(); i++) total += cells[i].value.load(std::memory_order_relaxed);
+        return total;
+    }
+
+private:
+    std::unique_ptr<Cell[]> cells;
+};
+
+/** @brief Formats a sample value the way Prometheus expects. */
+inline std::string formatValue(double value) {
+    if (std::isnan(value)) return "NaN";
+    if (std::isinf(value)) return value > 0 ? "+Inf" : "-Inf";
+    char buf[32];
+    if (value == std::floor(value) && std::fabs(value) < 1e15) {
+        std::snprintf(buf, sizeof(buf), "%.0f", value);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%.9g", value);
+    }
+    return buf;
+}
+
+/** @brief Escapes a label value: backslash, double quote and newline. */
+inline std::string escapeLabel(const std::string& value) {
+    std::string out;
+    out.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\' || c == '"') out += '\\';
+        if (c == '\n') {
+            out += "\\n";
+            continue;
+        }
+        out += c;
+    }
+    return out;
+}
+
+/**
+ * @brief Builds a label set, e.g. label("command", "LOGIN") gives `command="LOGIN"`.
+ */
+inline std::string label(const std::string& name, const std::string& value) {
+    return name + "=\"" + escapeLabel(value) + "\"";
+}
+
+} // namespace metrics
+
+/**
+ * @brief A monotonically increasing count.
+ */
+class Counter {
+public:
+    /** @brief Adds to the count; a relaxed increment of a thread-local cache line. */
+    void inc(uint64_t n = 1) { value.add(static_cast<int64_t>(n)); }
+
+    uint64_t get() const { return static_cast<uint64_t>(value.sum()); }
+
+private:
+    metrics::ShardedValue value;
+};
+
+/**
+ * @brief A value that goes up and down, such as open connections.
+ *
+ * Kept as sharded increments and decrements, so it has no set(); values
+ * owned elsewhere are registered with MetricsRegistry::sampled() instead.
+ */
+class Gauge {
+public:
+    void inc(int64_t n = 1) { value.add(n); }
+    void dec(int64_t n = 1) { value.add(-n); }
+
+    int64_t get() const { return value.sum(); }
+
+private:
+    metrics::ShardedValue value;
+};
+
+/**
+ * @brief Named metrics, rendered in the Prometheus text format.
+ *
+ * Metrics are registered once at startup and updated through the returned
+ * references, which stay valid for the registry's lifetime; only
+ * registration and render() take the lock. Series that share a name (one
+ * per label set) are written under one # HELP/# TYPE header, in
+ * registration order.
+ */
+class MetricsRegistry {
+public:
+    /**
+     * @brief Registers a counter series.
+     * @param name Metric name; by convention ends in _total.
+     * @param help One-line description.
+     * @param labels Label set without braces (see metrics::label()), or empty.
+     */
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex);
+        counters.emplace_back();
+        Counter* c = &counters.back();
+        add(name, help, metrics::Type::COUNTER, labels, [c] { return static_cast<double>(c->get()); });
+        return *c;
+    }
+
+    /** @brief Registers a gauge series. */
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex);
+        gauges.emplace_back();
+        Gauge* g = &gauges.back();
+        add(name, help, metrics::Type::GAUGE, labels, [g] { return static_cast<double>(g->get()); });
+        return *g;
+    }
+
+    /**
+     * @brief Registers a series read from elsewhere when rendering, such as a queue depth or another
+     *        component's own counter.
+     * @param read Called under the registry lock on every render; must be cheap and must not block.
+     */
+    void sampled(const std::string& name, const std::string& help, metrics::Type type, std::function<double()> read,
+                 const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex);
+        add(name, help, type, labels, std::move(read));
+    }
+
+    /**
+     * @brief Registers a summary series: quantiles plus _sum and _count, read when rendering.
+     *
+     * A series whose count is still zero is left out of the output.
+     */
+    void summary(const std::string& name, const std::string& help, std::function<metrics::Summary()> read,
+                 const std::string& labels = "") {
+        std::lock_guard<std::mutex> lock(mutex);
+        Series series{ labels, nullptr, std::move(read) };
+        add(name, help, metrics::Type::SUMMARY, std::move(series));
+    }
+
+    /**
+     * @brief Renders every series.
+     * @return Prometheus text exposition format 0.0.4.
+     */
+    std::string render() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string out;
+        static const char* types[] = { " counter\n", " gauge\n", " summary\n" };
+        for (const Family& family : families) {
+            out += "# HELP " + family.name + " " + family.help + "\n";
+            out += "# TYPE " + family.name + types[static_cast<int>(family.type)];
+            for (const Series& series : family.series) {
+                if (family.type == metrics::Type::SUMMARY) {
+                    renderSummary(family.name, series, out);
+                    continue;
+                }
+                out += family.name;
+                if (!series.labels.empty()) out += "{" + series.labels + "}";
+                out += " " + metrics::formatValue(series.read()) + "\n";
+            }
+        }
+        return out;
+    }
+
+private:
+    struct Series {
+        std::string labels;
+        std::function<double()> read;
+        std::function<metrics::Summary()> readSummary;
+    };
+
+    struct Family {
+        std::string name;
+        std::string help;
+        metrics::Type type;
+        std::vector<Series> series;
+    };
+
+    mutable std::mutex mutex;
+    // Deques keep element addresses stable as metrics are added.
+    std::deque<Counter> counters;
+    std::deque<Gauge> gauges;
+    std::vector<Family> families;
+
+    void add(const std::string& name, const std::string& help, metrics::Type type, const std::string& labels,
+             std::function<double()> read) {
+        add(name, help, type, Series{ labels, std::move(read), nullptr });
+    }
+
+    void add(const std::string& name, const std::string& help, metrics::Type type, Series series) {
+        auto it = std::find_if(families.begin(), families.end(), [&name](const Family& f) { return f.name == name; });
+        if (it == families.end()) {
+            families.push_back(Family{ name, help, type, {} });
+            it = families.end() - 1;
+        }
+        it->series.push_back(std::move(series));
+    }
+
+    static void renderSummary(const std::string& name, const Series& series, std::string& out) {
+        metrics::Summary summary = series.readSummary();
+        if (summary.count == 0) return;
+        std::string prefix = series.labels.empty() ? "" : series.labels + ",";
+        for (const auto& [quantile, value] : summary.quantiles) {
+            out += name + "{" + prefix + metrics::label("quantile", metrics::formatValue(quantile)) + "} " +
+                   metrics::formatValue(value) + "\n";
+        }
+        std::string labels = series.labels.empty() ? "" : "{" + series.labels + "}";
+        out += name + "_sum" + labels + " " + metrics::formatValue(summary.sum) + "\n";
+        out += name + "_count" + labels + " " + metrics::formatValue(static_cast<double>(summary.count)) + "\n";
+    }
+};
+
+#endif // METRICS_H
@@ -0,0 +1,145 @@
+/**
+ * @file metrics_http.h
+ * @brief Minimal HTTP listener serving GET /metrics for Prometheus.
+ */
+
+#ifndef METRICS_HTTP_H
+#define METRICS_HTTP_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/**
+ * @brief Settings of the metrics endpoint, read from the "metrics" block of db_config.json.
+ */
+struct MetricsHttpConfig {
+    /** @brief Serve /metrics at all. */
+    bool enabled = true;
+
+    /** @brief Address to listen on; loopback by default, so only a local scraper or proxy can read it. */
+    std::string bind = "127.0.0.1";
+
+    /** @brief TCP port; 0 picks a free one (see MetricsHttpServer::port()). */
+    uint16_t port = 9101;
+};
+
+/**
+ * @brief Answers Prometheus scrapes from its own thread.
+ *
+ * Deliberately small: one connection at a time, one request per
+ * connection, GET /metrics only. A scrape renders the body through the
+ * given callback, so the HTTP side knows nothing about the metrics.
+ */
+class MetricsHttpServer {
+public:
+    /**
+     * @brief Binds the listener and starts serving.
+     * @param config Address and port.
+     * @param render Produces the response body for each scrape.
+     * @throw std::runtime_error If the address cannot be bound.
+     */
+    MetricsHttpServer(const MetricsHttpConfig& config, std::function<std::string()> render)
+        : render(std::move(render)), listenFd(-1), boundPort(0), stopping(false) {
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) throw std::runtime_error("Metrics: cannot create socket");
+        int opt = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(config.port);
+        if (inet_pton(AF_INET, config.bind.c_str(), &addr.sin_addr) != 1 ||
+            ::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listenFd, 8) != 0) {
+            ::close(listenFd);
+            throw std::runtime_error("Metrics: cannot listen on " + config.bind + ":" + std::to_string(config.port));
+        }
+        socklen_t len = sizeof(addr);
+        getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &len);
+        boundPort = ntohs(addr.sin_port);
+        thread = std::thread(&MetricsHttpServer::run, this);
+    }
+
+    ~MetricsHttpServer() {
+        stopping = true;
+        thread.join();
+        ::close(listenFd);
+    }
+
+    MetricsHttpServer(const MetricsHttpServer&) = delete;
+    MetricsHttpServer& operator=(const MetricsHttpServer&) = delete;
+
+    /** @brief The port actually listened on. */
+    uint16_t port() const { return boundPort; }
+
+private:
+    std::function<std::string()> render;
+    int listenFd;
+    uint16_t boundPort;
+    std::atomic<bool> stopping;
+    std::thread thread;
+
+    void run() {
+        while (!stopping) {
+            // Wake periodically to notice stopping.
+            pollfd p{ listenFd, POLLIN, 0 };
+            if (poll(&p, 1, 200) <= 0) continue;
+            int client = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) continue;
+            // A scraper that stalls must not hold the endpoint for long.
+            timeval timeout{ 2, 0 };
+            setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            serve(client);
+            ::close(client);
+        }
+    }
+
+    void serve(int client) {
+        std::string request;
+        char buf[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+            ssize_t n = recv(client, buf, sizeof(buf), 0);
+            // With a receive timeout set, SA_RESTART does not restart recv after a signal such as SIGPROF.
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return;
+            request.append(buf, static_cast<size_t>(n));
+        }
+        std::string line = request.substr(0, request.find("\r\n"));
+        if (line.compare(0, 4, "GET ") != 0) {
+            respond(client, "405 Method Not Allowed", "text/plain", "GET only\n");
+            return;
+        }
+        std::string target = line.substr(4, line.find(' ', 4) - 4);
+        std::string path = target.substr(0, target.find('?'));
+        if (path != "/metrics") {
+            respond(client, "404 Not Found", "text/plain", "Not found; try /metrics\n");
+            return;
+        }
+        respond(client, "200 OK", "text/plain; version=0.0.4; charset=utf-8", render());
+    }
+
+    static void respond(int client, const std::string& status, const std::string& type, const std::string& body) {
+        std::string response = "HTTP/1.1 " + status + "\r\nContent-Type: " + type +
+                               "\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" +
+                               body;
+        size_t offset = 0;
+        while (offset < response.size()) {
+            ssize_t n = send(client, response.data() + offset, response.size() - offset, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return;
+            offset += static_cast<size_t>(n);
+        }
+    }
+};
+
+#endif // METRICS_HTTP_H
@@ -33,10 +33,36 @@ enum class Command : uint32_t {
     TOGGLE_MAINTENANCE = 101,
     SET_ONLINE = 102,
     REQUEST_FLAG_IMAGE = 103, 
+    HELLO = 104,
+    BATCH = 105,
+    STATS = 106,
+    PROFILE = 107,
     ACK = 200,
     ERROR = 400
 };
 
+/**
+ * @brief Per-packet option bits carried in the upper 16 bits of the command word.
+ *
+ * Clients that predate the flags always send zero there, so the wire format
+ * is unchanged for them. Command IDs must therefore stay below 0x10000.
+ */
+enum PacketFlags : uint16_t {
+    FLAG_NONE = 0x0000,
+    /** @brief The payload is compressed (see compression.h). */
+    FLAG_COMPRESSED = 0x0001,
+    /** @brief Request flag: the sender can decode FLAG_COMPRESSED replies. */
+    FLAG_ACCEPT_COMPRESSED = 0x0002,
+    /** @brief First frame of a chunked transfer; payload is the 8-byte total size (see stream.h). */
+    FLAG_STREAM_START = 0x0004,
+    /** @brief Continuation frame of a chunked transfer carrying the next chunk of data. */
+    FLAG_STREAM_DATA = 0x0008,
+    /** @brief Last frame of a chunked transfer; payload is the total CRC and size. */
+    FLAG_STREAM_END = 0x0010,
+    /** @brief Request flag: the sender can reassemble chunked replies. */
+    FLAG_ACCEPT_STREAM = 0x0020
+};
+
 #pragma pack(push, 1)
 /**
  * @brief Fixed-size header preceding every network packet.
@@ -66,17 +92,11 @@ struct Header {
 class NetworkPacket {
 private:
     Header header;
+    uint16_t flags;
     uint8_t* payload;
 
     static uint32_t calculateCRC32(const uint8_t* data, size_t length) {
-        uint32_t crc = 0xFFFFFFFF;
-        for (size_t i = 0; i < length; i++) {
-            crc ^= data[i];
-            for (int j = 0; j < 8; j++) {
-                crc = (crc >> 1) ^ (0xEDB88320 & (-(crc & 1)));
-            }
-        }
-        return ~crc;
+        return updateChecksum(0, data, length);
     }
 
 public:
@@ -87,6 +107,7 @@ public:
         header.commandID = Command::NONE;
         header.payloadSize = 0;
         header.payloadCRC = 0;
+        flags = FLAG_NONE;
         payload = nullptr;
     }
     
@@ -99,6 +120,7 @@ public:
         header.commandID = cmd;
         header.payloadSize = size;
         header.payloadCRC = 0; 
+        flags = FLAG_NONE;
         payload = nullptr;
         
         if (size > 0){
@@ -127,6 +149,7 @@ public:
      */
     NetworkPacket(NetworkPacket&& other) noexcept {
         header = other.header;       
+        flags = other.flags;
         payload = other.payload;     
         other.payload = nullptr;     
     }
@@ -140,6 +163,7 @@ public:
         if (this != &other) {
             delete[] payload;        
             header = other.header;   
+            flags = other.flags;
             payload = other.payload; 
             other.payload = nullptr; 
         }
@@ -178,6 +202,31 @@ public:
         return header.payloadCRC;
     }
 
+    /**
+     * @brief Retrieves the option bits sent alongside the command.
+     * @return A combination of PacketFlags values.
+     */
+    uint16_t getFlags() const {
+        return flags;
+    }
+
+    /**
+     * @brief Sets the option bits sent alongside the command.
+     * @param value A combination of PacketFlags values.
+     */
+    void setFlags(uint16_t value) {
+        flags = value;
+    }
+
+    /**
+     * @brief Checks whether a single option bit is set.
+     * @param flag The PacketFlags bit to test.
+     * @return True if the bit is set.
+     */
+    bool hasFlag(PacketFlags flag) const {
+        return (flags & flag) != 0;
+    }
+
     /**
      * @brief Writes data into the packet's payload buffer and calculates the CRC.
      * @param data Pointer to the raw bytes to copy.
@@ -193,6 +242,57 @@ public:
             header.payloadCRC = calculateCRC32(payload, header.payloadSize); 
         }
     }
+
+    /**
+     * @brief Writes data into the payload buffer using a checksum computed earlier.
+     *
+     * Used for cached assets whose CRC is calculated once when they are loaded.
+     *
+     * @param data Pointer to the raw bytes to copy.
+     * @param size The number of bytes to copy. Must equal the allocated payload size.
+     * @param crc The CRC32 of the data.
+     */
+    void writePayload(const uint8_t* data, uint32_t size, uint32_t crc) {
+        if (size != header.payloadSize) {
+            std::cerr << "Error: Payload size does not match allocated size\n";
+            return;
+        }
+        if (payload != nullptr && data != nullptr){
+            std::memcpy(payload, data, size);
+            header.payloadCRC = crc;
+        }
+    }
+
+    /**
+     * @brief Extends a CRC32 with more data, for checksums computed over several buffers.
+     *
+     * updateChecksum(updateChecksum(0, a), b) equals the checksum of a followed by b.
+     *
+     * @param previous The CRC of the data seen so far (0 for none).
+     * @param data Pointer to the next bytes.
+     * @param length The number of bytes.
+     * @return The CRC32 of all data seen so far.
+     */
+    static uint32_t updateChecksum(uint32_t previous, const uint8_t* data, size_t length) {
+        uint32_t crc = ~previous;
+        for (size_t i = 0; i < length; i++) {
+            crc ^= data[i];
+            for (int j = 0; j < 8; j++) {
+                crc = (crc >> 1) ^ (0xEDB88320 & (-(crc & 1)));
+            }
+        }
+        return ~crc;
+    }
+
+    /**
+     * @brief Calculates the CRC32 used in packet headers.
+     * @param data Pointer to the bytes to checksum.
+     * @param length The number of bytes.
+     * @return The 32-bit CRC.
+     */
+    static uint32_t checksum(const uint8_t* data, size_t length) {
+        return calculateCRC32(data, length);
+    }
     
     /**
      * @brief Serializes the packet (header + payload) into a single byte array for network transmission.
@@ -203,13 +303,7 @@ public:
      */
     std::vector<uint8_t> serialize() const {
         std::vector<uint8_t> buffer(sizeof(Header) + header.payloadSize);
-        
-        Header netHeader;
-        netHeader.commandID = static_cast<Command>(htonl(static_cast<uint32_t>(header.commandID)));
-        netHeader.payloadSize = htonl(header.payloadSize);
-        netHeader.payloadCRC = htonl(header.payloadCRC);
-
-        std::memcpy(buffer.data(), &netHeader, sizeof(Header));
+        encodeHeader(buffer.data(), header.commandID, flags, header.payloadSize, header.payloadCRC);
         
         if (payload != nullptr && header.payloadSize > 0) {
             std::memcpy(buffer.data() + sizeof(Header), payload, header.payloadSize);
@@ -217,6 +311,57 @@ public:
         return buffer;
     }
 
+    /**
+     * @brief Encodes a header in network byte order without building a packet.
+     *
+     * Used by senders that write the payload straight from their own buffers.
+     *
+     * @param out Destination for sizeof(Header) bytes.
+     * @param cmd The command.
+     * @param flags A combination of PacketFlags values.
+     * @param payloadSize The size of the payload that follows.
+     * @param payloadCRC The CRC32 of that payload.
+     */
+    static void encodeHeader(uint8_t* out, Command cmd, uint16_t flags, uint32_t payloadSize, uint32_t payloadCRC) {
+        Header netHeader;
+        uint32_t commandWord = (static_cast<uint32_t>(flags) << 16) | static_cast<uint32_t>(cmd);
+        netHeader.commandID = static_cast<Command>(htonl(commandWord));
+        netHeader.payloadSize = htonl(payloadSize);
+        netHeader.payloadCRC = htonl(payloadCRC);
+        std::memcpy(out, &netHeader, sizeof(Header));
+    }
+
+    /**
+     * @brief Decodes just the fixed-size header from a received byte array.
+     *
+     * Lets the receiver validate the command and declared payload size before
+     * reading or allocating the payload.
+     *
+     * @param data Pointer to at least sizeof(Header) bytes in network byte order.
+     * @return The header converted to host byte order.
+     */
+    static Header parseHeader(const uint8_t* data) {
+        Header netHeader;
+        std::memcpy(&netHeader, data, sizeof(Header));
+
+        Header header;
+        header.commandID = static_cast<Command>(ntohl(static_cast<uint32_t>(netHeader.commandID)) & 0xFFFF);
+        header.payloadSize = ntohl(netHeader.payloadSize);
+        header.payloadCRC = ntohl(netHeader.payloadCRC);
+        return header;
+    }
+
+    /**
+     * @brief Decodes the option bits from a received header.
+     * @param data Pointer to at least sizeof(Header) bytes in network byte order.
+     * @return A combination of PacketFlags values.
+     */
+    static uint16_t parseFlags(const uint8_t* data) {
+        uint32_t commandWord;
+        std::memcpy(&commandWord, data, sizeof(commandWord));
+        return static_cast<uint16_t>(ntohl(commandWord) >> 16);
+    }
+
     /**
      * @brief Deserializes a received byte array into a NetworkPacket object.
      * 
@@ -234,13 +379,8 @@ public:
         }
         
         NetworkPacket* packet = new NetworkPacket();
-        
-        Header netHeader;
-        std::memcpy(&netHeader, data, sizeof(Header));
-        
-        packet->header.commandID = static_cast<Command>(ntohl(static_cast<uint32_t>(netHeader.commandID)));
-        packet->header.payloadSize = ntohl(netHeader.payloadSize);
-        packet->header.payloadCRC = ntohl(netHeader.payloadCRC);
+        packet->header = parseHeader(data);
+        packet->flags = parseFlags(data);
 
         if (totalSize > sizeof(Header) && totalSize < sizeof(Header) + packet->header.payloadSize) {
             throw std::runtime_error("Data too small to contain complete payload");
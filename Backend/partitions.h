@@ -0,0 +1,311 @@
+/**
+ * @file partitions.h
+ * @brief Creates, retires and tracks daily partitions of ctf.login_attempts.
+ */
+
+#ifndef PARTITIONS_H
+#define PARTITIONS_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <libpq-fe.h>
+#include "db_pool.h"
+
+/**
+ * @brief Settings of PartitionManager, read from the "partitions" block of db_config.json.
+ */
+struct PartitionConfig {
+    /** @brief Manage partitions at all; the parent table must already be partitioned. */
+    bool enabled = false;
+
+    /** @brief Schema-qualified parent table. */
+    std::string table = "ctf.login_attempts";
+
+    /** @brief Partitions created ahead of today, so midnight never finds a missing one. */
+    int daysAhead = 3;
+
+    /** @brief Partitions whose day ended more than this many days ago are retired. */
+    int retentionDays = 30;
+
+    /** @brief Retired partitions are detached and moved here; empty drops them instead. */
+    std::string archiveSchema;
+
+    /** @brief Time between maintenance runs. */
+    std::chrono::minutes checkInterval{ 60 };
+};
+
+namespace partition {
+
+/** @brief A calendar date in UTC. */
+struct Date {
+    int year;
+    unsigned month;
+    unsigned day;
+};
+
+/**
+ * @brief Converts days since 1970-01-01 to a civil date (proleptic Gregorian).
+ * @param days Days since the epoch; may be negative.
+ */
+inline Date dateFromDays(int64_t days) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned doe = static_cast<unsigned>(days - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    unsigned day = doy - (153 * mp + 2) / 5 + 1;
+    unsigned month = mp < 10 ? mp + 3 : mp - 9;
+    return Date{ static_cast<int>(yoe + era * 400 + (month <= 2)), month, day };
+}
+
+/**
+ * @brief Converts a civil date to days since 1970-01-01.
+ */
+inline int64_t daysFromDate(const Date& date) {
+    int64_t year = date.year - (date.month <= 2);
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    unsigned yoe = static_cast<unsigned>(year - era * 400);
+    unsigned doy = (153 * (date.month > 2 ? date.month - 3 : date.month + 9) + 2) / 5 + date.day - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+/** @brief The current UTC day as days since the epoch. */
+inline int64_t today() {
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::hours>(now).count() / 24;
+}
+
+/**
+ * @brief Name suffix of a day's partition, e.g. "_p20261018".
+ */
+inline std::string suffix(int64_t day) {
+    Date date = dateFromDays(day);
+    // Sized for the widest int and unsigned values, so -Wformat-truncation has nothing to report.
+    char buf[48];
+    std::snprintf(buf, sizeof(buf), "_p%04d%02u%02u", date.year, date.month, date.day);
+    return buf;
+}
+
+/**
+ * @brief Recovers the day from a partition's table name.
+ * @param base Unqualified parent table name, e.g. "login_attempts".
+ * @param name Unqualified partition name.
+ * @return The day, or nullopt if the name was not made by suffix().
+ */
+inline std::optional<int64_t> parseDay(const std::string& base, const std::string& name) {
+    if (name.size() != base.size() + 10 || name.compare(0, base.size(), base) != 0 ||
+        name.compare(base.size(), 2, "_p") != 0) {
+        return std::nullopt;
+    }
+    int value = 0;
+    for (size_t i = base.size() + 2; i < name.size(); i++) {
+        if (name[i] < '0' || name[i] > '9') return std::nullopt;
+        value = value * 10 + (name[i] - '0');
+    }
+    Date date{ value / 10000, static_cast<unsigned>(value / 100 % 100), static_cast<unsigned>(value % 100) };
+    if (date.month < 1 || date.month > 12 || date.day < 1 || date.day > 31) return std::nullopt;
+    int64_t day = daysFromDate(date);
+    if (suffix(day) != name.substr(base.size())) return std::nullopt;
+    return day;
+}
+
+/**
+ * @brief Midnight UTC starting a day, as a timestamptz literal.
+ */
+inline std::string bound(int64_t day) {
+    Date date = dateFromDays(day);
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%04d-%02u-%02u 00:00:00+00", date.year, date.month, date.day);
+    return buf;
+}
+
+} // namespace partition
+
+/**
+ * @brief Keeps the partitioned login table ready for inserts and bounded in size.
+ *
+ * Every checkInterval a background thread creates the partitions for today
+ * through daysAhead, and retires partitions older than retentionDays by
+ * dropping them or detaching them into archiveSchema. Partitions cover one
+ * UTC day each and are named <table>_pYYYYMMDD.
+ *
+ * Because each partition has its own small indexes and old ones are removed
+ * whole, insert cost and index size stay flat no matter how long an event
+ * runs, and queries on a time range only scan the days they cover.
+ *
+ * The manager does nothing unless the parent is already declared
+ * `PARTITION BY RANGE` on its timestamp column; converting an existing
+ * table is a one-off migration (see README).
+ */
+class PartitionManager {
+public:
+    /**
+     * @brief Runs maintenance once, then starts the background thread.
+     * @param pool Connections used for maintenance.
+     * @param config Table, horizon and retention.
+     */
+    PartitionManager(PgConnectionPool& pool, PartitionConfig config)
+        : pool(pool), config(std::move(config)), stopping(false) {
+        size_t dot = this->config.table.find('.');
+        schema = dot == std::string::npos ? "public" : this->config.table.substr(0, dot);
+        base = dot == std::string::npos ? this->config.table : this->config.table.substr(dot + 1);
+        maintain();
+        thread = std::thread(&PartitionManager::run, this);
+    }
+
+    ~PartitionManager() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeCv.notify_one();
+        thread.join();
+    }
+
+    PartitionManager(const PartitionManager&) = delete;
+    PartitionManager& operator=(const PartitionManager&) = delete;
+
+    /**
+     * @brief Creates upcoming partitions and retires expired ones.
+     * @return False if the database was unreachable or the table is not partitioned.
+     */
+    bool maintain() {
+        PgConnectionPool::Lease conn = pool.acquire();
+        if (!conn) return false;
+        if (!isPartitioned(conn.get())) {
+            if (!warned) {
+                std::cerr << "Partitions: " << config.table << " is not partitioned, retention disabled\n";
+                warned = true;
+            }
+            return false;
+        }
+
+        int64_t day = partition::today();
+        bool ok = true;
+        for (int64_t d = day; d <= day + config.daysAhead; d++) {
+            ok = create(conn.get(), d) && ok;
+        }
+        for (const std::string& name : partitions(conn.get())) {
+            std::optional<int64_t> partDay = partition::parseDay(base, name);
+            if (partDay && *partDay < day - config.retentionDays) ok = retire(conn.get(), name) && ok;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        currentDay = day;
+        current = quote(conn.get(), schema) + "." + quote(conn.get(), base + partition::suffix(day));
+        return ok;
+    }
+
+    /**
+     * @brief Quoted name of today's partition, for writers that insert into it directly.
+     * @return Empty until maintenance has succeeded, or once the day it was computed for has passed.
+     */
+    std::string currentPartition() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return currentDay == partition::today() ? current : std::string();
+    }
+
+private:
+    PgConnectionPool& pool;
+    PartitionConfig config;
+    std::string schema;
+    std::string base;
+    mutable std::mutex mutex;
+    std::condition_variable wakeCv;
+    bool stopping;
+    bool warned = false;
+    int64_t currentDay = 0;
+    std::string current;
+    std::thread thread;
+
+    void run() {
+        while (true) {
+            std::unique_lock<std::mutex> lock(mutex);
+            // Wake at least hourly and just after midnight, so today's partition is always current.
+            auto untilMidnight = std::chrono::minutes(24 * 60) -
+                std::chrono::duration_cast<std::chrono::minutes>(
+                    std::chrono::system_clock::now().time_since_epoch() % std::chrono::hours(24)) +
+                std::chrono::minutes(1);
+            wakeCv.wait_for(lock, std::min<std::chrono::minutes>(config.checkInterval, untilMidnight),
+                            [this] { return stopping; });
+            if (stopping) return;
+            lock.unlock();
+            maintain();
+        }
+    }
+
+    static std::string quote(PGconn* conn, const std::string& identifier) {
+        char* escaped = PQescapeIdentifier(conn, identifier.c_str(), identifier.size());
+        if (escaped == nullptr) return std::string();
+        std::string result = escaped;
+        PQfreemem(escaped);
+        return result;
+    }
+
+    static bool exec(PGconn* conn, const std::string& sql) {
+        PGresult* res = PQexec(conn, sql.c_str());
+        bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+        if (!ok) std::cerr << "Partitions: " << PQerrorMessage(conn);
+        PQclear(res);
+        return ok;
+    }
+
+    bool isPartitioned(PGconn* conn) const {
+        const char* params[] = { schema.c_str(), base.c_str() };
+        PGresult* res = PQexecParams(conn,
+            "SELECT 1 FROM pg_partitioned_table p JOIN pg_class c ON c.oid = p.partrelid "
+            "JOIN pg_namespace n ON n.oid = c.relnamespace WHERE n.nspname = $1 AND c.relname = $2",
+            2, nullptr, params, nullptr, nullptr, 0);
+        bool partitioned = PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1;
+        PQclear(res);
+        return partitioned;
+    }
+
+    std::vector<std::string> partitions(PGconn* conn) const {
+        const char* params[] = { schema.c_str(), base.c_str() };
+        PGresult* res = PQexecParams(conn,
+            "SELECT c.relname FROM pg_inherits i JOIN pg_class c ON c.oid = i.inhrelid "
+            "JOIN pg_class p ON p.oid = i.inhparent JOIN pg_namespace n ON n.oid = p.relnamespace "
+            "WHERE n.nspname = $1 AND p.relname = $2",
+            2, nullptr, params, nullptr, nullptr, 0);
+        std::vector<std::string> names;
+        if (PQresultStatus(res) == PGRES_TUPLES_OK) {
+            for (int i = 0; i < PQntuples(res); i++) names.push_back(PQgetvalue(res, i, 0));
+        }
+        PQclear(res);
+        return names;
+    }
+
+    bool create(PGconn* conn, int64_t day) {
+        std::string name = quote(conn, schema) + "." + quote(conn, base + partition::suffix(day));
+        return exec(conn, "CREATE TABLE IF NOT EXISTS " + name + " PARTITION OF " + quote(conn, schema) + "." +
+                              quote(conn, base) + " FOR VALUES FROM ('" + partition::bound(day) + "') TO ('" +
+                              partition::bound(day + 1) + "')");
+    }
+
+    bool retire(PGconn* conn, const std::string& name) {
+        std::string qualified = quote(conn, schema) + "." + quote(conn, name);
+        if (config.archiveSchema.empty()) {
+            std::cout << "Partitions: dropping " << name << "\n";
+            return exec(conn, "DROP TABLE " + qualified);
+        }
+        std::cout << "Partitions: archiving " << name << " to " << config.archiveSchema << "\n";
+        return exec(conn, "ALTER TABLE " + quote(conn, schema) + "." + quote(conn, base) +
+                              " DETACH PARTITION " + qualified) &&
+               exec(conn, "CREATE SCHEMA IF NOT EXISTS " + quote(conn, config.archiveSchema)) &&
+               exec(conn, "ALTER TABLE " + qualified + " SET SCHEMA " + quote(conn, config.archiveSchema));
+    }
+};
+
+#endif // PARTITIONS_H
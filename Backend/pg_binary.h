@@ -0,0 +1,155 @@
+/**
+ * @file pg_binary.h
+ * @brief PostgreSQL binary wire encodings used for COPY and binary parameters.
+ */
+
+#ifndef PG_BINARY_H
+#define PG_BINARY_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+
+namespace pgbinary {
+
+/** @brief Address family codes used by the inet type (not the OS AF_* values). */
+constexpr uint8_t kInetFamilyV4 = 2;
+constexpr uint8_t kInetFamilyV6 = 3;
+
+/** @brief Largest encoded inet value (IPv6). */
+constexpr size_t kMaxInetSize = 4 + 16;
+
+/** @brief Microseconds from the Unix epoch to the PostgreSQL epoch (2000-01-01 UTC). */
+constexpr int64_t kPgEpochMicros = 946684800000000LL;
+
+/**
+ * @brief Encodes a 64-bit integer in network byte order (int8 binary format).
+ * @param value The value.
+ * @param out Destination for 8 bytes.
+ */
+inline void encodeInt64(int64_t value, uint8_t* out) {
+    uint64_t bits = static_cast<uint64_t>(value);
+    for (int i = 7; i >= 0; i--) {
+        out[i] = static_cast<uint8_t>(bits);
+        bits >>= 8;
+    }
+}
+
+/**
+ * @brief Converts a wall-clock time to the timestamptz binary value.
+ * @param time The time.
+ * @return Microseconds since 2000-01-01 UTC.
+ */
+inline int64_t timestamptzValue(std::chrono::system_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count() - kPgEpochMicros;
+}
+
+/**
+ * @brief Encodes a textual IP address as a binary inet value.
+ *
+ * Layout: family (1), prefix bits (1), is_cidr (1), address length (1), address bytes.
+ *
+ * @param ip Dotted IPv4 or textual IPv6 address.
+ * @param out Destination for at least kMaxInetSize bytes.
+ * @return Number of bytes written, or 0 if ip is not a valid address.
+ */
+inline size_t encodeInet(const std::string& ip, uint8_t* out) {
+    if (inet_pton(AF_INET, ip.c_str(), out + 4) == 1) {
+        out[0] = kInetFamilyV4;
+        out[1] = 32;
+        out[2] = 0;
+        out[3] = 4;
+        return 4 + 4;
+    }
+    if (inet_pton(AF_INET6, ip.c_str(), out + 4) == 1) {
+        out[0] = kInetFamilyV6;
+        out[1] = 128;
+        out[2] = 0;
+        out[3] = 16;
+        return 4 + 16;
+    }
+    return 0;
+}
+
+/**
+ * @brief Builds the body of a `COPY ... FROM STDIN (FORMAT binary)` stream.
+ *
+ * Call beginRow() with the column count, then one add*() per column, and
+ * finish() once after the last row. The buffer can be reused with clear().
+ */
+class CopyEncoder {
+public:
+    CopyEncoder() { clear(); }
+
+    /** @brief Discards all rows and writes a fresh file header. */
+    void clear() {
+        static const uint8_t signature[11] = { 'P', 'G', 'C', 'O', 'P', 'Y', '\n', 0xFF, '\r', '\n', 0 };
+        buffer.assign(signature, signature + sizeof(signature));
+        putU32(0); // flags
+        putU32(0); // header extension length
+        rows = 0;
+    }
+
+    /** @brief Starts a row with the given number of columns. */
+    void beginRow(uint16_t columns) {
+        putU16(columns);
+        rows++;
+    }
+
+    /** @brief Appends a text column. */
+    void addText(const std::string& value) {
+        putU32(static_cast<uint32_t>(value.size()));
+        buffer.insert(buffer.end(), value.begin(), value.end());
+    }
+
+    /** @brief Appends an inet column, or NULL if the address does not parse. */
+    void addInet(const std::string& ip) {
+        uint8_t inet[kMaxInetSize];
+        size_t size = encodeInet(ip, inet);
+        if (size == 0) {
+            addNull();
+            return;
+        }
+        putU32(static_cast<uint32_t>(size));
+        buffer.insert(buffer.end(), inet, inet + size);
+    }
+
+    /** @brief Appends a NULL column. */
+    void addNull() {
+        putU32(0xFFFFFFFF);
+    }
+
+    /** @brief Writes the end-of-data marker. */
+    void finish() {
+        putU16(0xFFFF);
+    }
+
+    /** @brief The encoded stream. */
+    const std::vector<uint8_t>& data() const { return buffer; }
+
+    /** @brief Number of rows begun since the last clear(). */
+    size_t rowCount() const { return rows; }
+
+private:
+    std::vector<uint8_t> buffer;
+    size_t rows;
+
+    void putU16(uint16_t value) {
+        uint16_t net = htons(value);
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&net);
+        buffer.insert(buffer.end(), p, p + sizeof(net));
+    }
+
+    void putU32(uint32_t value) {
+        uint32_t net = htonl(value);
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&net);
+        buffer.insert(buffer.end(), p, p + sizeof(net));
+    }
+};
+
+} // namespace pgbinary
+
+#endif // PG_BINARY_H
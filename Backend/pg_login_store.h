@@ -0,0 +1,179 @@
+/**
+ * @file pg_login_store.h
+ * @brief Stores login attempts in PostgreSQL with binary COPY.
+ */
+
+#ifndef PG_LOGIN_STORE_H
+#define PG_LOGIN_STORE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <libpq-fe.h>
+#include "db_pool.h"
+#include "login_store.h"
+#include "partitions.h"
+#include "pg_binary.h"
+#include "pipeline.h"
+#include "statements.h"
+#include "trace.h"
+
+/**
+ * @brief LoginStore backed by a PgConnectionPool.
+ *
+ * A batch is sent as one `COPY ... FROM STDIN (FORMAT binary)`; a batch of
+ * one row uses the prepared INSERT instead, which saves the COPY round trip.
+ * If the COPY is rejected (e.g. one row violates a constraint) the batch is
+ * retried as pipelined INSERTs so only the offending rows are lost.
+ *
+ * With a PartitionManager the COPY targets today's partition directly,
+ * which skips per-row partition routing. Rows stamped just past midnight
+ * fail that partition's bound and are re-sent through the parent by the
+ * INSERT fallback.
+ *
+ * Aggregated counts are upserted into ctf.login_credentials with pipelined
+ * prepared statements, one implicit transaction each, so a dropped
+ * connection only returns the deltas that had no result yet.
+ */
+class PgLoginStore : public LoginStore {
+public:
+    /**
+     * @brief Creates the store.
+     * @param pool Connections used for each batch; must prepare statements in its setup hook.
+     * @param partitions Source of the current partition, or nullptr to always COPY into the parent.
+     * @param tracer Samples batches like requests, so pool waits, connects and writes show up in dumps; may be null.
+     */
+    explicit PgLoginStore(PgConnectionPool& pool, const PartitionManager* partitions = nullptr,
+                          Tracer* tracer = nullptr)
+        : pool(pool), partitions(partitions), tracer(tracer), batches(0) {}
+
+    bool store(const std::vector<LoginAttempt>& batch, size_t& rejected) override {
+        rejected = 0;
+        if (batch.empty()) return true;
+        trace::Scope traced(tracer != nullptr ? tracer->begin(0, 0, ++batches) : TraceContext());
+        trace::Span span("db.batch");
+        if (batch.size() > 1) {
+            encoder.clear();
+            for (const LoginAttempt& attempt : batch) {
+                encoder.beginRow(3);
+                encoder.addText(attempt.username);
+                encoder.addText(attempt.password);
+                encoder.addInet(attempt.ip);
+            }
+            encoder.finish();
+        }
+        // A connection the server dropped while idle only fails on its next statement, so retry once.
+        for (int attempt = 0; attempt < 2; attempt++) {
+            PgConnectionPool::Lease conn = pool.acquire();
+            if (!conn) break;
+            bool ok;
+            {
+                trace::Span write(batch.size() > 1 ? "db.copy" : "db.insert");
+                ok = batch.size() > 1 ? copy(conn.get(), copyTarget(), encoder) : insert(conn.get(), batch.front());
+            }
+            if (ok) return true;
+            if (PQstatus(conn.get()) == CONNECTION_OK) {
+                if (batch.size() > 1) return insertEach(conn, batch, rejected);
+                // A single row the database rejected would be rejected again on retry.
+                rejected = 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t storeCounts(const std::vector<CredentialCount>& counts, std::vector<CredentialCount>& retry) override {
+        if (counts.empty()) return 0;
+        PgConnectionPool::Lease conn = pool.acquire();
+        if (!conn) {
+            retry.insert(retry.end(), counts.begin(), counts.end());
+            return 0;
+        }
+        Pipeline pipeline;
+        size_t upserted = 0;
+        for (const CredentialCount& count : counts) {
+            pipeline.add(Statement::UPSERT_CREDENTIAL,
+                         StatementParams().text(count.credential.username).text(count.credential.password)
+                             .inet(count.credential.ip).int8(static_cast<int64_t>(count.attempts))
+                             .timestamptz(count.firstSeen).timestamptz(count.lastSeen),
+                         [&upserted, &retry, &count](const PGresult* res) {
+                             if (res == nullptr) {
+                                 retry.push_back(count);
+                             } else if (PQresultStatus(res) == PGRES_COMMAND_OK) {
+                                 upserted++;
+                             }
+                         });
+        }
+        pipeline.run(conn.get());
+        if (PQpipelineStatus(conn.get()) != PQ_PIPELINE_OFF) conn.markBroken();
+        return upserted;
+    }
+
+    const char* name() const override { return "postgres"; }
+
+private:
+    static constexpr const char* kTable = "ctf.login_attempts";
+
+    PgConnectionPool& pool;
+    const PartitionManager* partitions;
+    Tracer* tracer;
+    /** @brief Numbers traced batches. */
+    uint32_t batches;
+    pgbinary::CopyEncoder encoder;
+
+    static bool insert(PGconn* conn, const LoginAttempt& attempt) {
+        PGresult* res = StatementParams().text(attempt.username).text(attempt.password).inet(attempt.ip)
+                            .execute(conn, Statement::INSERT_LOGIN_ATTEMPT);
+        bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+        if (!ok) std::cerr << "Insert error: " << PQerrorMessage(conn) << "\n";
+        PQclear(res);
+        return ok;
+    }
+
+    /** @brief Per-row fallback after a rejected COPY; false if the connection failed. */
+    static bool insertEach(PgConnectionPool::Lease& conn, const std::vector<LoginAttempt>& batch, size_t& rejected) {
+        Pipeline pipeline;
+        size_t inserted = 0;
+        for (const LoginAttempt& attempt : batch) {
+            pipeline.add(Statement::INSERT_LOGIN_ATTEMPT,
+                         StatementParams().text(attempt.username).text(attempt.password).inet(attempt.ip),
+                         [&inserted](const PGresult* res) {
+                             if (res != nullptr && PQresultStatus(res) == PGRES_COMMAND_OK) inserted++;
+                         });
+        }
+        bool ok = pipeline.run(conn.get());
+        if (PQpipelineStatus(conn.get()) != PQ_PIPELINE_OFF) conn.markBroken();
+        if (!ok) return false;
+        rejected = batch.size() - inserted;
+        return true;
+    }
+
+    std::string copyTarget() const {
+        std::string target = partitions ? partitions->currentPartition() : std::string();
+        return target.empty() ? kTable : target;
+    }
+
+    static bool copy(PGconn* conn, const std::string& table, const pgbinary::CopyEncoder& encoder) {
+        std::string sql = "COPY " + table + " (username, password, ip_address) FROM STDIN (FORMAT binary)";
+        PGresult* res = PQexec(conn, sql.c_str());
+        bool ready = PQresultStatus(res) == PGRES_COPY_IN;
+        PQclear(res);
+        if (!ready) {
+            std::cerr << "COPY error: " << PQerrorMessage(conn) << "\n";
+            return false;
+        }
+        const std::vector<uint8_t>& data = encoder.data();
+        bool sent = PQputCopyData(conn, reinterpret_cast<const char*>(data.data()), static_cast<int>(data.size())) == 1;
+        sent = PQputCopyEnd(conn, sent ? nullptr : "send failed") == 1 && sent;
+
+        bool ok = true;
+        while ((res = PQgetResult(conn)) != nullptr) {
+            if (PQresultStatus(res) != PGRES_COMMAND_OK) ok = false;
+            PQclear(res);
+        }
+        if (!ok || !sent) std::cerr << "COPY error: " << PQerrorMessage(conn) << "\n";
+        return ok && sent;
+    }
+};
+
+#endif // PG_LOGIN_STORE_H
@@ -0,0 +1,129 @@
+/**
+ * @file pipeline.h
+ * @brief Runs many prepared statements per round trip with libpq pipeline mode.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include <libpq-fe.h>
+#include "statements.h"
+
+/**
+ * @brief A batch of prepared statements sent back to back on one connection.
+ *
+ * Every queued statement is followed by its own sync point, so each runs in
+ * its own implicit transaction: a failing row does not abort the others, and
+ * every statement gets an individual result. Results arrive in queue order
+ * and are handed to the callback registered with the statement.
+ *
+ * Statements are sent in groups of at most kMaxDepth so that neither side's
+ * socket buffer fills while the other is still writing.
+ */
+class Pipeline {
+public:
+    /** @brief Receives a statement's result; nullptr if it never got one (connection failure). */
+    using Callback = std::function<void(const PGresult*)>;
+
+    /** @brief Statements in flight before results are read back. */
+    static constexpr size_t kMaxDepth = 256;
+
+    /**
+     * @brief Queues a statement; nothing is sent until run().
+     * @param statement The prepared statement.
+     * @param params Its parameters.
+     * @param callback Invoked with the statement's result.
+     */
+    void add(Statement statement, StatementParams params, Callback callback) {
+        queries.push_back(Query{ statement, std::move(params), std::move(callback) });
+    }
+
+    /** @brief Number of queued statements. */
+    size_t size() const { return queries.size(); }
+
+    /**
+     * @brief Sends every queued statement and dispatches the results.
+     *
+     * The queue is cleared. The connection is taken out of pipeline mode
+     * afterwards; if that fails, PQpipelineStatus() still reports pipeline
+     * mode and the connection must not be reused as is (mark its lease
+     * broken).
+     *
+     * @param conn A connection on which prepareStatements() succeeded.
+     * @return False if the connection failed; callbacks of statements
+     *         without a result receive nullptr.
+     */
+    bool run(PGconn* conn) {
+        bool ok = PQenterPipelineMode(conn) == 1;
+        size_t next = 0;
+        while (ok && next < queries.size()) {
+            size_t end = std::min(queries.size(), next + kMaxDepth);
+            if (!sendGroup(conn, next, end)) {
+                ok = false;
+                break;
+            }
+            ok = readGroup(conn, next, end);
+            next = end;
+        }
+        if (!ok) std::cerr << "Pipeline error: " << PQerrorMessage(conn) << "\n";
+        for (size_t i = next; i < queries.size(); i++) {
+            if (queries[i].callback) queries[i].callback(nullptr);
+        }
+        if (PQexitPipelineMode(conn) != 1) {
+            std::cerr << "Pipeline error: cannot leave pipeline mode: " << PQerrorMessage(conn) << "\n";
+        }
+        queries.clear();
+        return ok;
+    }
+
+private:
+    struct Query {
+        Statement statement;
+        StatementParams params;
+        Callback callback;
+    };
+
+    std::vector<Query> queries;
+
+    bool sendGroup(PGconn* conn, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (!queries[i].params.send(conn, queries[i].statement)) return false;
+            if (PQpipelineSync(conn) != 1) return false;
+        }
+        return PQflush(conn) == 0;
+    }
+
+    /**
+     * @brief Each statement yields its result, a nullptr terminator, then its sync marker.
+     * On failure, end is moved to the first statement whose callback has not run.
+     */
+    bool readGroup(PGconn* conn, size_t begin, size_t& end) {
+        for (size_t i = begin; i < end; i++) {
+            PGresult* res = PQgetResult(conn);
+            if (res == nullptr) {
+                end = i;
+                return false;
+            }
+            if (queries[i].callback) queries[i].callback(res);
+            PQclear(res);
+            while ((res = PQgetResult(conn)) != nullptr) PQclear(res);
+
+            res = PQgetResult(conn);
+            bool synced = PQresultStatus(res) == PGRES_PIPELINE_SYNC;
+            PQclear(res);
+            if (!synced) {
+                end = i + 1;
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+#endif // PIPELINE_H
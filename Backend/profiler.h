@@ -0,0 +1,350 @@
+/**
+ * @file profiler.h
+ * @brief SIGPROF sampling CPU profiler writing folded stacks for flame graphs.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cxxabi.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+/**
+ * @brief Settings of CpuProfiler, read from the "profiler" block of db_config.json.
+ */
+struct ProfilerConfig {
+    /** @brief Directory profiles are written to; created if missing. */
+    std::string dir = "profiles";
+
+    /** @brief Samples per second of CPU time when start() is not given a rate. */
+    unsigned frequency = 99;
+
+    /** @brief Samples kept per run; later ones are counted as dropped. Buffers exist only while running. */
+    size_t maxSamples = 16384;
+
+    /** @brief Profiles kept; the oldest are deleted once a new one is written. 0 keeps every file. */
+    size_t files = 16;
+};
+
+/**
+ * @brief Outcome of a profiling run.
+ */
+struct ProfileResult {
+    /** @brief Stacks collected. */
+    uint64_t samples;
+
+    /** @brief Samples lost because the buffer was full. */
+    uint64_t dropped;
+
+    /** @brief Distinct stacks in the folded output. */
+    size_t stacks;
+
+    /** @brief Where the folded stacks were written. */
+    std::string path;
+};
+
+namespace profiler {
+
+/**
+ * @brief Lists the profiles in a directory, oldest first.
+ * @return Pairs of start time in milliseconds and path; empty if the directory does not exist.
+ */
+inline std::vector<std::pair<uint64_t, std::string>> listFiles(const std::string& dir) {
+    std::vector<std::pair<uint64_t, std::string>> files;
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr) return files;
+    while (dirent* entry = readdir(d)) {
+        std::string name = entry->d_name;
+        const std::string prefix = "profile-", suffix = ".folded";
+        if (name.size() <= prefix.size() + suffix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            continue;
+        }
+        std::string digits = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+        if (digits.size() > 19 || digits.find_first_not_of("0123456789") != std::string::npos) continue;
+        files.emplace_back(std::stoull(digits), dir + "/" + name);
+    }
+    closedir(d);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+/** @brief Deepest stack kept; deeper stacks lose their outermost frames. */
+constexpr int kMaxDepth = 64;
+
+/** @brief Frames of the signal handler itself (the handler and the kernel's return trampoline). */
+constexpr int kHandlerFrames = 2;
+
+/** @brief One sampled stack, innermost frame first, as backtrace() returns it. */
+struct Sample {
+    int depth;
+    void* frames[kMaxDepth];
+};
+
+/**
+ * @brief Samples of the current run.
+ *
+ * Preallocated before the timer starts; the handler claims a slot with one
+ * atomic increment and writes only into it.
+ */
+struct SampleBuffer {
+    explicit SampleBuffer(size_t capacity) : samples(new Sample[capacity]), capacity(capacity) {}
+
+    std::unique_ptr<Sample[]> samples;
+    size_t capacity;
+    std::atomic<size_t> next{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+};
+
+/** @brief The running profiler's buffer; null whenever no profile is being taken. */
+inline std::atomic<SampleBuffer*>& active() {
+    static std::atomic<SampleBuffer*> buffer{ nullptr };
+    return buffer;
+}
+
+/** @brief Handlers currently running, so stop() can wait them out before reading the buffer. */
+inline std::atomic<int>& inHandler() {
+    static std::atomic<int> count{ 0 };
+    return count;
+}
+
+/**
+ * @brief The SIGPROF handler.
+ *
+ * Touches only preallocated memory and atomics. glibc's backtrace() is
+ * not formally async-signal-safe, but only its first call allocates (to
+ * load the unwinder), and CpuProfiler::start() makes that call up front.
+ */
+inline void onSignal(int) {
+    int savedErrno = errno;
+    inHandler().fetch_add(1);
+    SampleBuffer* buffer = active().load();
+    if (buffer != nullptr) {
+        size_t index = buffer->next.fetch_add(1, std::memory_order_relaxed);
+        if (index < buffer->capacity) {
+            Sample& sample = buffer->samples[index];
+            sample.depth = backtrace(sample.frames, kMaxDepth);
+        } else {
+            buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    inHandler().fetch_sub(1);
+    errno = savedErrno;
+}
+
+/**
+ * @brief Name of the function containing an address: demangled symbol, else module+offset, else the address.
+ *
+ * Functions of the executable itself only have names if it exports its
+ * symbols (linked with -rdynamic); otherwise the module+offset form can be
+ * fed to addr2line.
+ */
+inline std::string symbolize(void* address) {
+    char buf[64];
+    Dl_info info{};
+    if (dladdr(address, &info) == 0) {
+        std::snprintf(buf, sizeof(buf), "0x%llx", static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(address)));
+        return buf;
+    }
+    if (info.dli_sname != nullptr) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name = status == 0 && demangled != nullptr ? demangled : info.dli_sname;
+        std::free(demangled);
+        return name;
+    }
+    std::string module = info.dli_fname != nullptr ? info.dli_fname : "?";
+    module = module.substr(module.rfind('/') + 1);
+    std::snprintf(buf, sizeof(buf), "+0x%llx",
+                  static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(address) -
+                                                  reinterpret_cast<uintptr_t>(info.dli_fbase)));
+    return module + buf;
+}
+
+/**
+ * @brief Renders stacks in the folded format read by flamegraph.pl and speedscope.
+ * @param stacks Frame names, innermost first.
+ * @return One "outer;...;inner count" line per distinct stack, sorted.
+ */
+inline std::string foldStacks(const std::vector<std::vector<std::string>>& stacks) {
+    std::map<std::string, uint64_t> counts;
+    for (const auto& frames : stacks) {
+        if (frames.empty()) continue;
+        std::string line;
+        for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+            if (!line.empty()) line += ';';
+            // ';' separates frames, so it cannot appear inside one.
+            for (char c : *it) line += c == ';' ? ':' : c;
+        }
+        counts[line]++;
+    }
+    std::string out;
+    for (const auto& [line, count] : counts) out += line + " " + std::to_string(count) + "\n";
+    return out;
+}
+
+} // namespace profiler
+
+/**
+ * @brief Samples every thread's stack on SIGPROF while a profile is running.
+ *
+ * start() installs the handler and an ITIMER_PROF timer, which fires per
+ * unit of CPU time consumed by the process, so busy threads are sampled in
+ * proportion to the CPU they use and idle ones not at all. stop() removes
+ * the timer, then symbolizes and folds the stacks outside signal context.
+ * Until the first start() there is no handler, and between runs no timer
+ * and no buffer, so an idle profiler costs nothing.
+ *
+ * SIGPROF is process-wide, so only one profile can run at a time.
+ */
+class CpuProfiler {
+public:
+    explicit CpuProfiler(const ProfilerConfig& config = ProfilerConfig()) : config(config) {}
+
+    ~CpuProfiler() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (buffer) disarm();
+    }
+
+    CpuProfiler(const CpuProfiler&) = delete;
+    CpuProfiler& operator=(const CpuProfiler&) = delete;
+
+    bool running() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return buffer != nullptr;
+    }
+
+    /**
+     * @brief Starts sampling.
+     * @param frequency Samples per CPU second, 1 to 1000; 0 uses the configured rate.
+     * @throw std::runtime_error If a profile is already running or the timer cannot be set.
+     */
+    void start(unsigned frequency = 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (buffer) throw std::runtime_error("Profiler already running");
+        if (frequency == 0) frequency = config.frequency;
+        if (frequency == 0 || frequency > 1000) throw std::runtime_error("Profiler frequency must be 1-1000 Hz");
+        // Loads the unwinder now, so the first sample does not allocate inside the handler.
+        void* warmup[1];
+        backtrace(warmup, 1);
+
+        buffer = std::make_unique<profiler::SampleBuffer>(std::max<size_t>(1, config.maxSamples));
+        profiler::SampleBuffer* expected = nullptr;
+        if (!profiler::active().compare_exchange_strong(expected, buffer.get())) {
+            buffer.reset();
+            throw std::runtime_error("Another profiler is running");
+        }
+        struct sigaction action {};
+        action.sa_handler = profiler::onSignal;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGPROF, &action, nullptr);
+        itimerval timer{};
+        // tv_usec must stay below a second, so 1 Hz is tv_sec = 1.
+        timer.it_interval.tv_sec = static_cast<time_t>(1 / frequency);
+        timer.it_interval.tv_usec = static_cast<suseconds_t>((1000000 / frequency) % 1000000);
+        timer.it_value = timer.it_interval;
+        if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+            disarm();
+            throw std::runtime_error("Profiler: cannot start ITIMER_PROF");
+        }
+    }
+
+    /**
+     * @brief Stops sampling and writes the folded stacks to a new file.
+     * @throw std::runtime_error If no profile is running or the file cannot be written.
+     */
+    ProfileResult stop() {
+        std::unique_ptr<profiler::SampleBuffer> samples;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!buffer) throw std::runtime_error("Profiler not running");
+            disarm();
+            samples = std::move(buffer);
+        }
+        size_t count = std::min(samples->next.load(), samples->capacity);
+        std::vector<std::vector<std::string>> stacks;
+        stacks.reserve(count);
+        std::unordered_map<void*, std::string> names;
+        for (size_t i = 0; i < count; i++) {
+            const profiler::Sample& sample = samples->samples[i];
+            std::vector<std::string> frames;
+            for (int f = profiler::kHandlerFrames; f < sample.depth; f++) {
+                // Outer frames hold return addresses, which can point just past their call's function.
+                void* address = f == profiler::kHandlerFrames
+                    ? sample.frames[f]
+                    : static_cast<char*>(sample.frames[f]) - 1;
+                auto it = names.find(address);
+                if (it == names.end()) it = names.emplace(address, profiler::symbolize(address)).first;
+                frames.push_back(it->second);
+            }
+            stacks.push_back(std::move(frames));
+        }
+        std::string folded = profiler::foldStacks(stacks);
+
+        ProfileResult result{ count, samples->dropped.load(), 0, write(folded) };
+        for (char c : folded) result.stacks += c == '\n';
+        return result;
+    }
+
+private:
+    ProfilerConfig config;
+    mutable std::mutex mutex;
+    std::unique_ptr<profiler::SampleBuffer> buffer;
+
+    /**
+     * @brief Stops the timer and waits out handlers still running.
+     *
+     * The handler stays installed: a SIGPROF already pending when the timer
+     * stops would kill the process under the default action, while the
+     * handler just ignores it once no buffer is active.
+     */
+    void disarm() {
+        itimerval off{};
+        setitimer(ITIMER_PROF, &off, nullptr);
+        profiler::active().store(nullptr);
+        while (profiler::inHandler().load() != 0) std::this_thread::yield();
+    }
+
+    std::string write(const std::string& folded) const {
+        if (::mkdir(config.dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::runtime_error("Profiler: cannot create directory " + config.dir);
+        }
+        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::system_clock::now().time_since_epoch()).count();
+        std::string path = config.dir + "/profile-" + std::to_string(millis) + ".folded";
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        bool ok = file != nullptr && std::fwrite(folded.data(), 1, folded.size(), file) == folded.size();
+        if (file != nullptr && std::fclose(file) != 0) ok = false;
+        if (!ok) throw std::runtime_error("Profiler: cannot write " + path);
+        if (config.files > 0) {
+            auto files = profiler::listFiles(config.dir);
+            for (size_t i = 0; i + config.files < files.size(); i++) std::remove(files[i].second.c_str());
+        }
+        return path;
+    }
+};
+
+#endif // PROFILER_H
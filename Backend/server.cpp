@@ -10,6 +10,18 @@
 #include <atomic>
 #include <thread>
 #include <mutex>
+#include <array>
+#include <memory>
+#include <algorithm>
+#include <cstdlib>
+#include <optional>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <csignal>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -17,6 +29,31 @@
 #include <libpq-fe.h>
 #include <nlohmann/json.hpp>
 #include "packet.h"
+#include "command_registry.h"
+#include "worker_pool.h"
+#include "compression.h"
+#include "asset_cache.h"
+#include "stream.h"
+#include "checksum.h"
+#include "handshake.h"
+#include "batch.h"
+#include "db_pool.h"
+#include "statements.h"
+#include "login_writer.h"
+#include "pg_login_store.h"
+#include "sqlite_login_store.h"
+#include "partitions.h"
+#include "db_event_loop.h"
+#include "sketches.h"
+#include "audit_log.h"
+#include "capture.h"
+#include "metrics.h"
+#include "metrics_http.h"
+#include "latency.h"
+#include "trace.h"
+#include "profiler.h"
+#include "instrumented_mutex.h"
+#include "accounting.h"
 
 /**
  * @brief Represents the current operational state of the server.
@@ -38,8 +75,40 @@ class CTFServer {
 private:
     int listenFd;
     std::atomic<ServerState> serverState;
+    TraceConfig traceConfig;
+    /** @brief Spans of sampled requests; declared before the storage it traces so it outlives it. */
+    std::unique_ptr<Tracer> tracer;
     std::string dbConnStr;
-    std::mutex dbMutex;
+    PoolConfig dbPoolConfig;
+    std::unique_ptr<PgConnectionPool> dbPool;
+    PartitionConfig partitionConfig;
+    std::unique_ptr<PartitionManager> partitions;
+    /** @brief Where login attempts go: "postgres" (default) or "sqlite" ("storage.backend"). */
+    std::string storageBackend = "postgres";
+    SqliteConfig sqliteConfig;
+    std::unique_ptr<LoginStore> loginStore;
+    LoginWriterConfig loginWriterConfig;
+    std::unique_ptr<LoginWriter> loginWriter;
+    /** @brief Acknowledge LOGIN only after its row is committed ("login_writer.ack": "committed"). */
+    bool commitBeforeAck = false;
+    DbEventLoopConfig dbLoopConfig;
+    std::unique_ptr<DbEventLoop> dbLoop;
+    /** @brief Heavy hitters and distinct counts over every LOGIN, reported by STATS. */
+    LoginSketches loginSketches;
+    AuditConfig auditConfig;
+    std::unique_ptr<AuditLogger> auditLog;
+    /** @brief Connections accepted so far; numbers sessions in the audit log. */
+    std::atomic<uint64_t> connectionCount{ 0 };
+    CaptureConfig captureConfig;
+    /** @brief pcapng capture of sampled connections; null unless enabled. */
+    std::unique_ptr<PacketCapture> packetCapture;
+    /** @brief Writes a trace dump on SIGUSR1; null unless tracing is enabled. */
+    std::unique_ptr<TraceDumper> traceDumper;
+    ProfilerConfig profilerConfig;
+    /** @brief CPU profiler driven by PROFILE; idle (no handler, timer or buffer) until started. */
+    std::unique_ptr<CpuProfiler> profiler;
+    /** @brief Token admin commands must carry; empty refuses them all. */
+    std::string adminToken;
 
     void loadDbConfig() {
         std::ifstream f("db_config.json");
@@ -48,43 +117,170 @@ private:
             return;
         }
         auto cfg = nlohmann::json::parse(f);
-        auto& db = cfg["database"];
-        dbConnStr = "host=" + db["host"].get<std::string>() +
-                    " port=" + std::to_string(db["port"].get<int>()) +
-                    " dbname=" + db["dbname"].get<std::string>() +
-                    " user=" + db["user"].get<std::string>() +
-                    " password=" + db["password"].get<std::string>();
+        if (cfg.contains("storage")) {
+            auto& storage = cfg["storage"];
+            storageBackend = storage.value("backend", storageBackend);
+            if (storage.contains("sqlite")) {
+                auto& sqlite = storage["sqlite"];
+                sqliteConfig.path = sqlite.value("path", sqliteConfig.path);
+                sqliteConfig.synchronous = sqlite.value("synchronous", sqliteConfig.synchronous);
+                sqliteConfig.busyTimeout = std::chrono::milliseconds(
+                    sqlite.value("busy_timeout_ms", static_cast<int64_t>(sqliteConfig.busyTimeout.count())));
+            }
+        }
+        if (cfg.contains("database")) {
+            auto& db = cfg["database"];
+            dbConnStr = "host=" + db["host"].get<std::string>() +
+                        " port=" + std::to_string(db["port"].get<int>()) +
+                        " dbname=" + db["dbname"].get<std::string>() +
+                        " user=" + db["user"].get<std::string>() +
+                        " password=" + db["password"].get<std::string>();
+        }
+        if (cfg.contains("pool")) {
+            auto& pool = cfg["pool"];
+            dbPoolConfig.size = pool.value("size", dbPoolConfig.size);
+            dbPoolConfig.acquireTimeout = std::chrono::milliseconds(
+                pool.value("acquire_timeout_ms", static_cast<int64_t>(dbPoolConfig.acquireTimeout.count())));
+            dbPoolConfig.initialBackoff = std::chrono::milliseconds(
+                pool.value("initial_backoff_ms", static_cast<int64_t>(dbPoolConfig.initialBackoff.count())));
+            dbPoolConfig.maxBackoff = std::chrono::milliseconds(
+                pool.value("max_backoff_ms", static_cast<int64_t>(dbPoolConfig.maxBackoff.count())));
+            dbPoolConfig.healthCheckIdle = std::chrono::milliseconds(
+                pool.value("health_check_idle_ms", static_cast<int64_t>(dbPoolConfig.healthCheckIdle.count())));
+        }
+        if (cfg.contains("login_writer")) {
+            auto& writer = cfg["login_writer"];
+            loginWriterConfig.queueCapacity = writer.value("queue_capacity", loginWriterConfig.queueCapacity);
+            loginWriterConfig.batchSize = writer.value("batch_size", loginWriterConfig.batchSize);
+            loginWriterConfig.flushInterval = std::chrono::milliseconds(
+                writer.value("flush_interval_ms", static_cast<int64_t>(loginWriterConfig.flushInterval.count())));
+            commitBeforeAck = writer.value("ack", std::string("queued")) == "committed";
+        }
+        if (cfg.contains("aggregation")) {
+            auto& aggregation = cfg["aggregation"];
+            AggregatorConfig& agg = loginWriterConfig.aggregation;
+            agg.enabled = aggregation.value("enabled", agg.enabled);
+            agg.shards = aggregation.value("shards", agg.shards);
+            agg.flushInterval = std::chrono::milliseconds(
+                aggregation.value("flush_interval_ms", static_cast<int64_t>(agg.flushInterval.count())));
+            agg.sampleEvery = aggregation.value("sample_every", agg.sampleEvery);
+            agg.maxEntries = aggregation.value("max_entries", agg.maxEntries);
+        }
+        if (cfg.contains("spool")) {
+            auto& spool = cfg["spool"];
+            loginWriterConfig.spool.path = spool.value("path", loginWriterConfig.spool.path);
+            loginWriterConfig.spool.commitInterval = std::chrono::milliseconds(
+                spool.value("commit_interval_ms", static_cast<int64_t>(loginWriterConfig.spool.commitInterval.count())));
+            loginWriterConfig.spool.replayBatch = spool.value("replay_batch", loginWriterConfig.spool.replayBatch);
+        }
+        if (cfg.contains("partitions")) {
+            auto& parts = cfg["partitions"];
+            partitionConfig.enabled = parts.value("enabled", partitionConfig.enabled);
+            partitionConfig.table = parts.value("table", partitionConfig.table);
+            partitionConfig.daysAhead = parts.value("days_ahead", partitionConfig.daysAhead);
+            partitionConfig.retentionDays = parts.value("retention_days", partitionConfig.retentionDays);
+            partitionConfig.archiveSchema = parts.value("archive_schema", partitionConfig.archiveSchema);
+            partitionConfig.checkInterval = std::chrono::minutes(
+                parts.value("check_interval_min", static_cast<int64_t>(partitionConfig.checkInterval.count())));
+        }
+        if (cfg.contains("audit")) {
+            auto& audit = cfg["audit"];
+            auditConfig.enabled = audit.value("enabled", auditConfig.enabled);
+            auditConfig.dir = audit.value("dir", auditConfig.dir);
+            auditConfig.segmentBytes = audit.value("segment_bytes", auditConfig.segmentBytes);
+            auditConfig.ringCapacity = audit.value("ring_capacity", auditConfig.ringCapacity);
+            auditConfig.flushInterval = std::chrono::milliseconds(
+                audit.value("flush_interval_ms", static_cast<int64_t>(auditConfig.flushInterval.count())));
+            auditConfig.preallocate = audit.value("preallocate_bytes", auditConfig.preallocate);
+            auditConfig.rotateInterval = std::chrono::seconds(audit.value("rotate_interval_s", static_cast<int64_t>(
+                std::chrono::duration_cast<std::chrono::seconds>(auditConfig.rotateInterval).count())));
+            auditConfig.compress = audit.value("compress", auditConfig.compress);
+            auditConfig.compressLevel = audit.value("compress_level", auditConfig.compressLevel);
+            auditConfig.diskBudget = audit.value("disk_budget_bytes", auditConfig.diskBudget);
+        }
+        if (cfg.contains("metrics")) {
+            auto& m = cfg["metrics"];
+            metricsConfig.enabled = m.value("enabled", metricsConfig.enabled);
+            metricsConfig.bind = m.value("bind", metricsConfig.bind);
+            metricsConfig.port = m.value("port", metricsConfig.port);
+        }
+        if (cfg.contains("capture")) {
+            auto& cap = cfg["capture"];
+            captureConfig.enabled = cap.value("enabled", captureConfig.enabled);
+            captureConfig.dir = cap.value("dir", captureConfig.dir);
+            captureConfig.fileBytes = cap.value("file_bytes", captureConfig.fileBytes);
+            captureConfig.files = cap.value("files", captureConfig.files);
+            captureConfig.sampleEvery = cap.value("sample_every", captureConfig.sampleEvery);
+            captureConfig.snaplen = cap.value("snaplen", captureConfig.snaplen);
+            captureConfig.queueCapacity = cap.value("queue_capacity", captureConfig.queueCapacity);
+        }
+        if (cfg.contains("trace")) {
+            auto& tr = cfg["trace"];
+            traceConfig.enabled = tr.value("enabled", traceConfig.enabled);
+            traceConfig.sampleEvery = tr.value("sample_every", traceConfig.sampleEvery);
+            traceConfig.bufferSpans = tr.value("buffer_spans", traceConfig.bufferSpans);
+            traceConfig.dir = tr.value("dir", traceConfig.dir);
+        }
+        if (cfg.contains("profiler")) {
+            auto& prof = cfg["profiler"];
+            profilerConfig.dir = prof.value("dir", profilerConfig.dir);
+            profilerConfig.frequency = prof.value("frequency", profilerConfig.frequency);
+            profilerConfig.maxSamples = prof.value("max_samples", profilerConfig.maxSamples);
+            profilerConfig.files = prof.value("files", profilerConfig.files);
+        }
+        if (cfg.contains("admin")) {
+            adminToken = cfg["admin"].value("token", adminToken);
+            if (adminToken.size() > kMaxAdminToken || adminToken.find(' ') != std::string::npos) {
+                std::cerr << "Warning: admin.token must be at most " << kMaxAdminToken
+                          << " bytes without spaces; admin commands are disabled\n";
+                adminToken.clear();
+            }
+        }
+        if (cfg.contains("event_loop")) {
+            auto& loop = cfg["event_loop"];
+            dbLoopConfig.connections = loop.value("connections", dbLoopConfig.connections);
+            dbLoopConfig.queueCapacity = loop.value("queue_capacity", dbLoopConfig.queueCapacity);
+            dbLoopConfig.pipelineDepth = loop.value("pipeline_depth", dbLoopConfig.pipelineDepth);
+        }
     }
 
-    void storeLogin(const std::string& username, const std::string& password, const std::string& ip) {
-        std::lock_guard<std::mutex> lock(dbMutex);
-        PGconn* conn = PQconnectdb(dbConnStr.c_str());
-        if (PQstatus(conn) != CONNECTION_OK) {
-            std::cerr << "DB error: " << PQerrorMessage(conn) << "\n";
-            PQfinish(conn);
+    void openStorage() {
+        if (storageBackend == "sqlite") {
+            loginStore = std::make_unique<SqliteLoginStore>(sqliteConfig);
+            std::cout << "Login storage: SQLite " << sqliteConfig.path << "\n";
+            // Commits are local and cheap; the committed-ack event loop is PostgreSQL only.
+            loginWriter = std::make_unique<LoginWriter>(*loginStore, loginWriterConfig);
             return;
         }
-        const char* params[] = { username.c_str(), password.c_str(), ip.c_str() };
-        PGresult* res = PQexecParams(conn,
-            "INSERT INTO ctf.login_attempts (username, password, ip_address) VALUES ($1, $2, $3)",
-            3, nullptr, params, nullptr, nullptr, 0);
-        if (PQresultStatus(res) != PGRES_COMMAND_OK)
-            std::cerr << "Insert error: " << PQerrorMessage(conn) << "\n";
-        PQclear(res);
-        PQfinish(conn);
+        if (storageBackend != "postgres") {
+            throw std::runtime_error("Unknown storage backend: " + storageBackend);
+        }
+        dbPool = std::make_unique<PgConnectionPool>(dbConnStr, dbPoolConfig, prepareStatements);
+        PoolStats stats = dbPool->stats();
+        std::cout << "DB pool: " << stats.idle << "/" << stats.size << " connections ready\n";
+        if (partitionConfig.enabled) partitions = std::make_unique<PartitionManager>(*dbPool, partitionConfig);
+        loginStore = std::make_unique<PgLoginStore>(*dbPool, partitions.get(), tracer.get());
+        loginWriter = std::make_unique<LoginWriter>(*loginStore, loginWriterConfig);
+        if (commitBeforeAck) {
+            dbLoopConfig.initialBackoff = dbPoolConfig.initialBackoff;
+            dbLoopConfig.maxBackoff = dbPoolConfig.maxBackoff;
+            dbLoop = std::make_unique<DbEventLoop>(dbConnStr, dbLoopConfig);
+        }
     }
 
-    void logPacket(const NetworkPacket& p, const std::string& dir) {
-        std::ofstream f("packet_audit.log", std::ios::app);
-        if (f.is_open()) {
-            f << "[" << dir << "] Cmd:" << static_cast<uint32_t>(p.getCommandID())
-              << " Size:" << p.getPayloadSize() << " CRC:0x" << std::hex << p.getPayloadCrc() << std::dec << "\n";
+    void storeLogin(const std::string& username, const std::string& password, const std::string& ip) {
+        trace::Span span("db.enqueue");
+        auto start = std::chrono::steady_clock::now();
+        if (!loginWriter->submit(LoginAttempt{ username, password, ip })) {
+            std::cerr << "Login writer queue full and no spool, attempt dropped\n";
         }
+        latency.since(Command::LOGIN, Stage::DB, start);
     }
 
     bool recieveExact(int fd, uint8_t* buffer, size_t size) {
         size_t totalReceived = 0;
         while (totalReceived < size) {
+            accounting::syscall();
             ssize_t received = recv(fd, buffer + totalReceived, size - totalReceived, 0);
             if (received <= 0) return false;
             totalReceived += received;
@@ -100,110 +296,1158 @@ private:
         return "unknown";
     }
 
+    /** @brief Shared by every session's send lock. */
+    static LockSite& sendLockSite() {
+        static LockSite& site = locks::site("session_send");
+        return site;
+    }
+
+    /**
+     * @brief Per-connection state shared by the parser and the command handlers.
+     */
+    struct Session {
+        int fd = -1;
+        /** @brief Connection number in the audit log. */
+        uint64_t id = 0;
+        std::string clientIP;
+        /** @brief clientIP as stored in audit records. */
+        std::array<uint8_t, 16> peer{};
+        /** @brief Sampled for pcapng capture; frames of other sessions are not copied. */
+        bool captured = false;
+        std::atomic<bool> isAuthenticated{false};
+        /** @brief Options negotiated by HELLO; legacy framing until then. */
+        handshake::Options options = handshake::legacyOptions();
+        /** @brief Whether HELLO completed, enabling inbound checksum verification. */
+        bool negotiated = false;
+        /** @brief Set after the first packet, after which HELLO is refused. */
+        bool handshakeClosed = false;
+        /** @brief Serialises frames written by the connection thread and multiplexed workers. */
+        InstrumentedMutex sendMutex{ sendLockSite() };
+        /** @brief Multiplexed requests still running on the worker pool. */
+        int inflight = 0;
+        std::mutex inflightMutex;
+        std::condition_variable inflightCv;
+    };
+
+    using SteadyTime = std::chrono::steady_clock::time_point;
+
+    /**
+     * @brief A decoded request together with the reply options that apply to it.
+     */
+    struct PendingBatch;
+
+    struct Request {
+        NetworkPacket packet;
+        /** @brief Echoed in the reply header on version 2 connections. */
+        uint32_t id;
+        /** @brief FLAG_ACCEPT_COMPRESSED was set or compression was negotiated. */
+        bool acceptsCompression;
+        /** @brief FLAG_ACCEPT_STREAM was set or streaming was negotiated. */
+        bool acceptsStream;
+        /** @brief Part of a BATCH; the handler must return its reply rather than send it. */
+        bool batched;
+        /** @brief When the header arrived, for the reply latency in the audit log. */
+        SteadyTime received;
+        /** @brief Part of a BATCH: the batch, where a handler may leave its reply for later, and this entry's slot. */
+        std::shared_ptr<PendingBatch> batch = nullptr;
+        size_t batchEntry = 0;
+    };
+
+    /**
+     * @brief A BATCH whose sub-replies may arrive after its worker is done.
+     *
+     * Committed-ack LOGIN entries fill in their reply from the DB event loop
+     * when their insert completes, so the worker never waits on the database.
+     * Whoever drops remaining to zero sends the batch.
+     */
+    struct PendingBatch {
+        /** @brief Routing of the reply; the request payload is not kept. */
+        Request request;
+        uint64_t requestSize;
+        uint32_t requestCrc;
+        /** @brief One per entry, written once each by the worker or by the entry's insert callback. */
+        std::vector<std::optional<NetworkPacket>> replies;
+        /** @brief Entries waiting for an insert, plus one for the worker until it has run every entry. */
+        std::atomic<size_t> remaining{ 1 };
+        /** @brief Entries left for later so far; only the worker running the batch touches it. */
+        size_t deferred = 0;
+        TraceContext context;
+        /** @brief What the worker charged, carried to the thread that sends the reply. */
+        accounting::Usage usage;
+    };
+
+    /** @brief An audit record for a session, with only the fields every event shares filled in. */
+    static AuditRecord auditRecord(const Session& session, AuditEvent event, Command cmd) {
+        AuditRecord record{};
+        record.connection = session.id;
+        record.peer = session.peer;
+        record.event = event;
+        record.command = static_cast<uint32_t>(cmd);
+        return record;
+    }
+
+    /** @brief Microseconds since a request arrived, for the audit log; 0 if its arrival is not known. */
+    static uint32_t latencyMicros(SteadyTime received) {
+        if (received == SteadyTime()) return 0;
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - received).count();
+        return static_cast<uint32_t>(std::min<int64_t>(micros, UINT32_MAX));
+    }
+
+    void logRequest(const Session& session, const NetworkPacket& p) {
+        AuditRecord record = auditRecord(session, AuditEvent::RECEIVED, p.getCommandID());
+        record.packet.size = p.getPayloadSize();
+        record.packet.crc = p.getPayloadCrc();
+        auditLog->log(record);
+    }
+
+    /** @brief Records a reply under the command it answers, with the reply command as the result. */
+    void logReply(const Session& session, AuditEvent event, Command request, Command reply, uint64_t size,
+                  uint32_t crc, SteadyTime received) {
+        AuditRecord record = auditRecord(session, event, request);
+        record.packet.size = size;
+        record.packet.crc = crc;
+        record.packet.latency = latencyMicros(received);
+        record.result = static_cast<uint16_t>(reply);
+        auditLog->log(record);
+        if (received != SteadyTime()) latency.since(request, Stage::TOTAL, received);
+        logUsage(session, request, reply);
+    }
+
+    void logBatch(const Session& session, const PendingBatch& pending, size_t failures, size_t replySize) {
+        static_assert(batch::kMaxEntries <= UINT16_MAX, "AuditBatch counts entries in 16 bits");
+        const Request& request = pending.request;
+        AuditRecord record = auditRecord(session, AuditEvent::BATCH, Command::BATCH);
+        record.batch.size = pending.requestSize;
+        record.batch.crc = pending.requestCrc;
+        record.batch.latency = latencyMicros(request.received);
+        record.batch.replySize = static_cast<uint32_t>(replySize);
+        record.batch.entries = static_cast<uint16_t>(pending.replies.size());
+        record.batch.failures = static_cast<uint16_t>(failures);
+        record.result = static_cast<uint16_t>(Command::ACK);
+        auditLog->log(record);
+        latency.since(Command::BATCH, Stage::TOTAL, request.received);
+        logUsage(session, Command::BATCH, Command::ACK);
+    }
+
+    /**
+     * @brief In CTF_ACCOUNTING builds, records what the request just answered cost, counted up to its reply.
+     *
+     * Work done after the reply, or on a thread outside any accounting scope
+     * (the login writer, the DB loop's own I/O), is not charged.
+     */
+    void logUsage(const Session& session, Command request, Command reply) {
+        if constexpr (accounting::kEnabled) {
+            const accounting::Usage* usage = accounting::current();
+            if (usage == nullptr) return;
+            AuditRecord record = auditRecord(session, AuditEvent::USAGE, request);
+            record.usage.allocatedBytes = usage->bytes;
+            record.usage.allocations = static_cast<uint32_t>(std::min<uint64_t>(usage->allocations, UINT32_MAX));
+            record.usage.syscalls = static_cast<uint32_t>(std::min<uint64_t>(usage->syscalls, UINT32_MAX));
+            record.result = static_cast<uint16_t>(reply);
+            auditLog->log(record);
+            requestUsage.add(request, *usage);
+        }
+    }
+
+    /**
+     * @brief A command handler. Returns the reply packet, or nullopt if the
+     * handler already sent its reply itself (e.g. as a chunked stream).
+     */
+    using Handler = std::optional<NetworkPacket> (CTFServer::*)(Session&, const Request&);
+
+    /** @brief Assets larger than this are streamed from disk instead of being cached. */
+    static constexpr uint64_t kMaxCachedAssetSize = 8 * 1024 * 1024;
+
+    std::array<Handler, kCommandCount> handlers;
+    WorkerPool workers;
+    AssetCache assetCache;
+
+    /** @brief Metrics updated on the request path; the rest are read from their owners on each scrape. */
+    struct ServerCounters {
+        Counter* accepted = nullptr;
+        Gauge* active = nullptr;
+        Counter* bytesIn = nullptr;
+        Counter* bytesOut = nullptr;
+        Counter* checksumFailures = nullptr;
+        /** @brief By commandIndex(); the last entry counts unknown commands. */
+        std::array<Counter*, kCommandCount + 1> received{};
+        /** @brief ACK, ERROR, anything else. */
+        std::array<Counter*, 3> sent{};
+    };
+
+    MetricsRegistry metrics;
+    ServerCounters counters;
+    /** @brief Stage latencies per command, exported as summaries and in STATS. */
+    RequestLatency latency;
+    /** @brief Allocations and syscalls per command; only filled in CTF_ACCOUNTING builds. */
+    accounting::CommandUsage requestUsage;
+    MetricsHttpConfig metricsConfig;
+    // Declared after everything its scrapes read, so it is stopped first.
+    std::unique_ptr<MetricsHttpServer> metricsServer;
+
+    void registerHandler(Command cmd, Handler handler) {
+        handlers[commandIndex(cmd)] = handler;
+    }
+
+    void registerHandlers() {
+        registerHandler(Command::LOGIN, &CTFServer::handleLogin);
+        registerHandler(Command::TOGGLE_MAINTENANCE, &CTFServer::handleToggleMaintenance);
+        registerHandler(Command::SET_ONLINE, &CTFServer::handleSetOnline);
+        registerHandler(Command::REQUEST_FLAG_IMAGE, &CTFServer::handleRequestFlagImage);
+        registerHandler(Command::HELLO, &CTFServer::handleHello);
+        registerHandler(Command::BATCH, &CTFServer::handleBatch);
+        registerHandler(Command::STATS, &CTFServer::handleStats);
+        registerHandler(Command::PROFILE, &CTFServer::handleProfile);
+        for (size_t i = 0; i < kCommandCount; i++) {
+            if (handlers[i] == nullptr) {
+                std::cerr << "No handler registered for " << kCommandTable[i].name << "\n";
+                std::abort();
+            }
+        }
+    }
+
+    void registerMetrics() {
+        counters.accepted = &metrics.counter("ctf_connections_accepted_total", "TCP connections accepted.");
+        counters.active = &metrics.gauge("ctf_connections_active", "TCP connections currently open.");
+        for (size_t i = 0; i <= kCommandCount; i++) {
+            std::string name = i < kCommandCount ? kCommandTable[i].name : "unknown";
+            counters.received[i] = &metrics.counter("ctf_packets_received_total", "Request frames received, by command.",
+                                                    metrics::label("command", name));
+        }
+        const char* replies[] = { "ACK", "ERROR", "other" };
+        for (size_t i = 0; i < counters.sent.size(); i++) {
+            counters.sent[i] = &metrics.counter("ctf_packets_sent_total", "Frames sent, by command.",
+                                                metrics::label("command", replies[i]));
+        }
+        counters.bytesIn = &metrics.counter("ctf_bytes_received_total", "Protocol bytes received, headers included.");
+        counters.bytesOut = &metrics.counter("ctf_bytes_sent_total", "Protocol bytes sent, headers included.");
+        counters.checksumFailures = &metrics.counter("ctf_checksum_failures_total",
+                                                     "Requests rejected because the payload checksum did not match.");
+
+        using metrics::Type;
+        metrics.sampled("ctf_login_queue_depth", "Login attempts waiting for the writer thread.", Type::GAUGE,
+                        [this] { return static_cast<double>(loginWriter->depth()); });
+        metrics.sampled("ctf_login_attempts_total", "Login attempts by outcome in the writer.", Type::COUNTER,
+                        [this] { return static_cast<double>(loginWriter->stats().written); },
+                        metrics::label("result", "written"));
+        metrics.sampled("ctf_login_attempts_total", "Login attempts by outcome in the writer.", Type::COUNTER,
+                        [this] { return static_cast<double>(loginWriter->stats().failed); },
+                        metrics::label("result", "failed"));
+        metrics.sampled("ctf_login_attempts_total", "Login attempts by outcome in the writer.", Type::COUNTER,
+                        [this] { return static_cast<double>(loginWriter->stats().dropped); },
+                        metrics::label("result", "dropped"));
+        metrics.sampled("ctf_login_spool_depth", "Login attempts spooled on disk waiting for the database.",
+                        Type::GAUGE, [this] { return static_cast<double>(loginWriter->stats().spool.depth); });
+        metrics.sampled("ctf_login_spool_replay_rate", "Attempts per second during the most recent spool replay.",
+                        Type::GAUGE, [this] { return loginWriter->stats().spool.replayRate; });
+        metrics.sampled("ctf_db_batches_total", "Login batches committed to the store.", Type::COUNTER,
+                        [this] { return static_cast<double>(loginWriter->stats().batches); });
+        metrics.sampled("ctf_db_write_seconds_total",
+                        "Time spent writing login batches; divide by ctf_db_batches_total for the mean.",
+                        Type::COUNTER, [this] { return static_cast<double>(loginWriter->stats().writeNanos) / 1e9; });
+        if (dbPool) {
+            metrics.sampled("ctf_db_pool_connections", "Pooled database connections, by state.", Type::GAUGE,
+                            [this] { return static_cast<double>(dbPool->stats().size); },
+                            metrics::label("state", "total"));
+            metrics.sampled("ctf_db_pool_connections", "Pooled database connections, by state.", Type::GAUGE,
+                            [this] { return static_cast<double>(dbPool->stats().idle); },
+                            metrics::label("state", "idle"));
+            metrics.sampled("ctf_db_pool_acquisitions_total", "Connection pool acquisitions by outcome.",
+                            Type::COUNTER, [this] { return static_cast<double>(dbPool->stats().acquired); },
+                            metrics::label("result", "acquired"));
+            metrics.sampled("ctf_db_pool_acquisitions_total", "Connection pool acquisitions by outcome.",
+                            Type::COUNTER, [this] { return static_cast<double>(dbPool->stats().failed); },
+                            metrics::label("result", "failed"));
+            metrics.sampled("ctf_db_pool_wait_seconds_total",
+                            "Time spent waiting for a pooled connection; divide by acquisitions for the mean.",
+                            Type::COUNTER,
+                            [this] { return static_cast<double>(dbPool->stats().totalWaitMicros) / 1e6; });
+            metrics.sampled("ctf_db_pool_max_wait_seconds", "Longest single wait for a pooled connection.",
+                            Type::GAUGE, [this] { return static_cast<double>(dbPool->stats().maxWaitMicros) / 1e6; });
+            metrics.sampled("ctf_db_pool_reconnects_total", "Pooled connections re-established after startup.",
+                            Type::COUNTER, [this] { return static_cast<double>(dbPool->stats().reconnects); });
+            metrics.sampled("ctf_db_pool_connect_failures_total", "Failed connection attempts, startup included.",
+                            Type::COUNTER, [this] { return static_cast<double>(dbPool->stats().connectFailures); });
+        }
+        if (dbLoop) {
+            metrics.sampled("ctf_db_queries_in_flight", "Event loop queries submitted and not yet finished.",
+                            Type::GAUGE, [this] {
+                                DbEventLoopStats stats = dbLoop->stats();
+                                return static_cast<double>(stats.submitted - stats.completed - stats.failed);
+                            });
+            metrics.sampled("ctf_db_queries_total", "Event loop queries by outcome.", Type::COUNTER,
+                            [this] { return static_cast<double>(dbLoop->stats().completed); },
+                            metrics::label("result", "completed"));
+            metrics.sampled("ctf_db_queries_total", "Event loop queries by outcome.", Type::COUNTER,
+                            [this] { return static_cast<double>(dbLoop->stats().failed); },
+                            metrics::label("result", "failed"));
+            metrics.sampled("ctf_db_queries_total", "Event loop queries by outcome.", Type::COUNTER,
+                            [this] { return static_cast<double>(dbLoop->stats().rejected); },
+                            metrics::label("result", "rejected"));
+        }
+        metrics.sampled("ctf_asset_cache_lookups_total", "Asset cache lookups by outcome.", Type::COUNTER,
+                        [this] { return static_cast<double>(assetCache.stats().hits); }, metrics::label("result", "hit"));
+        metrics.sampled("ctf_asset_cache_lookups_total", "Asset cache lookups by outcome.", Type::COUNTER,
+                        [this] { return static_cast<double>(assetCache.stats().misses); },
+                        metrics::label("result", "miss"));
+        for (size_t slot = 0; slot < RequestLatency::kSlots; slot++) {
+            for (size_t stage = 0; stage < kStageCount; stage++) {
+                const LatencyHistogram* histogram = &latency.histogram(slot, static_cast<Stage>(stage));
+                metrics.summary("ctf_request_stage_seconds", "Time spent in each stage of a request, by command.",
+                                [histogram] { return summarize(histogram->snapshot()); },
+                                metrics::label("command", RequestLatency::slotName(slot)) + "," +
+                                    metrics::label("stage", stageName(static_cast<Stage>(stage))));
+            }
+        }
+        if constexpr (accounting::kEnabled) {
+            for (size_t slot = 0; slot < RequestLatency::kSlots; slot++) {
+                std::string labels = metrics::label("command", RequestLatency::slotName(slot));
+                metrics.sampled("ctf_request_accounted_total", "Replies whose allocations and syscalls were counted.",
+                                Type::COUNTER,
+                                [this, slot] { return static_cast<double>(requestUsage.requests(slot)); }, labels);
+                metrics.sampled("ctf_request_allocations_total", "Heap allocations charged to requests, by command.",
+                                Type::COUNTER,
+                                [this, slot] { return static_cast<double>(requestUsage.allocations(slot)); }, labels);
+                metrics.sampled("ctf_request_allocated_bytes_total", "Bytes allocated for requests, by command.",
+                                Type::COUNTER,
+                                [this, slot] { return static_cast<double>(requestUsage.bytes(slot)); }, labels);
+                metrics.sampled("ctf_request_syscalls_total", "Socket syscalls charged to requests, by command.",
+                                Type::COUNTER,
+                                [this, slot] { return static_cast<double>(requestUsage.syscalls(slot)); }, labels);
+            }
+        }
+        // Sessions come later; create their site now so it is exported.
+        sendLockSite();
+        locks::registerMetrics(metrics);
+        metrics.sampled("ctf_audit_records_dropped_total", "Audit records lost because a ring was full.",
+                        Type::COUNTER, [this] { return static_cast<double>(auditLog->stats().dropped); });
+    }
+
+    static NetworkPacket makeReply(Command cmd, const std::string& message) {
+        NetworkPacket res(cmd, message.size());
+        res.writePayload(reinterpret_cast<const uint8_t*>(message.data()), message.size());
+        return res;
+    }
+
+    static NetworkPacket makeAssetReply(const std::vector<uint8_t>& data, uint32_t crc, uint16_t flags) {
+        NetworkPacket res(Command::ACK, data.size());
+        res.writePayload(data.data(), data.size(), crc);
+        res.setFlags(flags);
+        return res;
+    }
+
+    /**
+     * @brief Compresses a reply for clients that accept it, when that makes it smaller.
+     */
+    static NetworkPacket compressReply(const Request& request, NetworkPacket packet) {
+        if (!request.acceptsCompression || packet.hasFlag(FLAG_COMPRESSED)) return packet;
+        std::vector<uint8_t> encoded;
+        if (!compression::compress(packet.getPayload(), packet.getPayloadSize(), encoded, Z_BEST_SPEED)) {
+            return packet;
+        }
+        NetworkPacket res(packet.getCommandID(), encoded.size());
+        res.writePayload(encoded.data(), encoded.size());
+        res.setFlags(packet.getFlags() | FLAG_COMPRESSED);
+        return res;
+    }
+
+    /**
+     * @brief Reasons a request is refused based on its header alone.
+     */
+    enum class Rejection { NONE, STREAMED, TOO_LARGE, UNKNOWN, UNAUTHORIZED, COMPRESSED };
+
+    static const char* rejectionMessage(Rejection rejection) {
+        switch (rejection) {
+            case Rejection::STREAMED: return "Streamed requests not supported";
+            case Rejection::TOO_LARGE: return "Payload too large";
+            case Rejection::UNKNOWN: return "Unknown command";
+            case Rejection::UNAUTHORIZED: return "Unauthorized";
+            case Rejection::COMPRESSED: return "Compressed requests not supported";
+            case Rejection::NONE: break;
+        }
+        return "";
+    }
+
+    /**
+     * @brief Applies the command traits to a header before its payload is read.
+     */
+    static Rejection checkRequest(const Session& session, const Header& header, uint16_t flags, const CommandInfo* info) {
+        // No request command carries bulk data, so inbound streams are refused outright.
+        if (flags & (FLAG_STREAM_START | FLAG_STREAM_DATA | FLAG_STREAM_END)) return Rejection::STREAMED;
+        if (header.payloadSize > (info ? info->maxPayload : 0)) return Rejection::TOO_LARGE;
+        if (info == nullptr) return Rejection::UNKNOWN;
+        if (info->requiresAuth && !session.isAuthenticated) return Rejection::UNAUTHORIZED;
+        if (flags & FLAG_COMPRESSED) return Rejection::COMPRESSED;
+        return Rejection::NONE;
+    }
+
+    bool discardExact(int fd, size_t size) {
+        uint8_t scratch[512];
+        while (size > 0) {
+            size_t chunk = size < sizeof(scratch) ? size : sizeof(scratch);
+            if (!recieveExact(fd, scratch, chunk)) return false;
+            size -= chunk;
+        }
+        return true;
+    }
+
+    /** @brief Samples a new session for capture and starts its stream with the socket's real addresses. */
+    void startCapture(Session& session) {
+        if (!packetCapture || !packetCapture->sample(session.id)) return;
+        sockaddr_in peerAddr{}, localAddr{};
+        socklen_t peerLen = sizeof(peerAddr), localLen = sizeof(localAddr);
+        getpeername(session.fd, reinterpret_cast<sockaddr*>(&peerAddr), &peerLen);
+        getsockname(session.fd, reinterpret_cast<sockaddr*>(&localAddr), &localLen);
+        session.captured = true;
+        packetCapture->open(session.id, { peerAddr.sin_addr.s_addr, peerAddr.sin_port },
+                            { localAddr.sin_addr.s_addr, localAddr.sin_port });
+    }
+
+    /** @brief Captures a received frame as read: header, request ID on version 2, then payload or skipped bytes. */
+    void captureReceived(const Session& session, const uint8_t* header, uint32_t netId, const uint8_t* payload,
+                         size_t size, size_t skipped) {
+        if (!session.captured) return;
+        iovec iov[3];
+        int count = 0;
+        iov[count++] = { const_cast<uint8_t*>(header), sizeof(Header) };
+        if (session.options.version >= handshake::kRequestIdVersion) {
+            iov[count++] = { &netId, sizeof(netId) };
+        }
+        if (size > 0) {
+            iov[count++] = { const_cast<uint8_t*>(payload), size };
+        }
+        packetCapture->frame(session.id, PacketCapture::Direction::FROM_CLIENT, iov, count, skipped);
+    }
+
     void handleClient(int fd) {
-        bool isAuthenticated = false;
-        std::string clientIP = getClientIP(fd);
+        Session session;
+        session.fd = fd;
+        session.id = ++connectionCount;
+        session.clientIP = getClientIP(fd);
+        session.peer = audit::parsePeer(session.clientIP);
+        startCapture(session);
+        counters.active->inc();
+        uint32_t requestCount = 0;
         try {
             while (true) {
-                std::vector<uint8_t> headerBuffer(sizeof(Header));
-                if (!recieveExact(fd, headerBuffer.data(), sizeof(Header))) break;
+                // Charges this request with everything the connection thread does for it, from its first recv.
+                accounting::Usage usage;
+                accounting::Scope counted(&usage);
+                uint8_t headerBuffer[sizeof(Header)];
+                // The wait for the first bytes is idle time between requests, so the header read is timed after it.
+                accounting::syscall();
+                ssize_t first = recv(fd, headerBuffer, sizeof(Header), 0);
+                if (first <= 0) break;
+                SteadyTime headerStart = std::chrono::steady_clock::now();
+                if (!recieveExact(fd, headerBuffer + first, sizeof(Header) - static_cast<size_t>(first))) break;
+
+                uint32_t requestId = 0;
+                uint32_t netId = 0;
+                if (session.options.version >= handshake::kRequestIdVersion) {
+                    if (!recieveExact(fd, reinterpret_cast<uint8_t*>(&netId), sizeof(netId))) break;
+                    requestId = ntohl(netId);
+                }
+                SteadyTime received = std::chrono::steady_clock::now();
+                trace::Scope traced(tracer->begin(session.id, requestId, ++requestCount));
+                trace::record("recv.header", headerStart, received);
+
+                Header header = NetworkPacket::parseHeader(headerBuffer);
+                uint16_t flags = NetworkPacket::parseFlags(headerBuffer);
+                const CommandInfo* info = findCommand(header.commandID);
+                latency.record(header.commandID, Stage::HEADER_READ, received - headerStart);
+                counters.received[info != nullptr ? commandIndex(info->command) : kCommandCount]->inc();
+                counters.bytesIn->inc(sizeof(Header) + (session.options.version >= handshake::kRequestIdVersion
+                                                            ? sizeof(netId) : 0));
+
+                // Reject before touching the payload: the declared size is attacker controlled,
+                // and once a size or stream frame is refused the connection cannot be resynchronised.
+                Rejection rejection = checkRequest(session, header, flags, info);
+                if (rejection != Rejection::NONE) {
+                    bool fatal = rejection == Rejection::STREAMED || rejection == Rejection::TOO_LARGE;
+                    if (!fatal && !discardExact(fd, header.payloadSize)) break;
+                    if (!fatal) counters.bytesIn->inc(header.payloadSize);
+                    captureReceived(session, headerBuffer, netId, nullptr, 0, fatal ? 0 : header.payloadSize);
+                    sendPacket(session, requestId, makeReply(Command::ERROR, rejectionMessage(rejection)), true,
+                               header.commandID, received);
+                    if (fatal) break;
+                    continue;
+                }
 
-                NetworkPacket* headerPeek = NetworkPacket::deserialize(headerBuffer.data(), sizeof(Header));
-                uint32_t payloadSize = headerPeek->getPayloadSize();
-                delete headerPeek;
+                std::vector<uint8_t> fullBuf(sizeof(Header) + header.payloadSize);
+                std::memcpy(fullBuf.data(), headerBuffer, sizeof(Header));
 
-                std::vector<uint8_t> fullBuf(sizeof(Header) + payloadSize);
-                std::memcpy(fullBuf.data(), headerBuffer.data(), sizeof(Header));
+                if (header.payloadSize > 0) {
+                    trace::Span span("recv.payload");
+                    if (!recieveExact(fd, fullBuf.data() + sizeof(Header), header.payloadSize)) break;
+                }
+                if (header.payloadSize > 0) latency.since(header.commandID, Stage::PAYLOAD_READ, received);
+                counters.bytesIn->inc(header.payloadSize);
+                captureReceived(session, headerBuffer, netId, fullBuf.data() + sizeof(Header), header.payloadSize, 0);
+
+                std::unique_ptr<NetworkPacket> req(NetworkPacket::deserialize(fullBuf.data(), fullBuf.size()));
+                // BATCH writes one summary line for the whole exchange instead.
+                if (info->command != Command::BATCH) logRequest(session, *req);
 
-                if (payloadSize > 0) {
-                    if (!recieveExact(fd, fullBuf.data() + sizeof(Header), payloadSize)) break;
+                if (session.negotiated && session.options.checksum != ChecksumType::NONE &&
+                    checksum::compute(session.options.checksum, req->getPayload(), req->getPayloadSize()) != header.payloadCRC) {
+                    counters.checksumFailures->inc();
+                    sendPacket(session, requestId, makeReply(Command::ERROR, "Checksum mismatch"), true,
+                               header.commandID, received);
+                    continue;
                 }
 
-                NetworkPacket* req = NetworkPacket::deserialize(fullBuf.data(), fullBuf.size());
-                logPacket(*req, "RECEIVED");
-                processCommand(fd, *req, isAuthenticated, clientIP);
-                delete req;
+                Request request{ std::move(*req), requestId,
+                                 session.options.compression || (flags & FLAG_ACCEPT_COMPRESSED) != 0,
+                                 session.options.streaming || (flags & FLAG_ACCEPT_STREAM) != 0, false, received };
+                processCommand(session, *info, std::move(request));
+                session.handshakeClosed = true;
             }
         } catch (const std::exception& e) {
             std::cerr << "Error handling client: " << e.what() << "\n";
         }
+        {
+            std::unique_lock<std::mutex> lock(session.inflightMutex);
+            session.inflightCv.wait(lock, [&session] { return session.inflight == 0; });
+        }
+        if (session.captured) packetCapture->close(session.id);
+        counters.active->dec();
         close(fd);
     }
 
-    void processCommand(int fd, const NetworkPacket& packet, bool& isAuthenticated, const std::string& clientIP) {
-        Command cmd = packet.getCommandID();
+    /**
+     * @brief Runs a request's handler and sends its reply.
+     *
+     * On multiplexed connections worker commands run asynchronously and their
+     * replies are matched to requests by ID; otherwise replies keep request order.
+     */
+    void processCommand(Session& session, const CommandInfo& info, Request request) {
+        Handler handler = handlers[commandIndex(info.command)];
+        if (info.dispatch == Dispatch::WORKER && session.options.multiplex) {
+            {
+                std::lock_guard<std::mutex> lock(session.inflightMutex);
+                session.inflight++;
+            }
+            auto pending = std::make_shared<Request>(std::move(request));
+            Command cmd = info.command;
+            SteadyTime queued = std::chrono::steady_clock::now();
+            workers.submit([this, handler, &session, pending, cmd, queued, context = trace::current(),
+                            name = info.name, usage = accounting::carry()]() mutable {
+                trace::Scope traced(context);
+                accounting::Scope counted(&usage);
+                trace::record("worker.wait", queued, std::chrono::steady_clock::now());
+                try {
+                    std::optional<NetworkPacket> reply;
+                    {
+                        trace::Span span(name);
+                        reply = (this->*handler)(session, *pending);
+                    }
+                    latency.since(cmd, Stage::PROCESS, queued);
+                    if (reply) sendReply(session, *pending, std::move(*reply));
+                } catch (const std::exception& e) {
+                    std::cerr << "Error handling client: " << e.what() << "\n";
+                    shutdown(session.fd, SHUT_RDWR);
+                }
+                std::lock_guard<std::mutex> lock(session.inflightMutex);
+                session.inflight--;
+                session.inflightCv.notify_all();
+            });
+            return;
+        }
+
+        std::optional<NetworkPacket> reply;
+        SteadyTime start = std::chrono::steady_clock::now();
+        if (info.dispatch == Dispatch::WORKER) {
+            reply = workers.submit([this, handler, &session, &request, start, context = trace::current(),
+                                    name = info.name, usage = accounting::current()] {
+                trace::Scope traced(context);
+                accounting::Scope counted(usage);
+                trace::record("worker.wait", start, std::chrono::steady_clock::now());
+                trace::Span span(name);
+                return (this->*handler)(session, request);
+            }).get();
+            // A BATCH may still be waiting for its inserts; its reply must go out before the next request's.
+            std::unique_lock<std::mutex> lock(session.inflightMutex);
+            session.inflightCv.wait(lock, [&session] { return session.inflight == 0; });
+        } else {
+            trace::Span span(info.name);
+            reply = (this->*handler)(session, request);
+        }
+        latency.since(info.command, Stage::PROCESS, start);
+        if (reply) sendReply(session, request, std::move(*reply));
+    }
+
+    std::optional<NetworkPacket> handleLogin(Session& session, const Request& request) {
+        const NetworkPacket& packet = request.packet;
+        std::string payload(reinterpret_cast<const char*>(packet.getPayload()), packet.getPayloadSize());
+        std::string username = "unknown", password = "unknown";
+        auto sep = payload.find(':');
+        if (sep != std::string::npos) {
+            username = payload.substr(0, sep);
+            password = payload.substr(sep + 1);
+        }
+        loginSketches.record(LoginAttempt{ username, password, session.clientIP });
+        if (dbLoop) {
+            return storeLoginCommitted(session, request, LoginAttempt{ username, password, session.clientIP });
+        }
+        storeLogin(username, password, session.clientIP);
+
+        session.isAuthenticated = true;
+        return makeReply(Command::ACK, "Login successful");
+    }
+
+    /**
+     * @brief Inserts a login through the DB event loop and acknowledges it once committed.
+     *
+     * ACK means the row is in the database. If the insert fails, or the loop
+     * cannot take it, the reply is ERROR and the attempt is not stored; the
+     * session is authenticated either way, as with any credentials.
+     * Multiplexed connections get the reply once the insert completes, sent
+     * by a worker because the loop thread must never block on a client
+     * socket, so the connection thread keeps reading requests meanwhile.
+     * A BATCH entry leaves its reply in the batch the same way, so the
+     * worker running the batch never waits on the database. Other
+     * connections wait here to keep replies in order.
+     */
+    std::optional<NetworkPacket> storeLoginCommitted(Session& session, const Request& request, LoginAttempt attempt) {
+        session.isAuthenticated = true;
+
+        if (request.batch) {
+            std::shared_ptr<PendingBatch> pending = request.batch;
+            size_t entry = request.batchEntry;
+            pending->remaining++;
+            bool queued = submitLogin(attempt, [this, &session, pending, entry](bool committed) {
+                pending->replies[entry] = loginReply(committed);
+                if (pending->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+                workers.submit([this, &session, pending] {
+                    trace::Scope traced(pending->context);
+                    accounting::Scope counted(&pending->usage);
+                    sendBatch(session, *pending);
+                });
+            });
+            if (queued) {
+                pending->deferred++;
+                return std::nullopt;
+            }
+            pending->remaining--;
+            return loginReply(false);
+        }
+
+        if (session.options.multiplex) {
+            {
+                std::lock_guard<std::mutex> lock(session.inflightMutex);
+                session.inflight++;
+            }
+            // Only the reply routing is needed once the handler has returned.
+            auto reply = std::make_shared<Request>(Request{ NetworkPacket(Command::LOGIN, 0), request.id,
+                                                            request.acceptsCompression, false, false,
+                                                            request.received });
+            bool queued = submitLogin(attempt, [this, &session, reply](bool committed) {
+                workers.submit([this, &session, reply, committed, context = trace::current(),
+                                usage = accounting::carry()]() mutable {
+                    trace::Scope traced(context);
+                    accounting::Scope counted(&usage);
+                    sendReply(session, *reply, loginReply(committed));
+                    std::lock_guard<std::mutex> lock(session.inflightMutex);
+                    session.inflight--;
+                    session.inflightCv.notify_all();
+                });
+            });
+            if (queued) return std::nullopt;
+            {
+                std::lock_guard<std::mutex> lock(session.inflightMutex);
+                session.inflight--;
+                session.inflightCv.notify_all();
+            }
+            return loginReply(false);
+        }
+
+        std::promise<bool> committed;
+        std::future<bool> done = committed.get_future();
+        if (!submitLogin(attempt, [&committed](bool stored) { committed.set_value(stored); })) return loginReply(false);
+        return loginReply(done.get());
+    }
+
+    /**
+     * @brief Queues a login insert on the DB event loop.
+     * @param done Called on the loop thread, in the request's trace and accounting scope, with whether the row
+     *        was committed.
+     * @return False if the loop's queue was full; done is not called then.
+     */
+    bool submitLogin(const LoginAttempt& attempt, std::function<void(bool)> done) {
+        StatementParams params;
+        params.text(attempt.username).text(attempt.password).inet(attempt.ip);
+        SteadyTime submitted = std::chrono::steady_clock::now();
+        return dbLoop->submit(Statement::INSERT_LOGIN_ATTEMPT, std::move(params),
+            [this, done = std::move(done), submitted, context = trace::current(),
+             usage = accounting::carry()](const PGresult* res) mutable {
+                trace::Scope traced(context);
+                accounting::Scope counted(&usage);
+                trace::record("db.commit", submitted, std::chrono::steady_clock::now());
+                latency.since(Command::LOGIN, Stage::DB, submitted);
+                done(insertCommitted(res));
+            });
+    }
+
+    /** @brief True if an event loop insert committed; logs why it did not otherwise. */
+    static bool insertCommitted(const PGresult* res) {
+        if (res != nullptr && PQresultStatus(res) == PGRES_COMMAND_OK) return true;
+        if (res != nullptr) std::cerr << "Insert error: " << PQresultErrorMessage(res);
+        return false;
+    }
+
+    static NetworkPacket loginReply(bool committed) {
+        return committed ? makeReply(Command::ACK, "Login successful")
+                         : makeReply(Command::ERROR, "Login not recorded, try again");
+    }
+
+    std::optional<NetworkPacket> handleToggleMaintenance(Session&, const Request&) {
+        serverState = ServerState::MAINTENANCE;
+        return makeReply(Command::ACK, "Server in maintenance mode");
+    }
+
+    std::optional<NetworkPacket> handleSetOnline(Session&, const Request&) {
+        serverState = ServerState::ONLINE;
+        return makeReply(Command::ACK, "Server online");
+    }
 
-        if (cmd == Command::LOGIN) {
-            std::string payload(reinterpret_cast<const char*>(packet.getPayload()), packet.getPayloadSize());
-            std::string username = "unknown", password = "unknown";
-            auto sep = payload.find(':');
-            if (sep != std::string::npos) {
-                username = payload.substr(0, sep);
-                password = payload.substr(sep + 1);
+    std::optional<NetworkPacket> handleRequestFlagImage(Session& session, const Request& request) {
+        std::string flagPath = "flag.png";
+        struct stat st;
+        if (stat(flagPath.c_str(), &st) != 0) {
+            return makeReply(Command::ERROR, "Flag not found");
+        }
+        if (static_cast<uint64_t>(st.st_size) > kMaxCachedAssetSize) {
+            if (!request.acceptsStream) {
+                return makeReply(Command::ERROR, "Flag too large, request it with FLAG_ACCEPT_STREAM");
             }
-            storeLogin(username, password, clientIP);
+            if (!streamFile(session, request, flagPath, st.st_size)) throw std::runtime_error("Flag stream failed");
+            return std::nullopt;
+        }
 
-            isAuthenticated = true;
-            std::string response = "Login successful";
-            NetworkPacket res(Command::ACK, response.size());
-            res.writePayload(reinterpret_cast<const uint8_t*>(response.data()), response.size());
-            sendPacket(fd, res);
-            return;
+        std::shared_ptr<const Asset> flag = assetCache.get(flagPath);
+        if (!flag) {
+            return makeReply(Command::ERROR, "Flag not found");
         }
-        if (!isAuthenticated) {
-            std::string response = "Unauthorized";
-            NetworkPacket res(Command::ERROR, response.size());
-            res.writePayload(reinterpret_cast<const uint8_t*>(response.data()), response.size());
-            sendPacket(fd, res);
-            return;
+        bool compressed = request.acceptsCompression && !flag->compressed.empty();
+        const std::vector<uint8_t>& data = compressed ? flag->compressed : flag->raw;
+        uint16_t flags = compressed ? FLAG_COMPRESSED : FLAG_NONE;
+
+        if (request.acceptsStream && data.size() > session.options.maxFrameSize) {
+            if (!streamBuffer(session, request, data, flags)) throw std::runtime_error("Flag stream failed");
+            return std::nullopt;
         }
-        if (cmd == Command::TOGGLE_MAINTENANCE) {
-            serverState = ServerState::MAINTENANCE;
-            std::string response = "Server in maintenance mode";
-            NetworkPacket res(Command::ACK, response.size());
-            res.writePayload(reinterpret_cast<const uint8_t*>(response.data()), response.size());
-            sendPacket(fd, res);
-            return;
+        return makeAssetReply(data, compressed ? flag->compressedCRC : flag->rawCRC, flags);
+    }
+
+    /**
+     * @brief Negotiates connection options. The ACK goes out in the old framing,
+     * so the handler sends it itself before switching.
+     */
+    std::optional<NetworkPacket> handleHello(Session& session, const Request& request) {
+        if (session.handshakeClosed) {
+            return makeReply(Command::ERROR, "HELLO must be the first packet");
         }
-        if (cmd == Command::REQUEST_FLAG_IMAGE) {
-            std::string flagPath = "flag.png";
-            std::ifstream f(flagPath, std::ios::binary);
-            if (!f.is_open()) {
-                std::string response = "Flag not found";
-                NetworkPacket res(Command::ERROR, response.size());
-                res.writePayload(reinterpret_cast<const uint8_t*>(response.data()), response.size());
-                sendPacket(fd, res);
-                return;
+        const NetworkPacket& packet = request.packet;
+        handshake::Hello chosen;
+        try {
+            chosen = handshake::negotiate(handshake::decode(packet.getPayload(), packet.getPayloadSize()),
+                                          handshake::serverCapabilities());
+        } catch (const std::runtime_error& e) {
+            return makeReply(Command::ERROR, e.what());
+        }
+
+        uint8_t payload[handshake::kHelloSize];
+        handshake::encode(chosen, payload);
+        NetworkPacket ack(Command::ACK, sizeof(payload));
+        ack.writePayload(payload, sizeof(payload));
+        sendPacket(session, request.id, ack, true, Command::HELLO, request.received);
+
+        session.options = handshake::toOptions(chosen);
+        session.negotiated = true;
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Runs every sub-request of a BATCH in order on this worker and
+     * sends all sub-replies in a single ACK, once the last committed-ack
+     * LOGIN among them has its insert result (see PendingBatch).
+     */
+    std::optional<NetworkPacket> handleBatch(Session& session, const Request& request) {
+        const NetworkPacket& packet = request.packet;
+        std::vector<batch::Entry> entries;
+        try {
+            entries = batch::split(packet.getPayload(), packet.getPayloadSize());
+        } catch (const std::runtime_error& e) {
+            return makeReply(Command::ERROR, e.what());
+        }
+
+        auto pending = std::make_shared<PendingBatch>();
+        pending->request = Request{ NetworkPacket(Command::BATCH, 0), request.id, request.acceptsCompression,
+                                    request.acceptsStream, false, request.received };
+        pending->requestSize = packet.getPayloadSize();
+        pending->requestCrc = packet.getPayloadCrc();
+        pending->replies.resize(entries.size());
+        pending->context = trace::current();
+        // Held until the reply is sent, which may be after this worker has moved on.
+        {
+            std::lock_guard<std::mutex> lock(session.inflightMutex);
+            session.inflight++;
+        }
+        for (size_t i = 0; i < entries.size(); i++) {
+            std::optional<NetworkPacket> reply = runBatchEntry(session, request, entries[i], pending, i);
+            if (reply) pending->replies[i] = std::move(*reply);
+        }
+        pending->usage = accounting::carry();
+        if (pending->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) sendBatch(session, *pending);
+        return std::nullopt;
+    }
+
+    /** @brief Sends a batch whose entries all have replies, and releases its hold on the session. */
+    void sendBatch(Session& session, PendingBatch& pending) {
+        std::vector<uint8_t> payload;
+        size_t failures = 0;
+        for (const std::optional<NetworkPacket>& reply : pending.replies) {
+            if (reply->getCommandID() == Command::ERROR) failures++;
+            batch::append(payload, *reply, session.options.checksum);
+        }
+        NetworkPacket res(Command::ACK, payload.size());
+        res.writePayload(payload.data(), payload.size());
+        sendReply(session, pending.request, std::move(res), false);
+        logBatch(session, pending, failures, payload.size());
+        std::lock_guard<std::mutex> lock(session.inflightMutex);
+        session.inflight--;
+        session.inflightCv.notify_all();
+    }
+
+    /**
+     * @brief Checks the token an admin command's payload starts with.
+     * @param arguments Receives the rest of the payload, after the token and one space.
+     * @return False if no admin.token is configured or the payload does not start with it.
+     */
+    bool adminArguments(const NetworkPacket& packet, std::string& arguments) const {
+        std::string payload(reinterpret_cast<const char*>(packet.getPayload()), packet.getPayloadSize());
+        size_t end = std::min(payload.find(' '), payload.size());
+        if (adminToken.empty() || end != adminToken.size()) return false;
+        // Compares every byte, so the reply time does not tell how much of a guess was right.
+        unsigned char diff = 0;
+        for (size_t i = 0; i < end; i++) diff |= static_cast<unsigned char>(payload[i] ^ adminToken[i]);
+        if (diff != 0) return false;
+        arguments = end < payload.size() ? payload.substr(end + 1) : "";
+        return true;
+    }
+
+    /**
+     * @brief Reports the login sketches and request latencies as JSON. The payload is the admin token,
+     * then optionally the length of each top list in decimal (default 10, at most 100).
+     */
+    std::optional<NetworkPacket> handleStats(Session&, const Request& request) {
+        std::string text;
+        if (!adminArguments(request.packet, text)) return makeReply(Command::ERROR, "Admin token required");
+        size_t n = 10;
+        if (!text.empty()) {
+            if (text.size() > 8 || text.find_first_not_of("0123456789") != std::string::npos) {
+                return makeReply(Command::ERROR, "Invalid STATS length");
             }
-            f.seekg(0, std::ios::end);
-            size_t fileSize = f.tellg();
-            f.seekg(0, std::ios::beg);
-            NetworkPacket res(Command::ACK, fileSize);
-            std::vector<uint8_t> fileData(fileSize);
-            f.read(reinterpret_cast<char*>(fileData.data()), fileSize);
-            res.writePayload(fileData.data(), fileSize);
-            sendPacket(fd, res);
+            n = std::min<size_t>(std::stoul(text), 100);
         }
+
+        LoginSketchReport report = loginSketches.report(n);
+        auto list = [](const std::vector<HeavyHitter>& items) {
+            nlohmann::json array = nlohmann::json::array();
+            for (const HeavyHitter& item : items) {
+                array.push_back({ { "value", item.value }, { "count", item.count }, { "error", item.error } });
+            }
+            return array;
+        };
+        nlohmann::json stats = {
+            { "logins", report.logins },
+            { "unique_ips", report.uniqueIps },
+            { "unique_credentials", report.uniqueCredentials },
+            { "top_usernames", list(report.usernames) },
+            { "top_passwords", list(report.passwords) },
+            { "top_ips", list(report.ips) },
+            { "latency", latencyJson() },
+        };
+        if constexpr (accounting::kEnabled) stats["usage"] = usageJson();
+        return makeReply(Command::ACK, stats.dump());
     }
 
-    void sendPacket(int fd, const NetworkPacket& packet) {
-        std::vector<uint8_t> data = packet.serialize();
-        send(fd, data.data(), data.size(), 0);
-        logPacket(packet, "SENT");
+    /**
+     * @brief Stage latencies as {command: {stage: {count, p50_us, p99_us, p999_us, max_us}}}, leaving out
+     *        commands and stages with no samples yet.
+     */
+    nlohmann::json latencyJson() const {
+        nlohmann::json out = nlohmann::json::object();
+        for (size_t slot = 0; slot < RequestLatency::kSlots; slot++) {
+            nlohmann::json stages = nlohmann::json::object();
+            for (size_t stage = 0; stage < kStageCount; stage++) {
+                HistogramSnapshot snapshot = latency.histogram(slot, static_cast<Stage>(stage)).snapshot();
+                if (snapshot.count == 0) continue;
+                stages[stageName(static_cast<Stage>(stage))] = {
+                    { "count", snapshot.count },
+                    { "p50_us", snapshot.percentile(0.5) / 1000.0 },
+                    { "p99_us", snapshot.percentile(0.99) / 1000.0 },
+                    { "p999_us", snapshot.percentile(0.999) / 1000.0 },
+                    { "max_us", snapshot.max / 1000.0 },
+                };
+            }
+            if (!stages.empty()) out[RequestLatency::slotName(slot)] = std::move(stages);
+        }
+        return out;
+    }
+
+    /**
+     * @brief Mean cost per request as {command: {requests, allocations, bytes, syscalls}}, leaving out commands
+     *        not seen yet. Only reported by CTF_ACCOUNTING builds.
+     */
+    nlohmann::json usageJson() const {
+        nlohmann::json out = nlohmann::json::object();
+        for (size_t slot = 0; slot < RequestLatency::kSlots; slot++) {
+            uint64_t requests = requestUsage.requests(slot);
+            if (requests == 0) continue;
+            double n = static_cast<double>(requests);
+            out[RequestLatency::slotName(slot)] = {
+                { "requests", requests },
+                { "allocations", requestUsage.allocations(slot) / n },
+                { "bytes", requestUsage.bytes(slot) / n },
+                { "syscalls", requestUsage.syscalls(slot) / n },
+            };
+        }
+        return out;
+    }
+
+    /**
+     * @brief Starts or stops the CPU profiler. The payload is the admin token, then "start", "start <hz>" or
+     * "stop"; stop replies with the sample counts and the path of the folded-stack file.
+     */
+    std::optional<NetworkPacket> handleProfile(Session&, const Request& request) {
+        std::string action;
+        if (!adminArguments(request.packet, action)) return makeReply(Command::ERROR, "Admin token required");
+        try {
+            if (action == "stop") {
+                ProfileResult result = profiler->stop();
+                nlohmann::json reply = {
+                    { "samples", result.samples },
+                    { "dropped", result.dropped },
+                    { "stacks", result.stacks },
+                    { "path", result.path },
+                };
+                return makeReply(Command::ACK, reply.dump());
+            }
+            if (action.compare(0, 5, "start") == 0) {
+                std::string rate = action.size() > 5 && action[5] == ' ' ? action.substr(6) : "";
+                if (action.size() > 5 && (rate.empty() || rate.find_first_not_of("0123456789") != std::string::npos)) {
+                    return makeReply(Command::ERROR, "Invalid PROFILE rate");
+                }
+                profiler->start(rate.empty() ? 0 : static_cast<unsigned>(std::min<unsigned long>(std::stoul(rate), 100000)));
+                return makeReply(Command::ACK, "Profiling started");
+            }
+        } catch (const std::exception& e) {
+            return makeReply(Command::ERROR, e.what());
+        }
+        return makeReply(Command::ERROR, "PROFILE expects start or stop");
+    }
+
+    /** @brief Runs one BATCH entry; no reply means the entry will fill in its slot of the batch itself. */
+    std::optional<NetworkPacket> runBatchEntry(Session& session, const Request& parent, const batch::Entry& entry,
+                                               const std::shared_ptr<PendingBatch>& pending, size_t index) {
+        const CommandInfo* info = findCommand(entry.header.commandID);
+        Rejection rejection = checkRequest(session, entry.header, entry.flags, info);
+        if (rejection != Rejection::NONE) {
+            return makeReply(Command::ERROR, rejectionMessage(rejection));
+        }
+        if (info->command == Command::BATCH || info->command == Command::HELLO) {
+            return makeReply(Command::ERROR, "Command not allowed in BATCH");
+        }
+        if (session.negotiated && session.options.checksum != ChecksumType::NONE &&
+            checksum::compute(session.options.checksum, entry.payload, entry.header.payloadSize) != entry.header.payloadCRC) {
+            return makeReply(Command::ERROR, "Checksum mismatch");
+        }
+
+        // Sub-replies are embedded in the batch, so they are never streamed or compressed on their own.
+        Request sub{ NetworkPacket(entry.header.commandID, entry.header.payloadSize), parent.id, false, false, true,
+                     parent.received, pending, index };
+        sub.packet.writePayload(entry.payload, entry.header.payloadSize);
+        try {
+            size_t deferred = pending->deferred;
+            std::optional<NetworkPacket> reply = (this->*handlers[commandIndex(info->command)])(session, sub);
+            if (reply) return reply;
+            if (pending->deferred != deferred) return std::nullopt;
+            return makeReply(Command::ERROR, "Command not allowed in BATCH");
+        } catch (const std::exception& e) {
+            std::cerr << "Error handling batch entry: " << e.what() << "\n";
+            return makeReply(Command::ERROR, "Internal error");
+        }
+    }
+
+    stream::StreamWriter makeStreamWriter(Session& session, const Request& request, uint16_t flags, uint64_t totalSize) {
+        uint32_t requestId = request.id;
+        Command cmd = request.packet.getCommandID();
+        return stream::StreamWriter(Command::ACK, flags, totalSize, session.options.maxFrameSize,
+            [this, &session, requestId, cmd](const uint8_t* frame, size_t size) {
+                return sendFrame(session, requestId, frame, frame + sizeof(Header), size - sizeof(Header), cmd);
+            }, session.options.checksum);
+    }
+
+    /**
+     * @brief Streams an in-memory buffer as START/DATA/END frames.
+     */
+    bool streamBuffer(Session& session, const Request& request, const std::vector<uint8_t>& data, uint16_t flags) {
+        stream::StreamWriter writer = makeStreamWriter(session, request, flags, data.size());
+        bool ok = writer.begin() && writer.write(data.data(), data.size()) && writer.finish();
+        logReply(session, AuditEvent::SENT_STREAM, request.packet.getCommandID(), Command::ACK, data.size(),
+                 writer.getTotalCrc(), request.received);
+        return ok;
+    }
+
+    /**
+     * @brief Streams a file from disk through the writer's fixed-size buffer.
+     */
+    bool streamFile(Session& session, const Request& request, const std::string& path, uint64_t size) {
+        std::ifstream f(path, std::ios::binary);
+        if (!f.is_open()) return false;
+        stream::StreamWriter writer = makeStreamWriter(session, request, FLAG_NONE, size);
+        if (!writer.begin()) return false;
+
+        uint8_t buffer[16 * 1024];
+        uint64_t remaining = size;
+        while (remaining > 0) {
+            size_t want = remaining < sizeof(buffer) ? static_cast<size_t>(remaining) : sizeof(buffer);
+            f.read(reinterpret_cast<char*>(buffer), want);
+            if (static_cast<size_t>(f.gcount()) != want) return false;
+            if (!writer.write(buffer, want)) return false;
+            remaining -= want;
+        }
+        bool ok = writer.finish();
+        logReply(session, AuditEvent::SENT_STREAM, request.packet.getCommandID(), Command::ACK, size,
+                 writer.getTotalCrc(), request.received);
+        return ok;
+    }
+
+    /**
+     * @brief Writes one frame, inserting the request ID after the header on version 2 connections.
+     */
+    bool sendFrame(Session& session, uint32_t requestId, const uint8_t* header, const uint8_t* payload, size_t size,
+                   Command request) {
+        uint32_t netId = htonl(requestId);
+        iovec iov[3];
+        int count = 0;
+        iov[count++] = { const_cast<uint8_t*>(header), sizeof(Header) };
+        if (session.options.version >= handshake::kRequestIdVersion) {
+            iov[count++] = { &netId, sizeof(netId) };
+        }
+        if (size > 0) {
+            iov[count++] = { const_cast<uint8_t*>(payload), size };
+        }
+        uint16_t command = static_cast<uint16_t>(header[2] << 8 | header[3]);
+        counters.sent[command == static_cast<uint16_t>(Command::ACK) ? 0
+                      : command == static_cast<uint16_t>(Command::ERROR) ? 1 : 2]->inc();
+        size_t bytes = 0;
+        for (int i = 0; i < count; i++) bytes += iov[i].iov_len;
+        counters.bytesOut->inc(bytes);
+        SteadyTime start = std::chrono::steady_clock::now();
+        std::lock_guard<InstrumentedMutex> lock(session.sendMutex);
+        trace::record("send.lock", start, std::chrono::steady_clock::now());
+        // Under sendMutex so captured frames keep the order they have on the wire.
+        if (session.captured) packetCapture->frame(session.id, PacketCapture::Direction::FROM_SERVER, iov, count);
+        bool sent;
+        {
+            trace::Span span("send");
+            sent = sendVectored(session.fd, iov, count);
+        }
+        latency.since(request, Stage::SEND, start);
+        return sent;
+    }
+
+    bool sendVectored(int fd, iovec* iov, int count) {
+        while (count > 0) {
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            accounting::syscall();
+            ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+            if (sent <= 0) return false;
+            while (count > 0 && static_cast<size_t>(sent) >= iov->iov_len) {
+                sent -= iov->iov_len;
+                iov++;
+                count--;
+            }
+            if (count > 0) {
+                iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + sent;
+                iov->iov_len -= sent;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Sends a packet and, if audit is set, records it as the reply to a request of the given command.
+     */
+    void sendPacket(Session& session, uint32_t requestId, const NetworkPacket& packet, bool audit = true,
+                    Command request = Command::NONE, SteadyTime received = SteadyTime()) {
+        uint32_t crc = session.options.checksum == ChecksumType::CRC32
+            ? packet.getPayloadCrc()
+            : checksum::compute(session.options.checksum, packet.getPayload(), packet.getPayloadSize());
+        uint8_t header[sizeof(Header)];
+        NetworkPacket::encodeHeader(header, packet.getCommandID(), packet.getFlags(), packet.getPayloadSize(), crc);
+        sendFrame(session, requestId, header, packet.getPayload(), packet.getPayloadSize(), request);
+        if (audit) {
+            logReply(session, AuditEvent::SENT, request, packet.getCommandID(), packet.getPayloadSize(),
+                     packet.getPayloadCrc(), received);
+        }
+    }
+
+    void sendReply(Session& session, const Request& request, NetworkPacket packet, bool audit = true) {
+        sendPacket(session, request.id, compressReply(request, std::move(packet)), audit, request.packet.getCommandID(),
+                   request.received);
     }
 
 public:
     /**
      * @brief Constructs the CTF Server and loads database configurations.
      */
-    CTFServer() : listenFd(-1), serverState(ServerState::ONLINE) { loadDbConfig(); }
+    CTFServer() : listenFd(-1), serverState(ServerState::ONLINE), handlers{},
+                  workers(std::max(2u, std::thread::hardware_concurrency())) {
+        loadDbConfig();
+        tracer = std::make_unique<Tracer>(traceConfig);
+        profiler = std::make_unique<CpuProfiler>(profilerConfig);
+        auditLog = std::make_unique<AuditLogger>(auditConfig);
+        if (captureConfig.enabled) packetCapture = std::make_unique<PacketCapture>(captureConfig);
+        openStorage();
+        registerHandlers();
+        registerMetrics();
+        if (metricsConfig.enabled) {
+            try {
+                metricsServer = std::make_unique<MetricsHttpServer>(metricsConfig, [this] { return metrics.render(); });
+                std::cout << "Metrics on http://" << metricsConfig.bind << ":" << metricsServer->port() << "/metrics\n";
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << ", metrics endpoint disabled\n";
+            }
+        }
+        if (traceConfig.enabled) {
+            traceDumper = std::make_unique<TraceDumper>(*tracer);
+            // SA_RESTART keeps the signal from failing blocking recv/send calls with EINTR.
+            struct sigaction action {};
+            action.sa_handler = trace::onDumpSignal;
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_RESTART;
+            sigaction(SIGUSR1, &action, nullptr);
+            std::cout << "Tracing 1 in " << traceConfig.sampleEvery << " requests; kill -USR1 " << getpid()
+                      << " writes a dump to " << traceConfig.dir << "/\n";
+        }
+        if constexpr (accounting::kEnabled) {
+            std::cout << "Accounting build: allocations and syscalls are counted per request (USAGE audit records)\n";
+        }
+    }
 
     /**
      * @brief Starts the server loop, binding to the specified port.
      * 
      * Initializes the socket, listens for incoming TCP connections, and 
      * spins off a detached thread for every accepted client to handle
-     * packet parsing and commands.
+     * packet parsing. Commands marked Dispatch::WORKER in the command
+     * registry are executed on the shared worker pool.
      * 
      * @param port The port number to listen on (e.g., 8080).
      */
@@ -223,12 +1467,15 @@ public:
         std::cout << "Server listening on port " << port << "\n";
         while (true) {
             int client = accept(listenFd, nullptr, nullptr);
-            if (client >= 0)
+            if (client >= 0) {
+                counters.accepted->inc();
                 std::thread(&CTFServer::handleClient, this, client).detach();
+            }
         }
     }
 };
 
+CTF_ACCOUNTING_ALLOCATION_HOOKS()
 
 /**
  * @brief Main entry point for the CTF backend server.
@@ -0,0 +1,307 @@
+/**
+ * @file sketches.h
+ * @brief Fixed-size streaming summaries of login traffic: heavy hitters and distinct counts.
+ */
+
+#ifndef SKETCHES_H
+#define SKETCHES_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "instrumented_mutex.h"
+#include "login_attempt.h"
+
+namespace sketch {
+
+/** @brief splitmix64 finaliser; spreads std::hash output over all 64 bits. */
+inline uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/** @brief 64-bit hash of a string. */
+inline uint64_t hash(const std::string& value) {
+    return mix(std::hash<std::string>()(value));
+}
+
+} // namespace sketch
+
+/**
+ * @brief Count-Min sketch with conservative update.
+ *
+ * Estimates never undercount; with width w and depth d they overcount by
+ * at most e/w of the total with probability 1 - e^-d.
+ */
+class CountMinSketch {
+public:
+    static constexpr size_t kDepth = 4;
+    static constexpr size_t kWidth = 2048;
+
+    CountMinSketch() : counters(kDepth * kWidth, 0) {}
+
+    /**
+     * @brief Counts one occurrence.
+     * @param key Hash of the item.
+     * @return The item's new estimate.
+     */
+    uint64_t add(uint64_t key) {
+        std::array<size_t, kDepth> cells = slots(key);
+        uint64_t estimate = UINT64_MAX;
+        for (size_t cell : cells) estimate = std::min(estimate, counters[cell]);
+        estimate++;
+        // Conservative update: only raise the cells that are below the new estimate.
+        for (size_t cell : cells) counters[cell] = std::max(counters[cell], estimate);
+        return estimate;
+    }
+
+    /** @brief Current estimate for an item (never below its true count). */
+    uint64_t estimate(uint64_t key) const {
+        uint64_t result = UINT64_MAX;
+        for (size_t cell : slots(key)) result = std::min(result, counters[cell]);
+        return result;
+    }
+
+private:
+    std::vector<uint64_t> counters;
+
+    static std::array<size_t, kDepth> slots(uint64_t key) {
+        // Double hashing: row i uses h1 + i * h2.
+        uint64_t h1 = key, h2 = sketch::mix(key) | 1;
+        std::array<size_t, kDepth> cells{};
+        for (size_t i = 0; i < kDepth; i++) cells[i] = i * kWidth + static_cast<size_t>((h1 + i * h2) % kWidth);
+        return cells;
+    }
+};
+
+/**
+ * @brief One item reported by a heavy-hitter summary.
+ */
+struct HeavyHitter {
+    std::string value;
+
+    /** @brief Estimated occurrences; an upper bound. */
+    uint64_t count;
+
+    /** @brief Largest possible overestimate included in count. */
+    uint64_t error;
+};
+
+/**
+ * @brief Space-Saving top-K summary with O(1) updates (stream-summary layout).
+ *
+ * Keeps exactly `capacity` counters. Counters sit in buckets of equal count,
+ * and buckets are ordered by count, so an increment moves a counter to the
+ * neighbouring bucket and the smallest counter is always at the front. A new
+ * item replaces the smallest counter and inherits its count as error. Any
+ * item occurring more than total / capacity times is guaranteed to be kept.
+ *
+ * A Count-Min sketch alongside tightens the reported counts: an item that
+ * inherited a large error gets min(Space-Saving count, Count-Min estimate).
+ */
+class TopK {
+public:
+    /** @param capacity Counters kept; reported items are the top ones among these. */
+    explicit TopK(size_t capacity) : capacity(capacity == 0 ? 1 : capacity) {
+        index.reserve(this->capacity);
+    }
+
+    /** @brief Counts one occurrence of an item. */
+    void add(const std::string& value) {
+        uint64_t key = sketch::hash(value);
+        cms.add(key);
+        auto it = index.find(value);
+        if (it != index.end()) {
+            increment(it->second);
+            return;
+        }
+        if (index.size() < capacity) {
+            if (buckets.empty() || buckets.front().count != 1) buckets.push_front(Bucket{ 1, {} });
+            Bucket& first = buckets.front();
+            first.entries.push_back(Entry{ value, 0, buckets.begin() });
+            index.emplace(value, std::prev(first.entries.end()));
+            return;
+        }
+        // Evict one of the smallest counters and reuse it for the new item.
+        Bucket& smallest = buckets.front();
+        EntryIt victim = smallest.entries.begin();
+        index.erase(victim->value);
+        victim->value = value;
+        victim->error = smallest.count;
+        index.emplace(value, victim);
+        increment(victim);
+    }
+
+    /**
+     * @brief Lists the most frequent items.
+     * @param n Maximum number of items.
+     * @return Items in descending order of count.
+     */
+    std::vector<HeavyHitter> top(size_t n) const {
+        std::vector<HeavyHitter> result;
+        for (auto bucket = buckets.rbegin(); bucket != buckets.rend(); ++bucket) {
+            for (const Entry& entry : bucket->entries) {
+                uint64_t count = std::min(bucket->count, cms.estimate(sketch::hash(entry.value)));
+                uint64_t floor = bucket->count - entry.error;
+                result.push_back(HeavyHitter{ entry.value, count, count - std::min(count, floor) });
+            }
+            // Later buckets hold smaller counts; stop once none of them can displace the n-th item.
+            auto next = std::next(bucket);
+            if (n > 0 && result.size() >= n && next != buckets.rend() && next->count <= nthCount(result, n)) break;
+        }
+        std::stable_sort(result.begin(), result.end(),
+                         [](const HeavyHitter& a, const HeavyHitter& b) { return a.count > b.count; });
+        if (result.size() > n) result.resize(n);
+        return result;
+    }
+
+private:
+    struct Bucket;
+    using BucketIt = std::list<Bucket>::iterator;
+
+    struct Entry {
+        std::string value;
+        uint64_t error;
+        BucketIt bucket;
+    };
+    using EntryIt = std::list<Entry>::iterator;
+
+    struct Bucket {
+        uint64_t count;
+        std::list<Entry> entries;
+    };
+
+    size_t capacity;
+    std::list<Bucket> buckets;
+    std::unordered_map<std::string, EntryIt> index;
+    CountMinSketch cms;
+
+    static uint64_t nthCount(const std::vector<HeavyHitter>& items, size_t n) {
+        std::vector<uint64_t> counts;
+        counts.reserve(items.size());
+        for (const HeavyHitter& item : items) counts.push_back(item.count);
+        std::nth_element(counts.begin(), counts.begin() + (n - 1), counts.end(), std::greater<uint64_t>());
+        return counts[n - 1];
+    }
+
+    void increment(EntryIt entry) {
+        BucketIt from = entry->bucket;
+        BucketIt to = std::next(from);
+        if (to == buckets.end() || to->count != from->count + 1) to = buckets.insert(to, Bucket{ from->count + 1, {} });
+        to->entries.splice(to->entries.end(), from->entries, entry);
+        entry->bucket = to;
+        if (from->entries.empty()) buckets.erase(from);
+    }
+};
+
+/**
+ * @brief HyperLogLog distinct counter.
+ *
+ * 2^kPrecision one-byte registers (4 KiB), standard error about 1.6%.
+ */
+class HyperLogLog {
+public:
+    static constexpr unsigned kPrecision = 12;
+    static constexpr size_t kRegisters = size_t(1) << kPrecision;
+
+    HyperLogLog() : registers(kRegisters, 0) {}
+
+    /** @brief Adds an item by its 64-bit hash. */
+    void add(uint64_t key) {
+        size_t slot = static_cast<size_t>(key >> (64 - kPrecision));
+        uint64_t rest = key << kPrecision;
+        uint8_t rank = rest == 0 ? static_cast<uint8_t>(64 - kPrecision + 1)
+                                 : static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+        if (rank > registers[slot]) registers[slot] = rank;
+    }
+
+    /** @brief Estimated number of distinct items added. */
+    uint64_t estimate() const {
+        double sum = 0;
+        size_t zeros = 0;
+        for (uint8_t r : registers) {
+            sum += std::ldexp(1.0, -r);
+            if (r == 0) zeros++;
+        }
+        const double m = static_cast<double>(kRegisters);
+        const double alpha = 0.7213 / (1.0 + 1.079 / m);
+        double raw = alpha * m * m / sum;
+        // Small cardinalities: linear counting on empty registers is far more accurate.
+        if (raw <= 2.5 * m && zeros > 0) raw = m * std::log(m / static_cast<double>(zeros));
+        return static_cast<uint64_t>(std::llround(raw));
+    }
+
+private:
+    std::vector<uint8_t> registers;
+};
+
+/**
+ * @brief Snapshot of the login sketches, as reported by STATS.
+ */
+struct LoginSketchReport {
+    uint64_t logins;
+    uint64_t uniqueIps;
+    uint64_t uniqueCredentials;
+    std::vector<HeavyHitter> usernames;
+    std::vector<HeavyHitter> passwords;
+    std::vector<HeavyHitter> ips;
+};
+
+/**
+ * @brief Every sketch kept over LOGIN traffic, updated in O(1) per attempt.
+ *
+ * Memory is fixed at a few hundred KiB regardless of traffic, so
+ * dashboards can ask the server for top usernames, passwords and source
+ * addresses instead of running GROUP BY over login_attempts.
+ */
+class LoginSketches {
+public:
+    /** @param capacity Counters kept per top-K summary. */
+    explicit LoginSketches(size_t capacity = 256)
+        : logins(0), usernames(capacity), passwords(capacity), ips(capacity) {}
+
+    /** @brief Records one attempt. */
+    void record(const LoginAttempt& attempt) {
+        uint64_t credential = sketch::mix(sketch::hash(attempt.username) ^ (sketch::hash(attempt.password) * 31));
+        std::lock_guard<InstrumentedMutex> lock(mutex);
+        logins++;
+        usernames.add(attempt.username);
+        passwords.add(attempt.password);
+        ips.add(attempt.ip);
+        uniqueIps.add(sketch::hash(attempt.ip));
+        uniqueCredentials.add(credential);
+    }
+
+    /**
+     * @brief Takes a snapshot.
+     * @param n Items per top list.
+     */
+    LoginSketchReport report(size_t n) const {
+        std::lock_guard<InstrumentedMutex> lock(mutex);
+        return LoginSketchReport{ logins, uniqueIps.estimate(), uniqueCredentials.estimate(),
+                                  usernames.top(n), passwords.top(n), ips.top(n) };
+    }
+
+private:
+    /** @brief Taken by every LOGIN, so it is instrumented. */
+    mutable InstrumentedMutex mutex{ locks::site("login_sketches") };
+    uint64_t logins;
+    TopK usernames;
+    TopK passwords;
+    TopK ips;
+    HyperLogLog uniqueIps;
+    HyperLogLog uniqueCredentials;
+};
+
+#endif // SKETCHES_H
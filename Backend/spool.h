@@ -0,0 +1,395 @@
+/**
+ * @file spool.h
+ * @brief Append-only, checksummed local file holding login attempts the database could not take.
+ *
+ * File layout (all integers big-endian):
+ *
+ *   | magic "CTFSPOOL" (8) | replay offset (8) |                    file header
+ *   | size (4) | CRC32C of body (4) | body (size) |   ...            records
+ *
+ * A body is three length-prefixed strings: | len (2) | username | len (2) | password | len (2) | ip |.
+ * The replay offset marks how far the file has been written to the database.
+ * Records before it are skipped when the server restarts.
+ */
+
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "checksum.h"
+#include "login_attempt.h"
+#include "stream.h"
+
+/**
+ * @brief Tuning knobs for LoginSpool, read from the "spool" block of db_config.json.
+ */
+struct SpoolConfig {
+    /** @brief Spool file location; empty disables the spool. */
+    std::string path = "login_spool.bin";
+
+    /** @brief Appends are made durable together at most this often (group commit). */
+    std::chrono::milliseconds commitInterval{ 1000 };
+
+    /** @brief Buffered bytes that force a write before the commit interval. */
+    size_t maxBuffered = 256 * 1024;
+
+    /** @brief Attempts per replayed batch. */
+    size_t replayBatch = 1000;
+};
+
+/**
+ * @brief Counters describing the spool.
+ */
+struct SpoolStats {
+    /** @brief Attempts in the spool that have not been replayed yet. */
+    uint64_t depth;
+
+    /** @brief Bytes of unreplayed records. */
+    uint64_t bytes;
+
+    /** @brief Attempts appended since startup. */
+    uint64_t spooled;
+
+    /** @brief Attempts replayed into the database since startup. */
+    uint64_t replayed;
+
+    /** @brief Attempts per second during the most recent replay. */
+    double replayRate;
+
+    /** @brief Bytes discarded at startup because a record was torn or corrupt. */
+    uint64_t discarded;
+};
+
+namespace spool {
+
+constexpr char kMagic[8] = { 'C', 'T', 'F', 'S', 'P', 'O', 'O', 'L' };
+constexpr size_t kFileHeaderSize = 16;
+constexpr size_t kRecordHeaderSize = 8;
+
+/** @brief Largest encoded record: the header plus three fields of up to 65535 bytes each. */
+constexpr size_t kMaxRecordSize = kRecordHeaderSize + 3 * (2 + 0xFFFF);
+
+/** @brief Bytes read at a time when scanning the spool on open; holds at least one whole record. */
+constexpr size_t kRecoverChunk = 256 * 1024;
+static_assert(kRecoverChunk >= kMaxRecordSize, "a record must fit in one recovery chunk");
+
+/** @brief Bytes a replay read holds beyond 1 KiB per batched record; the first record always fits whole. */
+constexpr size_t kReplaySlack = 256 * 1024;
+static_assert(kReplaySlack >= kMaxRecordSize, "a record must fit in one replay read");
+
+/**
+ * @brief Appends one encoded record to a buffer.
+ * @param attempt The attempt to encode; fields longer than 65535 bytes are truncated.
+ * @param out Destination buffer.
+ */
+inline void encodeRecord(const LoginAttempt& attempt, std::vector<uint8_t>& out) {
+    size_t start = out.size();
+    out.resize(start + kRecordHeaderSize);
+    for (const std::string* field : { &attempt.username, &attempt.password, &attempt.ip }) {
+        uint16_t len = static_cast<uint16_t>(field->size() > 0xFFFF ? 0xFFFF : field->size());
+        uint16_t netLen = htons(len);
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&netLen);
+        out.insert(out.end(), p, p + sizeof(netLen));
+        out.insert(out.end(), field->begin(), field->begin() + len);
+    }
+    uint32_t size = static_cast<uint32_t>(out.size() - start - kRecordHeaderSize);
+    uint32_t netSize = htonl(size);
+    uint32_t netCrc = htonl(checksum::updateCrc32c(0, out.data() + start + kRecordHeaderSize, size));
+    std::memcpy(out.data() + start, &netSize, 4);
+    std::memcpy(out.data() + start + 4, &netCrc, 4);
+}
+
+/**
+ * @brief Decodes one record from the front of a buffer.
+ * @param data Buffer positioned at a record header.
+ * @param length Bytes available.
+ * @param attempt Receives the decoded attempt.
+ * @return Bytes consumed, or 0 if the record is incomplete or fails its checksum.
+ */
+inline size_t decodeRecord(const uint8_t* data, size_t length, LoginAttempt& attempt) {
+    if (length < kRecordHeaderSize) return 0;
+    uint32_t netSize, netCrc;
+    std::memcpy(&netSize, data, 4);
+    std::memcpy(&netCrc, data + 4, 4);
+    size_t size = ntohl(netSize);
+    if (size > length - kRecordHeaderSize) return 0;
+    const uint8_t* body = data + kRecordHeaderSize;
+    if (checksum::updateCrc32c(0, body, size) != ntohl(netCrc)) return 0;
+
+    size_t offset = 0;
+    for (std::string* field : { &attempt.username, &attempt.password, &attempt.ip }) {
+        if (size - offset < 2) return 0;
+        uint16_t netLen;
+        std::memcpy(&netLen, body + offset, 2);
+        size_t len = ntohs(netLen);
+        offset += 2;
+        if (size - offset < len) return 0;
+        field->assign(reinterpret_cast<const char*>(body + offset), len);
+        offset += len;
+    }
+    return offset == size ? kRecordHeaderSize + size : 0;
+}
+
+} // namespace spool
+
+/**
+ * @brief Durable overflow for login attempts.
+ *
+ * append() only copies the record into memory, so it is safe to call from
+ * a request thread. sync() writes everything buffered with one write() and
+ * one fdatasync(), at most once per commit interval unless maxBuffered bytes
+ * are waiting, so a burst of failures costs one flash write instead of one
+ * per attempt. A crash can lose at most the last commit interval of appends.
+ *
+ * replay() hands committed records to a sink in batches and advances the
+ * stored replay offset after each accepted batch. Once everything is
+ * replayed the file is truncated back to its header. A crash between a
+ * committed batch and the offset update replays that batch again, so
+ * delivery is at-least-once.
+ */
+class LoginSpool {
+public:
+    /** @brief Stores one batch; returns false to stop replaying (e.g. the database is down again). */
+    using Sink = std::function<bool(const std::vector<LoginAttempt>&)>;
+
+    /**
+     * @brief Opens or creates the spool and recovers its state.
+     *
+     * Records after the last intact one (a torn write from a crash) are cut off.
+     *
+     * @param config File path and commit settings.
+     * @throw std::runtime_error If the file cannot be opened or is not a spool.
+     */
+    explicit LoginSpool(SpoolConfig config)
+        : config(std::move(config)), writeOffset(spool::kFileHeaderSize), replayOffset(spool::kFileHeaderSize),
+          depth(0), spooled(0), replayed(0), replayRate(0), discarded(0), lastSync(Clock::now()) {
+        fd = open(this->config.path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0) throw std::runtime_error("Cannot open spool " + this->config.path);
+        try {
+            recover();
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+    }
+
+    ~LoginSpool() {
+        sync(true);
+        close(fd);
+    }
+
+    LoginSpool(const LoginSpool&) = delete;
+    LoginSpool& operator=(const LoginSpool&) = delete;
+
+    /**
+     * @brief Buffers attempts for the next group commit; never writes to the file.
+     * @param attempts The attempts to spool.
+     * @return True once maxBuffered bytes are waiting, so the caller should get sync() called soon.
+     */
+    bool append(const std::vector<LoginAttempt>& attempts) {
+        std::lock_guard<std::mutex> lock(spoolMutex);
+        for (const LoginAttempt& attempt : attempts) spool::encodeRecord(attempt, buffer);
+        depth += attempts.size();
+        spooled += attempts.size();
+        return buffer.size() >= config.maxBuffered;
+    }
+
+    /** @brief Buffers one attempt for the next group commit. */
+    bool append(const LoginAttempt& attempt) {
+        std::lock_guard<std::mutex> lock(spoolMutex);
+        spool::encodeRecord(attempt, buffer);
+        depth++;
+        spooled++;
+        return buffer.size() >= config.maxBuffered;
+    }
+
+    /**
+     * @brief Writes and fsyncs buffered records if the commit interval has passed or maxBuffered bytes are waiting.
+     * @param force Commit now regardless of the interval.
+     * @return False if the write failed; the records stay buffered.
+     */
+    bool sync(bool force = false) {
+        std::lock_guard<std::mutex> lock(spoolMutex);
+        return syncLocked(force);
+    }
+
+    /**
+     * @brief Checks whether there is anything to replay.
+     * @return True if committed or buffered records are waiting.
+     */
+    bool pending() const {
+        std::lock_guard<std::mutex> lock(spoolMutex);
+        return depth > 0;
+    }
+
+    /**
+     * @brief Moves spooled attempts into the database.
+     * @param sink Stores one batch.
+     * @param maxBatches Upper bound on batches per call, so live traffic is not starved.
+     * @return Attempts replayed.
+     */
+    size_t replay(const Sink& sink, size_t maxBatches) {
+        Clock::time_point start = Clock::now();
+        size_t total = 0;
+        std::vector<LoginAttempt> batch;
+        std::vector<uint8_t> data;
+        for (size_t n = 0; n < maxBatches; n++) {
+            uint64_t from, to;
+            {
+                std::lock_guard<std::mutex> lock(spoolMutex);
+                // Only committed records are replayed; fresh appends wait for their group commit.
+                if (!syncLocked(false)) break;
+                from = replayOffset;
+                to = writeOffset;
+            }
+            if (from == to) break;
+
+            size_t consumed = readBatch(from, to, batch, data);
+            if (batch.empty() || !sink(batch)) break;
+
+            std::lock_guard<std::mutex> lock(spoolMutex);
+            replayOffset = from + consumed;
+            depth -= batch.size();
+            replayed += batch.size();
+            total += batch.size();
+            if (replayOffset == writeOffset && buffer.empty()) {
+                // Everything is in the database: start over instead of growing the file forever.
+                if (ftruncate(fd, spool::kFileHeaderSize) == 0) {
+                    writeOffset = replayOffset = spool::kFileHeaderSize;
+                }
+            }
+            writeHeader();
+        }
+        if (total > 0) {
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            std::lock_guard<std::mutex> lock(spoolMutex);
+            replayRate = seconds > 0 ? total / seconds : 0;
+        }
+        return total;
+    }
+
+    /**
+     * @brief Retrieves the spool counters.
+     * @return A snapshot of the counters.
+     */
+    SpoolStats stats() const {
+        std::lock_guard<std::mutex> lock(spoolMutex);
+        return SpoolStats{ depth, writeOffset - replayOffset + buffer.size(), spooled, replayed, replayRate, discarded };
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    SpoolConfig config;
+    int fd;
+    mutable std::mutex spoolMutex;
+    std::vector<uint8_t> buffer;
+    uint64_t writeOffset;
+    uint64_t replayOffset;
+    uint64_t depth;
+    uint64_t spooled;
+    uint64_t replayed;
+    double replayRate;
+    uint64_t discarded;
+    Clock::time_point lastSync;
+
+    void recover() {
+        off_t size = lseek(fd, 0, SEEK_END);
+        if (size < static_cast<off_t>(spool::kFileHeaderSize)) {
+            writeHeader();
+            return;
+        }
+        uint8_t header[spool::kFileHeaderSize];
+        if (pread(fd, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+            std::memcmp(header, spool::kMagic, sizeof(spool::kMagic)) != 0) {
+            throw std::runtime_error("Not a spool file: " + config.path);
+        }
+        uint64_t stored = stream::readU64(header + sizeof(spool::kMagic));
+        replayOffset = stored < spool::kFileHeaderSize || stored > static_cast<uint64_t>(size)
+            ? spool::kFileHeaderSize : stored;
+
+        // Walk the unreplayed records a chunk at a time to count them and find where intact data ends.
+        // A record cut by the end of a chunk is decoded again at the start of the next one.
+        std::vector<uint8_t> data(spool::kRecoverChunk);
+        uint64_t offset = replayOffset;
+        LoginAttempt attempt;
+        while (offset < static_cast<uint64_t>(size)) {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(static_cast<uint64_t>(size) - offset, data.size()));
+            if (pread(fd, data.data(), want, static_cast<off_t>(offset)) != static_cast<ssize_t>(want)) {
+                throw std::runtime_error("Cannot read spool " + config.path);
+            }
+            size_t used = 0;
+            while (size_t record = spool::decodeRecord(data.data() + used, want - used, attempt)) {
+                used += record;
+                depth++;
+            }
+            if (used == 0) break;
+            offset += used;
+        }
+        writeOffset = offset;
+        if (writeOffset < static_cast<uint64_t>(size)) {
+            discarded = static_cast<uint64_t>(size) - writeOffset;
+            if (ftruncate(fd, static_cast<off_t>(writeOffset)) != 0) {
+                throw std::runtime_error("Cannot truncate spool " + config.path);
+            }
+        }
+    }
+
+    bool syncLocked(bool force) {
+        if (buffer.empty()) return true;
+        Clock::time_point now = Clock::now();
+        if (!force && buffer.size() < config.maxBuffered && now - lastSync < config.commitInterval) return true;
+        size_t done = 0;
+        while (done < buffer.size()) {
+            ssize_t n = pwrite(fd, buffer.data() + done, buffer.size() - done, static_cast<off_t>(writeOffset + done));
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                return false;
+            }
+            done += static_cast<size_t>(n);
+        }
+        if (fdatasync(fd) != 0) return false;
+        writeOffset += buffer.size();
+        buffer.clear();
+        lastSync = now;
+        return true;
+    }
+
+    void writeHeader() {
+        uint8_t header[spool::kFileHeaderSize];
+        std::memcpy(header, spool::kMagic, sizeof(spool::kMagic));
+        stream::writeU64(header + sizeof(spool::kMagic), replayOffset);
+        if (pwrite(fd, header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header))) fdatasync(fd);
+    }
+
+    size_t readBatch(uint64_t from, uint64_t to, std::vector<LoginAttempt>& batch, std::vector<uint8_t>& data) {
+        batch.clear();
+        // Records are small; a bounded read per batch keeps memory flat for large spools.
+        size_t want =
+            static_cast<size_t>(std::min<uint64_t>(to - from, config.replayBatch * 1024 + spool::kReplaySlack));
+        data.resize(want);
+        if (pread(fd, data.data(), want, static_cast<off_t>(from)) != static_cast<ssize_t>(want)) return 0;
+        size_t offset = 0;
+        LoginAttempt attempt;
+        while (batch.size() < config.replayBatch) {
+            size_t used = spool::decodeRecord(data.data() + offset, want - offset, attempt);
+            if (used == 0) break;
+            batch.push_back(attempt);
+            offset += used;
+        }
+        return offset;
+    }
+};
+
+#endif // SPOOL_H
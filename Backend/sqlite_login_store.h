@@ -0,0 +1,210 @@
+/**
+ * @file sqlite_login_store.h
+ * @brief Stores login attempts in an embedded SQLite database.
+ */
+
+#ifndef SQLITE_LOGIN_STORE_H
+#define SQLITE_LOGIN_STORE_H
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+#include "login_store.h"
+
+/**
+ * @brief Settings of the SQLite backend, read from the "storage.sqlite" block of db_config.json.
+ */
+struct SqliteConfig {
+    /** @brief Database file; created with its schema if missing. */
+    std::string path = "ctf_logins.db";
+
+    /**
+     * @brief PRAGMA synchronous level. "NORMAL" only fsyncs at WAL checkpoints,
+     *        so a power cut can lose the last few commits but never corrupts the file.
+     */
+    std::string synchronous = "NORMAL";
+
+    /** @brief How long a write waits for a reader (e.g. an admin query) holding the lock. */
+    std::chrono::milliseconds busyTimeout{ 5000 };
+};
+
+/**
+ * @brief LoginStore backed by a local SQLite file in WAL mode.
+ *
+ * Meant for standalone deployments where running PostgreSQL costs more than
+ * the game server can spare. Each batch is one transaction around a
+ * prepared INSERT, so a batch costs one WAL append instead of one journal
+ * sync per row. The tables mirror ctf.login_attempts and
+ * ctf.login_credentials, with addresses stored as text and timestamps as
+ * ISO 8601 UTC (so MIN/MAX order them correctly).
+ */
+class SqliteLoginStore : public LoginStore {
+public:
+    /**
+     * @brief Opens (or creates) the database and prepares its statements.
+     * @param config File location and durability settings.
+     * @throw std::runtime_error If the database cannot be opened or initialised.
+     */
+    explicit SqliteLoginStore(const SqliteConfig& config) : db(nullptr), insertStmt(nullptr), upsertStmt(nullptr) {
+        if (sqlite3_open_v2(config.path.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX,
+                            nullptr) != SQLITE_OK) {
+            std::string error = db ? sqlite3_errmsg(db) : "out of memory";
+            sqlite3_close(db);
+            throw std::runtime_error("Cannot open SQLite database " + config.path + ": " + error);
+        }
+        sqlite3_busy_timeout(db, static_cast<int>(config.busyTimeout.count()));
+        try {
+            exec("PRAGMA journal_mode=WAL");
+            exec("PRAGMA synchronous=" + config.synchronous);
+            exec("CREATE TABLE IF NOT EXISTS login_attempts ("
+                 "id INTEGER PRIMARY KEY, "
+                 "username TEXT NOT NULL, "
+                 "password TEXT NOT NULL, "
+                 "ip_address TEXT, "
+                 "attempted_at TEXT NOT NULL DEFAULT (strftime('%Y-%m-%dT%H:%M:%fZ', 'now')))");
+            exec("CREATE TABLE IF NOT EXISTS login_credentials ("
+                 "username TEXT NOT NULL, "
+                 "password TEXT NOT NULL, "
+                 "ip_address TEXT NOT NULL, "
+                 "attempts INTEGER NOT NULL, "
+                 "first_seen TEXT NOT NULL, "
+                 "last_seen TEXT NOT NULL, "
+                 "PRIMARY KEY (username, password, ip_address))");
+            prepare("INSERT INTO login_attempts (username, password, ip_address) VALUES (?, ?, ?)", insertStmt);
+            prepare("INSERT INTO login_credentials AS c (username, password, ip_address, attempts, first_seen, last_seen) "
+                    "VALUES (?, ?, ?, ?, ?, ?) ON CONFLICT (username, password, ip_address) DO UPDATE SET "
+                    "attempts = c.attempts + excluded.attempts, first_seen = MIN(c.first_seen, excluded.first_seen), "
+                    "last_seen = MAX(c.last_seen, excluded.last_seen)", upsertStmt);
+        } catch (...) {
+            sqlite3_finalize(insertStmt);
+            sqlite3_finalize(upsertStmt);
+            sqlite3_close(db);
+            throw;
+        }
+    }
+
+    ~SqliteLoginStore() override {
+        sqlite3_finalize(insertStmt);
+        sqlite3_finalize(upsertStmt);
+        sqlite3_close(db);
+    }
+
+    SqliteLoginStore(const SqliteLoginStore&) = delete;
+    SqliteLoginStore& operator=(const SqliteLoginStore&) = delete;
+
+    bool store(const std::vector<LoginAttempt>& batch, size_t& rejected) override {
+        rejected = 0;
+        if (batch.empty()) return true;
+        if (!run("BEGIN IMMEDIATE")) return false;
+        for (const LoginAttempt& attempt : batch) {
+            sqlite3_bind_text(insertStmt, 1, attempt.username.data(), static_cast<int>(attempt.username.size()),
+                              SQLITE_STATIC);
+            sqlite3_bind_text(insertStmt, 2, attempt.password.data(), static_cast<int>(attempt.password.size()),
+                              SQLITE_STATIC);
+            if (attempt.ip.empty()) {
+                sqlite3_bind_null(insertStmt, 3);
+            } else {
+                sqlite3_bind_text(insertStmt, 3, attempt.ip.data(), static_cast<int>(attempt.ip.size()), SQLITE_STATIC);
+            }
+            int rc = sqlite3_step(insertStmt);
+            sqlite3_reset(insertStmt);
+            if (rc == SQLITE_DONE) continue;
+            if ((rc & 0xFF) == SQLITE_CONSTRAINT) {
+                rejected++;
+                continue;
+            }
+            // Disk full, I/O error, lock timeout: give the whole batch back to the caller.
+            std::cerr << "SQLite insert error: " << sqlite3_errmsg(db) << "\n";
+            run("ROLLBACK");
+            return false;
+        }
+        sqlite3_clear_bindings(insertStmt);
+        if (!run("COMMIT")) {
+            run("ROLLBACK");
+            return false;
+        }
+        return true;
+    }
+
+    size_t storeCounts(const std::vector<CredentialCount>& counts, std::vector<CredentialCount>& retry) override {
+        if (counts.empty()) return 0;
+        if (!run("BEGIN IMMEDIATE")) {
+            retry.insert(retry.end(), counts.begin(), counts.end());
+            return 0;
+        }
+        size_t upserted = 0;
+        for (const CredentialCount& count : counts) {
+            const LoginAttempt& credential = count.credential;
+            std::string firstSeen = isoTime(count.firstSeen), lastSeen = isoTime(count.lastSeen);
+            sqlite3_bind_text(upsertStmt, 1, credential.username.data(), static_cast<int>(credential.username.size()),
+                              SQLITE_STATIC);
+            sqlite3_bind_text(upsertStmt, 2, credential.password.data(), static_cast<int>(credential.password.size()),
+                              SQLITE_STATIC);
+            sqlite3_bind_text(upsertStmt, 3, credential.ip.data(), static_cast<int>(credential.ip.size()), SQLITE_STATIC);
+            sqlite3_bind_int64(upsertStmt, 4, static_cast<sqlite3_int64>(count.attempts));
+            sqlite3_bind_text(upsertStmt, 5, firstSeen.data(), static_cast<int>(firstSeen.size()), SQLITE_STATIC);
+            sqlite3_bind_text(upsertStmt, 6, lastSeen.data(), static_cast<int>(lastSeen.size()), SQLITE_STATIC);
+            int rc = sqlite3_step(upsertStmt);
+            sqlite3_reset(upsertStmt);
+            if (rc == SQLITE_DONE) {
+                upserted++;
+            } else if ((rc & 0xFF) != SQLITE_CONSTRAINT) {
+                std::cerr << "SQLite upsert error: " << sqlite3_errmsg(db) << "\n";
+                run("ROLLBACK");
+                retry.insert(retry.end(), counts.begin(), counts.end());
+                return 0;
+            }
+        }
+        sqlite3_clear_bindings(upsertStmt);
+        if (!run("COMMIT")) {
+            run("ROLLBACK");
+            retry.insert(retry.end(), counts.begin(), counts.end());
+            return 0;
+        }
+        return upserted;
+    }
+
+    const char* name() const override { return "sqlite"; }
+
+private:
+    sqlite3* db;
+    sqlite3_stmt* insertStmt;
+    sqlite3_stmt* upsertStmt;
+
+    /** @brief Formats a time as YYYY-MM-DDTHH:MM:SS.mmmZ, matching the attempted_at default. */
+    static std::string isoTime(std::chrono::system_clock::time_point time) {
+        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count();
+        std::time_t seconds = static_cast<std::time_t>(millis / 1000);
+        std::tm utc{};
+        gmtime_r(&seconds, &utc);
+        char buf[40];
+        size_t length = std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &utc);
+        std::snprintf(buf + length, sizeof(buf) - length, ".%03dZ", static_cast<int>(millis % 1000));
+        return buf;
+    }
+
+    void prepare(const char* sql, sqlite3_stmt*& stmt) {
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+            throw std::runtime_error(std::string("SQLite prepare failed: ") + sqlite3_errmsg(db));
+        }
+    }
+
+    bool run(const char* sql) {
+        char* error = nullptr;
+        if (sqlite3_exec(db, sql, nullptr, nullptr, &error) == SQLITE_OK) return true;
+        std::cerr << "SQLite error (" << sql << "): " << (error ? error : "unknown") << "\n";
+        sqlite3_free(error);
+        return false;
+    }
+
+    void exec(const std::string& sql) {
+        if (!run(sql.c_str())) throw std::runtime_error("SQLite initialisation failed: " + sql);
+    }
+};
+
+#endif // SQLITE_LOGIN_STORE_H
@@ -0,0 +1,200 @@
+/**
+ * @file statements.h
+ * @brief Registry of every SQL statement the server runs, prepared once per connection.
+ */
+
+#ifndef STATEMENTS_H
+#define STATEMENTS_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <libpq-fe.h>
+#include "pg_binary.h"
+
+/** @brief Type OIDs of the parameter types the statements use (from pg_type.h). */
+namespace pgtype {
+constexpr Oid kInt8 = 20;
+constexpr Oid kText = 25;
+constexpr Oid kInet = 869;
+constexpr Oid kTimestamptz = 1184;
+}
+
+/**
+ * @brief Statements known to the server. Code refers to these instead of SQL text.
+ */
+enum class Statement : uint8_t {
+    INSERT_LOGIN_ATTEMPT, /**< (username text, password text, ip_address inet) */
+    UPSERT_CREDENTIAL,    /**< (username text, password text, ip_address inet, attempts int8,
+                               first_seen timestamptz, last_seen timestamptz) */
+    COUNT
+};
+
+/**
+ * @brief Name, SQL and parameter types of one statement.
+ */
+struct StatementInfo {
+    Statement statement;
+
+    /** @brief Server-side name passed to PQprepare. */
+    const char* name;
+
+    const char* sql;
+
+    int paramCount;
+
+    /** @brief Parameter type OIDs; binary parameters need exact types. */
+    std::array<Oid, 6> paramTypes;
+
+    /** @brief Uses a table that only exists when its feature is set up; failing to prepare it is not fatal. */
+    bool optional;
+};
+
+/**
+ * @brief Every statement, indexed by its Statement value.
+ */
+constexpr std::array<StatementInfo, static_cast<size_t>(Statement::COUNT)> kStatements = {{
+    { Statement::INSERT_LOGIN_ATTEMPT, "ctf_insert_login_attempt",
+      "INSERT INTO ctf.login_attempts (username, password, ip_address) VALUES ($1, $2, $3)",
+      3, { pgtype::kText, pgtype::kText, pgtype::kInet, 0, 0, 0 }, false },
+    { Statement::UPSERT_CREDENTIAL, "ctf_upsert_credential",
+      "INSERT INTO ctf.login_credentials AS c (username, password, ip_address, attempts, first_seen, last_seen) "
+      "VALUES ($1, $2, $3, $4, $5, $6) ON CONFLICT (username, password, ip_address) DO UPDATE SET "
+      "attempts = c.attempts + EXCLUDED.attempts, first_seen = LEAST(c.first_seen, EXCLUDED.first_seen), "
+      "last_seen = GREATEST(c.last_seen, EXCLUDED.last_seen)",
+      6, { pgtype::kText, pgtype::kText, pgtype::kInet, pgtype::kInt8, pgtype::kTimestamptz, pgtype::kTimestamptz }, true },
+}};
+
+namespace detail {
+constexpr bool statementTableIsOrdered() {
+    for (size_t i = 0; i < kStatements.size(); i++) {
+        if (static_cast<size_t>(kStatements[i].statement) != i) return false;
+    }
+    return true;
+}
+}
+
+static_assert(detail::statementTableIsOrdered(), "kStatements must list statements in enum order");
+
+/**
+ * @brief Binary-format parameters for one execution of a prepared statement.
+ *
+ * Values are copied into an internal buffer, so the builder may outlive the
+ * strings passed to it.
+ */
+class StatementParams {
+public:
+    /** @brief Adds a text parameter (text is its own binary format). */
+    StatementParams& text(const std::string& value) {
+        return add(reinterpret_cast<const uint8_t*>(value.data()), value.size());
+    }
+
+    /** @brief Adds an inet parameter, or NULL if the address does not parse. */
+    StatementParams& inet(const std::string& ip) {
+        uint8_t encoded[pgbinary::kMaxInetSize];
+        size_t size = pgbinary::encodeInet(ip, encoded);
+        if (size == 0) return null();
+        return add(encoded, size);
+    }
+
+    /** @brief Adds an int8 parameter. */
+    StatementParams& int8(int64_t value) {
+        uint8_t encoded[8];
+        pgbinary::encodeInt64(value, encoded);
+        return add(encoded, sizeof(encoded));
+    }
+
+    /** @brief Adds a timestamptz parameter. */
+    StatementParams& timestamptz(std::chrono::system_clock::time_point time) {
+        return int8(pgbinary::timestamptzValue(time));
+    }
+
+    /** @brief Adds a NULL parameter. */
+    StatementParams& null() {
+        offsets.push_back(kNull);
+        lengths.push_back(0);
+        return *this;
+    }
+
+    /** @brief Number of parameters added so far. */
+    int count() const { return static_cast<int>(offsets.size()); }
+
+    /**
+     * @brief Runs a prepared statement with these parameters.
+     * @param conn A connection on which prepareStatements() succeeded.
+     * @param statement The statement to execute.
+     * @return The result, which the caller must PQclear.
+     */
+    PGresult* execute(PGconn* conn, Statement statement) const {
+        std::vector<const char*> values = pointers();
+        std::vector<int> formats(offsets.size(), 1);
+        return PQexecPrepared(conn, nameOf(statement), count(), values.data(), lengths.data(), formats.data(), 0);
+    }
+
+    /**
+     * @brief Queues a prepared statement without waiting for its result.
+     * @param conn A connection on which prepareStatements() succeeded.
+     * @param statement The statement to execute.
+     * @return False if libpq could not queue the query.
+     */
+    bool send(PGconn* conn, Statement statement) const {
+        std::vector<const char*> values = pointers();
+        std::vector<int> formats(offsets.size(), 1);
+        return PQsendQueryPrepared(conn, nameOf(statement), count(), values.data(), lengths.data(),
+                                   formats.data(), 0) == 1;
+    }
+
+private:
+    static constexpr size_t kNull = static_cast<size_t>(-1);
+
+    std::vector<uint8_t> buffer;
+    std::vector<size_t> offsets;
+    std::vector<int> lengths;
+
+    static const char* nameOf(Statement statement) {
+        return kStatements[static_cast<size_t>(statement)].name;
+    }
+
+    std::vector<const char*> pointers() const {
+        std::vector<const char*> values(offsets.size());
+        for (size_t i = 0; i < offsets.size(); i++) {
+            values[i] = offsets[i] == kNull ? nullptr : reinterpret_cast<const char*>(buffer.data() + offsets[i]);
+        }
+        return values;
+    }
+
+    StatementParams& add(const uint8_t* data, size_t size) {
+        offsets.push_back(buffer.size());
+        lengths.push_back(static_cast<int>(size));
+        buffer.insert(buffer.end(), data, data + size);
+        return *this;
+    }
+};
+
+/**
+ * @brief Prepares every registered statement on a fresh connection.
+ *
+ * Prepared statements live only as long as the session, so this must run
+ * again after every connect or PQreset.
+ *
+ * @param conn The connection.
+ * @return False if any statement that is not optional failed to prepare.
+ */
+inline bool prepareStatements(PGconn* conn) {
+    for (const StatementInfo& info : kStatements) {
+        PGresult* res = PQprepare(conn, info.name, info.sql, info.paramCount, info.paramTypes.data());
+        bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+        PQclear(res);
+        if (!ok) {
+            std::cerr << "Prepare error (" << info.name << "): " << PQerrorMessage(conn) << "\n";
+            if (!info.optional) return false;
+        }
+    }
+    return true;
+}
+
+#endif // STATEMENTS_H
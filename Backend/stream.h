@@ -0,0 +1,273 @@
+/**
+ * @file stream.h
+ * @brief Chunked transfer framing for payloads too large to send as one packet.
+ *
+ * A stream is a sequence of ordinary packets sharing one command:
+ *
+ *   START (FLAG_STREAM_START) - payload: 8-byte big-endian total size
+ *   DATA  (FLAG_STREAM_DATA)  - payload: next chunk (at most the chunk size), header CRC covers the chunk
+ *   END   (FLAG_STREAM_END)   - payload: 4-byte checksum of all data, 8-byte total size
+ *
+ * Other flags set on START (e.g. FLAG_COMPRESSED) describe the reassembled data.
+ * Frame and total checksums use the connection's negotiated ChecksumType.
+ * Both ends work through a single fixed-size buffer, so memory use per
+ * connection does not depend on the size of the transfer.
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+#include "checksum.h"
+#include "packet.h"
+
+namespace stream {
+
+/** @brief Chunk size used unless the connection negotiated another one. */
+constexpr uint32_t kDefaultChunkSize = 16 * 1024;
+
+/** @brief Largest chunk either side will accept in a DATA frame. */
+constexpr uint32_t kMaxChunkSize = 256 * 1024;
+
+/** @brief Payload size of a START frame. */
+constexpr uint32_t kStartPayloadSize = 8;
+
+/** @brief Payload size of an END frame. */
+constexpr uint32_t kEndPayloadSize = 12;
+
+inline void writeU64(uint8_t* out, uint64_t value) {
+    uint32_t high = htonl(static_cast<uint32_t>(value >> 32));
+    uint32_t low = htonl(static_cast<uint32_t>(value));
+    std::memcpy(out, &high, 4);
+    std::memcpy(out + 4, &low, 4);
+}
+
+inline uint64_t readU64(const uint8_t* in) {
+    uint32_t high, low;
+    std::memcpy(&high, in, 4);
+    std::memcpy(&low, in + 4, 4);
+    return (static_cast<uint64_t>(ntohl(high)) << 32) | ntohl(low);
+}
+
+/**
+ * @brief Sends data as a chunked stream through one fixed-size frame buffer.
+ *
+ * Call begin(), then write() any number of times, then finish(). The total
+ * size must be known up front so the receiver can reject oversized streams
+ * before any data arrives.
+ */
+class StreamWriter {
+public:
+    /** @brief Receives each encoded frame; returns false if the connection failed. */
+    using Sink = std::function<bool(const uint8_t*, size_t)>;
+
+    /**
+     * @brief Prepares a stream and allocates its frame buffer.
+     * @param cmd The command carried by every frame.
+     * @param flags Flags describing the reassembled data (e.g. FLAG_COMPRESSED).
+     * @param totalSize Exact number of data bytes that will be written.
+     * @param chunkSize Largest DATA payload, clamped to [1, kMaxChunkSize].
+     * @param sink Destination for encoded frames.
+     * @param checksumType Algorithm for frame and total checksums.
+     */
+    StreamWriter(Command cmd, uint16_t flags, uint64_t totalSize, uint32_t chunkSize, Sink sink,
+                 ChecksumType checksumType = ChecksumType::CRC32)
+        : cmd(cmd), flags(flags), totalSize(totalSize), written(0), totalCRC(0), fill(0),
+          chunkSize(chunkSize == 0 ? 1 : (chunkSize > kMaxChunkSize ? kMaxChunkSize : chunkSize)),
+          checksumType(checksumType), frame(sizeof(Header) + this->chunkSize), sink(std::move(sink)) {}
+
+    /**
+     * @brief Sends the START frame.
+     * @return False if the sink failed.
+     */
+    bool begin() {
+        uint8_t payload[kStartPayloadSize];
+        writeU64(payload, totalSize);
+        return emit(static_cast<uint16_t>(flags | FLAG_STREAM_START), payload, sizeof(payload));
+    }
+
+    /**
+     * @brief Appends data, sending a DATA frame each time the buffer fills.
+     * @param data Pointer to the bytes.
+     * @param length The number of bytes.
+     * @return False if the sink failed or more than totalSize bytes were written.
+     */
+    bool write(const uint8_t* data, size_t length) {
+        if (written + length > totalSize) return false;
+        written += length;
+        totalCRC = checksum::update(checksumType, totalCRC, data, length);
+        while (length > 0) {
+            size_t take = chunkSize - fill;
+            if (take > length) take = length;
+            std::memcpy(frame.data() + sizeof(Header) + fill, data, take);
+            fill += take;
+            data += take;
+            length -= take;
+            if (fill == chunkSize && !flushChunk()) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Flushes the final partial chunk and sends the END frame.
+     * @return False if the sink failed or fewer than totalSize bytes were written.
+     */
+    bool finish() {
+        if (written != totalSize) return false;
+        if (fill > 0 && !flushChunk()) return false;
+        uint8_t payload[kEndPayloadSize];
+        uint32_t netCRC = htonl(totalCRC);
+        std::memcpy(payload, &netCRC, 4);
+        writeU64(payload + 4, totalSize);
+        return emit(static_cast<uint16_t>(flags | FLAG_STREAM_END), payload, sizeof(payload));
+    }
+
+    /**
+     * @brief Retrieves the checksum of the data written so far.
+     * @return The running checksum.
+     */
+    uint32_t getTotalCrc() const {
+        return totalCRC;
+    }
+
+private:
+    Command cmd;
+    uint16_t flags;
+    uint64_t totalSize;
+    uint64_t written;
+    uint32_t totalCRC;
+    uint32_t fill;
+    uint32_t chunkSize;
+    ChecksumType checksumType;
+    std::vector<uint8_t> frame;
+    Sink sink;
+
+    bool flushChunk() {
+        uint8_t* chunk = frame.data() + sizeof(Header);
+        NetworkPacket::encodeHeader(frame.data(), cmd, static_cast<uint16_t>(flags | FLAG_STREAM_DATA), fill,
+                                    checksum::compute(checksumType, chunk, fill));
+        bool ok = sink(frame.data(), sizeof(Header) + fill);
+        fill = 0;
+        return ok;
+    }
+
+    bool emit(uint16_t frameFlags, const uint8_t* payload, uint32_t size) {
+        uint8_t buffer[sizeof(Header) + kEndPayloadSize];
+        NetworkPacket::encodeHeader(buffer, cmd, frameFlags, size, checksum::compute(checksumType, payload, size));
+        std::memcpy(buffer + sizeof(Header), payload, size);
+        return sink(buffer, sizeof(Header) + size);
+    }
+};
+
+/**
+ * @brief Validates an incoming chunked stream frame by frame.
+ *
+ * The reader never buffers data itself: each verified chunk is handed to the
+ * sink, so the caller decides whether to write it to disk, hash it, or
+ * reassemble it. Every violation throws std::runtime_error, matching
+ * NetworkPacket::deserialize.
+ */
+class StreamReader {
+public:
+    /** @brief Receives each verified chunk of data. */
+    using Sink = std::function<void(const uint8_t*, size_t)>;
+
+    /**
+     * @brief Creates a reader that enforces the given limits.
+     * @param maxTotal Largest total size accepted in the START frame.
+     * @param maxChunk Largest DATA payload accepted.
+     * @param sink Destination for verified data.
+     * @param checksumType Algorithm the sender used for frame and total checksums.
+     */
+    StreamReader(uint64_t maxTotal, uint32_t maxChunk, Sink sink, ChecksumType checksumType = ChecksumType::CRC32)
+        : maxTotal(maxTotal), maxChunk(maxChunk), totalSize(0), received(0), totalCRC(0),
+          started(false), finished(false), checksumType(checksumType), sink(std::move(sink)) {}
+
+    /**
+     * @brief Checks a frame's declared size before its payload is read.
+     * @param header The decoded frame header.
+     * @param flags The frame's flags.
+     * @throw std::runtime_error If the frame is out of order or too large.
+     */
+    void checkHeader(const Header& header, uint16_t flags) const {
+        if (flags & FLAG_STREAM_START) {
+            if (started) throw std::runtime_error("Duplicate stream start");
+            if (header.payloadSize != kStartPayloadSize) throw std::runtime_error("Malformed stream start");
+        } else if (flags & FLAG_STREAM_DATA) {
+            if (!started || finished) throw std::runtime_error("Stream data outside stream");
+            if (header.payloadSize > maxChunk) throw std::runtime_error("Stream chunk too large");
+            if (received + header.payloadSize > totalSize) throw std::runtime_error("Stream exceeds declared size");
+        } else if (flags & FLAG_STREAM_END) {
+            if (!started || finished) throw std::runtime_error("Stream end outside stream");
+            if (header.payloadSize != kEndPayloadSize) throw std::runtime_error("Malformed stream end");
+        } else {
+            throw std::runtime_error("Not a stream frame");
+        }
+    }
+
+    /**
+     * @brief Consumes one frame whose header passed checkHeader().
+     * @param header The decoded frame header.
+     * @param flags The frame's flags.
+     * @param payload The frame payload (header.payloadSize bytes).
+     * @throw std::runtime_error If a checksum or size does not match.
+     */
+    void accept(const Header& header, uint16_t flags, const uint8_t* payload) {
+        checkHeader(header, flags);
+        if (checksum::compute(checksumType, payload, header.payloadSize) != header.payloadCRC) {
+            throw std::runtime_error("Stream frame CRC mismatch");
+        }
+        if (flags & FLAG_STREAM_START) {
+            totalSize = readU64(payload);
+            if (totalSize > maxTotal) throw std::runtime_error("Stream too large");
+            started = true;
+        } else if (flags & FLAG_STREAM_DATA) {
+            received += header.payloadSize;
+            totalCRC = checksum::update(checksumType, totalCRC, payload, header.payloadSize);
+            sink(payload, header.payloadSize);
+        } else {
+            uint32_t netCRC;
+            std::memcpy(&netCRC, payload, 4);
+            if (readU64(payload + 4) != totalSize || received != totalSize) {
+                throw std::runtime_error("Stream size mismatch");
+            }
+            if (ntohl(netCRC) != totalCRC) throw std::runtime_error("Stream CRC mismatch");
+            finished = true;
+        }
+    }
+
+    /**
+     * @brief Checks whether the END frame has been verified.
+     * @return True once the whole stream arrived intact.
+     */
+    bool isComplete() const {
+        return finished;
+    }
+
+    /**
+     * @brief Retrieves the total size declared by the START frame.
+     * @return The size in bytes.
+     */
+    uint64_t getTotalSize() const {
+        return totalSize;
+    }
+
+private:
+    uint64_t maxTotal;
+    uint32_t maxChunk;
+    uint64_t totalSize;
+    uint64_t received;
+    uint32_t totalCRC;
+    bool started;
+    bool finished;
+    ChecksumType checksumType;
+    Sink sink;
+};
+
+} // namespace stream
+
+#endif // STREAM_H
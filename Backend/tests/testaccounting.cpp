@@ -0,0 +1,94 @@
+// Backend/tests/testaccounting.cpp
+// Always built in accounting mode: the hooks below replace this binary's allocator.
+#ifndef CTF_ACCOUNTING
+#define CTF_ACCOUNTING
+#endif
+#include <gtest/gtest.h>
+#include <new>
+#include <thread>
+#include "../accounting.h"
+
+CTF_ACCOUNTING_ALLOCATION_HOOKS()
+
+// Test that allocations inside a scope are charged with their size, and frees are not
+TEST(AccountingTest, ChargesAllocationsInScope) {
+    accounting::Usage usage;
+    {
+        accounting::Scope counted(&usage);
+        void* small = ::operator new(24);
+        void* aligned = ::operator new(256, std::align_val_t{ 128 });
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned) % 128, 0u);
+        ::operator delete(small);
+        ::operator delete(aligned, std::align_val_t{ 128 });
+    }
+    EXPECT_EQ(usage.allocations.load(), 2u);
+    EXPECT_EQ(usage.bytes.load(), 280u);
+    EXPECT_EQ(usage.syscalls.load(), 0u);
+}
+
+// Test that nothing is charged outside a scope
+TEST(AccountingTest, IgnoresWorkOutsideScope) {
+    accounting::Usage usage;
+    {
+        accounting::Scope counted(&usage);
+    }
+    ::operator delete(::operator new(64));
+    accounting::syscall();
+    EXPECT_EQ(accounting::current(), nullptr);
+    EXPECT_EQ(usage.allocations.load(), 0u);
+    EXPECT_EQ(usage.syscalls.load(), 0u);
+}
+
+// Test that nested scopes charge the innermost one and restore the outer one
+TEST(AccountingTest, NestedScopesChargeInnermost) {
+    accounting::Usage outer, inner;
+    {
+        accounting::Scope outerScope(&outer);
+        accounting::syscall();
+        {
+            accounting::Scope innerScope(&inner);
+            accounting::syscall();
+            accounting::syscall();
+            ::operator delete(::operator new(8));
+        }
+        ::operator delete(::operator new(8));
+    }
+    EXPECT_EQ(outer.syscalls.load(), 1u);
+    EXPECT_EQ(outer.allocations.load(), 1u);
+    EXPECT_EQ(inner.syscalls.load(), 2u);
+    EXPECT_EQ(inner.allocations.load(), 1u);
+}
+
+// Test that usage carried to another thread continues from the snapshot
+TEST(AccountingTest, CarriesUsageAcrossThreads) {
+    accounting::Usage usage;
+    accounting::Scope counted(&usage);
+    accounting::syscall();
+    std::thread worker([carried = accounting::carry()]() mutable {
+        EXPECT_EQ(accounting::current(), nullptr);
+        accounting::Scope workerScope(&carried);
+        accounting::syscall();
+        EXPECT_EQ(carried.syscalls.load(), 2u);
+    });
+    worker.join();
+    EXPECT_EQ(usage.syscalls.load(), 1u);
+}
+
+// Test that per-command totals add up each reply's usage
+TEST(AccountingTest, SumsUsagePerCommand) {
+    accounting::CommandUsage totals;
+    accounting::Usage usage;
+    usage.allocations = 3;
+    usage.bytes = 100;
+    usage.syscalls = 2;
+    totals.add(Command::LOGIN, usage);
+    totals.add(Command::LOGIN, usage);
+    totals.add(static_cast<Command>(999), usage);
+    size_t login = RequestLatency::slot(Command::LOGIN);
+    EXPECT_EQ(totals.requests(login), 2u);
+    EXPECT_EQ(totals.allocations(login), 6u);
+    EXPECT_EQ(totals.bytes(login), 200u);
+    EXPECT_EQ(totals.syscalls(login), 4u);
+    EXPECT_EQ(totals.requests(RequestLatency::kSlots - 1), 1u);
+    EXPECT_EQ(totals.requests(RequestLatency::slot(Command::STATS)), 0u);
+}
@@ -0,0 +1,297 @@
+// Backend/tests/testauditlog.cpp
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "../audit_log.h"
+
+namespace {
+
+/** @brief A directory of the running test's own, so tests run in parallel processes never share segments. */
+std::string testDir() {
+    const ::testing::TestInfo* test = ::testing::UnitTest::GetInstance()->current_test_info();
+    return ::testing::TempDir() + "audit_" + test->name() + "_" + std::to_string(getpid());
+}
+
+void clearDir() {
+    for (const auto& segment : audit::listSegments(testDir())) std::remove(segment.second.c_str());
+    rmdir(testDir().c_str());
+}
+
+AuditConfig makeConfig(size_t ringCapacity) {
+    AuditConfig config;
+    config.dir = testDir();
+    config.ringCapacity = ringCapacity;
+    config.flushInterval = std::chrono::milliseconds(5);
+    config.preallocate = 64 * 1024;
+    config.compress = false;
+    return config;
+}
+
+AuditRecord packet(AuditEvent event, uint32_t command, uint64_t size) {
+    AuditRecord record{};
+    record.event = event;
+    record.command = command;
+    record.packet.size = size;
+    record.packet.crc = 0xabc;
+    record.connection = 7;
+    record.peer = audit::parsePeer("10.0.0.1");
+    return record;
+}
+
+/** @brief Waits up to a second for the maintenance thread to get a counter to a value. */
+template <typename F>
+bool waitFor(F&& done) {
+    for (int i = 0; i < 200 && !done(); i++) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    return done();
+}
+
+uint64_t totalSize() {
+    uint64_t total = 0;
+    for (const auto& segment : audit::listSegments(testDir())) {
+        std::ifstream f(segment.second, std::ios::binary | std::ios::ate);
+        total += static_cast<uint64_t>(f.tellg());
+    }
+    return total;
+}
+
+std::vector<AuditRecord> readAll() {
+    std::vector<AuditRecord> records;
+    for (const auto& segment : audit::listSegments(testDir())) {
+        audit::MappedSegment mapped(segment.second);
+        records.insert(records.end(), mapped.begin(), mapped.end());
+    }
+    return records;
+}
+
+} // namespace
+
+// Test that records format as readable lines
+TEST(AuditLogTest, FormatsLines) {
+    std::string out;
+    AuditRecord received = packet(AuditEvent::RECEIVED, 100, 11);
+    received.timestamp = 1760000000123456789ull;
+    audit::format(received, out);
+    AuditRecord sent = packet(AuditEvent::SENT, 100, 16);
+    sent.timestamp = received.timestamp;
+    sent.result = 200;
+    sent.packet.latency = 42;
+    audit::format(sent, out);
+    AuditRecord batch = packet(AuditEvent::BATCH, 105, 0);
+    batch.timestamp = received.timestamp;
+    batch.batch.size = 40;
+    batch.batch.crc = 0xdef;
+    batch.batch.latency = 7;
+    batch.batch.replySize = 60;
+    batch.batch.entries = 3;
+    batch.batch.failures = 1;
+    audit::format(batch, out);
+    AuditRecord usage = packet(AuditEvent::USAGE, 100, 0);
+    usage.timestamp = received.timestamp;
+    usage.usage.allocatedBytes = 512;
+    usage.usage.allocations = 4;
+    usage.usage.syscalls = 3;
+    audit::format(usage, out);
+    EXPECT_EQ(out, "2025-10-09T08:53:20.123456Z conn=7 peer=10.0.0.1 [RECEIVED] Cmd:100 Size:11 CRC:0xabc\n"
+                   "2025-10-09T08:53:20.123456Z conn=7 peer=10.0.0.1 [SENT] Cmd:100 Size:16 CRC:0xabc Result:200 "
+                   "Latency:42us\n"
+                   "2025-10-09T08:53:20.123456Z conn=7 peer=10.0.0.1 [BATCH] Cmd:105 Count:3 OK:2 ERR:1 Size:40 "
+                   "CRC:0xdef ReplySize:60 Latency:7us\n"
+                   "2025-10-09T08:53:20.123456Z conn=7 peer=10.0.0.1 [USAGE] Cmd:100 Allocs:4 AllocBytes:512 "
+                   "Syscalls:3\n");
+}
+
+// Test that IPv4 and IPv6 peers survive the 16-byte encoding
+TEST(AuditLogTest, PeerRoundTrip) {
+    EXPECT_EQ(audit::peerString(audit::parsePeer("192.168.1.20")), "192.168.1.20");
+    EXPECT_EQ(audit::peerString(audit::parsePeer("2001:db8::1")), "2001:db8::1");
+    EXPECT_EQ(audit::parsePeer("unknown"), (std::array<uint8_t, 16>{}));
+}
+
+// Test that records from many threads all reach the segments intact and timestamped
+TEST(AuditLogTest, WritesEveryThreadsRecords) {
+    clearDir();
+    AuditStats stats;
+    {
+        AuditLogger logger(makeConfig(1024));
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < 4; t++) {
+            threads.emplace_back([&logger, t] {
+                for (int i = 0; i < 500; i++) {
+                    while (!logger.log(packet(AuditEvent::SENT, 200 + t, i))) std::this_thread::yield();
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        stats = logger.stats();
+    }
+    std::vector<AuditRecord> records = readAll();
+    ASSERT_EQ(records.size(), 2000u);
+    size_t perThread[4] = {};
+    for (const AuditRecord& r : records) {
+        ASSERT_GE(r.command, 200u);
+        ASSERT_LT(r.command, 204u);
+        EXPECT_EQ(r.packet.size, perThread[r.command - 200]++);
+        EXPECT_GT(r.timestamp, 0u);
+        EXPECT_EQ(r.connection, 7u);
+    }
+    EXPECT_EQ(stats.logged, 2000u);
+    clearDir();
+}
+
+// Test that a full ring drops records, counts them and stores the gap as a DROPPED record
+TEST(AuditLogTest, DropsWhenRingIsFull) {
+    clearDir();
+    AuditStats stats;
+    {
+        AuditConfig config = makeConfig(4);
+        config.flushInterval = std::chrono::hours(1);
+        AuditLogger logger(config);
+        size_t accepted = 0;
+        for (int i = 0; i < 10; i++) accepted += logger.log(packet(AuditEvent::RECEIVED, 100, i));
+        EXPECT_EQ(accepted, 4u);
+        stats = logger.stats();
+    }
+    EXPECT_EQ(stats.logged, 4u);
+    EXPECT_EQ(stats.dropped, 6u);
+    std::vector<AuditRecord> records = readAll();
+    ASSERT_EQ(records.size(), 5u);
+    EXPECT_EQ(records.back().event, AuditEvent::DROPPED);
+    EXPECT_EQ(records.back().dropped.records, 6u);
+    clearDir();
+}
+
+// Test that full segments roll over and a restart continues the numbering
+TEST(AuditLogTest, RollsSegments) {
+    clearDir();
+    AuditConfig config = makeConfig(64);
+    config.segmentBytes = sizeof(audit::SegmentHeader) + 10 * sizeof(AuditRecord);
+    {
+        AuditLogger logger(config);
+        for (int i = 0; i < 25; i++) logger.log(packet(AuditEvent::RECEIVED, 100, i));
+    }
+    auto segments = audit::listSegments(testDir());
+    ASSERT_EQ(segments.size(), 3u);
+    uint64_t previous = 0;
+    for (size_t i = 0; i < segments.size(); i++) {
+        audit::MappedSegment mapped(segments[i].second);
+        EXPECT_EQ(mapped.header().sequence, segments[i].first);
+        EXPECT_GE(mapped.header().created, previous);
+        previous = mapped.header().created;
+        EXPECT_EQ(mapped.size(), i < 2 ? 10u : 5u);
+    }
+    {
+        AuditLogger logger(config);
+        logger.log(packet(AuditEvent::RECEIVED, 100, 99));
+    }
+    segments = audit::listSegments(testDir());
+    ASSERT_EQ(segments.size(), 4u);
+    EXPECT_EQ(segments.back().first, segments[2].first + 1);
+    EXPECT_EQ(readAll().size(), 26u);
+    clearDir();
+}
+
+// Test that preallocation keeps the visible size exact and a torn tail record is ignored
+TEST(AuditLogTest, PreallocationAndTornTail) {
+    clearDir();
+    {
+        AuditLogger logger(makeConfig(16));
+        logger.log(packet(AuditEvent::RECEIVED, 100, 1));
+    }
+    auto segments = audit::listSegments(testDir());
+    ASSERT_EQ(segments.size(), 1u);
+    {
+        std::ifstream f(segments[0].second, std::ios::binary | std::ios::ate);
+        EXPECT_EQ(static_cast<size_t>(f.tellg()), sizeof(audit::SegmentHeader) + sizeof(AuditRecord));
+    }
+    {
+        std::ofstream f(segments[0].second, std::ios::binary | std::ios::app);
+        f.write("partial", 7);
+    }
+    audit::MappedSegment mapped(segments[0].second);
+    ASSERT_EQ(mapped.size(), 1u);
+    EXPECT_EQ(mapped.begin()->packet.size, 1u);
+    clearDir();
+}
+
+// Test that a segment holding records is closed once rotateInterval passes, without opening an empty one
+TEST(AuditLogTest, RotatesByAge) {
+    clearDir();
+    AuditConfig config = makeConfig(16);
+    config.rotateInterval = std::chrono::milliseconds(20);
+    {
+        AuditLogger logger(config);
+        logger.log(packet(AuditEvent::RECEIVED, 100, 1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        EXPECT_EQ(audit::listSegments(testDir()).size(), 1u);
+        logger.log(packet(AuditEvent::RECEIVED, 100, 2));
+    }
+    auto segments = audit::listSegments(testDir());
+    ASSERT_EQ(segments.size(), 2u);
+    audit::MappedSegment second(segments[1].second);
+    ASSERT_EQ(second.size(), 1u);
+    EXPECT_EQ(second.begin()->packet.size, 2u);
+    clearDir();
+}
+
+// Test that closed segments are gzipped, read back transparently, and that the open one is left alone
+TEST(AuditLogTest, CompressesClosedSegments) {
+    clearDir();
+    AuditConfig config = makeConfig(64);
+    config.segmentBytes = sizeof(audit::SegmentHeader) + 10 * sizeof(AuditRecord);
+    config.compress = true;
+    {
+        AuditLogger logger(config);
+        for (int i = 0; i < 25; i++) logger.log(packet(AuditEvent::RECEIVED, 100, i));
+        EXPECT_TRUE(waitFor([&logger] { return logger.stats().compressed == 2; }));
+    }
+    auto segments = audit::listSegments(testDir());
+    ASSERT_EQ(segments.size(), 3u);
+    EXPECT_TRUE(audit::isCompressed(segments[0].second));
+    EXPECT_TRUE(audit::isCompressed(segments[1].second));
+    EXPECT_FALSE(audit::isCompressed(segments[2].second));
+    audit::SegmentHeader header;
+    ASSERT_TRUE(audit::readHeader(segments[1].second, header));
+    EXPECT_EQ(header.sequence, segments[1].first);
+    std::vector<AuditRecord> records = readAll();
+    ASSERT_EQ(records.size(), 25u);
+    for (size_t i = 0; i < records.size(); i++) EXPECT_EQ(records[i].packet.size, i);
+
+    // A restart compresses the segment the previous run left open.
+    {
+        AuditLogger logger(config);
+        EXPECT_TRUE(waitFor([&logger] { return logger.stats().compressed == 1; }));
+    }
+    segments = audit::listSegments(testDir());
+    ASSERT_EQ(segments.size(), 4u);
+    EXPECT_TRUE(audit::isCompressed(segments[2].second));
+    EXPECT_EQ(readAll().size(), 25u);
+    clearDir();
+}
+
+// Test that the oldest closed segments are deleted to stay within the disk budget
+TEST(AuditLogTest, EnforcesDiskBudget) {
+    clearDir();
+    AuditConfig config = makeConfig(128);
+    uint64_t segmentSize = sizeof(audit::SegmentHeader) + 10 * sizeof(AuditRecord);
+    config.segmentBytes = segmentSize;
+    config.diskBudget = 3 * segmentSize;
+    {
+        AuditLogger logger(config);
+        for (int i = 0; i < 60; i++) logger.log(packet(AuditEvent::RECEIVED, 100, i));
+        EXPECT_TRUE(waitFor([&logger] { return logger.stats().deleted == 3; }));
+    }
+    EXPECT_LE(totalSize(), config.diskBudget);
+    auto segments = audit::listSegments(testDir());
+    ASSERT_EQ(segments.size(), 3u);
+    EXPECT_EQ(segments.back().first - segments.front().first, 2u);
+    std::vector<AuditRecord> records = readAll();
+    ASSERT_EQ(records.size(), 30u);
+    EXPECT_EQ(records.front().packet.size, 30u);
+    EXPECT_EQ(records.back().packet.size, 59u);
+    clearDir();
+}
@@ -0,0 +1,79 @@
+// Backend/tests/testbatch.cpp
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include "../batch.h"
+
+static NetworkPacket makePacket(Command cmd, const std::string& payload) {
+    NetworkPacket packet(cmd, payload.size());
+    if (!payload.empty()) {
+        packet.writePayload(reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+    }
+    return packet;
+}
+
+// Test that appended packets split back into the same headers and payloads
+TEST(BatchTest, AppendSplitRoundTrip) {
+    std::vector<uint8_t> payload;
+    batch::append(payload, makePacket(Command::LOGIN, "user:pass"));
+    batch::append(payload, makePacket(Command::TOGGLE_MAINTENANCE, ""));
+
+    std::vector<batch::Entry> entries = batch::split(payload.data(), payload.size());
+    ASSERT_EQ(entries.size(), 2u);
+    EXPECT_EQ(entries[0].header.commandID, Command::LOGIN);
+    EXPECT_EQ(entries[0].header.payloadSize, 9u);
+    EXPECT_EQ(std::memcmp(entries[0].payload, "user:pass", 9), 0);
+    EXPECT_EQ(entries[0].header.payloadCRC, NetworkPacket::checksum(entries[0].payload, 9));
+    EXPECT_EQ(entries[1].header.commandID, Command::TOGGLE_MAINTENANCE);
+    EXPECT_EQ(entries[1].header.payloadSize, 0u);
+}
+
+// Test that sub-headers carry the connection's negotiated checksum
+TEST(BatchTest, AppendUsesNegotiatedChecksum) {
+    std::vector<uint8_t> payload;
+    batch::append(payload, makePacket(Command::ACK, "hello"), ChecksumType::CRC32C);
+
+    std::vector<batch::Entry> entries = batch::split(payload.data(), payload.size());
+    ASSERT_EQ(entries.size(), 1u);
+    EXPECT_EQ(entries[0].header.payloadCRC,
+              checksum::compute(ChecksumType::CRC32C, reinterpret_cast<const uint8_t*>("hello"), 5));
+}
+
+// Test that an empty batch is rejected
+TEST(BatchTest, SplitRejectsEmptyBatch) {
+    EXPECT_THROW(batch::split(nullptr, 0), std::runtime_error);
+}
+
+// Test that a truncated length prefix is rejected
+TEST(BatchTest, SplitRejectsTruncatedPrefix) {
+    std::vector<uint8_t> payload;
+    batch::append(payload, makePacket(Command::LOGIN, "a:b"));
+    payload.push_back(0);
+    EXPECT_THROW(batch::split(payload.data(), payload.size()), std::runtime_error);
+}
+
+// Test that an entry longer than the remaining payload is rejected
+TEST(BatchTest, SplitRejectsOverlongEntry) {
+    std::vector<uint8_t> payload;
+    batch::append(payload, makePacket(Command::LOGIN, "a:b"));
+    payload.pop_back();
+    EXPECT_THROW(batch::split(payload.data(), payload.size()), std::runtime_error);
+}
+
+// Test that a sub-header whose size disagrees with its length prefix is rejected
+TEST(BatchTest, SplitRejectsHeaderSizeMismatch) {
+    std::vector<uint8_t> payload;
+    batch::append(payload, makePacket(Command::LOGIN, "a:b"));
+    uint32_t wrongSize = htonl(2);
+    std::memcpy(payload.data() + batch::kPrefixSize + 4, &wrongSize, 4);
+    EXPECT_THROW(batch::split(payload.data(), payload.size()), std::runtime_error);
+}
+
+// Test that batches beyond kMaxEntries are rejected
+TEST(BatchTest, SplitRejectsTooManyEntries) {
+    std::vector<uint8_t> payload;
+    for (size_t i = 0; i <= batch::kMaxEntries; i++) {
+        batch::append(payload, makePacket(Command::SET_ONLINE, ""));
+    }
+    EXPECT_THROW(batch::split(payload.data(), payload.size()), std::runtime_error);
+}
@@ -0,0 +1,60 @@
+// Backend/tests/testboundedqueue.cpp
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include "../bounded_queue.h"
+
+// Test that capacity is rounded up to a power of two
+TEST(BoundedQueueTest, CapacityRoundsUp) {
+    BoundedQueue<int> queue(100);
+    EXPECT_EQ(queue.capacity(), 128u);
+}
+
+// Test that elements come out in FIFO order
+TEST(BoundedQueueTest, PreservesOrder) {
+    BoundedQueue<int> queue(8);
+    for (int i = 0; i < 5; i++) EXPECT_TRUE(queue.tryPush(int(i)));
+    EXPECT_EQ(queue.size(), 5u);
+    for (int i = 0; i < 5; i++) {
+        std::optional<int> value = queue.tryPop();
+        ASSERT_TRUE(value.has_value());
+        EXPECT_EQ(*value, i);
+    }
+    EXPECT_FALSE(queue.tryPop().has_value());
+}
+
+// Test that a full queue rejects pushes until an element is popped
+TEST(BoundedQueueTest, RejectsWhenFull) {
+    BoundedQueue<int> queue(4);
+    for (int i = 0; i < 4; i++) EXPECT_TRUE(queue.tryPush(int(i)));
+    EXPECT_FALSE(queue.tryPush(99));
+    EXPECT_TRUE(queue.tryPop().has_value());
+    EXPECT_TRUE(queue.tryPush(99));
+}
+
+// Test that concurrent producers lose and duplicate nothing
+TEST(BoundedQueueTest, ConcurrentProducers) {
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 10000;
+    BoundedQueue<int> queue(1024);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < kThreads; t++) {
+        producers.emplace_back([&queue, t] {
+            for (int i = 0; i < kPerThread; i++) {
+                int value = t * kPerThread + i;
+                while (!queue.tryPush(std::move(value))) std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<int> seen(kThreads * kPerThread, 0);
+    int received = 0;
+    while (received < kThreads * kPerThread) {
+        std::optional<int> value = queue.tryPop();
+        if (!value) continue;
+        seen[*value]++;
+        received++;
+    }
+    for (auto& t : producers) t.join();
+    for (int count : seen) EXPECT_EQ(count, 1);
+}
@@ -0,0 +1,279 @@
+// Backend/tests/testcapture.cpp
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "../capture.h"
+
+namespace {
+
+/** @brief A directory of the running test's own, so tests run in parallel processes never share files. */
+std::string testDir() {
+    const ::testing::TestInfo* test = ::testing::UnitTest::GetInstance()->current_test_info();
+    return ::testing::TempDir() + "capture_" + test->name() + "_" + std::to_string(getpid());
+}
+
+void clearDir() {
+    for (const auto& file : capture::listFiles(testDir())) std::remove(file.second.c_str());
+    rmdir(testDir().c_str());
+}
+
+CaptureConfig makeConfig() {
+    CaptureConfig config;
+    config.enabled = true;
+    config.dir = testDir();
+    return config;
+}
+
+struct Packet {
+    uint64_t timestamp;
+    uint32_t originalLength;
+    std::vector<uint8_t> data;
+
+    uint16_t get16(size_t offset) const { return static_cast<uint16_t>(data[offset] << 8 | data[offset + 1]); }
+    uint32_t get32(size_t offset) const {
+        return static_cast<uint32_t>(get16(offset)) << 16 | get16(offset + 2);
+    }
+    uint16_t srcPort() const { return get16(20); }
+    uint32_t seq() const { return get32(24); }
+    uint32_t ack() const { return get32(28); }
+    uint8_t flags() const { return data[33]; }
+    std::string payload() const { return std::string(data.begin() + 40, data.end()); }
+};
+
+struct File {
+    uint32_t linkType = 0;
+    uint32_t snaplen = 0;
+    std::vector<Packet> packets;
+};
+
+/** @brief The 32-bit word at offset; 0, and a test failure, if the file is too short. */
+uint32_t word(const std::vector<uint8_t>& bytes, size_t offset) {
+    if (offset > bytes.size() || bytes.size() - offset < 4) {
+        ADD_FAILURE() << "read of 4 bytes at " << offset << " past the end of a " << bytes.size() << "-byte file";
+        return 0;
+    }
+    uint32_t value;
+    std::memcpy(&value, bytes.data() + offset, 4);
+    return value;
+}
+
+/** @brief Parses a capture file, checking the block framing on the way. */
+File readFile(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    File file;
+    EXPECT_GE(bytes.size(), 28u);
+    EXPECT_EQ(word(bytes, 0), capture::kSectionHeader);
+    EXPECT_EQ(word(bytes, 8), 0x1A2B3C4Du);
+    size_t offset = 0;
+    while (offset + 12 <= bytes.size()) {
+        uint32_t type = word(bytes, offset);
+        uint32_t length = word(bytes, offset + 4);
+        EXPECT_EQ(length % 4, 0u);
+        EXPECT_GE(length, 12u);
+        EXPECT_LE(offset + length, bytes.size());
+        if (length < 12 || offset + length > bytes.size()) break;
+        EXPECT_EQ(word(bytes, offset + length - 4), length);
+        if (type == capture::kInterfaceDescription) {
+            file.linkType = word(bytes, offset + 8) & 0xFFFF;
+            file.snaplen = word(bytes, offset + 12);
+            EXPECT_EQ(word(bytes, offset + 16), (1u << 16) | 9u);  // if_tsresol: nanoseconds
+        } else if (type == capture::kEnhancedPacket) {
+            Packet packet;
+            packet.timestamp = static_cast<uint64_t>(word(bytes, offset + 12)) << 32 | word(bytes, offset + 16);
+            uint32_t captured = word(bytes, offset + 20);
+            packet.originalLength = word(bytes, offset + 24);
+            EXPECT_LE(28 + static_cast<size_t>(captured), length);
+            if (28 + static_cast<size_t>(captured) > length) break;
+            packet.data.assign(bytes.begin() + offset + 28, bytes.begin() + offset + 28 + captured);
+            file.packets.push_back(std::move(packet));
+        }
+        offset += length;
+    }
+    EXPECT_EQ(offset, bytes.size());
+    return file;
+}
+
+std::vector<Packet> readAll() {
+    std::vector<Packet> packets;
+    for (const auto& file : capture::listFiles(testDir())) {
+        File parsed = readFile(file.second);
+        packets.insert(packets.end(), parsed.packets.begin(), parsed.packets.end());
+    }
+    return packets;
+}
+
+capture::Endpoint endpoint(const char* ip, uint16_t port) {
+    capture::Endpoint e;
+    inet_pton(AF_INET, ip, &e.address);
+    e.port = htons(port);
+    return e;
+}
+
+void frame(PacketCapture& capture, uint64_t connection, PacketCapture::Direction direction, const std::string& data,
+           uint64_t skipped = 0) {
+    iovec iov{ const_cast<char*>(data.data()), data.size() };
+    capture.frame(connection, direction, &iov, 1, skipped);
+}
+
+constexpr auto kClient = PacketCapture::Direction::FROM_CLIENT;
+constexpr auto kServer = PacketCapture::Direction::FROM_SERVER;
+
+} // namespace
+
+// Test that a connection becomes a complete TCP stream with valid checksums
+TEST(CaptureTest, WritesTcpStream) {
+    clearDir();
+    {
+        PacketCapture capture(makeConfig());
+        capture.open(1, endpoint("10.0.0.2", 40000), endpoint("10.0.0.1", 8080));
+        frame(capture, 1, kClient, "request");
+        frame(capture, 1, kServer, "reply!");
+        capture.close(1);
+    }
+    auto files = capture::listFiles(testDir());
+    ASSERT_EQ(files.size(), 1u);
+    File file = readFile(files[0].second);
+    EXPECT_EQ(file.linkType, capture::kLinkTypeRaw);
+    EXPECT_EQ(file.snaplen, 65535u);
+    ASSERT_EQ(file.packets.size(), 7u);
+
+    using namespace capture;
+    const std::vector<Packet>& p = file.packets;
+    uint8_t expected[] = { kSyn, kSyn | kAck, kAck, kPsh | kAck, kPsh | kAck, kFin | kAck, kFin | kAck };
+    for (size_t i = 0; i < p.size(); i++) {
+        EXPECT_EQ(p[i].flags(), expected[i]) << i;
+        EXPECT_EQ(fold(sum(p[i].data.data(), kIpHeader)), 0) << "IP checksum " << i;
+        uint32_t pseudo = sum(p[i].data.data() + 12, 8) + 6 + static_cast<uint32_t>(p[i].data.size() - kIpHeader);
+        EXPECT_EQ(fold(sum(p[i].data.data() + kIpHeader, p[i].data.size() - kIpHeader, pseudo)), 0)
+            << "TCP checksum " << i;
+        EXPECT_EQ(p[i].srcPort(), i == 1 || i == 4 || i == 6 ? 8080 : 40000) << i;
+        EXPECT_GT(p[i].timestamp, 0u);
+    }
+    EXPECT_EQ(p[1].ack(), p[0].seq() + 1);
+    EXPECT_EQ(p[3].seq(), p[0].seq() + 1);
+    EXPECT_EQ(p[3].payload(), "request");
+    EXPECT_EQ(p[4].seq(), p[1].seq() + 1);
+    EXPECT_EQ(p[4].ack(), p[3].seq() + 7);
+    EXPECT_EQ(p[4].payload(), "reply!");
+    EXPECT_EQ(p[5].seq(), p[3].seq() + 7);
+    EXPECT_EQ(p[6].seq(), p[4].seq() + 6);
+    clearDir();
+}
+
+// Test that skipped bytes leave a sequence gap and large frames are split and cut to snaplen
+TEST(CaptureTest, SkipsSplitsAndTruncates) {
+    clearDir();
+    {
+        CaptureConfig config = makeConfig();
+        config.snaplen = 1000;
+        PacketCapture capture(config);
+        capture.open(1, endpoint("10.0.0.2", 40000), endpoint("10.0.0.1", 8080));
+        frame(capture, 1, kClient, "header", 100);
+        frame(capture, 1, kClient, std::string(capture::kMaxSegment + 10, 'x'));
+        frame(capture, 1, kClient, "next");
+        CaptureStats stats = capture.stats();
+        EXPECT_EQ(stats.frames, 3u);
+        EXPECT_EQ(stats.dropped, 0u);
+    }
+    std::vector<Packet> p = readAll();
+    ASSERT_EQ(p.size(), 7u);
+    uint32_t start = p[3].seq();
+    EXPECT_EQ(p[4].seq(), start + 6 + 100);
+    EXPECT_EQ(p[4].data.size(), 1000u);
+    EXPECT_EQ(p[4].originalLength, 65535u);
+    EXPECT_EQ(p[5].seq(), p[4].seq() + capture::kMaxSegment);
+    EXPECT_EQ(p[5].payload(), std::string(10, 'x'));
+    EXPECT_EQ(p[6].seq(), p[5].seq() + 10);
+    EXPECT_EQ(p[6].payload(), "next");
+    clearDir();
+}
+
+// Test that files rotate, keep only the newest ones and continue the numbering after a restart
+TEST(CaptureTest, RotatesFiles) {
+    clearDir();
+    CaptureConfig config = makeConfig();
+    config.fileBytes = 1024;
+    config.files = 3;
+    {
+        PacketCapture capture(config);
+        capture.open(1, endpoint("10.0.0.2", 40000), endpoint("10.0.0.1", 8080));
+        for (int i = 0; i < 40; i++) frame(capture, 1, kClient, std::string(100, 'a' + i % 26));
+        capture.close(1);
+    }
+    auto files = capture::listFiles(testDir());
+    ASSERT_EQ(files.size(), 3u);
+    uint64_t last = files.back().first;
+    EXPECT_GT(last, 3u);
+    for (const auto& file : files) {
+        File parsed = readFile(file.second);
+        EXPECT_EQ(parsed.linkType, capture::kLinkTypeRaw);
+        EXPECT_FALSE(parsed.packets.empty());
+    }
+    { PacketCapture capture(config); }
+    files = capture::listFiles(testDir());
+    ASSERT_EQ(files.size(), 3u);
+    EXPECT_EQ(files.back().first, last + 1);
+    clearDir();
+}
+
+// Test that sampling picks one connection in N and frames of unopened connections are dropped
+TEST(CaptureTest, SamplesConnections) {
+    clearDir();
+    CaptureConfig config = makeConfig();
+    config.sampleEvery = 4;
+    {
+        PacketCapture capture(config);
+        int sampled = 0;
+        for (uint64_t connection = 1; connection <= 100; connection++) sampled += capture.sample(connection);
+        EXPECT_EQ(sampled, 25);
+        frame(capture, 9, kClient, "orphan");
+        for (int i = 0; i < 200 && capture.stats().dropped == 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        EXPECT_EQ(capture.stats().dropped, 1u);
+    }
+    EXPECT_TRUE(readAll().empty());
+    clearDir();
+}
+
+// Test that a full queue drops data frames but not the close, and the dropped bytes still advance the sequence
+TEST(CaptureTest, FullQueueKeepsStreamEnds) {
+    clearDir();
+    constexpr int kFrames = 40;
+    {
+        CaptureConfig config = makeConfig();
+        config.queueCapacity = 8;
+        PacketCapture capture(config);
+        capture.open(1, endpoint("10.0.0.2", 40000), endpoint("10.0.0.1", 8080));
+        for (int i = 0; i < kFrames; i++) frame(capture, 1, kClient, std::string(10, 'a' + i % 26));
+        frame(capture, 1, kServer, "reply");
+        capture.close(1);
+        CaptureStats stats = capture.stats();
+        EXPECT_GT(stats.dropped, 0u);
+        EXPECT_EQ(stats.frames + stats.dropped, kFrames + 1u);
+    }
+    std::vector<Packet> p = readAll();
+    ASSERT_GE(p.size(), 5u);
+    uint32_t clientStart = p[2].seq();
+    uint32_t serverStart = p[2].ack();
+    uint32_t last = clientStart;
+    for (size_t i = 3; i + 2 < p.size(); i++) {
+        if (p[i].srcPort() != 40000) continue;
+        EXPECT_EQ((p[i].seq() - clientStart) % 10, 0u);
+        EXPECT_GE(p[i].seq(), last);
+        last = p[i].seq() + 10;
+    }
+    const Packet& clientFin = p[p.size() - 2];
+    const Packet& serverFin = p.back();
+    EXPECT_EQ(clientFin.flags() & capture::kFin, capture::kFin);
+    EXPECT_EQ(clientFin.seq(), clientStart + kFrames * 10);
+    EXPECT_EQ(serverFin.seq(), serverStart + 5);
+    clearDir();
+}
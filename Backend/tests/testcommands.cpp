@@ -0,0 +1,49 @@
+// Backend/tests/testcommands.cpp
+#include <gtest/gtest.h>
+#include "../command_registry.h"
+
+// Test that every request command maps to its own slot in the dense table
+TEST(CommandRegistryTest, RequestCommandsHaveDenseIndices) {
+    EXPECT_EQ(commandIndex(Command::LOGIN), 0);
+    EXPECT_EQ(commandIndex(Command::TOGGLE_MAINTENANCE), 1);
+    EXPECT_EQ(commandIndex(Command::SET_ONLINE), 2);
+    EXPECT_EQ(commandIndex(Command::REQUEST_FLAG_IMAGE), 3);
+    EXPECT_EQ(commandIndex(Command::HELLO), 4);
+    EXPECT_EQ(commandIndex(Command::BATCH), 5);
+    EXPECT_EQ(commandIndex(Command::STATS), 6);
+    EXPECT_EQ(commandIndex(Command::PROFILE), 7);
+}
+
+// Test that response codes and unknown IDs are not dispatchable
+TEST(CommandRegistryTest, NonRequestCommandsAreUnknown) {
+    EXPECT_EQ(findCommand(Command::NONE), nullptr);
+    EXPECT_EQ(findCommand(Command::ACK), nullptr);
+    EXPECT_EQ(findCommand(Command::ERROR), nullptr);
+    EXPECT_EQ(findCommand(static_cast<Command>(99)), nullptr);
+    EXPECT_EQ(findCommand(static_cast<Command>(0xFFFFFFFF)), nullptr);
+}
+
+// Test that the runtime table reflects the compile-time traits
+TEST(CommandRegistryTest, TableMatchesTraits) {
+    const CommandInfo* login = findCommand(Command::LOGIN);
+    ASSERT_NE(login, nullptr);
+    EXPECT_FALSE(login->requiresAuth);
+    EXPECT_EQ(login->maxPayload, CommandTraits<Command::LOGIN>::maxPayload);
+    EXPECT_EQ(login->dispatch, Dispatch::INLINE);
+
+    const CommandInfo* toggle = findCommand(Command::TOGGLE_MAINTENANCE);
+    ASSERT_NE(toggle, nullptr);
+    EXPECT_TRUE(toggle->requiresAuth);
+    EXPECT_EQ(toggle->dispatch, Dispatch::INLINE);
+
+    const CommandInfo* flag = findCommand(Command::REQUEST_FLAG_IMAGE);
+    ASSERT_NE(flag, nullptr);
+    EXPECT_EQ(flag->dispatch, Dispatch::WORKER);
+}
+
+// Test that the primary template describes a rejected command
+TEST(CommandRegistryTest, UnspecialisedTraitsRejectEverything) {
+    EXPECT_FALSE(CommandTraits<Command::ACK>::known);
+    EXPECT_TRUE(CommandTraits<Command::ACK>::requiresAuth);
+    EXPECT_EQ(CommandTraits<Command::ACK>::maxPayload, 0u);
+}
@@ -0,0 +1,58 @@
+// Backend/tests/testcompression.cpp
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "../compression.h"
+
+// Test that repetitive data round-trips through the codec
+TEST(CompressionTest, CompressAndDecompressRoundTrip) {
+    std::string text;
+    for (int i = 0; i < 200; i++) text += "flag{compress_me} ";
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+
+    std::vector<uint8_t> encoded;
+    ASSERT_TRUE(compression::compress(data, text.size(), encoded));
+    EXPECT_LT(encoded.size(), text.size());
+    EXPECT_EQ(compression::decodedSize(encoded.data(), encoded.size()), text.size());
+
+    std::vector<uint8_t> decoded = compression::decompress(encoded.data(), encoded.size(), text.size());
+    EXPECT_EQ(std::string(decoded.begin(), decoded.end()), text);
+}
+
+// Test that tiny payloads are left alone
+TEST(CompressionTest, SmallPayloadIsNotCompressed) {
+    const uint8_t data[] = "Login successful";
+    std::vector<uint8_t> encoded;
+    EXPECT_FALSE(compression::compress(data, sizeof(data), encoded));
+    EXPECT_TRUE(encoded.empty());
+}
+
+// Test that data which does not shrink is reported as incompressible
+TEST(CompressionTest, IncompressibleDataIsRejected) {
+    std::vector<uint8_t> noise(4096);
+    uint32_t state = 12345;
+    for (auto& b : noise) {
+        state = state * 1103515245 + 12345;
+        b = static_cast<uint8_t>(state >> 24);
+    }
+    std::vector<uint8_t> encoded;
+    EXPECT_FALSE(compression::compress(noise.data(), noise.size(), encoded));
+}
+
+// Test that the declared size is checked before allocating
+TEST(CompressionTest, DecompressRejectsOversizedOutput) {
+    std::string text(4096, 'a');
+    std::vector<uint8_t> encoded;
+    ASSERT_TRUE(compression::compress(reinterpret_cast<const uint8_t*>(text.data()), text.size(), encoded));
+    EXPECT_THROW(compression::decompress(encoded.data(), encoded.size(), 1024), std::runtime_error);
+}
+
+// Test that truncated or corrupt streams throw
+TEST(CompressionTest, DecompressRejectsCorruptData) {
+    std::string text(4096, 'b');
+    std::vector<uint8_t> encoded;
+    ASSERT_TRUE(compression::compress(reinterpret_cast<const uint8_t*>(text.data()), text.size(), encoded));
+
+    EXPECT_THROW(compression::decompress(encoded.data(), 2, 8192), std::runtime_error);
+    EXPECT_THROW(compression::decompress(encoded.data(), encoded.size() - 4, 8192), std::runtime_error);
+}
@@ -0,0 +1,97 @@
+// Backend/tests/testcredentialaggregator.cpp
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "../credential_aggregator.h"
+
+namespace {
+
+AggregatorConfig makeConfig(uint64_t sampleEvery) {
+    AggregatorConfig config;
+    config.enabled = true;
+    config.shards = 4;
+    config.sampleEvery = sampleEvery;
+    return config;
+}
+
+} // namespace
+
+// Test that repeats of one credential collapse into a single count
+TEST(CredentialAggregatorTest, CountsRepeats) {
+    CredentialAggregator aggregator(makeConfig(0));
+    for (int i = 0; i < 1000; i++) EXPECT_FALSE(aggregator.record(LoginAttempt{ "root", "toor", "10.0.0.1" }));
+    aggregator.record(LoginAttempt{ "root", "toor", "10.0.0.2" });
+    aggregator.record(LoginAttempt{ "admin", "toor", "10.0.0.1" });
+
+    std::vector<CredentialCount> counts = aggregator.drain();
+    ASSERT_EQ(counts.size(), 3u);
+    auto it = std::find_if(counts.begin(), counts.end(), [](const CredentialCount& c) {
+        return c.credential.username == "root" && c.credential.ip == "10.0.0.1";
+    });
+    ASSERT_NE(it, counts.end());
+    EXPECT_EQ(it->attempts, 1000u);
+    EXPECT_LE(it->firstSeen, it->lastSeen);
+    EXPECT_TRUE(aggregator.drain().empty());
+    EXPECT_EQ(aggregator.stats().flushed, 3u);
+}
+
+// Test that one attempt in sampleEvery is passed on as a raw row, starting with the first
+TEST(CredentialAggregatorTest, SamplesRawRows) {
+    CredentialAggregator aggregator(makeConfig(10));
+    int raw = 0;
+    for (int i = 0; i < 100; i++) {
+        bool sampled = aggregator.record(LoginAttempt{ "u", "p", "10.0.0.1" });
+        if (i == 0) {
+            EXPECT_TRUE(sampled);
+        }
+        raw += sampled;
+    }
+    EXPECT_EQ(raw, 10);
+    EXPECT_EQ(aggregator.stats().raw, 10u);
+}
+
+// Test that new credentials overflow to raw rows once the table is full
+TEST(CredentialAggregatorTest, FullTableFallsBackToRaw) {
+    AggregatorConfig config = makeConfig(0);
+    config.maxEntries = 2;
+    CredentialAggregator aggregator(config);
+    EXPECT_FALSE(aggregator.record(LoginAttempt{ "a", "p", "10.0.0.1" }));
+    EXPECT_FALSE(aggregator.record(LoginAttempt{ "b", "p", "10.0.0.1" }));
+    EXPECT_TRUE(aggregator.record(LoginAttempt{ "c", "p", "10.0.0.1" }));
+    EXPECT_FALSE(aggregator.record(LoginAttempt{ "a", "p", "10.0.0.1" }));
+    EXPECT_EQ(aggregator.stats().pending, 2u);
+}
+
+// Test that restored deltas merge with counts recorded after the drain
+TEST(CredentialAggregatorTest, RestoreMerges) {
+    CredentialAggregator aggregator(makeConfig(0));
+    for (int i = 0; i < 5; i++) aggregator.record(LoginAttempt{ "u", "p", "10.0.0.1" });
+    std::vector<CredentialCount> counts = aggregator.drain();
+    for (int i = 0; i < 3; i++) aggregator.record(LoginAttempt{ "u", "p", "10.0.0.1" });
+    aggregator.restore(counts);
+
+    counts = aggregator.drain();
+    ASSERT_EQ(counts.size(), 1u);
+    EXPECT_EQ(counts[0].attempts, 8u);
+}
+
+// Test that concurrent recorders lose no counts
+TEST(CredentialAggregatorTest, ConcurrentRecorders) {
+    CredentialAggregator aggregator(makeConfig(0));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&aggregator] {
+            for (int i = 0; i < 10000; i++) {
+                aggregator.record(LoginAttempt{ "user" + std::to_string(i % 50), "p", "10.0.0.1" });
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+
+    uint64_t total = 0;
+    std::vector<CredentialCount> counts = aggregator.drain();
+    for (const CredentialCount& count : counts) total += count.attempts;
+    EXPECT_EQ(counts.size(), 50u);
+    EXPECT_EQ(total, 40000u);
+}
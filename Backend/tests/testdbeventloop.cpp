@@ -0,0 +1,97 @@
+// Backend/tests/testdbeventloop.cpp
+#include <gtest/gtest.h>
+#include <condition_variable>
+#include <cstdlib>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "../db_event_loop.h"
+
+// Test that queries fail fast instead of waiting while the database is unreachable
+TEST(DbEventLoopTest, FailsQueriesWhileEveryConnectionIsDown) {
+    DbEventLoopConfig config;
+    config.connections = 2;
+    config.initialBackoff = std::chrono::milliseconds(60000);
+    DbEventLoop loop("host=127.0.0.1 port=1 connect_timeout=1", config);
+
+    std::promise<const PGresult*> result;
+    std::future<const PGresult*> done = result.get_future();
+    // Give the connects time to be refused so the loop is in backoff.
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    ASSERT_TRUE(loop.submit(Statement::INSERT_LOGIN_ATTEMPT, StatementParams().text("u").text("p").inet("10.0.0.1"),
+                            [&result](const PGresult* res) { result.set_value(res); }));
+    ASSERT_EQ(done.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(done.get(), nullptr);
+
+    DbEventLoopStats stats = loop.stats();
+    EXPECT_EQ(stats.submitted, 1u);
+    EXPECT_EQ(stats.failed, 1u);
+    EXPECT_EQ(stats.connects, 0u);
+}
+
+// Test that every accepted query hears back when the loop shuts down
+TEST(DbEventLoopTest, ShutdownCompletesAcceptedQueries) {
+    int completed = 0;
+    int accepted = 0;
+    {
+        DbEventLoop loop("host=127.0.0.1 port=1 connect_timeout=1", DbEventLoopConfig{});
+        for (int i = 0; i < 10; i++) {
+            if (loop.submit(Statement::INSERT_LOGIN_ATTEMPT, StatementParams().text("u").text("p").null(),
+                            [&completed](const PGresult*) { completed++; })) {
+                accepted++;
+            }
+        }
+    }
+    EXPECT_EQ(accepted, 10);
+    EXPECT_EQ(completed, accepted);
+}
+
+// Test against a real server that pipelined results reach their own callbacks in order and a
+// failing query does not affect the others
+TEST(DbEventLoopTest, MatchesResultsToCallbacks) {
+    const char* conninfo = std::getenv("CTF_TEST_DATABASE");
+    if (conninfo == nullptr) GTEST_SKIP() << "Set CTF_TEST_DATABASE to a libpq connection string to run";
+    PGconn* admin = PQconnectdb(conninfo);
+    ASSERT_EQ(PQstatus(admin), CONNECTION_OK) << PQerrorMessage(admin);
+    PQclear(PQexec(admin, "CREATE SCHEMA IF NOT EXISTS ctf"));
+    PQclear(PQexec(admin, "CREATE TABLE IF NOT EXISTS ctf.login_attempts (username text, password text, "
+                          "ip_address inet, attempted_at timestamptz NOT NULL DEFAULT now())"));
+    std::string username = "event_loop_test_" + std::to_string(getpid());
+
+    const size_t count = 500;
+    std::vector<ExecStatusType> statuses(count, PGRES_EMPTY_QUERY);
+    std::mutex mutex;
+    std::condition_variable doneCv;
+    size_t done = 0;
+    {
+        // A shallow pipeline on two connections, so queries queue, spread and overlap.
+        DbEventLoopConfig config;
+        config.connections = 2;
+        config.pipelineDepth = 16;
+        DbEventLoop loop(conninfo, config);
+        for (size_t i = 0; i < count; i++) {
+            // Every third password is invalid UTF-8, which the server rejects.
+            std::string password = i % 3 == 0 ? std::string("\xff") : "p" + std::to_string(i);
+            ASSERT_TRUE(loop.submit(Statement::INSERT_LOGIN_ATTEMPT,
+                                    StatementParams().text(username).text(password).inet("10.0.0.1"),
+                                    [&, i](const PGresult* res) {
+                                        std::lock_guard<std::mutex> lock(mutex);
+                                        statuses[i] = res != nullptr ? PQresultStatus(res) : PGRES_EMPTY_QUERY;
+                                        done++;
+                                        doneCv.notify_one();
+                                    }));
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(doneCv.wait_for(lock, std::chrono::seconds(30), [&] { return done == count; }));
+        EXPECT_EQ(loop.stats().completed, count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        EXPECT_EQ(statuses[i], i % 3 == 0 ? PGRES_FATAL_ERROR : PGRES_COMMAND_OK) << "query " << i;
+    }
+    const char* params[] = { username.c_str() };
+    PQclear(PQexecParams(admin, "DELETE FROM ctf.login_attempts WHERE username = $1",
+                         1, nullptr, params, nullptr, nullptr, 0));
+    PQfinish(admin);
+}
@@ -0,0 +1,59 @@
+// Backend/tests/testdbpool.cpp
+#include <gtest/gtest.h>
+#include "../db_pool.h"
+
+using std::chrono::milliseconds;
+
+// Nothing listens on port 1, so every connect attempt is refused immediately
+static const char* kUnreachable = "host=127.0.0.1 port=1 connect_timeout=1";
+
+// Test that the reconnect delay doubles per failure and is capped
+TEST(DbPoolTest, BackoffDoublesUpToMax) {
+    EXPECT_EQ(PgConnectionPool::backoff(1, milliseconds(100), milliseconds(1000)), milliseconds(100));
+    EXPECT_EQ(PgConnectionPool::backoff(2, milliseconds(100), milliseconds(1000)), milliseconds(200));
+    EXPECT_EQ(PgConnectionPool::backoff(4, milliseconds(100), milliseconds(1000)), milliseconds(800));
+    EXPECT_EQ(PgConnectionPool::backoff(5, milliseconds(100), milliseconds(1000)), milliseconds(1000));
+    EXPECT_EQ(PgConnectionPool::backoff(200, milliseconds(100), milliseconds(1000)), milliseconds(1000));
+}
+
+// Test that every connection is attempted at startup
+TEST(DbPoolTest, ConnectsAtStartup) {
+    PoolConfig config;
+    config.size = 3;
+    PgConnectionPool pool(kUnreachable, config);
+
+    PoolStats stats = pool.stats();
+    EXPECT_EQ(stats.size, 3u);
+    EXPECT_EQ(stats.idle, 0u);
+    EXPECT_EQ(stats.connectFailures, 3u);
+}
+
+// Test that acquire fails fast instead of waiting while every connection backs off
+TEST(DbPoolTest, AcquireFailsFastWhileBackingOff) {
+    PoolConfig config;
+    config.size = 2;
+    config.acquireTimeout = milliseconds(5000);
+    config.initialBackoff = milliseconds(60000);
+    PgConnectionPool pool(kUnreachable, config);
+
+    auto start = std::chrono::steady_clock::now();
+    PgConnectionPool::Lease lease = pool.acquire();
+    EXPECT_FALSE(lease);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, milliseconds(1000));
+
+    PoolStats stats = pool.stats();
+    EXPECT_EQ(stats.failed, 1u);
+    EXPECT_EQ(stats.connectFailures, 2u);
+}
+
+// Test that an expired backoff triggers a reconnect attempt on acquire
+TEST(DbPoolTest, AcquireRetriesAfterBackoff) {
+    PoolConfig config;
+    config.size = 1;
+    config.initialBackoff = milliseconds(0);
+    PgConnectionPool pool(kUnreachable, config);
+
+    PgConnectionPool::Lease lease = pool.acquire();
+    EXPECT_FALSE(lease);
+    EXPECT_GE(pool.stats().connectFailures, 2u);
+}
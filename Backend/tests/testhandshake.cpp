@@ -0,0 +1,93 @@
+// Backend/tests/testhandshake.cpp
+#include <gtest/gtest.h>
+#include <cstring>
+#include "../handshake.h"
+
+using namespace handshake;
+
+// Test that the HELLO payload round-trips through encode/decode
+TEST(HandshakeTest, EncodeDecodeRoundTrip) {
+    Hello hello{ 2, CHECKSUM_CRC32 | CHECKSUM_CRC32C, COMPRESSION_ZLIB, FEATURE_STREAM, 65536 };
+    uint8_t buffer[kHelloSize];
+    encode(hello, buffer);
+
+    Hello decoded = decode(buffer, sizeof(buffer));
+    EXPECT_EQ(decoded.version, 2);
+    EXPECT_EQ(decoded.checksums, CHECKSUM_CRC32 | CHECKSUM_CRC32C);
+    EXPECT_EQ(decoded.compression, COMPRESSION_ZLIB);
+    EXPECT_EQ(decoded.features, FEATURE_STREAM);
+    EXPECT_EQ(decoded.maxFrameSize, 65536u);
+}
+
+// Test that a HELLO with the wrong size is rejected
+TEST(HandshakeTest, DecodeRejectsWrongSize) {
+    uint8_t buffer[kHelloSize] = {};
+    EXPECT_THROW(decode(buffer, 4), std::runtime_error);
+}
+
+// Test that the cheapest common options are selected
+TEST(HandshakeTest, NegotiatePicksCheapestCommonMode) {
+    Hello client{ 2, CHECKSUM_CRC32 | CHECKSUM_CRC32C, COMPRESSION_ZLIB,
+                  FEATURE_STREAM | FEATURE_MULTIPLEX, 32 * 1024 };
+    Hello chosen = negotiate(client, serverCapabilities());
+
+    EXPECT_EQ(chosen.version, 2);
+    EXPECT_EQ(chosen.checksums, CHECKSUM_CRC32C);
+    EXPECT_EQ(chosen.compression, COMPRESSION_ZLIB);
+    EXPECT_EQ(chosen.features, FEATURE_STREAM | FEATURE_MULTIPLEX);
+    EXPECT_EQ(chosen.maxFrameSize, 32u * 1024);
+
+    client.checksums |= CHECKSUM_NONE;
+    EXPECT_EQ(negotiate(client, serverCapabilities()).checksums, CHECKSUM_NONE);
+}
+
+// Test that version 1 peers cannot multiplex and fall back to CRC32
+TEST(HandshakeTest, NegotiateFallsBackForOldPeers) {
+    Hello client{ 1, 0, 0, FEATURE_MULTIPLEX, 0 };
+    Hello chosen = negotiate(client, serverCapabilities());
+
+    EXPECT_EQ(chosen.version, kLegacyVersion);
+    EXPECT_EQ(chosen.checksums, CHECKSUM_CRC32);
+    EXPECT_EQ(chosen.compression, 0);
+    EXPECT_EQ(chosen.features, 0);
+    EXPECT_EQ(chosen.maxFrameSize, kMinFrameSize);
+}
+
+// Test that a newer client is capped at the server's version
+TEST(HandshakeTest, NegotiateCapsVersionAndFrameSize) {
+    Hello client{ 9, CHECKSUM_CRC32, 0, 0, 0xFFFFFFFF };
+    Hello chosen = negotiate(client, serverCapabilities());
+    EXPECT_EQ(chosen.version, kMaxVersion);
+    EXPECT_EQ(chosen.maxFrameSize, stream::kMaxChunkSize);
+
+    Hello invalid{ 0, CHECKSUM_CRC32, 0, 0, 0 };
+    EXPECT_THROW(negotiate(invalid, serverCapabilities()), std::runtime_error);
+}
+
+// Test that negotiated selections map onto connection options
+TEST(HandshakeTest, ToOptionsReflectsSelections) {
+    Options options = toOptions(Hello{ 2, CHECKSUM_NONE, COMPRESSION_ZLIB, FEATURE_MULTIPLEX, 4096 });
+    EXPECT_EQ(options.version, 2);
+    EXPECT_EQ(options.checksum, ChecksumType::NONE);
+    EXPECT_TRUE(options.compression);
+    EXPECT_FALSE(options.streaming);
+    EXPECT_TRUE(options.multiplex);
+    EXPECT_EQ(options.maxFrameSize, 4096u);
+}
+
+// Test CRC32C against the standard check value
+TEST(ChecksumTest, Crc32cMatchesCheckValue) {
+    const uint8_t data[] = "123456789";
+    EXPECT_EQ(checksum::compute(ChecksumType::CRC32C, data, 9), 0xE3069283u);
+    EXPECT_EQ(checksum::compute(ChecksumType::CRC32, data, 9), 0xCBF43926u);
+    EXPECT_EQ(checksum::compute(ChecksumType::NONE, data, 9), 0u);
+}
+
+// Test that CRC32C can be computed incrementally
+TEST(ChecksumTest, Crc32cIncrementalMatchesOneShot) {
+    uint8_t data[1000];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = static_cast<uint8_t>(i * 7);
+    uint32_t crc = checksum::update(ChecksumType::CRC32C, 0, data, 333);
+    crc = checksum::update(ChecksumType::CRC32C, crc, data + 333, sizeof(data) - 333);
+    EXPECT_EQ(crc, checksum::compute(ChecksumType::CRC32C, data, sizeof(data)));
+}
@@ -0,0 +1,117 @@
+// Backend/tests/testinstrumentedmutex.cpp
+#include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../instrumented_mutex.h"
+
+// Test that uncontended locking counts acquisitions without recording waits
+TEST(InstrumentedMutexTest, CountsUncontendedAcquisitions) {
+    LockSite site("test_uncontended");
+    InstrumentedMutex mutex(site);
+    for (int i = 0; i < 255; i++) {
+        std::lock_guard<InstrumentedMutex> lock(mutex);
+    }
+    EXPECT_TRUE(mutex.try_lock());
+    mutex.unlock();
+    LockSiteStats stats = site.stats();
+    EXPECT_EQ(stats.acquisitions, 256u);
+    EXPECT_EQ(stats.contended, 0u);
+    EXPECT_EQ(stats.waitNanos, 0u);
+    EXPECT_EQ(site.waits().snapshot().count, 0u);
+    // One acquisition in kHoldSampleEvery has its hold time measured.
+    EXPECT_EQ(site.holds().snapshot().count, 256u / LockSite::kHoldSampleEvery);
+}
+
+// Test that the mutex can be waited on through std::condition_variable_any
+TEST(InstrumentedMutexTest, WorksWithConditionVariableAny) {
+    LockSite site("test_condition");
+    InstrumentedMutex mutex(site);
+    std::condition_variable_any ready;
+    bool signalled = false;
+    std::thread signaller([&] {
+        std::lock_guard<InstrumentedMutex> lock(mutex);
+        signalled = true;
+        ready.notify_one();
+    });
+    {
+        std::unique_lock<InstrumentedMutex> lock(mutex);
+        EXPECT_TRUE(ready.wait_for(lock, std::chrono::seconds(10), [&] { return signalled; }));
+    }
+    signaller.join();
+    // The waiter's first lock and the signaller's; a wakeup adds one more reacquisition.
+    EXPECT_GE(site.stats().acquisitions, 2u);
+}
+
+// Test that a site keeps the acquisitions of mutexes already destroyed
+TEST(InstrumentedMutexTest, KeepsCountsOfDestroyedMutexes) {
+    LockSite site("test_retired");
+    InstrumentedMutex kept(site);
+    {
+        InstrumentedMutex gone(site);
+        for (int i = 0; i < 3; i++) {
+            std::lock_guard<InstrumentedMutex> lock(gone);
+        }
+    }
+    std::lock_guard<InstrumentedMutex> lock(kept);
+    EXPECT_EQ(site.stats().acquisitions, 4u);
+}
+
+// Test that a waiter is counted as contended with roughly the time it waited
+TEST(InstrumentedMutexTest, RecordsContendedWaits) {
+    LockSite site("test_contended");
+    InstrumentedMutex mutex(site);
+    mutex.lock();
+    EXPECT_FALSE(mutex.try_lock());
+    std::thread waiter([&mutex] { std::lock_guard<InstrumentedMutex> lock(mutex); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    mutex.unlock();
+    waiter.join();
+
+    LockSiteStats stats = site.stats();
+    EXPECT_EQ(stats.acquisitions, 2u);
+    EXPECT_EQ(stats.contended, 1u);
+    EXPECT_GE(stats.waitNanos, 40000000u);
+    HistogramSnapshot waits = site.waits().snapshot();
+    EXPECT_EQ(waits.count, 1u);
+    EXPECT_EQ(waits.max, stats.waitNanos);
+}
+
+// Test mutual exclusion and counting under real contention
+TEST(InstrumentedMutexTest, ExcludesAcrossThreads) {
+    LockSite site("test_threads");
+    InstrumentedMutex mutex(site);
+    uint64_t value = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&mutex, &value] {
+            for (int i = 0; i < 10000; i++) {
+                std::lock_guard<InstrumentedMutex> lock(mutex);
+                value++;
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    EXPECT_EQ(value, 80000u);
+    EXPECT_EQ(site.stats().acquisitions, 80000u);
+    EXPECT_EQ(site.waits().snapshot().count, site.stats().contended);
+}
+
+// Test that sites are shared by name and exported with a lock label
+TEST(InstrumentedMutexTest, RegistersSitesAsMetrics) {
+    LockSite& site = locks::site("test_registry");
+    EXPECT_EQ(&locks::site("test_registry"), &site);
+    InstrumentedMutex mutex(site);
+    mutex.lock();
+    mutex.unlock();
+
+    MetricsRegistry metrics;
+    locks::registerMetrics(metrics);
+    std::string text = metrics.render();
+    EXPECT_NE(text.find("# TYPE ctf_lock_acquisitions_total counter\n"), std::string::npos);
+    EXPECT_NE(text.find("ctf_lock_acquisitions_total{lock=\"test_registry\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("ctf_lock_contended_total{lock=\"test_registry\"} 0\n"), std::string::npos);
+    EXPECT_NE(text.find("# TYPE ctf_lock_hold_seconds summary\n"), std::string::npos);
+}
@@ -0,0 +1,78 @@
+// Backend/tests/testlatency.cpp
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include "../latency.h"
+
+// Test that buckets tile the value range without gaps and stay within 1/16 of their values
+TEST(LatencyTest, BucketsAreContiguousAndNarrow) {
+    EXPECT_EQ(LatencyHistogram::bucketOf(0), 0u);
+    EXPECT_EQ(LatencyHistogram::bucketOf(15), 15u);
+    EXPECT_EQ(LatencyHistogram::bucketOf(16), 16u);
+    for (size_t b = 1; b + 1 < LatencyHistogram::kBuckets; b++) {
+        uint64_t upper = LatencyHistogram::bucketUpper(b);
+        ASSERT_EQ(LatencyHistogram::bucketOf(upper), b);
+        ASSERT_EQ(LatencyHistogram::bucketOf(upper + 1), b + 1);
+        uint64_t lower = LatencyHistogram::bucketUpper(b - 1) + 1;
+        ASSERT_LE(static_cast<double>(upper - lower + 1), static_cast<double>(lower) / 16.0 + 1.0);
+    }
+    EXPECT_EQ(LatencyHistogram::bucketOf(UINT64_MAX), LatencyHistogram::kBuckets - 1);
+}
+
+// Test percentiles of a uniform 1..10000 us distribution against the exact values
+TEST(LatencyTest, PercentilesWithinBucketError) {
+    LatencyHistogram histogram;
+    for (uint64_t us = 1; us <= 10000; us++) histogram.record(us * 1000);
+    HistogramSnapshot snapshot = histogram.snapshot();
+    EXPECT_EQ(snapshot.count, 10000u);
+    EXPECT_EQ(snapshot.max, 10000000u);
+    EXPECT_EQ(snapshot.sum, 1000ull * 10000 * 10001 / 2);
+    for (auto [p, exact] : { std::pair<double, double>{ 0.5, 5e6 }, { 0.99, 9.9e6 }, { 0.999, 9.99e6 } }) {
+        double estimate = static_cast<double>(snapshot.percentile(p));
+        EXPECT_GE(estimate, exact) << p;
+        EXPECT_LE(estimate, exact * 1.0625) << p;
+    }
+    EXPECT_EQ(snapshot.percentile(1.0), snapshot.max);
+    EXPECT_EQ(HistogramSnapshot().percentile(0.5), 0u);
+}
+
+// Test that a rare slow sample shows up in the tail but not the median
+TEST(LatencyTest, TailSeesOutliers) {
+    LatencyHistogram histogram;
+    for (int i = 0; i < 999; i++) histogram.record(std::chrono::microseconds(100));
+    histogram.record(std::chrono::milliseconds(50));
+    HistogramSnapshot snapshot = histogram.snapshot();
+    EXPECT_LE(snapshot.percentile(0.5), 106250u);
+    EXPECT_LE(snapshot.percentile(0.99), 106250u);
+    EXPECT_EQ(snapshot.percentile(0.9999), 50000000u);
+}
+
+// Test that samples from many threads all land in the merged snapshot
+TEST(LatencyTest, MergesThreads) {
+    LatencyHistogram histogram;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&histogram, t] {
+            for (uint64_t i = 0; i < 10000; i++) histogram.record(i + static_cast<uint64_t>(t));
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    HistogramSnapshot snapshot = histogram.snapshot();
+    EXPECT_EQ(snapshot.count, 80000u);
+    EXPECT_EQ(snapshot.max, 10006u);
+}
+
+// Test that commands map to their own slots and unknown ones share the last
+TEST(LatencyTest, RequestLatencySlots) {
+    RequestLatency latency;
+    latency.record(Command::LOGIN, Stage::TOTAL, std::chrono::microseconds(5));
+    latency.record(static_cast<Command>(999), Stage::HEADER_READ, std::chrono::microseconds(1));
+    size_t login = RequestLatency::slot(Command::LOGIN);
+    EXPECT_STREQ(RequestLatency::slotName(login), "LOGIN");
+    EXPECT_EQ(latency.histogram(login, Stage::TOTAL).snapshot().count, 1u);
+    EXPECT_EQ(latency.histogram(login, Stage::SEND).snapshot().count, 0u);
+    EXPECT_EQ(RequestLatency::slot(static_cast<Command>(999)), kCommandCount);
+    EXPECT_STREQ(RequestLatency::slotName(kCommandCount), "unknown");
+    EXPECT_EQ(latency.histogram(kCommandCount, Stage::HEADER_READ).snapshot().count, 1u);
+    EXPECT_STREQ(stageName(Stage::PAYLOAD_READ), "payload_read");
+}
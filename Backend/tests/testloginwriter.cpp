@@ -0,0 +1,110 @@
+// Backend/tests/testloginwriter.cpp
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include "../login_writer.h"
+#include "../pg_login_store.h"
+
+using namespace pgbinary;
+
+// Test that IPv4 addresses use the inet binary layout
+TEST(PgBinaryTest, EncodesIPv4Inet) {
+    uint8_t out[kMaxInetSize];
+    ASSERT_EQ(encodeInet("192.168.1.20", out), 8u);
+    const uint8_t expected[] = { kInetFamilyV4, 32, 0, 4, 192, 168, 1, 20 };
+    EXPECT_EQ(std::memcmp(out, expected, sizeof(expected)), 0);
+}
+
+// Test that IPv6 addresses use the inet binary layout
+TEST(PgBinaryTest, EncodesIPv6Inet) {
+    uint8_t out[kMaxInetSize];
+    ASSERT_EQ(encodeInet("::1", out), 20u);
+    EXPECT_EQ(out[0], kInetFamilyV6);
+    EXPECT_EQ(out[1], 128);
+    EXPECT_EQ(out[3], 16);
+    EXPECT_EQ(out[19], 1);
+}
+
+// Test that unparsable addresses are reported
+TEST(PgBinaryTest, RejectsInvalidInet) {
+    uint8_t out[kMaxInetSize];
+    EXPECT_EQ(encodeInet("unknown", out), 0u);
+}
+
+// Test the COPY header, a row with a NULL inet, and the trailer
+TEST(PgBinaryTest, CopyEncoderLayout) {
+    CopyEncoder encoder;
+    encoder.beginRow(2);
+    encoder.addText("ab");
+    encoder.addInet("not-an-ip");
+    encoder.finish();
+
+    const uint8_t expected[] = {
+        'P', 'G', 'C', 'O', 'P', 'Y', '\n', 0xFF, '\r', '\n', 0,
+        0, 0, 0, 0,  0, 0, 0, 0,
+        0, 2,
+        0, 0, 0, 2, 'a', 'b',
+        0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF
+    };
+    ASSERT_EQ(encoder.data().size(), sizeof(expected));
+    EXPECT_EQ(std::memcmp(encoder.data().data(), expected, sizeof(expected)), 0);
+    EXPECT_EQ(encoder.rowCount(), 1u);
+
+    encoder.clear();
+    EXPECT_EQ(encoder.rowCount(), 0u);
+    EXPECT_EQ(encoder.data().size(), 19u);
+}
+
+// Test that submit never blocks and drops attempts once the queue is full
+TEST(LoginWriterTest, CountsLostBatchesWithoutDatabase) {
+    PoolConfig poolConfig;
+    poolConfig.size = 1;
+    poolConfig.initialBackoff = std::chrono::milliseconds(60000);
+    PgConnectionPool pool("host=127.0.0.1 port=1 connect_timeout=1", poolConfig);
+
+    LoginWriterConfig config;
+    config.queueCapacity = 8;
+    config.batchSize = 4;
+    config.flushInterval = std::chrono::milliseconds(60000);
+    config.spool.path = "";
+    {
+        PgLoginStore store(pool);
+        LoginWriter writer(store, config);
+        size_t accepted = 0;
+        for (int i = 0; i < 20; i++) {
+            if (writer.submit(LoginAttempt{ "user", "pass", "10.0.0.1" })) accepted++;
+        }
+        LoginWriterStats stats = writer.stats();
+        EXPECT_EQ(stats.queued, accepted);
+        EXPECT_EQ(stats.queued + stats.dropped, 20u);
+    }
+}
+
+// Test that overflow and unwritable batches go to the spool instead of being lost
+TEST(LoginWriterTest, SpoolsAttemptsWithoutDatabase) {
+    PoolConfig poolConfig;
+    poolConfig.size = 1;
+    poolConfig.initialBackoff = std::chrono::milliseconds(60000);
+    PgConnectionPool pool("host=127.0.0.1 port=1 connect_timeout=1", poolConfig);
+
+    std::string path = ::testing::TempDir() + "login_writer_spool.bin";
+    std::remove(path.c_str());
+    LoginWriterConfig config;
+    config.queueCapacity = 8;
+    config.batchSize = 4;
+    config.flushInterval = std::chrono::milliseconds(60000);
+    config.spool.path = path;
+    {
+        PgLoginStore store(pool);
+        LoginWriter writer(store, config);
+        for (int i = 0; i < 20; i++) {
+            EXPECT_TRUE(writer.submit(LoginAttempt{ "user", "pass", "10.0.0.1" }));
+        }
+        EXPECT_EQ(writer.stats().dropped, 0u);
+    }
+    // The queued attempts were spooled on shutdown and survive a restart.
+    LoginSpool spool(config.spool);
+    EXPECT_EQ(spool.stats().depth, 20u);
+    std::remove(path.c_str());
+}
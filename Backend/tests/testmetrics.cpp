@@ -0,0 +1,126 @@
+// Backend/tests/testmetrics.cpp
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../metrics.h"
+#include "../metrics_http.h"
+
+namespace {
+
+/** @brief Sends a raw HTTP request to the endpoint and returns the whole response. */
+std::string httpGet(uint16_t port, const std::string& request) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return "";
+    }
+    send(fd, request.data(), request.size(), 0);
+    std::string response;
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) response.append(buf, static_cast<size_t>(n));
+    close(fd);
+    return response;
+}
+
+} // namespace
+
+// Test that increments from many threads all land in the summed value
+TEST(MetricsTest, CountersSumAcrossThreads) {
+    MetricsRegistry registry;
+    Counter& counter = registry.counter("test_total", "Test.");
+    Gauge& gauge = registry.gauge("test_active", "Test.");
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&counter, &gauge] {
+            for (int i = 0; i < 10000; i++) {
+                counter.inc();
+                gauge.inc();
+                if (i % 2 == 0) gauge.dec();
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    EXPECT_EQ(counter.get(), 80000u);
+    EXPECT_EQ(gauge.get(), 40000);
+    counter.inc(5);
+    EXPECT_EQ(counter.get(), 80005u);
+}
+
+// Test that shards sit on separate cache lines
+TEST(MetricsTest, ShardsArePadded) {
+    EXPECT_EQ(sizeof(metrics::Cell), 64u);
+    EXPECT_EQ(alignof(metrics::Cell), 64u);
+    size_t shards = metrics::shardCount();
+    EXPECT_EQ(shards & (shards - 1), 0u);
+    EXPECT_LT(metrics::shard(), shards);
+}
+
+// Test the Prometheus text format: one header per family, labels, sampled values
+TEST(MetricsTest, RendersTextFormat) {
+    MetricsRegistry registry;
+    registry.counter("ctf_packets_received_total", "Requests.", metrics::label("command", "LOGIN")).inc(3);
+    registry.gauge("ctf_connections_active", "Open.").inc(2);
+    registry.counter("ctf_packets_received_total", "Requests.", metrics::label("command", "HELLO"));
+    double depth = 1.5;
+    registry.sampled("ctf_queue_depth", "Depth.", metrics::Type::GAUGE, [&depth] { return depth; });
+    registry.sampled("ctf_odd", "Odd \"label\".", metrics::Type::COUNTER, [] { return 7.0; },
+                     metrics::label("path", "a\"b\\c"));
+    EXPECT_EQ(registry.render(),
+              "# HELP ctf_packets_received_total Requests.\n"
+              "# TYPE ctf_packets_received_total counter\n"
+              "ctf_packets_received_total{command=\"LOGIN\"} 3\n"
+              "ctf_packets_received_total{command=\"HELLO\"} 0\n"
+              "# HELP ctf_connections_active Open.\n"
+              "# TYPE ctf_connections_active gauge\n"
+              "ctf_connections_active 2\n"
+              "# HELP ctf_queue_depth Depth.\n"
+              "# TYPE ctf_queue_depth gauge\n"
+              "ctf_queue_depth 1.5\n"
+              "# HELP ctf_odd Odd \"label\".\n"
+              "# TYPE ctf_odd counter\n"
+              "ctf_odd{path=\"a\\\"b\\\\c\"} 7\n");
+}
+
+// Test that summaries render quantiles, _sum and _count, and are left out while empty
+TEST(MetricsTest, RendersSummaries) {
+    MetricsRegistry registry;
+    metrics::Summary login{ { { 0.5, 0.001 }, { 0.99, 0.25 } }, 1.5, 4 };
+    registry.summary("ctf_stage_seconds", "Stages.", [&login] { return login; }, metrics::label("command", "LOGIN"));
+    registry.summary("ctf_stage_seconds", "Stages.", [] { return metrics::Summary{}; },
+                     metrics::label("command", "HELLO"));
+    EXPECT_EQ(registry.render(),
+              "# HELP ctf_stage_seconds Stages.\n"
+              "# TYPE ctf_stage_seconds summary\n"
+              "ctf_stage_seconds{command=\"LOGIN\",quantile=\"0.5\"} 0.001\n"
+              "ctf_stage_seconds{command=\"LOGIN\",quantile=\"0.99\"} 0.25\n"
+              "ctf_stage_seconds_sum{command=\"LOGIN\"} 1.5\n"
+              "ctf_stage_seconds_count{command=\"LOGIN\"} 4\n");
+}
+
+// Test that the HTTP endpoint serves /metrics and refuses anything else
+TEST(MetricsTest, ServesMetricsOverHttp) {
+    MetricsRegistry registry;
+    registry.counter("ctf_test_total", "Test.").inc(42);
+    MetricsHttpConfig config;
+    config.port = 0;
+    MetricsHttpServer server(config, [&registry] { return registry.render(); });
+    ASSERT_NE(server.port(), 0);
+
+    std::string ok = httpGet(server.port(), "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    EXPECT_EQ(ok.compare(0, 15, "HTTP/1.1 200 OK"), 0);
+    EXPECT_NE(ok.find("Content-Type: text/plain; version=0.0.4"), std::string::npos);
+    EXPECT_NE(ok.find("\r\n\r\n# HELP ctf_test_total Test.\n"), std::string::npos);
+    EXPECT_NE(ok.find("ctf_test_total 42\n"), std::string::npos);
+
+    EXPECT_EQ(httpGet(server.port(), "GET / HTTP/1.1\r\n\r\n").compare(0, 12, "HTTP/1.1 404"), 0);
+    EXPECT_EQ(httpGet(server.port(), "POST /metrics HTTP/1.1\r\n\r\n").compare(0, 12, "HTTP/1.1 405"), 0);
+}
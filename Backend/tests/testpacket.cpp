@@ -195,3 +195,42 @@ TEST(PacketTest, MoveAssignmentCleansUpExistingPayload){
     EXPECT_EQ(std::memcmp(target.getPayload(), "new!", 4), 0);
     EXPECT_EQ(source.getPayload(), nullptr);
 }
+// Test that the header can be decoded without touching the payload
+TEST(PacketTest, ParseHeaderReadsHostOrderFields){
+    NetworkPacket original(Command::REQUEST_FLAG_IMAGE, 4);
+    original.writePayload((const uint8_t*)"flag", 4);
+    std::vector<uint8_t> buffer = original.serialize();
+
+    Header header = NetworkPacket::parseHeader(buffer.data());
+
+    EXPECT_EQ(header.commandID, Command::REQUEST_FLAG_IMAGE);
+    EXPECT_EQ(header.payloadSize, 4);
+    EXPECT_EQ(header.payloadCRC, original.getPayloadCrc());
+}
+// Test that flags travel in the upper half of the command word
+TEST(PacketTest, FlagsSurviveSerialization){
+    NetworkPacket original(Command::ACK, 4);
+    original.writePayload((const uint8_t*)"test", 4);
+    original.setFlags(FLAG_COMPRESSED);
+
+    std::vector<uint8_t> buffer = original.serialize();
+    EXPECT_EQ(NetworkPacket::parseHeader(buffer.data()).commandID, Command::ACK);
+    EXPECT_EQ(NetworkPacket::parseFlags(buffer.data()), FLAG_COMPRESSED);
+
+    NetworkPacket* deserialized = NetworkPacket::deserialize(buffer.data(), buffer.size());
+    EXPECT_EQ(deserialized->getCommandID(), Command::ACK);
+    EXPECT_TRUE(deserialized->hasFlag(FLAG_COMPRESSED));
+    EXPECT_FALSE(deserialized->hasFlag(FLAG_ACCEPT_COMPRESSED));
+
+    delete deserialized;
+}
+// Test that packets without flags keep the original wire format
+TEST(PacketTest, NoFlagsKeepsLegacyCommandWord){
+    NetworkPacket packet(Command::LOGIN, 0);
+    std::vector<uint8_t> buffer = packet.serialize();
+
+    EXPECT_EQ(buffer[0], 0);
+    EXPECT_EQ(buffer[1], 0);
+    EXPECT_EQ(buffer[2], 0);
+    EXPECT_EQ(buffer[3], 100);
+}
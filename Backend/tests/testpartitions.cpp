@@ -0,0 +1,122 @@
+// Backend/tests/testpartitions.cpp
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include "../partitions.h"
+
+using namespace partition;
+
+// Test civil date conversion around the epoch, leap days and century rules
+TEST(PartitionTest, DateConversion) {
+    Date epoch = dateFromDays(0);
+    EXPECT_EQ(epoch.year, 1970);
+    EXPECT_EQ(epoch.month, 1u);
+    EXPECT_EQ(epoch.day, 1u);
+
+    EXPECT_EQ(daysFromDate(Date{ 2000, 2, 29 }) + 1, daysFromDate(Date{ 2000, 3, 1 }));
+    EXPECT_EQ(daysFromDate(Date{ 2100, 2, 28 }) + 1, daysFromDate(Date{ 2100, 3, 1 }));
+    for (int64_t day = -800; day < 40000; day += 37) {
+        EXPECT_EQ(daysFromDate(dateFromDays(day)), day);
+    }
+}
+
+// Test that partition names encode the day and parse back
+TEST(PartitionTest, NamesRoundTrip) {
+    int64_t day = daysFromDate(Date{ 2026, 10, 8 });
+    EXPECT_EQ(suffix(day), "_p20261008");
+    std::optional<int64_t> parsed = parseDay("login_attempts", "login_attempts" + suffix(day));
+    ASSERT_TRUE(parsed.has_value());
+    EXPECT_EQ(*parsed, day);
+}
+
+// Test that names not made by suffix() are left alone
+TEST(PartitionTest, IgnoresForeignNames) {
+    EXPECT_FALSE(parseDay("login_attempts", "login_attempts_legacy").has_value());
+    EXPECT_FALSE(parseDay("login_attempts", "login_attempts_p2026100").has_value());
+    EXPECT_FALSE(parseDay("login_attempts", "login_attempts_p20261332").has_value());
+    EXPECT_FALSE(parseDay("login_attempts", "login_attempts_p20260230").has_value());
+    EXPECT_FALSE(parseDay("login_attempts", "other_table_p20261008").has_value());
+}
+
+// Test that bounds are UTC midnights and adjacent days share a bound
+TEST(PartitionTest, Bounds) {
+    int64_t day = daysFromDate(Date{ 2024, 12, 31 });
+    EXPECT_EQ(bound(day), "2024-12-31 00:00:00+00");
+    EXPECT_EQ(bound(day + 1), "2025-01-01 00:00:00+00");
+}
+
+// Test that the manager stays inert without a database
+TEST(PartitionTest, ManagerWithoutDatabase) {
+    PoolConfig poolConfig;
+    poolConfig.size = 1;
+    poolConfig.initialBackoff = std::chrono::milliseconds(60000);
+    PgConnectionPool pool("host=127.0.0.1 port=1 connect_timeout=1", poolConfig);
+
+    PartitionConfig config;
+    config.enabled = true;
+    PartitionManager manager(pool, config);
+    EXPECT_FALSE(manager.maintain());
+    EXPECT_TRUE(manager.currentPartition().empty());
+}
+
+// Test against a real server that maintenance creates the upcoming partitions, retires expired
+// ones into the archive schema and leaves foreign partitions alone
+TEST(PartitionTest, MaintainsPartitionedTable) {
+    const char* conninfo = std::getenv("CTF_TEST_DATABASE");
+    if (conninfo == nullptr) GTEST_SKIP() << "Set CTF_TEST_DATABASE to a libpq connection string to run";
+    std::string schema = "ctf_partition_test_" + std::to_string(getpid());
+    PoolConfig poolConfig;
+    poolConfig.size = 1;
+    PgConnectionPool pool(conninfo, poolConfig);
+    PgConnectionPool::Lease conn = pool.acquire();
+    ASSERT_TRUE(conn);
+    auto exec = [&conn](const std::string& sql) {
+        PGresult* res = PQexec(conn.get(), sql.c_str());
+        bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+        PQclear(res);
+        return ok;
+    };
+    int64_t day = today();
+    ASSERT_TRUE(exec("CREATE SCHEMA " + schema));
+    ASSERT_TRUE(exec("CREATE TABLE " + schema + ".attempts (username text, attempted_at timestamptz NOT NULL) "
+                     "PARTITION BY RANGE (attempted_at)"));
+    ASSERT_TRUE(exec("CREATE TABLE " + schema + ".attempts" + suffix(day - 40) + " PARTITION OF " + schema +
+                     ".attempts FOR VALUES FROM ('" + bound(day - 40) + "') TO ('" + bound(day - 39) + "')"));
+    ASSERT_TRUE(exec("CREATE TABLE " + schema + ".attempts_legacy PARTITION OF " + schema +
+                     ".attempts FOR VALUES FROM (MINVALUE) TO ('" + bound(day - 100) + "')"));
+    conn.reset();
+
+    PartitionConfig config;
+    config.enabled = true;
+    config.table = schema + ".attempts";
+    config.daysAhead = 2;
+    config.retentionDays = 30;
+    config.archiveSchema = schema + "_archive";
+    {
+        PartitionManager manager(pool, config);
+        EXPECT_TRUE(manager.maintain());
+        EXPECT_EQ(manager.currentPartition(), "\"" + schema + "\".\"attempts" + suffix(day) + "\"");
+    }
+
+    conn = pool.acquire();
+    ASSERT_TRUE(conn);
+    const char* params[] = { schema.c_str() };
+    PGresult* res = PQexecParams(conn.get(),
+        "SELECT n.nspname || '.' || c.relname FROM pg_class c JOIN pg_namespace n ON n.oid = c.relnamespace "
+        "WHERE n.nspname LIKE $1 || '%' AND c.relkind = 'r' ORDER BY 1", 1, nullptr, params, nullptr, nullptr, 0);
+    ASSERT_EQ(PQresultStatus(res), PGRES_TUPLES_OK);
+    std::vector<std::string> tables;
+    for (int i = 0; i < PQntuples(res); i++) tables.push_back(PQgetvalue(res, i, 0));
+    PQclear(res);
+    auto has = [&tables](const std::string& name) {
+        return std::find(tables.begin(), tables.end(), name) != tables.end();
+    };
+    for (int64_t d = day; d <= day + 2; d++) EXPECT_TRUE(has(schema + ".attempts" + suffix(d))) << suffix(d);
+    EXPECT_FALSE(has(schema + ".attempts" + suffix(day - 40)));
+    EXPECT_TRUE(has(schema + "_archive.attempts" + suffix(day - 40)));
+    EXPECT_TRUE(has(schema + ".attempts_legacy"));
+    exec("DROP SCHEMA " + schema + " CASCADE");
+    exec("DROP SCHEMA " + schema + "_archive CASCADE");
+}
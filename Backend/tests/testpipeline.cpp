@@ -0,0 +1,93 @@
+// Backend/tests/testpipeline.cpp
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "../pipeline.h"
+
+namespace {
+
+/** @brief Connects to the database named by CTF_TEST_DATABASE and makes sure ctf.login_attempts exists. */
+PGconn* testDatabase() {
+    const char* conninfo = std::getenv("CTF_TEST_DATABASE");
+    if (conninfo == nullptr) return nullptr;
+    PGconn* conn = PQconnectdb(conninfo);
+    PQclear(PQexec(conn, "CREATE SCHEMA IF NOT EXISTS ctf"));
+    PQclear(PQexec(conn, "CREATE TABLE IF NOT EXISTS ctf.login_attempts (username text, password text, "
+                         "ip_address inet, attempted_at timestamptz NOT NULL DEFAULT now())"));
+    return conn;
+}
+
+long countRows(PGconn* conn, const std::string& username) {
+    const char* params[] = { username.c_str() };
+    PGresult* res = PQexecParams(conn, "SELECT count(*) FROM ctf.login_attempts WHERE username = $1",
+                                 1, nullptr, params, nullptr, nullptr, 0);
+    long count = PQresultStatus(res) == PGRES_TUPLES_OK ? std::atol(PQgetvalue(res, 0, 0)) : -1;
+    PQclear(res);
+    return count;
+}
+
+void deleteRows(PGconn* conn, const std::string& username) {
+    const char* params[] = { username.c_str() };
+    PQclear(PQexecParams(conn, "DELETE FROM ctf.login_attempts WHERE username = $1",
+                         1, nullptr, params, nullptr, nullptr, 0));
+}
+
+} // namespace
+
+// Test that every queued statement hears back even when the connection is unusable
+TEST(PipelineTest, FailedConnectionCompletesEveryCallback) {
+    PGconn* conn = PQconnectdb("host=127.0.0.1 port=1 connect_timeout=1");
+    ASSERT_NE(PQstatus(conn), CONNECTION_OK);
+
+    Pipeline pipeline;
+    int completed = 0;
+    for (int i = 0; i < 3; i++) {
+        pipeline.add(Statement::INSERT_LOGIN_ATTEMPT, StatementParams().text("u").text("p").inet("10.0.0.1"),
+                     [&completed](const PGresult* res) {
+                         EXPECT_EQ(res, nullptr);
+                         completed++;
+                     });
+    }
+    EXPECT_EQ(pipeline.size(), 3u);
+    EXPECT_FALSE(pipeline.run(conn));
+    EXPECT_EQ(completed, 3);
+    EXPECT_EQ(pipeline.size(), 0u);
+    PQfinish(conn);
+}
+
+// Test against a real server that each callback gets its own statement's result, that a failing
+// statement does not abort its neighbours, and that the connection leaves pipeline mode afterwards
+TEST(PipelineTest, IsolatesFailuresAndMatchesResults) {
+    PGconn* conn = testDatabase();
+    if (conn == nullptr) GTEST_SKIP() << "Set CTF_TEST_DATABASE to a libpq connection string to run";
+    ASSERT_EQ(PQstatus(conn), CONNECTION_OK) << PQerrorMessage(conn);
+    ASSERT_TRUE(prepareStatements(conn));
+
+    std::string username = "pipeline_test_" + std::to_string(getpid());
+    deleteRows(conn, username);
+    // More than one group, with every third statement carrying text the server rejects (invalid UTF-8).
+    const size_t count = Pipeline::kMaxDepth * 2 + 7;
+    std::vector<ExecStatusType> statuses(count, PGRES_EMPTY_QUERY);
+    Pipeline pipeline;
+    for (size_t i = 0; i < count; i++) {
+        std::string password = i % 3 == 0 ? std::string("\xff") : "p" + std::to_string(i);
+        pipeline.add(Statement::INSERT_LOGIN_ATTEMPT, StatementParams().text(username).text(password).inet("10.0.0.1"),
+                     [&statuses, i](const PGresult* res) {
+                         statuses[i] = res != nullptr ? PQresultStatus(res) : PGRES_EMPTY_QUERY;
+                     });
+    }
+    EXPECT_TRUE(pipeline.run(conn));
+    EXPECT_EQ(PQpipelineStatus(conn), PQ_PIPELINE_OFF);
+
+    long expected = 0;
+    for (size_t i = 0; i < count; i++) {
+        ExecStatusType want = i % 3 == 0 ? PGRES_FATAL_ERROR : PGRES_COMMAND_OK;
+        EXPECT_EQ(statuses[i], want) << "statement " << i;
+        if (want == PGRES_COMMAND_OK) expected++;
+    }
+    EXPECT_EQ(countRows(conn, username), expected);
+    deleteRows(conn, username);
+    PQfinish(conn);
+}
@@ -0,0 +1,142 @@
+// Backend/tests/testprofiler.cpp
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <ctime>
+#include <unistd.h>
+#include "../profiler.h"
+
+namespace {
+
+ProfilerConfig makeConfig() {
+    ProfilerConfig config;
+    config.dir = "/tmp/ctf_profiler_test_" + std::to_string(::getpid());
+    return config;
+}
+
+std::string readFile(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream body;
+    body << file.rdbuf();
+    return body.str();
+}
+
+/** @brief CPU time used by the whole process, which is what ITIMER_PROF counts. */
+std::chrono::nanoseconds processCpuTime() {
+    timespec ts{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+} // namespace
+
+// Exported (the test links with -rdynamic) so the profile can name it.
+// Spins until the process has used `cpu` more CPU time, however busy the machine is (up to a minute of wall time).
+extern "C" __attribute__((noinline)) double profilerTestSpin(std::chrono::milliseconds cpu) {
+    volatile double x = 1.0;
+    auto end = processCpuTime() + cpu;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+    while (processCpuTime() < end && std::chrono::steady_clock::now() < deadline) {
+        for (int i = 0; i < 1000; i++) x = x * 1.0000001 + 0.5;
+    }
+    return x;
+}
+
+// Test that folding merges equal stacks and writes them outermost first
+TEST(ProfilerTest, FoldsStacks) {
+    std::vector<std::vector<std::string>> stacks = {
+        { "leaf", "handle", "main" },
+        { "leaf", "handle", "main" },
+        { "send", "main" },
+        { "odd;name", "main" },
+        {},
+    };
+    EXPECT_EQ(profiler::foldStacks(stacks),
+              "main;handle;leaf 2\n"
+              "main;odd:name 1\n"
+              "main;send 1\n");
+}
+
+// Test that a busy function shows up in the samples of a real run
+TEST(ProfilerTest, SamplesBusyCode) {
+    CpuProfiler profiler(makeConfig());
+    EXPECT_FALSE(profiler.running());
+    profiler.start(1000);
+    EXPECT_TRUE(profiler.running());
+    profilerTestSpin(std::chrono::milliseconds(300));
+    ProfileResult result = profiler.stop();
+    EXPECT_FALSE(profiler.running());
+    EXPECT_GT(result.samples, 50u);
+    EXPECT_EQ(result.dropped, 0u);
+    EXPECT_GT(result.stacks, 0u);
+
+    std::string folded = readFile(result.path);
+    EXPECT_NE(folded.find("profilerTestSpin"), std::string::npos);
+    EXPECT_EQ(folded.find("onSignal"), std::string::npos);
+    std::remove(result.path.c_str());
+    ::rmdir(makeConfig().dir.c_str());
+}
+
+// Test that samples beyond the buffer are counted, not stored
+TEST(ProfilerTest, CountsDroppedSamples) {
+    ProfilerConfig config = makeConfig();
+    config.maxSamples = 5;
+    CpuProfiler profiler(config);
+    profiler.start(1000);
+    // Enough CPU time for well over maxSamples ticks even at a 250 Hz kernel timer.
+    profilerTestSpin(std::chrono::milliseconds(100));
+    ProfileResult result = profiler.stop();
+    EXPECT_EQ(result.samples, 5u);
+    EXPECT_GT(result.dropped, 0u);
+    std::remove(result.path.c_str());
+    ::rmdir(config.dir.c_str());
+}
+
+// Test that the slowest documented rate arms a valid timer (tv_usec must stay below one second)
+TEST(ProfilerTest, StartsAtOneHertz) {
+    CpuProfiler profiler(makeConfig());
+    ASSERT_NO_THROW(profiler.start(1));
+    itimerval timer{};
+    getitimer(ITIMER_PROF, &timer);
+    EXPECT_EQ(timer.it_interval.tv_sec, 1);
+    EXPECT_EQ(timer.it_interval.tv_usec, 0);
+    ProfileResult result = profiler.stop();
+    std::remove(result.path.c_str());
+    ::rmdir(makeConfig().dir.c_str());
+}
+
+// Test the start/stop state errors
+TEST(ProfilerTest, RejectsBadTransitions) {
+    CpuProfiler profiler(makeConfig());
+    EXPECT_THROW(profiler.stop(), std::runtime_error);
+    EXPECT_THROW(profiler.start(5000), std::runtime_error);
+    profiler.start();
+    EXPECT_THROW(profiler.start(), std::runtime_error);
+    CpuProfiler other(makeConfig());
+    EXPECT_THROW(other.start(), std::runtime_error);
+    EXPECT_FALSE(other.running());
+}
+
+// Test that writing a profile deletes the oldest ones beyond the configured count and leaves other files alone
+TEST(ProfilerTest, KeepsNewestFiles) {
+    ProfilerConfig config = makeConfig();
+    config.files = 2;
+    ::mkdir(config.dir.c_str(), 0755);
+    for (const char* name : { "/profile-1.folded", "/profile-2.folded", "/profile-3.folded", "/notes.txt" }) {
+        std::ofstream(config.dir + name) << "main 1\n";
+    }
+    CpuProfiler profiler(config);
+    profiler.start();
+    ProfileResult result = profiler.stop();
+    auto files = profiler::listFiles(config.dir);
+    ASSERT_EQ(files.size(), 2u);
+    EXPECT_EQ(files[0].second, config.dir + "/profile-3.folded");
+    EXPECT_EQ(files[1].second, result.path);
+    EXPECT_FALSE(readFile(config.dir + "/notes.txt").empty());
+    for (const auto& file : files) std::remove(file.second.c_str());
+    std::remove((config.dir + "/notes.txt").c_str());
+    ::rmdir(config.dir.c_str());
+}
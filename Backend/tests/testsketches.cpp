@@ -0,0 +1,82 @@
+// Backend/tests/testsketches.cpp
+#include <gtest/gtest.h>
+#include <string>
+#include <unordered_map>
+#include "../sketches.h"
+
+// Test that Count-Min estimates are never below the true count
+TEST(SketchTest, CountMinNeverUndercounts) {
+    CountMinSketch cms;
+    std::unordered_map<uint64_t, uint64_t> truth;
+    for (uint64_t i = 0; i < 50000; i++) {
+        uint64_t key = sketch::hash("item" + std::to_string(i % 5000 * (i % 7 + 1)));
+        cms.add(key);
+        truth[key]++;
+    }
+    for (const auto& [key, count] : truth) EXPECT_GE(cms.estimate(key), count);
+}
+
+// Test that TopK counts exactly while it has room for every item
+TEST(SketchTest, TopKExactUnderCapacity) {
+    TopK top(8);
+    for (int i = 0; i < 5; i++) {
+        for (int j = 0; j <= i; j++) top.add("user" + std::to_string(i));
+    }
+    std::vector<HeavyHitter> items = top.top(3);
+    ASSERT_EQ(items.size(), 3u);
+    EXPECT_EQ(items[0].value, "user4");
+    EXPECT_EQ(items[0].count, 5u);
+    EXPECT_EQ(items[0].error, 0u);
+    EXPECT_EQ(items[1].value, "user3");
+    EXPECT_EQ(items[2].value, "user2");
+    EXPECT_EQ(top.top(100).size(), 5u);
+}
+
+// Test that heavy hitters survive a stream of many more distinct items than counters
+TEST(SketchTest, TopKKeepsHeavyHitters) {
+    TopK top(32);
+    for (int i = 0; i < 100000; i++) {
+        if (i % 10 == 0) top.add("root");
+        else if (i % 25 == 1) top.add("admin");
+        else top.add("noise" + std::to_string(i));
+    }
+    std::vector<HeavyHitter> items = top.top(2);
+    ASSERT_EQ(items.size(), 2u);
+    EXPECT_EQ(items[0].value, "root");
+    EXPECT_GE(items[0].count, 10000u);
+    EXPECT_LE(items[0].count - items[0].error, 10000u);
+    EXPECT_EQ(items[1].value, "admin");
+    EXPECT_GE(items[1].count, 4000u);
+}
+
+// Test that HyperLogLog is exact-ish for small sets and within a few percent for large ones
+TEST(SketchTest, HyperLogLogAccuracy) {
+    HyperLogLog small, large;
+    for (int i = 0; i < 100; i++) {
+        small.add(sketch::hash("10.0.0." + std::to_string(i)));
+        small.add(sketch::hash("10.0.0." + std::to_string(i)));
+    }
+    EXPECT_NEAR(static_cast<double>(small.estimate()), 100.0, 2.0);
+
+    for (int i = 0; i < 100000; i++) large.add(sketch::hash("ip" + std::to_string(i)));
+    EXPECT_NEAR(static_cast<double>(large.estimate()), 100000.0, 5000.0);
+}
+
+// Test that LoginSketches reports counts, cardinalities and top lists
+TEST(SketchTest, LoginSketchesReport) {
+    LoginSketches sketches(16);
+    for (int i = 0; i < 300; i++) {
+        sketches.record(LoginAttempt{ i % 3 == 0 ? "root" : "user" + std::to_string(i), "123456",
+                                      "10.0.0." + std::to_string(i % 50) });
+    }
+    LoginSketchReport report = sketches.report(1);
+    EXPECT_EQ(report.logins, 300u);
+    EXPECT_NEAR(static_cast<double>(report.uniqueIps), 50.0, 2.0);
+    EXPECT_NEAR(static_cast<double>(report.uniqueCredentials), 201.0, 6.0);
+    ASSERT_EQ(report.usernames.size(), 1u);
+    EXPECT_EQ(report.usernames[0].value, "root");
+    ASSERT_EQ(report.passwords.size(), 1u);
+    EXPECT_EQ(report.passwords[0].value, "123456");
+    EXPECT_EQ(report.passwords[0].count, 300u);
+    EXPECT_EQ(report.ips.size(), 1u);
+}
@@ -0,0 +1,209 @@
+// Backend/tests/testspool.cpp
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "../spool.h"
+
+namespace {
+
+SpoolConfig tempConfig(const std::string& name) {
+    SpoolConfig config;
+    config.path = ::testing::TempDir() + name;
+    config.replayBatch = 4;
+    std::remove(config.path.c_str());
+    return config;
+}
+
+std::vector<LoginAttempt> attempts(int count) {
+    std::vector<LoginAttempt> result;
+    for (int i = 0; i < count; i++) {
+        result.push_back(LoginAttempt{ "user" + std::to_string(i), "pass", "10.0.0." + std::to_string(i) });
+    }
+    return result;
+}
+
+off_t fileSize(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return static_cast<off_t>(file.tellg());
+}
+
+} // namespace
+
+// Test that a record decodes to the attempt it was encoded from
+TEST(SpoolTest, RecordRoundTrip) {
+    std::vector<uint8_t> data;
+    spool::encodeRecord(LoginAttempt{ "admin", "hunter2", "::1" }, data);
+    LoginAttempt decoded;
+    ASSERT_EQ(spool::decodeRecord(data.data(), data.size(), decoded), data.size());
+    EXPECT_EQ(decoded.username, "admin");
+    EXPECT_EQ(decoded.password, "hunter2");
+    EXPECT_EQ(decoded.ip, "::1");
+
+    data[data.size() - 1] ^= 0xFF;
+    EXPECT_EQ(spool::decodeRecord(data.data(), data.size(), decoded), 0u);
+    EXPECT_EQ(spool::decodeRecord(data.data(), data.size() - 1, decoded), 0u);
+}
+
+// Test that committed attempts survive reopening and replay in order
+TEST(SpoolTest, ReplaysAfterReopen) {
+    SpoolConfig config = tempConfig("spool_reopen.bin");
+    {
+        LoginSpool spool(config);
+        spool.append(attempts(10));
+        EXPECT_EQ(spool.stats().depth, 10u);
+    }
+    LoginSpool spool(config);
+    EXPECT_EQ(spool.stats().depth, 10u);
+
+    std::vector<std::string> seen;
+    size_t replayed = spool.replay([&seen](const std::vector<LoginAttempt>& batch) {
+        EXPECT_LE(batch.size(), 4u);
+        for (const LoginAttempt& attempt : batch) seen.push_back(attempt.username);
+        return true;
+    }, 100);
+    EXPECT_EQ(replayed, 10u);
+    ASSERT_EQ(seen.size(), 10u);
+    EXPECT_EQ(seen.front(), "user0");
+    EXPECT_EQ(seen.back(), "user9");
+    EXPECT_FALSE(spool.pending());
+    std::remove(config.path.c_str());
+}
+
+// Test that replay gets past a record larger than the per-record read budget
+TEST(SpoolTest, ReplaysMaximumSizeRecords) {
+    SpoolConfig config = tempConfig("spool_large.bin");
+    config.replayBatch = 1;
+    std::string field(0xFFFF, 'x');
+    {
+        LoginSpool spool(config);
+        spool.append({ LoginAttempt{ field, field, field }, LoginAttempt{ "small", "pass", "::1" } });
+    }
+    LoginSpool spool(config);
+    std::vector<std::string> seen;
+    size_t replayed = spool.replay([&seen](const std::vector<LoginAttempt>& batch) {
+        for (const LoginAttempt& attempt : batch) seen.push_back(attempt.username);
+        return true;
+    }, 100);
+    EXPECT_EQ(replayed, 2u);
+    ASSERT_EQ(seen.size(), 2u);
+    EXPECT_EQ(seen[0].size(), 0xFFFFu);
+    EXPECT_EQ(seen[1], "small");
+    EXPECT_FALSE(spool.pending());
+    std::remove(config.path.c_str());
+}
+
+// Test that a refused batch stays spooled and the replay offset survives a restart
+TEST(SpoolTest, PersistsReplayOffset) {
+    SpoolConfig config = tempConfig("spool_offset.bin");
+    {
+        LoginSpool spool(config);
+        spool.append(attempts(10));
+        ASSERT_TRUE(spool.sync(true));
+        int calls = 0;
+        size_t replayed = spool.replay([&calls](const std::vector<LoginAttempt>&) {
+            return ++calls == 1;
+        }, 100);
+        EXPECT_EQ(replayed, 4u);
+        EXPECT_EQ(spool.stats().depth, 6u);
+    }
+    LoginSpool spool(config);
+    EXPECT_EQ(spool.stats().depth, 6u);
+    std::string first;
+    spool.replay([&first](const std::vector<LoginAttempt>& batch) {
+        if (first.empty()) first = batch.front().username;
+        return true;
+    }, 100);
+    EXPECT_EQ(first, "user4");
+    std::remove(config.path.c_str());
+}
+
+// Test that a torn record at the end of the file is cut off on open
+TEST(SpoolTest, TruncatesTornTail) {
+    SpoolConfig config = tempConfig("spool_torn.bin");
+    {
+        LoginSpool spool(config);
+        spool.append(attempts(3));
+    }
+    off_t intact = fileSize(config.path);
+    {
+        std::ofstream file(config.path, std::ios::binary | std::ios::app);
+        std::vector<uint8_t> record;
+        spool::encodeRecord(LoginAttempt{ "torn", "pass", "10.0.0.1" }, record);
+        file.write(reinterpret_cast<const char*>(record.data()), static_cast<std::streamsize>(record.size() / 2));
+    }
+    LoginSpool spool(config);
+    SpoolStats stats = spool.stats();
+    EXPECT_EQ(stats.depth, 3u);
+    EXPECT_GT(stats.discarded, 0u);
+    EXPECT_EQ(fileSize(config.path), intact);
+    std::remove(config.path.c_str());
+}
+
+// Test that a fully replayed spool shrinks back to its header
+TEST(SpoolTest, TruncatesAfterFullReplay) {
+    SpoolConfig config = tempConfig("spool_truncate.bin");
+    LoginSpool spool(config);
+    spool.append(attempts(5));
+    ASSERT_TRUE(spool.sync(true));
+    EXPECT_GT(fileSize(config.path), static_cast<off_t>(spool::kFileHeaderSize));
+    EXPECT_EQ(spool.replay([](const std::vector<LoginAttempt>&) { return true; }, 100), 5u);
+    EXPECT_EQ(fileSize(config.path), static_cast<off_t>(spool::kFileHeaderSize));
+    EXPECT_EQ(spool.stats().bytes, 0u);
+
+    spool.append(attempts(2));
+    ASSERT_TRUE(spool.sync(true));
+    EXPECT_EQ(spool.replay([](const std::vector<LoginAttempt>&) { return true; }, 100), 2u);
+    std::remove(config.path.c_str());
+}
+
+// Test that appends wait for the commit interval unless forced
+TEST(SpoolTest, GroupsCommits) {
+    SpoolConfig config = tempConfig("spool_group.bin");
+    config.commitInterval = std::chrono::milliseconds(60000);
+    LoginSpool spool(config);
+    spool.append(attempts(3));
+    ASSERT_TRUE(spool.sync());
+    EXPECT_EQ(fileSize(config.path), static_cast<off_t>(spool::kFileHeaderSize));
+    ASSERT_TRUE(spool.sync(true));
+    EXPECT_GT(fileSize(config.path), static_cast<off_t>(spool::kFileHeaderSize));
+    std::remove(config.path.c_str());
+}
+
+// Test that append only buffers, even past maxBuffered, and sync then commits without waiting for the interval
+TEST(SpoolTest, AppendNeverWrites) {
+    SpoolConfig config = tempConfig("spool_append.bin");
+    config.commitInterval = std::chrono::milliseconds(60000);
+    config.maxBuffered = 64;
+    LoginSpool spool(config);
+    EXPECT_FALSE(spool.append(LoginAttempt{ "a", "b", "c" }));
+    EXPECT_TRUE(spool.append(attempts(10)));
+    EXPECT_EQ(fileSize(config.path), static_cast<off_t>(spool::kFileHeaderSize));
+    ASSERT_TRUE(spool.sync());
+    EXPECT_GT(fileSize(config.path), static_cast<off_t>(spool::kFileHeaderSize));
+    std::remove(config.path.c_str());
+}
+
+// Test that recovery counts records across several read chunks and still cuts a torn tail
+TEST(SpoolTest, RecoversAcrossChunks) {
+    SpoolConfig config = tempConfig("spool_chunks.bin");
+    const int count = 40000;
+    {
+        LoginSpool spool(config);
+        spool.append(attempts(count));
+    }
+    off_t intact = fileSize(config.path);
+    ASSERT_GT(intact, static_cast<off_t>(2 * spool::kRecoverChunk));
+    {
+        std::ofstream file(config.path, std::ios::binary | std::ios::app);
+        file.write("\0\0\0\x10torn", 8);
+    }
+    LoginSpool spool(config);
+    SpoolStats stats = spool.stats();
+    EXPECT_EQ(stats.depth, static_cast<uint64_t>(count));
+    EXPECT_EQ(stats.discarded, 8u);
+    EXPECT_EQ(fileSize(config.path), intact);
+    std::remove(config.path.c_str());
+}
@@ -0,0 +1,96 @@
+// Backend/tests/testsqlitestore.cpp
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+#include "../login_writer.h"
+#include "../sqlite_login_store.h"
+
+namespace {
+
+SqliteConfig tempConfig(const std::string& name) {
+    SqliteConfig config;
+    config.path = ::testing::TempDir() + name;
+    for (const char* suffix : { "", "-wal", "-shm" }) std::remove((config.path + suffix).c_str());
+    return config;
+}
+
+std::string queryText(const std::string& path, const char* sql) {
+    sqlite3* db = nullptr;
+    sqlite3_open(path.c_str(), &db);
+    sqlite3_stmt* stmt = nullptr;
+    std::string result;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        const unsigned char* text = sqlite3_column_text(stmt, 0);
+        if (text) result = reinterpret_cast<const char*>(text);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return result;
+}
+
+} // namespace
+
+// Test that a new database is created in WAL mode with the login table
+TEST(SqliteLoginStoreTest, CreatesWalDatabase) {
+    SqliteConfig config = tempConfig("store_wal.db");
+    SqliteLoginStore store(config);
+    EXPECT_EQ(queryText(config.path, "PRAGMA journal_mode"), "wal");
+    EXPECT_EQ(queryText(config.path, "SELECT count(*) FROM login_attempts"), "0");
+    EXPECT_STREQ(store.name(), "sqlite");
+}
+
+// Test that a batch is committed with every column and a timestamp
+TEST(SqliteLoginStoreTest, StoresBatch) {
+    SqliteConfig config = tempConfig("store_batch.db");
+    SqliteLoginStore store(config);
+    std::vector<LoginAttempt> batch;
+    for (int i = 0; i < 50; i++) batch.push_back(LoginAttempt{ "user" + std::to_string(i), "pass", "10.0.0.1" });
+    batch.push_back(LoginAttempt{ "noip", "pass", "" });
+
+    size_t rejected = 99;
+    ASSERT_TRUE(store.store(batch, rejected));
+    EXPECT_EQ(rejected, 0u);
+    EXPECT_EQ(queryText(config.path, "SELECT count(*) FROM login_attempts"), "51");
+    EXPECT_EQ(queryText(config.path, "SELECT username FROM login_attempts ORDER BY id LIMIT 1"), "user0");
+    EXPECT_EQ(queryText(config.path, "SELECT count(*) FROM login_attempts WHERE ip_address IS NULL"), "1");
+    EXPECT_FALSE(queryText(config.path, "SELECT attempted_at FROM login_attempts LIMIT 1").empty());
+}
+
+// Test that LoginWriter drains its queue into SQLite on shutdown
+TEST(SqliteLoginStoreTest, WriterFlushesIntoSqlite) {
+    SqliteConfig sqlite = tempConfig("store_writer.db");
+    LoginWriterConfig config;
+    config.batchSize = 16;
+    config.flushInterval = std::chrono::milliseconds(60000);
+    config.spool.path = "";
+    {
+        SqliteLoginStore store(sqlite);
+        LoginWriter writer(store, config);
+        for (int i = 0; i < 100; i++) EXPECT_TRUE(writer.submit(LoginAttempt{ "user", "pass", "10.0.0.2" }));
+    }
+    EXPECT_EQ(queryText(sqlite.path, "SELECT count(*) FROM login_attempts"), "100");
+}
+
+// Test that credential deltas are upserted into running totals
+TEST(SqliteLoginStoreTest, UpsertsCredentialCounts) {
+    SqliteConfig config = tempConfig("store_counts.db");
+    SqliteLoginStore store(config);
+    auto now = std::chrono::system_clock::now();
+    std::vector<CredentialCount> counts = {
+        { LoginAttempt{ "root", "toor", "10.0.0.1" }, 5, now, now },
+        { LoginAttempt{ "admin", "admin", "10.0.0.2" }, 2, now, now },
+    };
+    std::vector<CredentialCount> retry;
+    EXPECT_EQ(store.storeCounts(counts, retry), 2u);
+    counts[0].attempts = 7;
+    counts[0].firstSeen = now - std::chrono::hours(1);
+    EXPECT_EQ(store.storeCounts(counts, retry), 2u);
+    EXPECT_TRUE(retry.empty());
+
+    EXPECT_EQ(queryText(config.path, "SELECT count(*) FROM login_credentials"), "2");
+    EXPECT_EQ(queryText(config.path, "SELECT attempts FROM login_credentials WHERE username = 'root'"), "12");
+    EXPECT_LT(queryText(config.path, "SELECT first_seen FROM login_credentials WHERE username = 'root'"),
+              queryText(config.path, "SELECT last_seen FROM login_credentials WHERE username = 'root'"));
+}
@@ -0,0 +1,33 @@
+// Backend/tests/teststatements.cpp
+#include <gtest/gtest.h>
+#include <cstring>
+#include <set>
+#include <string>
+#include "../statements.h"
+
+// Test that statement names are unique, since they share one namespace per session
+TEST(StatementsTest, NamesAreUnique) {
+    std::set<std::string> names;
+    for (const StatementInfo& info : kStatements) {
+        EXPECT_TRUE(names.insert(info.name).second) << info.name;
+    }
+}
+
+// Test that every statement declares a type for each of its placeholders
+TEST(StatementsTest, ParamTypesMatchPlaceholders) {
+    for (const StatementInfo& info : kStatements) {
+        std::string sql = info.sql;
+        EXPECT_NE(sql.find("$" + std::to_string(info.paramCount)), std::string::npos) << info.name;
+        EXPECT_EQ(sql.find("$" + std::to_string(info.paramCount + 1)), std::string::npos) << info.name;
+        for (int i = 0; i < info.paramCount; i++) {
+            EXPECT_NE(info.paramTypes[i], 0u) << info.name;
+        }
+    }
+}
+
+// Test that the parameter builder counts values and NULLs
+TEST(StatementsTest, ParamsCountValuesAndNulls) {
+    StatementParams params;
+    params.text("user").text("").inet("10.1.2.3").inet("garbage").null();
+    EXPECT_EQ(params.count(), 5);
+}
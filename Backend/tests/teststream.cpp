@@ -0,0 +1,134 @@
+// Backend/tests/teststream.cpp
+#include <gtest/gtest.h>
+#include <vector>
+#include <cstring>
+#include "../stream.h"
+
+// Collects the frames produced by a StreamWriter
+struct FrameLog {
+    std::vector<std::vector<uint8_t>> frames;
+
+    stream::StreamWriter::Sink sink() {
+        return [this](const uint8_t* data, size_t size) {
+            frames.emplace_back(data, data + size);
+            return true;
+        };
+    }
+};
+
+static std::vector<uint8_t> makeData(size_t size) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) data[i] = static_cast<uint8_t>(i * 31 + 7);
+    return data;
+}
+
+// Feeds every frame into a reader, reassembling the data
+static std::vector<uint8_t> replay(const FrameLog& log, uint64_t maxTotal, uint32_t maxChunk) {
+    std::vector<uint8_t> out;
+    stream::StreamReader reader(maxTotal, maxChunk, [&out](const uint8_t* data, size_t size) {
+        out.insert(out.end(), data, data + size);
+    });
+    for (const auto& frame : log.frames) {
+        Header header = NetworkPacket::parseHeader(frame.data());
+        uint16_t flags = NetworkPacket::parseFlags(frame.data());
+        reader.accept(header, flags, frame.data() + sizeof(Header));
+    }
+    EXPECT_TRUE(reader.isComplete());
+    return out;
+}
+
+// Test that a stream round-trips and no DATA frame exceeds the chunk size
+TEST(StreamTest, WriterAndReaderRoundTrip) {
+    std::vector<uint8_t> data = makeData(10000);
+    FrameLog log;
+    stream::StreamWriter writer(Command::ACK, FLAG_NONE, data.size(), 1024, log.sink());
+
+    ASSERT_TRUE(writer.begin());
+    ASSERT_TRUE(writer.write(data.data(), 3000));
+    ASSERT_TRUE(writer.write(data.data() + 3000, data.size() - 3000));
+    ASSERT_TRUE(writer.finish());
+
+    // START + ceil(10000 / 1024) DATA + END
+    EXPECT_EQ(log.frames.size(), 1u + 10u + 1u);
+    for (size_t i = 1; i + 1 < log.frames.size(); i++) {
+        EXPECT_LE(log.frames[i].size(), sizeof(Header) + 1024);
+    }
+    EXPECT_EQ(writer.getTotalCrc(), NetworkPacket::checksum(data.data(), data.size()));
+    EXPECT_EQ(replay(log, data.size(), 1024), data);
+}
+
+// Test that START and END carry the stream flags alongside the data flags
+TEST(StreamTest, FramesCarryStreamFlags) {
+    std::vector<uint8_t> data = makeData(100);
+    FrameLog log;
+    stream::StreamWriter writer(Command::ACK, FLAG_COMPRESSED, data.size(), 64, log.sink());
+    ASSERT_TRUE(writer.begin() && writer.write(data.data(), data.size()) && writer.finish());
+
+    EXPECT_EQ(NetworkPacket::parseFlags(log.frames.front().data()), FLAG_COMPRESSED | FLAG_STREAM_START);
+    EXPECT_EQ(NetworkPacket::parseFlags(log.frames[1].data()), FLAG_COMPRESSED | FLAG_STREAM_DATA);
+    EXPECT_EQ(NetworkPacket::parseFlags(log.frames.back().data()), FLAG_COMPRESSED | FLAG_STREAM_END);
+}
+
+// Test that the writer refuses to send more or less than it announced
+TEST(StreamTest, WriterEnforcesDeclaredSize) {
+    std::vector<uint8_t> data = makeData(100);
+    FrameLog log;
+    stream::StreamWriter over(Command::ACK, FLAG_NONE, 50, 64, log.sink());
+    ASSERT_TRUE(over.begin());
+    EXPECT_FALSE(over.write(data.data(), data.size()));
+
+    stream::StreamWriter under(Command::ACK, FLAG_NONE, 200, 64, log.sink());
+    ASSERT_TRUE(under.begin());
+    ASSERT_TRUE(under.write(data.data(), data.size()));
+    EXPECT_FALSE(under.finish());
+}
+
+// Test that a declared total above the limit is rejected at START
+TEST(StreamTest, ReaderRejectsOversizedStream) {
+    std::vector<uint8_t> data = makeData(5000);
+    FrameLog log;
+    stream::StreamWriter writer(Command::ACK, FLAG_NONE, data.size(), 1024, log.sink());
+    ASSERT_TRUE(writer.begin() && writer.write(data.data(), data.size()) && writer.finish());
+
+    EXPECT_THROW(replay(log, 4096, 1024), std::runtime_error);
+}
+
+// Test that chunks larger than the reader's limit are rejected from the header alone
+TEST(StreamTest, ReaderRejectsOversizedChunk) {
+    std::vector<uint8_t> data = makeData(5000);
+    FrameLog log;
+    stream::StreamWriter writer(Command::ACK, FLAG_NONE, data.size(), 2048, log.sink());
+    ASSERT_TRUE(writer.begin() && writer.write(data.data(), data.size()) && writer.finish());
+
+    EXPECT_THROW(replay(log, data.size(), 1024), std::runtime_error);
+}
+
+// Test that a corrupted chunk is detected
+TEST(StreamTest, ReaderDetectsCorruptChunk) {
+    std::vector<uint8_t> data = makeData(3000);
+    FrameLog log;
+    stream::StreamWriter writer(Command::ACK, FLAG_NONE, data.size(), 1024, log.sink());
+    ASSERT_TRUE(writer.begin() && writer.write(data.data(), data.size()) && writer.finish());
+
+    log.frames[2][sizeof(Header) + 10] ^= 0xFF;
+    EXPECT_THROW(replay(log, data.size(), 1024), std::runtime_error);
+}
+
+// Test that data frames without a START are rejected
+TEST(StreamTest, ReaderRejectsDataBeforeStart) {
+    std::vector<uint8_t> data = makeData(3000);
+    FrameLog log;
+    stream::StreamWriter writer(Command::ACK, FLAG_NONE, data.size(), 1024, log.sink());
+    ASSERT_TRUE(writer.begin() && writer.write(data.data(), data.size()) && writer.finish());
+
+    log.frames.erase(log.frames.begin());
+    EXPECT_THROW(replay(log, data.size(), 1024), std::runtime_error);
+}
+
+// Test that the incremental CRC matches the one-shot CRC
+TEST(StreamTest, UpdateChecksumMatchesOneShot) {
+    std::vector<uint8_t> data = makeData(777);
+    uint32_t crc = NetworkPacket::updateChecksum(0, data.data(), 300);
+    crc = NetworkPacket::updateChecksum(crc, data.data() + 300, data.size() - 300);
+    EXPECT_EQ(crc, NetworkPacket::checksum(data.data(), data.size()));
+}
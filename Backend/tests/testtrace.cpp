@@ -0,0 +1,128 @@
+// Backend/tests/testtrace.cpp
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "../trace.h"
+
+namespace {
+
+TraceConfig makeConfig(uint64_t sampleEvery, size_t bufferSpans = 1024) {
+    TraceConfig config;
+    config.sampleEvery = sampleEvery;
+    config.bufferSpans = bufferSpans;
+    config.dir = "/tmp/ctf_trace_test_" + std::to_string(::getpid());
+    return config;
+}
+
+} // namespace
+
+// Test that spans are recorded only under a sampled context, with its IDs
+TEST(TraceTest, RecordsSpansOfSampledRequests) {
+    Tracer tracer(makeConfig(1));
+    {
+        trace::Span outside("outside");
+    }
+    {
+        trace::Scope scope(tracer.begin(7, 42, 3));
+        trace::Span span("recv.payload");
+    }
+    EXPECT_FALSE(trace::current().sampled());
+    std::vector<TraceSpan> spans = tracer.collect();
+    ASSERT_EQ(spans.size(), 1u);
+    EXPECT_STREQ(spans[0].name, "recv.payload");
+    EXPECT_EQ(spans[0].connection, 7u);
+    EXPECT_EQ(spans[0].request, 42u);
+    EXPECT_EQ(spans[0].sequence, 3u);
+    EXPECT_EQ(spans[0].tid, trace::threadId());
+}
+
+// Test that one request in sampleEvery is traced, and none when disabled
+TEST(TraceTest, SamplesRequests) {
+    Tracer tracer(makeConfig(10));
+    int sampled = 0;
+    for (int i = 0; i < 1000; i++) {
+        if (tracer.begin(1, 0, static_cast<uint32_t>(i)).sampled()) sampled++;
+    }
+    EXPECT_EQ(sampled, 100);
+
+    TraceConfig off = makeConfig(1);
+    off.enabled = false;
+    Tracer disabled(off);
+    EXPECT_FALSE(disabled.begin(1, 0, 1).sampled());
+}
+
+// Test that a context carried to another thread tags that thread's spans
+TEST(TraceTest, ContextFollowsWorkToOtherThreads) {
+    Tracer tracer(makeConfig(1));
+    trace::Scope scope(tracer.begin(5, 9, 1));
+    {
+        trace::Span span("recv.header");
+    }
+    std::thread worker([context = trace::current()] {
+        trace::Scope traced(context);
+        trace::Span span("LOGIN");
+    });
+    worker.join();
+    std::vector<TraceSpan> spans = tracer.collect();
+    ASSERT_EQ(spans.size(), 2u);
+    EXPECT_NE(spans[0].tid, spans[1].tid);
+    for (const TraceSpan& span : spans) EXPECT_EQ(span.connection, 5u);
+    EXPECT_LE(spans[0].start, spans[1].start);
+}
+
+// Test that a full buffer keeps the newest spans and exited threads' buffers are reused
+TEST(TraceTest, BuffersWrapAndAreReused) {
+    Tracer tracer(makeConfig(1, 4));
+    trace::Scope scope(tracer.begin(1, 0, 1));
+    const char* names[] = { "a", "b", "c", "d", "e", "f" };
+    for (const char* name : names) trace::Span span(name);
+    std::vector<TraceSpan> spans = tracer.collect();
+    ASSERT_EQ(spans.size(), 4u);
+    EXPECT_STREQ(spans.front().name, "c");
+    EXPECT_STREQ(spans.back().name, "f");
+
+    for (int i = 0; i < 5; i++) {
+        std::thread([context = trace::current()] {
+            trace::Scope traced(context);
+            trace::Span span("worker");
+        }).join();
+    }
+    EXPECT_EQ(tracer.bufferCount(), 2u);
+}
+
+// Test that a large buffer only holds the spans recorded so far
+TEST(TraceTest, BuffersGrowAsSpansAreRecorded) {
+    Tracer tracer(makeConfig(1, 1 << 20));
+    trace::Scope scope(tracer.begin(1, 0, 1));
+    for (int i = 0; i < 100; i++) trace::Span span("grow");
+    std::vector<TraceSpan> spans = tracer.collect();
+    ASSERT_EQ(spans.size(), 100u);
+    EXPECT_STREQ(spans.back().name, "grow");
+}
+
+// Test the Chrome trace-event JSON written by a dump
+TEST(TraceTest, DumpsChromeTraceJson) {
+    Tracer tracer(makeConfig(1));
+    {
+        trace::Scope scope(tracer.begin(3, 11, 2));
+        auto start = std::chrono::steady_clock::now();
+        trace::record("recv.header", start, start + std::chrono::nanoseconds(1500));
+    }
+    std::string path = tracer.dump();
+    std::ifstream file(path);
+    std::stringstream body;
+    body << file.rdbuf();
+    std::string json = body.str();
+    EXPECT_EQ(json.compare(0, 40, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"), 0);
+    EXPECT_NE(json.find("\"name\":\"recv.header\",\"cat\":\"request\",\"ph\":\"X\""), std::string::npos);
+    EXPECT_NE(json.find("\"dur\":1.500,"), std::string::npos);
+    EXPECT_NE(json.find("\"args\":{\"connection\":3,\"request\":11,\"sequence\":2}}"), std::string::npos);
+    EXPECT_EQ(json.substr(json.size() - 4), "\n]}\n");
+    std::remove(path.c_str());
+    ::rmdir(tracer.settings().dir.c_str());
+}
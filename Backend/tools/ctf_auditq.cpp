@@ -0,0 +1,304 @@
+/**
+ * @file ctf_auditq.cpp
+ * @brief Queries the binary packet audit log.
+ *
+ * Usage: ctf_auditq [options] [dir]
+ *
+ *   --from TIME   only records logged at or after TIME
+ *   --to TIME     only records logged before TIME
+ *   --ip ADDR     only records of this peer address
+ *   --cmd CMD     only records of this command (number or name, e.g. LOGIN)
+ *   --conn ID     only records of this connection
+ *   --event EV    only RECEIVED, SENT, SENT_STREAM, BATCH, DROPPED or USAGE records
+ *   --summary     print per-command and per-address totals instead of records
+ *   --top N       rows in the per-address table (default 10)
+ *
+ * The summary adds mean heap allocations and socket syscalls per request
+ * when the server was built with CTF_ACCOUNTING and wrote USAGE records.
+ *
+ * TIME is seconds since the epoch or a UTC date, "YYYY-MM-DD" or
+ * "YYYY-MM-DDTHH:MM:SS". dir defaults to "audit".
+ *
+ * Segments are memory-mapped and scanned in place, compressed ones
+ * (.seg.gz) are inflated first; a segment is skipped without being read
+ * when the next one was created before --from.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "../audit_log.h"
+#include "../command_registry.h"
+
+namespace {
+
+using Peer = std::array<uint8_t, 16>;
+
+struct Filter {
+    uint64_t from = 0;
+    uint64_t to = UINT64_MAX;
+    std::optional<Peer> peer;
+    std::optional<uint32_t> command;
+    std::optional<uint64_t> connection;
+    std::optional<AuditEvent> event;
+
+    bool matches(const AuditRecord& r) const {
+        if (r.timestamp < from || r.timestamp >= to) return false;
+        if (peer && r.peer != *peer) return false;
+        if (command && r.command != *command) return false;
+        if (connection && r.connection != *connection) return false;
+        if (event && r.event != *event) return false;
+        return true;
+    }
+};
+
+struct CommandTotals {
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+    uint64_t replies = 0;
+    uint64_t errors = 0;
+    uint64_t latencySum = 0;
+    uint32_t latencyMax = 0;
+    std::vector<uint32_t> latencies;
+    /** @brief USAGE records and what they add up to. */
+    uint64_t accounted = 0;
+    uint64_t allocations = 0;
+    uint64_t syscalls = 0;
+};
+
+struct PeerTotals {
+    uint64_t requests = 0;
+    uint64_t errors = 0;
+    std::unordered_set<uint64_t> connections;
+};
+
+std::string commandName(uint32_t id) {
+    if (id == static_cast<uint32_t>(Command::ACK)) return "ACK";
+    if (id == static_cast<uint32_t>(Command::ERROR)) return "ERROR";
+    if (id == static_cast<uint32_t>(Command::NONE)) return "(unknown)";
+    const CommandInfo* info = findCommand(static_cast<Command>(id));
+    return info != nullptr ? info->name : std::to_string(id);
+}
+
+std::optional<uint32_t> parseCommand(const std::string& text) {
+    if (!text.empty() && text.find_first_not_of("0123456789") == std::string::npos) {
+        return static_cast<uint32_t>(std::strtoul(text.c_str(), nullptr, 10));
+    }
+    for (const CommandInfo& info : kCommandTable) {
+        if (text == info.name) return static_cast<uint32_t>(info.command);
+    }
+    if (text == "ACK") return static_cast<uint32_t>(Command::ACK);
+    if (text == "ERROR") return static_cast<uint32_t>(Command::ERROR);
+    return std::nullopt;
+}
+
+std::optional<AuditEvent> parseEvent(const std::string& text) {
+    static const std::pair<const char*, AuditEvent> events[] = {
+        { "RECEIVED", AuditEvent::RECEIVED }, { "SENT", AuditEvent::SENT }, { "SENT_STREAM", AuditEvent::SENT_STREAM },
+        { "BATCH", AuditEvent::BATCH }, { "DROPPED", AuditEvent::DROPPED },
+        { "USAGE", AuditEvent::USAGE },
+    };
+    for (const auto& [name, event] : events) {
+        if (text == name) return event;
+    }
+    return std::nullopt;
+}
+
+/** @brief Parses a TIME argument into nanoseconds since the epoch. */
+std::optional<uint64_t> parseTime(const std::string& text) {
+    if (!text.empty() && text.find_first_not_of("0123456789") == std::string::npos) {
+        return std::strtoull(text.c_str(), nullptr, 10) * 1000000000ull;
+    }
+    std::tm tm{};
+    const char* end = strptime(text.c_str(), "%Y-%m-%dT%H:%M:%S", &tm);
+    if (end == nullptr || *end != '\0') {
+        tm = std::tm{};
+        end = strptime(text.c_str(), "%Y-%m-%d", &tm);
+        if (end == nullptr || *end != '\0') return std::nullopt;
+    }
+    std::time_t seconds = timegm(&tm);
+    if (seconds < 0) return std::nullopt;
+    return static_cast<uint64_t>(seconds) * 1000000000ull;
+}
+
+uint32_t percentile(std::vector<uint32_t>& values, double p) {
+    if (values.empty()) return 0;
+    // Nearest rank: the smallest value with at least p of the samples at or below it.
+    size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(values.size())));
+    size_t index = std::min(values.size(), std::max<size_t>(rank, 1)) - 1;
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+void printSummary(std::map<uint32_t, CommandTotals>& commands,
+                  const std::map<Peer, PeerTotals>& peers, uint64_t matched, uint64_t dropped,
+                  uint64_t first, uint64_t last, size_t top) {
+    std::string from, to;
+    if (matched > 0) {
+        AuditRecord edge{};
+        edge.timestamp = first;
+        audit::format(edge, from);
+        edge.timestamp = last;
+        audit::format(edge, to);
+        from = from.substr(0, from.find(' '));
+        to = to.substr(0, to.find(' '));
+    }
+    std::cout << matched << " records";
+    if (matched > 0) std::cout << " from " << from << " to " << to;
+    std::cout << ", " << dropped << " dropped by the logger\n\n";
+
+    std::cout << std::left << std::setw(20) << "command" << std::right << std::setw(10) << "records" << std::setw(14)
+              << "bytes" << std::setw(10) << "replies" << std::setw(8) << "errors" << std::setw(10) << "avg us"
+              << std::setw(10) << "p99 us" << std::setw(10) << "max us";
+    bool accounted = std::any_of(commands.begin(), commands.end(),
+                                 [](const auto& entry) { return entry.second.accounted > 0; });
+    if (accounted) std::cout << std::setw(12) << "allocs/req" << std::setw(14) << "syscalls/req";
+    std::cout << "\n";
+    for (auto& [id, totals] : commands) {
+        uint64_t average = totals.replies > 0 ? totals.latencySum / totals.replies : 0;
+        std::cout << std::left << std::setw(20) << commandName(id) << std::right << std::setw(10) << totals.records
+                  << std::setw(14) << totals.bytes << std::setw(10) << totals.replies << std::setw(8) << totals.errors
+                  << std::setw(10) << average << std::setw(10) << percentile(totals.latencies, 0.99)
+                  << std::setw(10) << totals.latencyMax;
+        if (accounted && totals.accounted > 0) {
+            double requests = static_cast<double>(totals.accounted);
+            std::cout << std::fixed << std::setprecision(1) << std::setw(12) << totals.allocations / requests
+                      << std::setw(14) << totals.syscalls / requests << std::defaultfloat;
+        }
+        std::cout << "\n";
+    }
+
+    std::vector<std::pair<Peer, const PeerTotals*>> ranked;
+    for (const auto& [peer, totals] : peers) ranked.emplace_back(peer, &totals);
+    std::stable_sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b) {
+        return a.second->requests > b.second->requests;
+    });
+    if (ranked.size() > top) ranked.resize(top);
+    std::cout << "\n" << std::left << std::setw(40) << "peer" << std::right << std::setw(10) << "requests"
+              << std::setw(8) << "errors" << std::setw(13) << "connections" << "\n";
+    for (const auto& [peer, totals] : ranked) {
+        std::cout << std::left << std::setw(40) << audit::peerString(peer) << std::right << std::setw(10)
+                  << totals->requests << std::setw(8) << totals->errors << std::setw(13) << totals->connections.size()
+                  << "\n";
+    }
+}
+
+int usage() {
+    std::cerr << "Usage: ctf_auditq [--from TIME] [--to TIME] [--ip ADDR] [--cmd CMD] [--conn ID] [--event EV]\n"
+                 "                  [--summary] [--top N] [dir]\n";
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Filter filter;
+    std::string dir = "audit";
+    bool summary = false;
+    size_t top = 10;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--summary") {
+            summary = true;
+        } else if ((arg == "--from" || arg == "--to") && hasValue) {
+            std::optional<uint64_t> time = parseTime(argv[++i]);
+            if (!time) return usage();
+            (arg == "--from" ? filter.from : filter.to) = *time;
+        } else if (arg == "--ip" && hasValue) {
+            std::string ip = argv[++i];
+            filter.peer = audit::parsePeer(ip);
+            if (*filter.peer == Peer{}) return usage();
+        } else if (arg == "--cmd" && hasValue) {
+            filter.command = parseCommand(argv[++i]);
+            if (!filter.command) return usage();
+        } else if (arg == "--conn" && hasValue) {
+            filter.connection = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--event" && hasValue) {
+            filter.event = parseEvent(argv[++i]);
+            if (!filter.event) return usage();
+        } else if (arg == "--top" && hasValue) {
+            top = std::strtoul(argv[++i], nullptr, 10);
+        } else if (!arg.empty() && arg[0] != '-') {
+            dir = arg;
+        } else {
+            return usage();
+        }
+    }
+
+    auto segments = audit::listSegments(dir);
+    if (segments.empty()) {
+        std::cerr << "No audit segments in " << dir << "\n";
+        return 1;
+    }
+
+    std::map<uint32_t, CommandTotals> commands;
+    std::map<Peer, PeerTotals> peers;
+    uint64_t matched = 0, dropped = 0, first = UINT64_MAX, last = 0;
+    std::string out;
+
+    for (size_t s = 0; s < segments.size(); s++) {
+        try {
+            // Records of a segment were all logged before the next segment was created.
+            if (filter.from > 0 && s + 1 < segments.size()) {
+                audit::SegmentHeader next;
+                if (audit::readHeader(segments[s + 1].second, next) && next.created < filter.from) continue;
+            }
+            audit::MappedSegment segment(segments[s].second);
+            for (const AuditRecord& r : segment) {
+                if (!filter.matches(r)) continue;
+                matched++;
+                if (!summary) {
+                    out.clear();
+                    audit::format(r, out);
+                    std::fwrite(out.data(), 1, out.size(), stdout);
+                    continue;
+                }
+                first = std::min(first, r.timestamp);
+                last = std::max(last, r.timestamp);
+                if (r.event == AuditEvent::DROPPED) {
+                    dropped += r.dropped.records;
+                    continue;
+                }
+                CommandTotals& totals = commands[r.command];
+                if (r.event == AuditEvent::USAGE) {
+                    totals.accounted++;
+                    totals.allocations += r.usage.allocations;
+                    totals.syscalls += r.usage.syscalls;
+                    continue;
+                }
+                totals.records++;
+                bool batched = r.event == AuditEvent::BATCH;
+                totals.bytes += batched ? r.batch.size : r.packet.size;
+                bool error = r.result == static_cast<uint16_t>(Command::ERROR) || (batched && r.batch.failures > 0);
+                if (r.event != AuditEvent::RECEIVED) {
+                    uint32_t latency = batched ? r.batch.latency : r.packet.latency;
+                    totals.replies++;
+                    totals.errors += error;
+                    totals.latencySum += latency;
+                    totals.latencyMax = std::max(totals.latencyMax, latency);
+                    totals.latencies.push_back(latency);
+                }
+                PeerTotals& peer = peers[r.peer];
+                if (r.event == AuditEvent::RECEIVED || r.event == AuditEvent::BATCH) peer.requests++;
+                if (r.event != AuditEvent::RECEIVED && error) peer.errors++;
+                peer.connections.insert(r.connection);
+            }
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << "\n";
+        }
+    }
+
+    if (summary) printSummary(commands, peers, matched, dropped, first, last, top);
+    return 0;
+}
@@ -0,0 +1,123 @@
+--[[
+  ctf_protocol.lua - Wireshark dissector for the CTF server protocol.
+
+  Usage: wireshark -X lua_script:ctf_protocol.lua capture/capture-00000001.pcapng
+  or copy it into the personal Lua plugins folder (Help > About > Folders).
+
+  Every frame starts with the 12-byte header, all fields big-endian:
+
+    offset 0  u16  flags    COMPRESSED 0x1, ACCEPT_COMPRESSED 0x2, STREAM_START 0x4,
+                            STREAM_DATA 0x8, STREAM_END 0x10, ACCEPT_STREAM 0x20
+    offset 2  u16  command  see the table below
+    offset 4  u32  size     payload bytes that follow
+    offset 8  u32  checksum of the payload (CRC32 unless HELLO negotiated otherwise)
+
+  After a HELLO that negotiates version 2, a u32 request ID follows the header
+  in both directions. Wireshark cannot see the negotiation result reliably, so
+  set the "Request IDs" preference (Edit > Preferences > Protocols > CTF) when
+  looking at version 2 connections. The port defaults to the server's 8080.
+]]
+
+local ctf = Proto("ctf", "CTF Server Protocol")
+
+local commands = {
+    [0] = "NONE",
+    [100] = "LOGIN",
+    [101] = "TOGGLE_MAINTENANCE",
+    [102] = "SET_ONLINE",
+    [103] = "REQUEST_FLAG_IMAGE",
+    [104] = "HELLO",
+    [105] = "BATCH",
+    [106] = "STATS",
+    [107] = "PROFILE",
+    [200] = "ACK",
+    [400] = "ERROR",
+}
+
+local HEADER_SIZE = 12
+
+local f_flags = ProtoField.uint16("ctf.flags", "Flags", base.HEX)
+local f_compressed = ProtoField.bool("ctf.flags.compressed", "Compressed", 16, nil, 0x0001)
+local f_accept_compressed = ProtoField.bool("ctf.flags.accept_compressed", "Accept compressed", 16, nil, 0x0002)
+local f_stream_start = ProtoField.bool("ctf.flags.stream_start", "Stream start", 16, nil, 0x0004)
+local f_stream_data = ProtoField.bool("ctf.flags.stream_data", "Stream data", 16, nil, 0x0008)
+local f_stream_end = ProtoField.bool("ctf.flags.stream_end", "Stream end", 16, nil, 0x0010)
+local f_accept_stream = ProtoField.bool("ctf.flags.accept_stream", "Accept stream", 16, nil, 0x0020)
+local f_command = ProtoField.uint16("ctf.command", "Command", base.DEC, commands)
+local f_size = ProtoField.uint32("ctf.size", "Payload size", base.DEC)
+local f_checksum = ProtoField.uint32("ctf.checksum", "Checksum", base.HEX)
+local f_request_id = ProtoField.uint32("ctf.request_id", "Request ID", base.DEC)
+local f_payload = ProtoField.bytes("ctf.payload", "Payload")
+local f_text = ProtoField.string("ctf.text", "Text")
+
+ctf.fields = {
+    f_flags, f_compressed, f_accept_compressed, f_stream_start, f_stream_data, f_stream_end, f_accept_stream,
+    f_command, f_size, f_checksum, f_request_id, f_payload, f_text,
+}
+
+ctf.prefs.port = Pref.uint("TCP port", 8080, "Port the CTF server listens on")
+ctf.prefs.request_ids = Pref.bool("Request IDs", false, "A 4-byte request ID follows each header (protocol version 2)")
+
+local function prefix_size()
+    return HEADER_SIZE + (ctf.prefs.request_ids and 4 or 0)
+end
+
+local function frame_length(tvb, pinfo, offset)
+    return prefix_size() + tvb(offset + 4, 4):uint()
+end
+
+-- Commands whose payload is readable text: LOGIN credentials, ACK/ERROR messages, STATS JSON, PROFILE actions.
+local text_commands = { [100] = true, [106] = true, [107] = true, [200] = true, [400] = true }
+
+local function dissect_frame(tvb, pinfo, tree)
+    local command = tvb(2, 2):uint()
+    local flags = tvb(0, 2)
+    local size = tvb(4, 4):uint()
+    local name = commands[command] or tostring(command)
+
+    local subtree = tree:add(ctf, tvb(), "CTF " .. name)
+    local flags_tree = subtree:add(f_flags, flags)
+    flags_tree:add(f_compressed, flags)
+    flags_tree:add(f_accept_compressed, flags)
+    flags_tree:add(f_stream_start, flags)
+    flags_tree:add(f_stream_data, flags)
+    flags_tree:add(f_stream_end, flags)
+    flags_tree:add(f_accept_stream, flags)
+    subtree:add(f_command, tvb(2, 2))
+    subtree:add(f_size, tvb(4, 4))
+    subtree:add(f_checksum, tvb(8, 4))
+
+    local offset = HEADER_SIZE
+    if ctf.prefs.request_ids then
+        subtree:add(f_request_id, tvb(offset, 4))
+        offset = offset + 4
+    end
+    if size > 0 then
+        local payload = tvb(offset, size)
+        subtree:add(f_payload, payload)
+        if text_commands[command] and bit.band(flags:uint(), 0x0001) == 0 then
+            subtree:add(f_text, payload)
+        end
+    end
+
+    pinfo.cols.protocol = "CTF"
+    pinfo.cols.info = name .. " size=" .. size
+    return tvb:len()
+end
+
+function ctf.dissector(tvb, pinfo, tree)
+    -- Frames may span or share TCP segments; let the TCP layer reassemble them.
+    dissect_tcp_pdus(tvb, tree, prefix_size(), frame_length, dissect_frame)
+    return tvb:len()
+end
+
+local registered_port = ctf.prefs.port
+DissectorTable.get("tcp.port"):add(registered_port, ctf)
+
+function ctf.prefs_changed()
+    if registered_port ~= ctf.prefs.port then
+        DissectorTable.get("tcp.port"):remove(registered_port, ctf)
+        registered_port = ctf.prefs.port
+        DissectorTable.get("tcp.port"):add(registered_port, ctf)
+    end
+end
@@ -0,0 +1,425 @@
+/**
+ * @file trace.h
+ * @brief Sampled request span tracing into per-thread buffers, dumped as Chrome trace-event JSON.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @brief Settings of Tracer, read from the "trace" block of db_config.json.
+ */
+struct TraceConfig {
+    /** @brief Trace at all. */
+    bool enabled = true;
+
+    /** @brief Trace one request in this many; 1 traces every request. */
+    uint64_t sampleEvery = 100;
+
+    /**
+     * @brief Spans kept per thread; the oldest are overwritten once a buffer is full.
+     *
+     * Buffers start empty and grow as spans are recorded, so an idle or
+     * rarely sampled thread costs next to nothing.
+     */
+    size_t bufferSpans = 1024;
+
+    /** @brief Directory dumps are written to; created if missing. */
+    std::string dir = "traces";
+};
+
+/**
+ * @brief A finished span as stored in a thread's buffer.
+ */
+struct TraceSpan {
+    /** @brief Static string naming the stage, e.g. "recv.header". */
+    const char* name;
+
+    /** @brief Start, in nanoseconds since the tracer was created. */
+    uint64_t start;
+
+    /** @brief Length in nanoseconds. */
+    uint64_t duration;
+
+    /** @brief Connection number (as in the audit log), or 0 for background work. */
+    uint64_t connection;
+
+    /** @brief Request ID from the wire (version 2 connections), else 0. */
+    uint32_t request;
+
+    /** @brief Request number on its connection, or batch number for background work. */
+    uint32_t sequence;
+
+    /** @brief Kernel ID of the thread that ran it. */
+    uint32_t tid;
+};
+
+class Tracer;
+
+/**
+ * @brief The request a thread is currently working for.
+ *
+ * Carried into worker and event loop callbacks so their spans are tied to
+ * the same request. A context without a tracer is not sampled, and spans
+ * opened under it cost one thread-local load.
+ */
+struct TraceContext {
+    Tracer* tracer = nullptr;
+    uint64_t connection = 0;
+    uint32_t request = 0;
+    uint32_t sequence = 0;
+
+    bool sampled() const { return tracer != nullptr; }
+};
+
+namespace trace {
+
+/** @brief The calling thread's context. */
+inline TraceContext& current() {
+    thread_local TraceContext context;
+    return context;
+}
+
+/** @brief Set by the SIGUSR1 handler and taken by the dump thread. */
+inline std::atomic<bool>& dumpRequested() {
+    static std::atomic<bool> requested{ false };
+    return requested;
+}
+
+/** @brief Async-signal-safe handler that only flags a dump. */
+inline void onDumpSignal(int) {
+    dumpRequested().store(true, std::memory_order_relaxed);
+}
+
+/** @brief Kernel thread ID, which is what trace viewers show as tid. */
+inline uint32_t threadId() {
+    thread_local const uint32_t tid = static_cast<uint32_t>(::syscall(SYS_gettid));
+    return tid;
+}
+
+/** @brief Writes a string as a JSON string literal. */
+inline void appendJsonString(std::string& out, const char* text) {
+    out += '"';
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') out += '\\';
+        if (static_cast<unsigned char>(*c) < 0x20) continue;
+        out += *c;
+    }
+    out += '"';
+}
+
+/** @brief Nanoseconds as microseconds with three decimals, the unit of trace-event timestamps. */
+inline void appendMicros(std::string& out, uint64_t nanos) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%llu.%03llu", static_cast<unsigned long long>(nanos / 1000),
+                  static_cast<unsigned long long>(nanos % 1000));
+    out += buf;
+}
+
+} // namespace trace
+
+/**
+ * @brief Records spans of sampled requests and renders them for chrome://tracing or Perfetto.
+ *
+ * Sampling is decided once per request by begin(); every span opened while
+ * that context is current (see trace::Scope) is recorded, on whichever
+ * thread it runs. Each thread writes to its own ring buffer, whose lock is
+ * only ever contended by a dump, so tracing a request costs a few
+ * uncontended lock/unlock pairs, and no allocation once the buffer has grown
+ * to its full size. Buffers of threads that
+ * exit are handed to the next new thread, so there are never more buffers
+ * than threads alive at once, and a dump still shows what exited threads did.
+ */
+class Tracer {
+public:
+    explicit Tracer(const TraceConfig& config = TraceConfig())
+        : config(config), epoch(std::chrono::steady_clock::now()),
+          id(nextId().fetch_add(1, std::memory_order_relaxed)) {
+        if (this->config.sampleEvery == 0) this->config.sampleEvery = 1;
+        if (this->config.bufferSpans == 0) this->config.bufferSpans = 1;
+    }
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    const TraceConfig& settings() const { return config; }
+
+    /**
+     * @brief Starts a request and decides whether it is traced.
+     * @return The context to make current; unsampled if tracing is off or the request is skipped.
+     */
+    TraceContext begin(uint64_t connection, uint32_t request, uint32_t sequence) {
+        if (!config.enabled || requests.fetch_add(1, std::memory_order_relaxed) % config.sampleEvery != 0) {
+            return TraceContext();
+        }
+        return TraceContext{ this, connection, request, sequence };
+    }
+
+    /** @brief Nanoseconds since the tracer was created. */
+    uint64_t now() const { return toNanos(std::chrono::steady_clock::now()); }
+
+    uint64_t toNanos(std::chrono::steady_clock::time_point time) const {
+        auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch).count();
+        return static_cast<uint64_t>(std::max<int64_t>(nanos, 0));
+    }
+
+    /** @brief Stores a finished span in the calling thread's buffer. */
+    void record(const TraceContext& context, const char* name, uint64_t start, uint64_t end) {
+        Buffer& buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        TraceSpan span{ name, start, end > start ? end - start : 0, context.connection, context.request,
+                        context.sequence, trace::threadId() };
+        if (buffer.spans.size() < config.bufferSpans) {
+            // Grow geometrically but never past the configured size.
+            if (buffer.spans.size() == buffer.spans.capacity()) {
+                buffer.spans.reserve(std::min(std::max<size_t>(64, buffer.spans.size() * 2), config.bufferSpans));
+            }
+            buffer.spans.push_back(span);
+            return;
+        }
+        buffer.spans[buffer.next] = span;
+        if (++buffer.next == buffer.spans.size()) buffer.next = 0;
+    }
+
+    /** @brief Copies out every buffered span, ordered by start time. */
+    std::vector<TraceSpan> collect() const {
+        std::vector<TraceSpan> out;
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        for (const auto& buffer : buffers) {
+            std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+            out.insert(out.end(), buffer->spans.begin(), buffer->spans.end());
+        }
+        std::sort(out.begin(), out.end(), [](const TraceSpan& a, const TraceSpan& b) { return a.start < b.start; });
+        return out;
+    }
+
+    /**
+     * @brief Renders every buffered span in the Chrome trace-event JSON format.
+     *
+     * Spans are complete ("X") events in microseconds with the connection,
+     * request ID and sequence number as args, so Perfetto can filter on them.
+     */
+    std::string render() const {
+        std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        std::string pid = std::to_string(::getpid());
+        for (const TraceSpan& span : collect()) {
+            if (!first) out += ',';
+            first = false;
+            out += "\n{\"name\":";
+            trace::appendJsonString(out, span.name);
+            out += ",\"cat\":\"";
+            out += span.connection != 0 ? "request" : "background";
+            out += "\",\"ph\":\"X\",\"pid\":" + pid + ",\"tid\":" + std::to_string(span.tid) +
+                   ",\"ts\":";
+            trace::appendMicros(out, span.start);
+            out += ",\"dur\":";
+            trace::appendMicros(out, span.duration);
+            out += ",\"args\":{\"connection\":" + std::to_string(span.connection) +
+                   ",\"request\":" + std::to_string(span.request) + ",\"sequence\":" + std::to_string(span.sequence) +
+                   "}}";
+        }
+        out += "\n]}\n";
+        return out;
+    }
+
+    /**
+     * @brief Writes render() to a new file in the configured directory.
+     * @return Path of the file written.
+     * @throw std::runtime_error If the directory or file cannot be written.
+     */
+    std::string dump() const {
+        if (::mkdir(config.dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::runtime_error("Trace: cannot create directory " + config.dir);
+        }
+        auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::system_clock::now().time_since_epoch()).count();
+        std::string path = config.dir + "/trace-" + std::to_string(millis) + ".json";
+        std::string temp = path + ".tmp";
+        std::string body = render();
+        std::FILE* file = std::fopen(temp.c_str(), "wb");
+        bool ok = file != nullptr && std::fwrite(body.data(), 1, body.size(), file) == body.size();
+        if (file != nullptr && std::fclose(file) != 0) ok = false;
+        // Written aside and renamed, so a reader never opens a half-written dump.
+        if (!ok || std::rename(temp.c_str(), path.c_str()) != 0) {
+            std::remove(temp.c_str());
+            throw std::runtime_error("Trace: cannot write " + path);
+        }
+        return path;
+    }
+
+    /** @brief Number of per-thread buffers allocated so far. */
+    size_t bufferCount() const {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        return buffers.size();
+    }
+
+private:
+    struct Buffer {
+        std::mutex mutex;
+        /** @brief Grows up to bufferSpans, then is overwritten oldest first. */
+        std::vector<TraceSpan> spans;
+        /** @brief The slot the next span overwrites once the buffer is full. */
+        size_t next = 0;
+        /** @brief Its thread exited; the buffer can be handed to another one. */
+        std::atomic<bool> free{ false };
+    };
+
+    /** @brief Gives the buffer back when its thread exits. */
+    struct Holder {
+        uint64_t tracer = 0;
+        std::shared_ptr<Buffer> buffer;
+
+        ~Holder() {
+            if (buffer) buffer->free.store(true, std::memory_order_release);
+        }
+    };
+
+    TraceConfig config;
+    std::chrono::steady_clock::time_point epoch;
+    /** @brief Identifies this tracer in thread-local holders; unlike its address, never reused. */
+    uint64_t id;
+    std::atomic<uint64_t> requests{ 0 };
+    mutable std::mutex buffersMutex;
+    std::vector<std::shared_ptr<Buffer>> buffers;
+
+    static std::atomic<uint64_t>& nextId() {
+        static std::atomic<uint64_t> next{ 1 };
+        return next;
+    }
+
+    Buffer& threadBuffer() {
+        thread_local Holder holder;
+        if (holder.tracer == id) return *holder.buffer;
+        if (holder.buffer) holder.buffer->free.store(true, std::memory_order_release);
+        holder.tracer = id;
+        holder.buffer = acquireBuffer();
+        return *holder.buffer;
+    }
+
+    std::shared_ptr<Buffer> acquireBuffer() {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        for (const auto& buffer : buffers) {
+            bool expected = true;
+            if (buffer->free.compare_exchange_strong(expected, false, std::memory_order_acq_rel)) return buffer;
+        }
+        auto buffer = std::make_shared<Buffer>();
+        buffers.push_back(buffer);
+        return buffer;
+    }
+};
+
+namespace trace {
+
+/**
+ * @brief Makes a context current on this thread for the scope's lifetime.
+ */
+class Scope {
+public:
+    explicit Scope(const TraceContext& context) : saved(current()) { current() = context; }
+    ~Scope() { current() = saved; }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    TraceContext saved;
+};
+
+/**
+ * @brief Times the enclosing block as a span of the current request, if it is sampled.
+ * @param name Must outlive the tracer; use string literals.
+ */
+class Span {
+public:
+    explicit Span(const char* name) : context(current()), name(name), start(0) {
+        if (context.sampled()) start = context.tracer->now();
+    }
+
+    ~Span() {
+        if (context.sampled()) context.tracer->record(context, name, start, context.tracer->now());
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    TraceContext context;
+    const char* name;
+    uint64_t start;
+};
+
+/** @brief Records a span that started before its request was sampled, e.g. the header read. */
+inline void record(const char* name, std::chrono::steady_clock::time_point start,
+                   std::chrono::steady_clock::time_point end) {
+    const TraceContext& context = current();
+    if (context.sampled()) context.tracer->record(context, name, context.tracer->toNanos(start),
+                                                  context.tracer->toNanos(end));
+}
+
+} // namespace trace
+
+/**
+ * @brief Writes a trace dump whenever one is requested with SIGUSR1.
+ *
+ * The signal handler only sets a flag; this thread polls it, so nothing
+ * but an atomic store runs in signal context.
+ */
+class TraceDumper {
+public:
+    explicit TraceDumper(const Tracer& tracer) : tracer(tracer), stopping(false) {
+        thread = std::thread(&TraceDumper::run, this);
+    }
+
+    ~TraceDumper() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeCv.notify_all();
+        thread.join();
+    }
+
+    TraceDumper(const TraceDumper&) = delete;
+    TraceDumper& operator=(const TraceDumper&) = delete;
+
+private:
+    const Tracer& tracer;
+    std::mutex mutex;
+    std::condition_variable wakeCv;
+    bool stopping;
+    std::thread thread;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            wakeCv.wait_for(lock, std::chrono::milliseconds(200));
+            if (!trace::dumpRequested().exchange(false, std::memory_order_relaxed)) continue;
+            try {
+                std::cout << "Trace written to " << tracer.dump() << "\n";
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << "\n";
+            }
+        }
+    }
+};
+
+#endif // TRACE_H
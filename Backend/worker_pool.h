@@ -0,0 +1,102 @@
+/**
+ * @file worker_pool.h
+ * @brief Fixed-size thread pool used for handlers that perform blocking work.
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "instrumented_mutex.h"
+
+/**
+ * @brief A small pool of long-lived threads that execute submitted tasks in FIFO order.
+ *
+ * Connection threads hand blocking handlers (database, file I/O) to the pool so that
+ * the number of concurrent blocking operations is bounded by the pool size rather
+ * than by the number of connected clients.
+ */
+class WorkerPool {
+private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    InstrumentedMutex queueMutex{ locks::site("worker_queue") };
+    std::condition_variable_any queueCv;
+    bool stopping;
+
+    void run() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<InstrumentedMutex> lock(queueMutex);
+                queueCv.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    /**
+     * @brief Starts the worker threads.
+     * @param count Number of threads; at least one is always started.
+     */
+    explicit WorkerPool(size_t count) : stopping(false) {
+        if (count == 0) count = 1;
+        for (size_t i = 0; i < count; i++) {
+            threads.emplace_back(&WorkerPool::run, this);
+        }
+    }
+
+    /**
+     * @brief Drains the remaining tasks and joins every worker thread.
+     */
+    ~WorkerPool() {
+        {
+            std::lock_guard<InstrumentedMutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueCv.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /**
+     * @brief Queues a callable for execution on a worker thread.
+     * @param fn The callable to run.
+     * @return A future that receives the callable's result (or exception).
+     */
+    template <typename Fn>
+    auto submit(Fn&& fn) -> std::future<decltype(fn())> {
+        using Result = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<InstrumentedMutex> lock(queueMutex);
+            tasks.emplace_back([task] { (*task)(); });
+        }
+        queueCv.notify_one();
+        return result;
+    }
+
+    /**
+     * @brief Retrieves the number of worker threads.
+     * @return The pool size.
+     */
+    size_t size() const {
+        return threads.size();
+    }
+};
+
+#endif // WORKER_POOL_H
@@ -1,11 +1,30 @@
 const net = require('net');
 const WebSocket = require('ws');
 const crc32 = require('crc-32');
+const zlib = require('zlib');
 
 const TCP_PORT = 8080;
 const TCP_HOST = '127.0.0.1'; 
 const WS_PORT = 3000;
 
+// Flag bits carried in the upper 16 bits of the command word (see packet.h)
+const FLAG_COMPRESSED = 0x0001;
+const FLAG_ACCEPT_COMPRESSED = 0x0002;
+const FLAG_STREAM_START = 0x0004;
+const FLAG_STREAM_DATA = 0x0008;
+const FLAG_STREAM_END = 0x0010;
+const FLAG_ACCEPT_STREAM = 0x0020;
+const STREAM_FLAGS = FLAG_STREAM_START | FLAG_STREAM_DATA | FLAG_STREAM_END;
+
+// Compressed payloads are a 4-byte big-endian original length followed by a zlib stream
+function decodePayload(payloadBuffer, flags) {
+    if (!(flags & FLAG_COMPRESSED)) return payloadBuffer;
+    const originalSize = payloadBuffer.readUInt32BE(0);
+    const decoded = zlib.inflateSync(payloadBuffer.subarray(4));
+    if (decoded.length !== originalSize) throw new Error('Compressed payload size mismatch');
+    return decoded;
+}
+
 const wss = new WebSocket.Server({ port: WS_PORT });
 
 wss.on('connection', (ws) => {
@@ -18,7 +37,7 @@ wss.on('connection', (ws) => {
             const payloadBuffer = Buffer.from(data.payload || '', 'utf-8');
             const headerBuffer = Buffer.alloc(12);
             
-            headerBuffer.writeUInt32BE(data.command, 0); 
+            headerBuffer.writeUInt32BE((((FLAG_ACCEPT_COMPRESSED | FLAG_ACCEPT_STREAM) << 16) | data.command) >>> 0, 0);
             headerBuffer.writeUInt32BE(payloadBuffer.length, 4);
             headerBuffer.writeUInt32BE(crc32.buf(payloadBuffer) >>> 0, 8);
 
@@ -27,22 +46,59 @@ wss.on('connection', (ws) => {
     });
 
     let receiveBuffer = Buffer.alloc(0);
+    let activeStream = null;
+
+    const deliver = (commandID, flags, payloadBuffer) => {
+        let decoded;
+        try {
+            decoded = decodePayload(payloadBuffer, flags);
+        } catch (err) {
+            console.error('Decode Error:', err);
+            return;
+        }
+        // If it's a huge payload (like our 1MB image), we convert to Base64 so React can display it
+        const isImage = decoded.length > 5000;
+        const payloadContent = isImage ? decoded.toString('base64') : decoded.toString('utf-8');
+        ws.send(JSON.stringify({ command: commandID, payload: payloadContent, isImage }));
+    };
+
+    // Chunked replies: START carries the total size, DATA the chunks, END the total CRC and size
+    const handleStreamFrame = (commandID, flags, frame) => {
+        if (flags & FLAG_STREAM_START) {
+            activeStream = { commandID, flags: flags & ~STREAM_FLAGS, total: Number(frame.readBigUInt64BE(0)), chunks: [], received: 0, crc: 0 };
+        } else if (activeStream && (flags & FLAG_STREAM_DATA)) {
+            activeStream.chunks.push(Buffer.from(frame));
+            activeStream.received += frame.length;
+            activeStream.crc = crc32.buf(frame, activeStream.crc);
+        } else if (activeStream && (flags & FLAG_STREAM_END)) {
+            const totalCrc = frame.readUInt32BE(0);
+            const totalSize = Number(frame.readBigUInt64BE(4));
+            const stream = activeStream;
+            activeStream = null;
+            if (totalSize !== stream.total || stream.received !== stream.total || totalCrc !== (stream.crc >>> 0)) {
+                console.error('Stream Error: size or CRC mismatch');
+                return;
+            }
+            deliver(stream.commandID, stream.flags, Buffer.concat(stream.chunks));
+        }
+    };
 
     tcpClient.on('data', (data) => {
         receiveBuffer = Buffer.concat([receiveBuffer, data]);
 
         while (receiveBuffer.length >= 12) {
-            const commandID = receiveBuffer.readUInt32BE(0);
+            const commandWord = receiveBuffer.readUInt32BE(0);
+            const commandID = commandWord & 0xFFFF;
+            const flags = commandWord >>> 16;
             const payloadSize = receiveBuffer.readUInt32BE(4);
             
             if (receiveBuffer.length >= 12 + payloadSize) {
                 const payloadBuffer = receiveBuffer.subarray(12, 12 + payloadSize);
-                
-                // If it's a huge payload (like our 1MB image), we convert to Base64 so React can display it
-                const isImage = payloadSize > 5000; 
-                const payloadContent = isImage ? payloadBuffer.toString('base64') : payloadBuffer.toString('utf-8');
-
-                ws.send(JSON.stringify({ command: commandID, payload: payloadContent, isImage }));
+                if (flags & STREAM_FLAGS) {
+                    handleStreamFrame(commandID, flags, payloadBuffer);
+                } else {
+                    deliver(commandID, flags, payloadBuffer);
+                }
                 receiveBuffer = receiveBuffer.subarray(12 + payloadSize);
             } else {
                 break; 
@@ -1,16 +1,23 @@
 // Middleware/system_tests.js
 // System tests for the C++ backend over raw TCP
-// Requires: backend server running on localhost:8080
+// Requires: backend server running on localhost:8080 (metrics on 9101)
+// Admin command tests run when CTF_ADMIN_TOKEN holds the server's admin.token
 // Run with: node --test system_tests.js
 
 const { describe, it } = require('node:test');
 const assert = require('node:assert');
 const net = require('net');
 const crc32 = require('crc-32');
+const crc32c = require('crc-32/crc32c');
+const zlib = require('zlib');
+const http = require('http');
 
 const TCP_PORT = 8080;
 const TCP_HOST = '127.0.0.1';
 const HEADER_SIZE = 12;
+const METRICS_PORT = 9101;
+const ADMIN_TOKEN = process.env.CTF_ADMIN_TOKEN || '';
+const NEEDS_ADMIN = ADMIN_TOKEN ? false : 'set CTF_ADMIN_TOKEN to the server\'s admin.token';
 
 // Command IDs matching packet.h
 const Command = {
@@ -19,31 +26,146 @@ const Command = {
     TOGGLE_MAINTENANCE: 101,
     SET_ONLINE: 102,
     REQUEST_FLAG_IMAGE: 103,
+    HELLO: 104,
+    BATCH: 105,
+    STATS: 106,
+    PROFILE: 107,
     ACK: 200,
     ERROR: 400
 };
 
+// Flag bits carried in the upper 16 bits of the command word
+const FLAG_COMPRESSED = 0x0001;
+const FLAG_ACCEPT_COMPRESSED = 0x0002;
+const FLAG_STREAM_START = 0x0004;
+const FLAG_STREAM_DATA = 0x0008;
+const FLAG_STREAM_END = 0x0010;
+const FLAG_ACCEPT_STREAM = 0x0020;
+
 // Build a binary packet matching the NetworkPacket format
-function buildPacket(commandID, payload) {
+function buildPacket(commandID, payload, flags = 0) {
     const payloadBuffer = Buffer.from(payload, 'utf-8');
     const header = Buffer.alloc(HEADER_SIZE);
-    header.writeUInt32BE(commandID, 0);
+    header.writeUInt32BE(((flags << 16) | commandID) >>> 0, 0);
     header.writeUInt32BE(payloadBuffer.length, 4);
     header.writeUInt32BE(crc32.buf(payloadBuffer) >>> 0, 8);
     return Buffer.concat([header, payloadBuffer]);
 }
 
+// Build a BATCH packet: each sub-packet is prefixed with its 4-byte big-endian length
+function buildBatch(packets) {
+    const parts = [];
+    for (const packet of packets) {
+        const prefix = Buffer.alloc(4);
+        prefix.writeUInt32BE(packet.length, 0);
+        parts.push(prefix, packet);
+    }
+    const payload = Buffer.concat(parts);
+    const header = Buffer.alloc(HEADER_SIZE);
+    header.writeUInt32BE(Command.BATCH, 0);
+    header.writeUInt32BE(payload.length, 4);
+    header.writeUInt32BE(crc32.buf(payload) >>> 0, 8);
+    return Buffer.concat([header, payload]);
+}
+
+// Split a BATCH reply payload into its parsed sub-replies
+function splitBatch(payload) {
+    const replies = [];
+    let offset = 0;
+    while (offset < payload.length) {
+        const size = payload.readUInt32BE(offset);
+        replies.push(parsePacket(payload.subarray(offset + 4, offset + 4 + size)));
+        offset += 4 + size;
+    }
+    return replies;
+}
+
+// HELLO capability bits (see handshake.h)
+const CHECKSUM_CRC32 = 0x0001;
+const CHECKSUM_CRC32C = 0x0002;
+const COMPRESSION_ZLIB = 0x0001;
+const FEATURE_STREAM = 0x0001;
+const FEATURE_MULTIPLEX = 0x0002;
+
+function buildHello(version, checksums, compression, features, maxFrameSize) {
+    const payload = Buffer.alloc(12);
+    payload.writeUInt16BE(version, 0);
+    payload.writeUInt16BE(checksums, 2);
+    payload.writeUInt16BE(compression, 4);
+    payload.writeUInt16BE(features, 6);
+    payload.writeUInt32BE(maxFrameSize, 8);
+    const header = Buffer.alloc(HEADER_SIZE);
+    header.writeUInt32BE(Command.HELLO, 0);
+    header.writeUInt32BE(payload.length, 4);
+    header.writeUInt32BE(crc32.buf(payload) >>> 0, 8);
+    return Buffer.concat([header, payload]);
+}
+
+// Build a version 2 packet: legacy header, 4-byte request ID, payload, CRC32C checksum
+function buildPacketV2(commandID, payload, requestId, checksum = (buf) => crc32c.buf(buf) >>> 0) {
+    const payloadBuffer = Buffer.from(payload, 'utf-8');
+    const header = Buffer.alloc(HEADER_SIZE + 4);
+    header.writeUInt32BE(commandID, 0);
+    header.writeUInt32BE(payloadBuffer.length, 4);
+    header.writeUInt32BE(checksum(payloadBuffer), 8);
+    header.writeUInt32BE(requestId, 12);
+    return Buffer.concat([header, payloadBuffer]);
+}
+
+// Helper: send on an existing socket and collect `count` version 2 replies
+function receiveV2(client, packet, count = 1, timeout = 10000) {
+    return new Promise((resolve, reject) => {
+        const timer = setTimeout(() => { reject(new Error('Timeout')); }, timeout);
+        let receiveBuffer = Buffer.alloc(0);
+        const replies = [];
+
+        const onData = (data) => {
+            receiveBuffer = Buffer.concat([receiveBuffer, data]);
+            while (receiveBuffer.length >= HEADER_SIZE + 4) {
+                const payloadSize = receiveBuffer.readUInt32BE(4);
+                if (receiveBuffer.length < HEADER_SIZE + 4 + payloadSize) break;
+                replies.push({
+                    command: receiveBuffer.readUInt32BE(0) & 0xFFFF,
+                    crc: receiveBuffer.readUInt32BE(8),
+                    requestId: receiveBuffer.readUInt32BE(12),
+                    payload: receiveBuffer.subarray(HEADER_SIZE + 4, HEADER_SIZE + 4 + payloadSize)
+                });
+                receiveBuffer = receiveBuffer.subarray(HEADER_SIZE + 4 + payloadSize);
+            }
+            if (replies.length >= count) {
+                clearTimeout(timer);
+                client.removeListener('data', onData);
+                resolve(replies);
+            }
+        };
+
+        client.on('data', onData);
+        client.write(packet);
+    });
+}
+
 // Parse a response packet from the server
 function parsePacket(buffer) {
     if (buffer.length < HEADER_SIZE) throw new Error('Response too small');
     return {
-        command: buffer.readUInt32BE(0),
+        command: buffer.readUInt32BE(0) & 0xFFFF,
+        flags: buffer.readUInt32BE(0) >>> 16,
         payloadSize: buffer.readUInt32BE(4),
         crc: buffer.readUInt32BE(8),
         payload: buffer.subarray(HEADER_SIZE).toString('utf-8')
     };
 }
 
+// Undo FLAG_COMPRESSED: 4-byte big-endian original length followed by a zlib stream
+function decodePayload(buffer) {
+    const response = parsePacket(buffer);
+    const payload = buffer.subarray(HEADER_SIZE, HEADER_SIZE + response.payloadSize);
+    if (!(response.flags & FLAG_COMPRESSED)) return payload;
+    const decoded = zlib.inflateSync(payload.subarray(4));
+    assert.strictEqual(decoded.length, payload.readUInt32BE(0));
+    return decoded;
+}
+
 // Helper: connect, send a packet, receive response
 function sendAndReceive(packet, timeout = 3000) {
     return new Promise((resolve, reject) => {
@@ -94,6 +216,36 @@ function sendOnSocket(client, packet, timeout = 10000) {
     });
 }
 
+// Helper: send on an existing socket and collect frames until a stream END frame
+function receiveStream(client, packet, timeout = 10000) {
+    return new Promise((resolve, reject) => {
+        const timer = setTimeout(() => { reject(new Error('Timeout')); }, timeout);
+        let receiveBuffer = Buffer.alloc(0);
+        const frames = [];
+
+        const onData = (data) => {
+            receiveBuffer = Buffer.concat([receiveBuffer, data]);
+            while (receiveBuffer.length >= HEADER_SIZE) {
+                const payloadSize = receiveBuffer.readUInt32BE(4);
+                if (receiveBuffer.length < HEADER_SIZE + payloadSize) break;
+                const frame = receiveBuffer.subarray(0, HEADER_SIZE + payloadSize);
+                receiveBuffer = receiveBuffer.subarray(HEADER_SIZE + payloadSize);
+                frames.push(frame);
+                const flags = frame.readUInt32BE(0) >>> 16;
+                if (!(flags & (FLAG_STREAM_START | FLAG_STREAM_DATA)) || (flags & FLAG_STREAM_END)) {
+                    clearTimeout(timer);
+                    client.removeListener('data', onData);
+                    resolve(frames);
+                    return;
+                }
+            }
+        };
+
+        client.on('data', onData);
+        client.write(packet);
+    });
+}
+
 // Helper: just connect, no send
 function connectOnly(timeout = 2000) {
     return new Promise((resolve, reject) => {
@@ -191,7 +343,223 @@ describe('Backend System Tests', () => {
         client2.destroy();
     });
 
-    // Test 10: Server survives client disconnect mid-transfer
+    // Test 10: SET_ONLINE returns an ACK (must login first on same connection)
+    it('should respond to SET_ONLINE with an ACK', async () => {
+        const client = await connectOnly();
+        await sendOnSocket(client, buildPacket(Command.LOGIN, 'admin:admin'));
+        const response = parsePacket(await sendOnSocket(client, buildPacket(Command.SET_ONLINE, '')));
+        client.destroy();
+        assert.strictEqual(response.command, Command.ACK);
+    });
+
+    // Test 11: Admin commands are refused before LOGIN
+    it('should reject TOGGLE_MAINTENANCE without LOGIN', async () => {
+        const response = parsePacket(await sendAndReceive(buildPacket(Command.TOGGLE_MAINTENANCE, '')));
+        assert.strictEqual(response.command, Command.ERROR);
+        assert.ok(response.payload.includes('Unauthorized'), `Got: ${response.payload}`);
+    });
+
+    // Test 12: A header declaring an oversized payload is rejected without sending the payload
+    it('should reject an oversized payload declared in the header', async () => {
+        const header = Buffer.alloc(HEADER_SIZE);
+        header.writeUInt32BE(Command.LOGIN, 0);
+        header.writeUInt32BE(0xFFFFFFF0, 4);
+        header.writeUInt32BE(0, 8);
+        const response = parsePacket(await sendAndReceive(header));
+        assert.strictEqual(response.command, Command.ERROR);
+        assert.ok(response.payload.includes('Payload too large'), `Got: ${response.payload}`);
+    });
+
+    // Test 13: Clients that accept compression get the same flag image bytes
+    it('should return an identical flag image when compression is accepted', async () => {
+        const client = await connectOnly();
+        await sendOnSocket(client, buildPacket(Command.LOGIN, 'admin:admin'));
+        const plain = await sendOnSocket(client, buildPacket(Command.REQUEST_FLAG_IMAGE, ''));
+        const packed = await sendOnSocket(client, buildPacket(Command.REQUEST_FLAG_IMAGE, '', FLAG_ACCEPT_COMPRESSED));
+        client.destroy();
+        assert.strictEqual(parsePacket(plain).flags & FLAG_COMPRESSED, 0);
+        const packedResponse = parsePacket(packed);
+        assert.strictEqual(packedResponse.command, Command.ACK);
+        assert.ok(packedResponse.payloadSize <= parsePacket(plain).payloadSize);
+        assert.ok(decodePayload(plain).equals(decodePayload(packed)));
+    });
+
+    // Test 14: Streamed flag image arrives in bounded chunks and matches the single-packet reply
+    it('should stream the flag image in bounded chunks when streaming is accepted', async () => {
+        const client = await connectOnly();
+        await sendOnSocket(client, buildPacket(Command.LOGIN, 'admin:admin'));
+        const plain = await sendOnSocket(client, buildPacket(Command.REQUEST_FLAG_IMAGE, ''));
+        const frames = await receiveStream(client, buildPacket(Command.REQUEST_FLAG_IMAGE, '', FLAG_ACCEPT_STREAM));
+        client.destroy();
+
+        const start = parsePacket(frames[0]);
+        assert.ok(start.flags & FLAG_STREAM_START, 'first frame should be STREAM_START');
+        const total = Number(frames[0].readBigUInt64BE(HEADER_SIZE));
+
+        const chunks = [];
+        let crc = 0;
+        for (const frame of frames.slice(1, -1)) {
+            const chunk = parsePacket(frame);
+            assert.ok(chunk.flags & FLAG_STREAM_DATA);
+            assert.ok(chunk.payloadSize <= 16 * 1024, `Chunk too large: ${chunk.payloadSize}`);
+            const data = frame.subarray(HEADER_SIZE);
+            assert.strictEqual(chunk.crc, crc32.buf(data) >>> 0);
+            crc = crc32.buf(data, crc);
+            chunks.push(data);
+        }
+
+        const end = frames[frames.length - 1];
+        assert.ok(parsePacket(end).flags & FLAG_STREAM_END, 'last frame should be STREAM_END');
+        assert.strictEqual(end.readUInt32BE(HEADER_SIZE), crc >>> 0);
+        assert.strictEqual(Number(end.readBigUInt64BE(HEADER_SIZE + 4)), total);
+
+        const reassembled = Buffer.concat(chunks);
+        assert.strictEqual(reassembled.length, total);
+        assert.ok(reassembled.equals(plain.subarray(HEADER_SIZE)));
+    });
+
+    // Test 15: HELLO negotiates the cheapest common options
+    it('should negotiate protocol options with HELLO', async () => {
+        const client = await connectOnly();
+        const hello = buildHello(2, CHECKSUM_CRC32 | CHECKSUM_CRC32C, COMPRESSION_ZLIB, FEATURE_STREAM | FEATURE_MULTIPLEX, 8192);
+        const response = parsePacket(await sendOnSocket(client, hello));
+        client.destroy();
+
+        assert.strictEqual(response.command, Command.ACK);
+        const payload = Buffer.from(response.payload, 'latin1');
+        assert.strictEqual(payload.readUInt16BE(0), 2);
+        assert.strictEqual(payload.readUInt16BE(2), CHECKSUM_CRC32C);
+        assert.strictEqual(payload.readUInt16BE(4), COMPRESSION_ZLIB);
+        assert.strictEqual(payload.readUInt16BE(6), FEATURE_STREAM | FEATURE_MULTIPLEX);
+        assert.strictEqual(payload.readUInt32BE(8), 8192);
+    });
+
+    // Test 16: Version 2 replies echo the request ID and use the negotiated checksum
+    it('should echo request IDs and use CRC32C after a version 2 HELLO', async () => {
+        const client = await connectOnly();
+        await sendOnSocket(client, buildHello(2, CHECKSUM_CRC32C, 0, FEATURE_MULTIPLEX, 8192));
+        const [login] = await receiveV2(client, buildPacketV2(Command.LOGIN, 'v2user:v2pass', 41));
+        const [bad] = await receiveV2(client, buildPacketV2(Command.SET_ONLINE, '', 42, () => 0xDEADBEEF));
+        client.destroy();
+
+        assert.strictEqual(login.command, Command.ACK);
+        assert.strictEqual(login.requestId, 41);
+        assert.strictEqual(login.crc, crc32c.buf(login.payload) >>> 0);
+        assert.ok(login.payload.toString().includes('Login successful'));
+
+        assert.strictEqual(bad.command, Command.ERROR);
+        assert.strictEqual(bad.requestId, 42);
+        assert.ok(bad.payload.toString().includes('Checksum mismatch'));
+    });
+
+    // Test 17: HELLO is only accepted as the first packet
+    it('should refuse HELLO after other traffic', async () => {
+        const client = await connectOnly();
+        await sendOnSocket(client, buildPacket(Command.LOGIN, 'admin:admin'));
+        const response = parsePacket(await sendOnSocket(client, buildHello(2, CHECKSUM_CRC32, 0, 0, 8192)));
+        client.destroy();
+        assert.strictEqual(response.command, Command.ERROR);
+    });
+
+    // Test 18: BATCH runs every sub-request and replies to each one individually
+    it('should answer each sub-request of a BATCH in order', async () => {
+        const batch = buildBatch([
+            buildPacket(Command.TOGGLE_MAINTENANCE, ''),
+            buildPacket(Command.LOGIN, 'batchuser:batchpass'),
+            buildPacket(Command.TOGGLE_MAINTENANCE, ''),
+            buildPacket(999, ''),
+            buildPacket(Command.TOGGLE_MAINTENANCE, '')
+        ]);
+        const raw = await sendAndReceive(batch);
+        assert.strictEqual(parsePacket(raw).command, Command.ACK);
+
+        const replies = splitBatch(raw.subarray(HEADER_SIZE));
+        assert.strictEqual(replies.length, 5);
+        assert.strictEqual(replies[0].command, Command.ERROR);
+        assert.ok(replies[0].payload.includes('Unauthorized'));
+        assert.strictEqual(replies[1].command, Command.ACK);
+        assert.ok(replies[1].payload.includes('Login successful'));
+        assert.strictEqual(replies[2].command, Command.ACK);
+        assert.strictEqual(replies[3].command, Command.ERROR);
+        assert.ok(replies[3].payload.includes('Unknown command'));
+        assert.strictEqual(replies[4].command, Command.ACK);
+    });
+
+    // Test 19: Malformed BATCH payloads are refused as a whole
+    it('should reject a malformed BATCH', async () => {
+        const batch = buildBatch([buildPacket(Command.SET_ONLINE, '')]);
+        batch.writeUInt32BE(HEADER_SIZE + 50, HEADER_SIZE);
+        batch.writeUInt32BE(crc32.buf(batch.subarray(HEADER_SIZE)) >>> 0, 8);
+        const response = parsePacket(await sendAndReceive(batch));
+        assert.strictEqual(response.command, Command.ERROR);
+    });
+
+    // Test 20: STATS reports login heavy hitters and distinct addresses as JSON
+    it('should report login sketches with STATS', { skip: NEEDS_ADMIN }, async () => {
+        const client = await connectOnly();
+        await sendOnSocket(client, buildPacket(Command.LOGIN, 'stats_user:stats_pass'));
+        await sendOnSocket(client, buildPacket(Command.LOGIN, 'stats_user:stats_pass'));
+        const response = parsePacket(await sendOnSocket(client, buildPacket(Command.STATS, `${ADMIN_TOKEN} 5`)));
+        client.destroy();
+        assert.strictEqual(response.command, Command.ACK);
+        const stats = JSON.parse(response.payload);
+        assert.ok(stats.logins >= 2);
+        assert.ok(stats.unique_ips >= 1);
+        assert.ok(stats.top_usernames.length <= 5);
+        const user = stats.top_usernames.find(item => item.value === 'stats_user');
+        assert.ok(user && user.count >= 2);
+        assert.ok(stats.top_passwords.some(item => item.value === 'stats_pass'));
+        assert.ok(stats.latency.LOGIN.total.count >= 2);
+        assert.ok(stats.latency.LOGIN.total.p99_us >= stats.latency.LOGIN.total.p50_us);
+    });
+
+    // Test 21: The Prometheus endpoint counts connections, packets and bytes
+    it('should expose counters on the metrics endpoint', async () => {
+        const client = await connectOnly();
+        await sendOnSocket(client, buildPacket(Command.LOGIN, 'metrics_user:metrics_pass'));
+        client.destroy();
+        const body = await new Promise((resolve, reject) => {
+            http.get({ host: TCP_HOST, port: METRICS_PORT, path: '/metrics' }, res => {
+                assert.strictEqual(res.statusCode, 200);
+                let data = '';
+                res.on('data', chunk => data += chunk);
+                res.on('end', () => resolve(data));
+            }).on('error', reject);
+        });
+        const value = (series) => {
+            const line = body.split('\n').find(l => l.startsWith(series + ' '));
+            return line === undefined ? undefined : Number(line.slice(series.length + 1));
+        };
+        assert.ok(value('ctf_connections_accepted_total') >= 1);
+        assert.ok(value('ctf_packets_received_total{command="LOGIN"}') >= 1);
+        assert.ok(value('ctf_packets_sent_total{command="ACK"}') >= 1);
+        assert.ok(value('ctf_bytes_received_total') > 0);
+        assert.ok(value('ctf_bytes_sent_total') > 0);
+        assert.ok(body.includes('# TYPE ctf_connections_active gauge'));
+        assert.ok(value('ctf_request_stage_seconds_count{command="LOGIN",stage="total"}') >= 1);
+        assert.ok(body.includes('ctf_request_stage_seconds{command="LOGIN",stage="process",quantile="0.99"}'));
+    });
+
+    // Test 22: PROFILE starts and stops the built-in CPU profiler
+    it('should collect a CPU profile between PROFILE start and stop', { skip: NEEDS_ADMIN }, async () => {
+        const client = await connectOnly();
+        await sendOnSocket(client, buildPacket(Command.LOGIN, 'profile_user:profile_pass'));
+        const started = parsePacket(await sendOnSocket(client, buildPacket(Command.PROFILE, `${ADMIN_TOKEN} start 1000`)));
+        assert.strictEqual(started.command, Command.ACK);
+        const again = parsePacket(await sendOnSocket(client, buildPacket(Command.PROFILE, `${ADMIN_TOKEN} start`)));
+        assert.strictEqual(again.command, Command.ERROR);
+        for (let i = 0; i < 20; i++) {
+            await sendOnSocket(client, buildPacket(Command.STATS, `${ADMIN_TOKEN} 100`));
+        }
+        const stopped = parsePacket(await sendOnSocket(client, buildPacket(Command.PROFILE, `${ADMIN_TOKEN} stop`)));
+        client.destroy();
+        assert.strictEqual(stopped.command, Command.ACK);
+        const result = JSON.parse(stopped.payload);
+        assert.ok(result.samples >= 0);
+        assert.ok(result.path.endsWith('.folded'));
+    });
+
+    // Test 23: Server survives client disconnect mid-transfer
     it('should stay alive after a client disconnects abruptly', async () => {
         const client = await connectOnly();
         // Send partial packet then kill connection
@@ -204,4 +572,27 @@ describe('Backend System Tests', () => {
         assert.ok(client2);
         client2.destroy();
     });
+
+    // Test 24: Logging in is not enough to run the profiler
+    it('should refuse PROFILE without the admin token', async () => {
+        const client = await connectOnly();
+        await sendOnSocket(client, buildPacket(Command.LOGIN, 'attacker:guess'));
+        const bare = parsePacket(await sendOnSocket(client, buildPacket(Command.PROFILE, 'start 1000')));
+        const wrong = parsePacket(await sendOnSocket(client, buildPacket(Command.PROFILE, `x${ADMIN_TOKEN} start`)));
+        client.destroy();
+        assert.strictEqual(bare.command, Command.ERROR);
+        assert.ok(bare.payload.includes('Admin token required'));
+        assert.strictEqual(wrong.command, Command.ERROR);
+    });
+
+    // Test 25: Logging in is not enough to read the collected credentials and addresses
+    it('should refuse STATS without the admin token', async () => {
+        const client = await connectOnly();
+        await sendOnSocket(client, buildPacket(Command.LOGIN, 'attacker:guess'));
+        const response = parsePacket(await sendOnSocket(client, buildPacket(Command.STATS, '5')));
+        client.destroy();
+        assert.strictEqual(response.command, Command.ERROR);
+        assert.ok(response.payload.includes('Admin token required'));
+        assert.ok(!response.payload.includes('attacker'));
+    });
 });